@@ -13,6 +13,7 @@ document.addEventListener('DOMContentLoaded', () => {
 function initializeEventListeners() {
     document.getElementById('btnFeedNow').addEventListener('click', feedNow);
     document.getElementById('btnCancel').addEventListener('click', cancelFeeding);
+    document.getElementById('btnRefill').addEventListener('click', refillAll);
     document.getElementById('btnCapture').addEventListener('click', capturePhoto);
     document.getElementById('btnRefresh').addEventListener('click', refreshCamera);
     document.getElementById('btnSaveSchedule').addEventListener('click', saveSchedule);
@@ -51,9 +52,19 @@ function updateUI(data) {
     document.getElementById('feedingProgress').style.width = progress + '%';
     document.getElementById('progressText').textContent = progress.toFixed(1) + '%';
     
+    // Con una alimentación en curso, las nuevas peticiones quedan en cola
+    const queueDepth = data.feeding.queueDepth;
+    document.getElementById('feedingQueue').textContent = queueDepth > 0
+        ? queueDepth + ' (espera ' + Math.round(data.feeding.queueWaitMs / 1000) + ' s)'
+        : 'Vacía';
+    
     const isFeeding = data.feeding.inProgress;
-    document.getElementById('btnFeedNow').disabled = isFeeding;
-    document.getElementById('btnCancel').disabled = !isFeeding;
+    document.getElementById('btnCancel').disabled = !isFeeding && queueDepth === 0;
+    
+    const filled = data.feeding.compartmentsFilled;
+    document.getElementById('inventoryStatus').textContent =
+        filled + ' compartimentos' + (data.feeding.inventoryLow ? ' ⚠️' : '');
+    document.getElementById('btnRefill').disabled = isFeeding;
     
     // Sensores
     if (data.sensors.valid) {
@@ -64,7 +75,7 @@ function updateUI(data) {
     }
     
     document.getElementById('presence').textContent = 
-        data.sensors.presence ? 'Detectada' : 'No detectada';
+        data.sensors.presence ? 'Detectada (' + data.sensors.presenceConfidence + '%)' : 'No detectada';
     
     // Programación
     document.getElementById('nextFeeding').textContent = data.schedule.nextFeeding;
@@ -77,6 +88,13 @@ function updateUI(data) {
         (data.system.freeHeap / 1024).toFixed(1) + ' KB';
     document.getElementById('uptime').textContent = formatUptime(data.system.uptime);
     
+    // Consumo estimado: reposo entre plazos (light sleep si está disponible)
+    const power = data.system.power;
+    document.getElementById('powerStatus').textContent =
+        '~' + power.estimatedCurrentMa.toFixed(0) + ' mA (estimado), ' +
+        Math.round(power.wakeupsPerHour) + ' despertares/h' +
+        (power.lightSleep ? '' : ' (sin light sleep)');
+    
     // Timestamp
     document.getElementById('lastUpdate').textContent = new Date().toLocaleTimeString();
 }
@@ -90,7 +108,7 @@ async function feedNow() {
         const data = await response.json();
         
         if (data.success) {
-            showToast('Alimentación iniciada', 'success');
+            showToast(data.message, 'success');
         } else {
             showToast('Error: ' + data.message, 'error');
         }
@@ -114,6 +132,28 @@ async function cancelFeeding() {
     }
 }
 
+async function refillAll() {
+    if (!confirm('¿Marcar todos los compartimentos como rellenados?')) return;
+    
+    try {
+        const response = await fetch('/api/inventory', {
+            method: 'POST',
+            headers: { 'Content-Type': 'application/json' },
+            body: JSON.stringify({})
+        });
+        const data = await response.json();
+        
+        if (data.success) {
+            showToast(data.message, 'success');
+            updateStatus();
+        } else {
+            showToast('Error: ' + data.message, 'error');
+        }
+    } catch (error) {
+        showToast('Error de conexión', 'error');
+    }
+}
+
 // Cámara
 function refreshCamera() {
     const img = document.getElementById('cameraStream');
@@ -166,8 +206,11 @@ async function loadConfiguration() {
         
         if (data.success) {
             document.getElementById('autoEnabled').checked = data.config.autoEnabled;
+            document.getElementById('feedingSlots').value = data.config.feedingSlots;
             document.getElementById('feedingInterval').value = data.config.feedingInterval;
             document.getElementById('portionsPerDay').value = data.config.portionsPerDay;
+            document.getElementById('portionsPerFeeding').value = data.config.portionsPerFeeding;
+            document.getElementById('missedPolicy').value = data.config.missedPolicy;
             document.getElementById('requirePresence').checked = data.config.requirePresence;
             document.getElementById('playSound').checked = data.config.playSound;
             document.getElementById('tempAlerts').checked = data.config.tempAlerts;
@@ -181,8 +224,11 @@ async function loadConfiguration() {
 async function saveSchedule() {
     const config = {
         autoEnabled: document.getElementById('autoEnabled').checked,
+        feedingSlots: document.getElementById('feedingSlots').value,
         feedingInterval: parseInt(document.getElementById('feedingInterval').value),
-        portionsPerDay: parseInt(document.getElementById('portionsPerDay').value)
+        portionsPerDay: parseInt(document.getElementById('portionsPerDay').value),
+        portionsPerFeeding: parseInt(document.getElementById('portionsPerFeeding').value),
+        missedPolicy: parseInt(document.getElementById('missedPolicy').value)
     };
     
     try {
@@ -197,7 +243,7 @@ async function saveSchedule() {
         if (data.success) {
             showToast('Configuración guardada', 'success');
         } else {
-            showToast('Error al guardar', 'error');
+            showToast('Error: ' + data.message, 'error');
         }
     } catch (error) {
         showToast('Error de conexión', 'error');
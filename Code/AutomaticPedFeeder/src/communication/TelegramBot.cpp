@@ -2,15 +2,16 @@
 
 TelegramBotManager* TelegramBotManager::instance = nullptr;
 
-TelegramBotManager::TelegramBotManager(FeedingLogic* feeding, StepperController* stepper,
-                                       SensorManager* sensors, CameraController* camera)
+TelegramBotManager::TelegramBotManager(FeedingLogic* feeding, FeedingScheduler* scheduler,
+                                       StepperController* stepper, SensorManager* sensors,
+                                       CameraController* camera)
     : feedingLogic(feeding),
+      feedingScheduler(scheduler),
       stepperController(stepper),
       sensorManager(sensors),
       cameraController(camera),
       bot(nullptr),
       allowedUserIds(),
-      lastUpdateTime(0),
       initialized(false) {
     instance = this; // Asignar instancia para callbacks
 }
@@ -29,18 +30,17 @@ bool TelegramBotManager::begin(const String& token, const std::vector<long long>
     bot = new UniversalTelegramBot(botToken, client);
     
     initialized = true;
+    timerQueue.every(UPDATE_INTERVAL, onPollTimer, this);
     return true;
 }
 
+void TelegramBotManager::onPollTimer(void* context) {
+    static_cast<TelegramBotManager*>(context)->update();
+}
+
 void TelegramBotManager::update() {
     if (!initialized) return;
     
-    unsigned long currentTime = millis();
-    if (currentTime - lastUpdateTime < UPDATE_INTERVAL) {
-        return;
-    }
-    lastUpdateTime = currentTime;
-    
     int numNewMessages = bot->getUpdates(bot->last_message_received + 1);
     
     while (numNewMessages) {
@@ -82,7 +82,9 @@ void TelegramBotManager::handleCommand(const String& command, const String& chat
     } else if (cleanCmd == CMD_STATUS) {
         cmdStatus(chatId);
     } else if (cleanCmd == CMD_FEED_NOW) {
-        cmdFeedNow(chatId);
+        // Argumento opcional: raciones ("/alimentar 2")
+        int portions = spacePos > 0 ? command.substring(spacePos + 1).toInt() : 1;
+        cmdFeedNow(chatId, portions);
     } else if (cleanCmd == CMD_PHOTO) {
         cmdPhoto(chatId);
     } else if (cleanCmd == CMD_SENSORS) {
@@ -94,7 +96,12 @@ void TelegramBotManager::handleCommand(const String& command, const String& chat
     } else if (cleanCmd == CMD_DISABLE_AUTO) {
         cmdDisableAuto(chatId);
     } else if (cleanCmd == CMD_REFILL) {
-        cmdRefill(chatId);
+        // "/rellenar" (todos), "/rellenar 2" o "/rellenar 2 80" (gramos)
+        cmdRefill(chatId, spacePos > 0 ? command.substring(spacePos + 1) : "");
+    } else if (cleanCmd == CMD_EMPTY) {
+        cmdEmpty(chatId, spacePos > 0 ? command.substring(spacePos + 1) : "");
+    } else if (cleanCmd == CMD_INVENTORY) {
+        cmdInventory(chatId);
     } else if (cleanCmd == CMD_CONFIG) {
         cmdConfig(chatId);
     } else if (cleanCmd == CMD_HELP) {
@@ -116,9 +123,17 @@ void TelegramBotManager::cmdStatus(const String& chatId) {
     String status = "📊 *Estado del Sistema*\n\n";
     
     status += "🍽️ *Alimentación*\n";
-    status += "Estado: " + feedingLogic->getStateString() + "\n";
+    status += "Estado: ";
+    status += feedingLogic->getStateString();
+    status += "\n";
     status += "Progreso: " + String(feedingLogic->getFeedingProgress(), 1) + "%\n";
-    status += "Compartimento: " + String(stepperController->getCurrentCompartment()) + "\n\n";
+    if (feedingLogic->getQueueDepth() > 0) {
+        status += "En cola: " + String(feedingLogic->getQueueDepth()) +
+                  " (espera " + String(feedingLogic->getQueueWaitTime() / 1000) + " s)\n";
+    }
+    status += "Compartimento: " + String(stepperController->getCurrentCompartment()) + "\n";
+    status += "Llenos: " + String(feedingLogic->getInventory().getFilledCount()) + "/" +
+              String(TOTAL_COMPARTMENTS) + (feedingLogic->getInventory().isLow() ? " ⚠️" : "") + "\n\n";
     
     EnvironmentData env = sensorManager->getEnvironmentData();
     if (env.valid) {
@@ -132,19 +147,39 @@ void TelegramBotManager::cmdStatus(const String& chatId) {
     
     status += "💾 *Sistema*\n";
     status += "WiFi: " + String(WiFi.RSSI()) + " dBm\n";
-    status += "Uptime: " + String(millis() / 60000) + " min\n";
-    status += "Memoria: " + String(ESP.getFreeHeap() / 1024) + " KB";
+    status += "Uptime: " + String(MonotonicClock::nowMs() / 60000) + " min\n";
+    status += "Memoria: " + String(ESP.getFreeHeap() / 1024) + " KB\n";
+    status += "Energía: ~" + String(powerManager.getEstimatedCurrentMa(), 0) + " mA (estimado), " +
+              String(powerManager.getWakeupsPerHour(), 0) + " despertares/h";
     
     bot->sendMessage(chatId, status, "Markdown");
 }
 
-void TelegramBotManager::cmdFeedNow(const String& chatId) {
+void TelegramBotManager::cmdFeedNow(const String& chatId, int portions) {
+    if (portions < 1 || portions > FEEDING_MAX_PORTIONS) {
+        bot->sendMessage(chatId, "❌ Raciones no válidas (1-" + String(FEEDING_MAX_PORTIONS) + ")", "");
+        return;
+    }
+    
     bot->sendMessage(chatId, "⏳ Iniciando alimentación manual...", "");
     
-    if (feedingLogic->startFeedingManual()) {
-        bot->sendMessage(chatId, "✅ Alimentación iniciada correctamente", "");
-    } else {
-        bot->sendMessage(chatId, "❌ Error: Ya hay una alimentación en curso", "");
+    switch (feedingLogic->requestFeeding(FEEDING_SOURCE_TELEGRAM, portions)) {
+        case FEEDING_REQUEST_STARTED:
+            bot->sendMessage(chatId, "✅ Alimentación iniciada correctamente", "");
+            break;
+        case FEEDING_REQUEST_QUEUED:
+            bot->sendMessage(chatId, "🕒 Alimentación en cola (" +
+                             String(feedingLogic->getQueueDepth()) + " en espera)", "");
+            break;
+        case FEEDING_REQUEST_MERGED:
+            bot->sendMessage(chatId, "ℹ️ Ya había una alimentación pedida; se unifican", "");
+            break;
+        case FEEDING_REQUEST_NO_FOOD:
+            bot->sendMessage(chatId, "❌ Comedero vacío: rellénalo y usa /rellenar", "");
+            break;
+        default:
+            bot->sendMessage(chatId, "❌ Error: cola de alimentación llena", "");
+            break;
     }
 }
 
@@ -240,7 +275,7 @@ void TelegramBotManager::cmdSensors(const String& chatId) {
         msg += "🌡️ Temperatura: " + String(env.temperature, 1) + "°C\n";
         msg += "💧 Humedad: " + String(env.humidity, 1) + "%\n";
         msg += "⏰ Última lectura: hace " + 
-               String((millis() - env.lastUpdate) / 1000) + "s\n\n";
+               String(MonotonicClock::elapsedMs(env.lastUpdate) / 1000) + "s\n\n";
         
         if (sensorManager->isEnvironmentOk()) {
             msg += "✅ Condiciones óptimas";
@@ -255,7 +290,16 @@ void TelegramBotManager::cmdSensors(const String& chatId) {
 }
 
 void TelegramBotManager::cmdSchedule(const String& chatId) {
-    bot->sendMessage(chatId, "⏰ Información de programación próximamente", "");
+    String msg = "⏰ *Programación*\n\n";
+    if (feedingScheduler->usesFixedTimes()) {
+        msg += "Horas fijas: " + feedingScheduler->getFeedingSlots() + "\n";
+    } else {
+        msg += "Cada " + String(feedingScheduler->getFeedingInterval()) + " h\n";
+    }
+    msg += "Próxima: " + feedingScheduler->getNextFeedingString() + "\n";
+    msg += "Hoy: " + String(feedingScheduler->getFeedingsTodayCount());
+    
+    bot->sendMessage(chatId, msg, "Markdown");
 }
 
 void TelegramBotManager::cmdEnableAuto(const String& chatId) {
@@ -266,8 +310,79 @@ void TelegramBotManager::cmdDisableAuto(const String& chatId) {
     bot->sendMessage(chatId, "⏸️ Alimentación automática desactivada", "");
 }
 
-void TelegramBotManager::cmdRefill(const String& chatId) {
-    bot->sendMessage(chatId, "✅ Contador de alimentaciones reiniciado", "");
+void TelegramBotManager::cmdRefill(const String& chatId, const String& args) {
+    if (feedingLogic->isFeedingInProgress()) {
+        bot->sendMessage(chatId, "⏳ Espera a que termine la alimentación en curso", "");
+        return;
+    }
+    
+    CompartmentInventory& inventory = feedingLogic->getInventory();
+    String params = args;
+    params.trim();
+    
+    if (params.length() == 0) {
+        inventory.fillAll(DEFAULT_PORTION_GRAMS, TimeUtils::getUnixTime());
+        bot->sendMessage(chatId, "✅ Todos los compartimentos rellenados", "");
+        return;
+    }
+    
+    int spacePos = params.indexOf(' ');
+    int compartment = params.substring(0, spacePos > 0 ? spacePos : params.length()).toInt();
+    int grams = DEFAULT_PORTION_GRAMS;
+    if (spacePos > 0) {
+        grams = params.substring(spacePos + 1).toInt();
+    } else if (CompartmentInventory::isValidCompartment(compartment)) {
+        grams = inventory.get(compartment).portionGrams;  // Se conserva la ración
+    }
+    
+    if (!CompartmentInventory::isValidCompartment(compartment) ||
+        !inventory.fill(compartment, grams, TimeUtils::getUnixTime())) {
+        bot->sendMessage(chatId, "❌ Uso: /rellenar [compartimento 0-" + String(TOTAL_COMPARTMENTS - 1) +
+                         "] [gramos 1-" + String(MAX_PORTION_GRAMS) + "]", "");
+        return;
+    }
+    
+    bot->sendMessage(chatId, "✅ Compartimento " + String(compartment) + " rellenado (" +
+                     String(grams) + " g)", "");
+}
+
+void TelegramBotManager::cmdEmpty(const String& chatId, const String& args) {
+    if (feedingLogic->isFeedingInProgress()) {
+        bot->sendMessage(chatId, "⏳ Espera a que termine la alimentación en curso", "");
+        return;
+    }
+    
+    String params = args;
+    params.trim();
+    int compartment = params.length() > 0 ? params.toInt() : -1;
+    
+    if (!feedingLogic->getInventory().markEmpty(compartment)) {
+        bot->sendMessage(chatId, "❌ Uso: /vaciar <compartimento 0-" + String(TOTAL_COMPARTMENTS - 1) + ">", "");
+        return;
+    }
+    
+    bot->sendMessage(chatId, "✅ Compartimento " + String(compartment) + " marcado como vacío", "");
+}
+
+void TelegramBotManager::cmdInventory(const String& chatId) {
+    const CompartmentInventory& inventory = feedingLogic->getInventory();
+    
+    String msg = "🥣 *Inventario*\n\n";
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        const CompartmentInfo& info = inventory.get(i);
+        msg += String(info.filled ? "🟢 " : "⚪ ") + String(i) + ": ";
+        if (info.filled) {
+            msg += String(info.portionGrams) + " g";
+            if (info.filledAt != 0) msg += ", rellenado hace " + TimeUtils::timeAgo(info.filledAt);
+        } else {
+            msg += "vacío";
+        }
+        msg += "\n";
+    }
+    msg += "\nLlenos: " + String(inventory.getFilledCount()) + "/" + String(TOTAL_COMPARTMENTS) +
+           " (" + String(inventory.getFilledGrams()) + " g)";
+    
+    bot->sendMessage(chatId, msg, "Markdown");
 }
 
 void TelegramBotManager::cmdConfig(const String& chatId) {
@@ -281,13 +396,15 @@ void TelegramBotManager::cmdConfig(const String& chatId) {
 void TelegramBotManager::cmdHelp(const String& chatId) {
     String help = "📚 *Comandos Disponibles*\n\n";
     help += "/estado - Ver estado completo\n";
-    help += "/alimentar - Dispensar ahora\n";
+    help += "/alimentar [raciones] - Dispensar ahora\n";
     help += "/foto - Capturar imagen\n";
     help += "/sensores - Ver temperatura/humedad\n";
     help += "/horario - Ver programación\n";
     help += "/activar - Activar modo auto\n";
     help += "/desactivar - Desactivar modo auto\n";
-    help += "/rellenar - Reiniciar contador\n";
+    help += "/inventario - Ver compartimentos con comida\n";
+    help += "/rellenar [n] [gramos] - Marcar rellenados (todos o uno)\n";
+    help += "/vaciar <n> - Marcar un compartimento vacío\n";
     help += "/configurar - Ir a config web\n";
     help += "/ayuda - Mostrar esta ayuda";
     
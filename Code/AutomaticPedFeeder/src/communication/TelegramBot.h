@@ -7,9 +7,13 @@
 #include <vector>
 #include "../config.h"
 #include "../feeding/FeedingLogic.h"
+#include "../feeding/FeedingScheduler.h"
 #include "../hardware/StepperController.h"
 #include "../hardware/SensorManager.h"
 #include "../hardware/CameraController.h"
+#include "../utils/TimeUtils.h"
+#include "../utils/TimerQueue.h"
+#include "../utils/PowerManager.h"
 
 class TelegramBotManager {
 private:
@@ -18,6 +22,7 @@ private:
     
     // Referencias a módulos
     FeedingLogic* feedingLogic;
+    FeedingScheduler* feedingScheduler;
     StepperController* stepperController;
     SensorManager* sensorManager;
     CameraController* cameraController;
@@ -25,19 +30,19 @@ private:
     // Configuración
     String botToken;
     std::vector<long long> allowedUserIds;
-    unsigned long lastUpdateTime;
-    const unsigned long UPDATE_INTERVAL = 1000; // 1 segundo
+    const unsigned long UPDATE_INTERVAL = 1000; // 1 segundo (temporizador de timerQueue)
     
     // Estado
     bool initialized;
     String lastMessageChatId;
     
 public:
-    TelegramBotManager(FeedingLogic* feeding, StepperController* stepper, 
-                       SensorManager* sensors, CameraController* camera);
+    TelegramBotManager(FeedingLogic* feeding, FeedingScheduler* scheduler,
+                       StepperController* stepper, SensorManager* sensors,
+                       CameraController* camera);
     ~TelegramBotManager();
     
-    // Inicialización
+    // Inicialización: begin() registra update() en timerQueue
     bool begin(const String& token, const std::vector<long long>& userIds = {});
     void update();
     
@@ -48,19 +53,22 @@ public:
     void sendPhoto(const String& chatId);
     
 private:
+    static void onPollTimer(void* context);
     void handleNewMessages(int numNewMessages);
     void handleCommand(const String& command, const String& chatId);
     
     // Comandos
     void cmdStart(const String& chatId);
     void cmdStatus(const String& chatId);
-    void cmdFeedNow(const String& chatId);
+    void cmdFeedNow(const String& chatId, int portions = 1);
     void cmdPhoto(const String& chatId);
     void cmdSensors(const String& chatId);
     void cmdSchedule(const String& chatId);
     void cmdEnableAuto(const String& chatId);
     void cmdDisableAuto(const String& chatId);
-    void cmdRefill(const String& chatId);
+    void cmdRefill(const String& chatId, const String& args);
+    void cmdEmpty(const String& chatId, const String& args);
+    void cmdInventory(const String& chatId);
     void cmdConfig(const String& chatId);
     void cmdHelp(const String& chatId);
     
@@ -135,6 +135,40 @@ void WebServerManager::setupAPIRoutes() {
     server.on("/api/system/reboot", HTTP_POST, [this](AsyncWebServerRequest* request) {
         handleReboot(request);
     });
+    
+    server.on("/api/debug/motion", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        handleGetMotionDebug(request);
+    });
+    
+    server.on("/api/feeding/trace", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        handleGetFeedingTrace(request);
+    });
+    
+    server.on("/api/inventory", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        handleGetInventory(request);
+    });
+    
+    server.on("/api/inventory", HTTP_POST,
+        [this](AsyncWebServerRequest* request) {},
+        nullptr,
+        [this](AsyncWebServerRequest* request, uint8_t* data, size_t len,
+               size_t index, size_t total) {
+            if (index == 0) {
+                request->_tempObject = new String();
+            }
+            
+            String* body = (String*)request->_tempObject;
+            for (size_t i = 0; i < len; i++) {
+                body->concat((char)data[i]);
+            }
+            
+            if (index + len == total) {
+                handleSaveInventory(request, *body);
+                delete body;
+                request->_tempObject = nullptr;
+            }
+        }
+    );
 }
 
 void WebServerManager::setupCameraRoutes() {
@@ -160,10 +194,32 @@ void WebServerManager::handleGetConfig(AsyncWebServerRequest* request) {
 }
 
 void WebServerManager::handleFeedNow(AsyncWebServerRequest* request) {
-    if (feedingLogic->startFeedingManual()) {
-        sendJSONResponse(request, true, "Alimentación iniciada");
-    } else {
-        sendJSONResponse(request, false, "Ya hay una alimentación en curso");
+    int portions = 1;
+    if (request->hasParam("portions")) {
+        portions = request->getParam("portions")->value().toInt();
+    }
+    if (portions < 1 || portions > FEEDING_MAX_PORTIONS) {
+        sendJSONResponse(request, false, "Raciones no válidas (1-" + String(FEEDING_MAX_PORTIONS) + ")");
+        return;
+    }
+    
+    switch (feedingLogic->requestFeeding(FEEDING_SOURCE_WEB, portions)) {
+        case FEEDING_REQUEST_STARTED:
+            sendJSONResponse(request, true, "Alimentación iniciada");
+            break;
+        case FEEDING_REQUEST_QUEUED:
+            sendJSONResponse(request, true, "Alimentación en cola (" +
+                             String(feedingLogic->getQueueDepth()) + " en espera)");
+            break;
+        case FEEDING_REQUEST_MERGED:
+            sendJSONResponse(request, true, "Ya había una alimentación pedida; se unifican");
+            break;
+        case FEEDING_REQUEST_NO_FOOD:
+            sendJSONResponse(request, false, "Comedero vacío: marca los compartimentos rellenados");
+            break;
+        default:
+            sendJSONResponse(request, false, "Cola de alimentación llena");
+            break;
     }
 }
 
@@ -191,6 +247,15 @@ void WebServerManager::handleSaveSchedule(AsyncWebServerRequest* request, const
         feedingScheduler->setEnabled(globalConfig.autoFeedingEnabled);
     }
     
+    if (doc.containsKey("feedingSlots")) {
+        String slots = doc["feedingSlots"].as<String>();
+        if (!feedingScheduler->setFeedingSlots(slots)) {
+            sendJSONResponse(request, false, "Horario no válido (p. ej. 08:00, 13:00 LMXJV, 20:00)");
+            return;
+        }
+        globalConfig.feedingSlots = feedingScheduler->getFeedingSlots();
+    }
+    
     if (doc.containsKey("feedingInterval")) {
         globalConfig.feedingIntervalHours = doc["feedingInterval"];
         feedingScheduler->setFeedingInterval(globalConfig.feedingIntervalHours);
@@ -201,6 +266,21 @@ void WebServerManager::handleSaveSchedule(AsyncWebServerRequest* request, const
         feedingScheduler->setMaxFeedingsPerDay(globalConfig.portionsPerDay);
     }
     
+    if (doc.containsKey("portionsPerFeeding")) {
+        globalConfig.portionsPerFeeding = doc["portionsPerFeeding"];
+        feedingScheduler->setPortionsPerFeeding(globalConfig.portionsPerFeeding);
+    }
+    
+    if (doc.containsKey("missedPolicy")) {
+        int policy = doc["missedPolicy"];
+        if (policy < MISSED_FEEDING_SKIP || policy > MISSED_FEEDING_ALL) {
+            sendJSONResponse(request, false, "Opción de tomas perdidas no válida");
+            return;
+        }
+        globalConfig.missedFeedingPolicy = policy;
+        feedingScheduler->setMissedFeedingPolicy(policy);
+    }
+    
     configManager->saveConfig(globalConfig);
     sendJSONResponse(request, true, "Configuración guardada");
 }
@@ -241,14 +321,75 @@ void WebServerManager::handleSaveAdvancedConfig(AsyncWebServerRequest* request,
     sendJSONResponse(request, true, "Configuración guardada");
 }
 
+void WebServerManager::handleGetInventory(AsyncWebServerRequest* request) {
+    request->send(200, "application/json", getInventoryJSON());
+}
+
+void WebServerManager::handleSaveInventory(AsyncWebServerRequest* request, const String& body) {
+    if (!feedingLogic) {
+        sendJSONResponse(request, false, "Error interno del servidor");
+        return;
+    }
+    
+    // Con el carrusel girando no se sabe qué compartimento está en el agujero
+    if (feedingLogic->isFeedingInProgress()) {
+        sendJSONResponse(request, false, "Espera a que termine la alimentación en curso");
+        return;
+    }
+    
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, body);
+    
+    if (error) {
+        sendJSONResponse(request, false, "JSON inválido");
+        return;
+    }
+    
+    // Sin "compartment" se rellenan todos; "filled": false lo marca vacío
+    int grams = doc["portionGrams"] | DEFAULT_PORTION_GRAMS;
+    bool filled = doc["filled"] | true;
+    
+    if (!CompartmentInventory::isValidPortion(grams)) {
+        sendJSONResponse(request, false, "Ración no válida (1-" + String(MAX_PORTION_GRAMS) + " g)");
+        return;
+    }
+    
+    int compartment = NO_COMPARTMENT;
+    if (doc.containsKey("compartment")) {
+        compartment = doc["compartment"];
+        if (!CompartmentInventory::isValidCompartment(compartment)) {
+            sendJSONResponse(request, false, "Compartimento no válido (0-" + String(TOTAL_COMPARTMENTS - 1) + ")");
+            return;
+        }
+    } else if (!filled) {
+        sendJSONResponse(request, false, "Indica el compartimento a vaciar");
+        return;
+    }
+    
+    // El inventario es de loop() (lo recorre la alimentación): la edición
+    // se aplica allí, en FeedingLogic::editInventory()
+    int32_t detail = filled ? grams : (doc.containsKey("portionGrams") ? -grams : 0);
+    if (!eventBus.publish(EVENT_INVENTORY_EDIT, compartment, detail)) {
+        sendJSONResponse(request, false, "Sistema ocupado, inténtalo de nuevo");
+        return;
+    }
+    
+    if (compartment == NO_COMPARTMENT) {
+        sendJSONResponse(request, true, "Todos los compartimentos rellenados");
+    } else {
+        sendJSONResponse(request, true, "Compartimento " + String(compartment) +
+                         (filled ? " rellenado" : " marcado como vacío"));
+    }
+}
+
 void WebServerManager::handleResetDaily(AsyncWebServerRequest* request) {
     if (!feedingScheduler || !configManager) {
         sendJSONResponse(request, false, "Error interno del servidor");
         return;
     }
     
-    globalConfig.feedingsToday = 0;
     feedingScheduler->resetDailyCount();
+    feedingScheduler->copyTo(globalConfig);
     configManager->saveConfig(globalConfig);
     sendJSONResponse(request, true, "Contador reiniciado");
 }
@@ -259,6 +400,34 @@ void WebServerManager::handleReboot(AsyncWebServerRequest* request) {
     ESP.restart();
 }
 
+void WebServerManager::handleGetMotionDebug(AsyncWebServerRequest* request) {
+    String json = getMotionDebugJSON();
+    request->send(200, "application/json", json);
+}
+
+void WebServerManager::handleGetFeedingTrace(AsyncWebServerRequest* request) {
+    // Copia del búfer: se sigue registrando mientras se serializa
+    TraceRecord* records = new TraceRecord[TRACE_CAPACITY];
+    uint16_t count = feedingTrace.snapshot(records, TRACE_CAPACITY);
+    
+    if (request->hasParam("format") && request->getParam("format")->value() == "hex") {
+        // Volcado binario en hexadecimal para FeedingLogic::replay() en el PC
+        String hex;
+        hex.reserve(count * sizeof(TraceRecord) * 2 + 1);
+        static const char digits[] = "0123456789abcdef";
+        const uint8_t* bytes = (const uint8_t*)records;
+        for (size_t i = 0; i < count * sizeof(TraceRecord); i++) {
+            hex += digits[bytes[i] >> 4];
+            hex += digits[bytes[i] & 0x0F];
+        }
+        request->send(200, "text/plain", hex);
+    } else {
+        request->send(200, "application/json", getFeedingTraceJSON(records, count));
+    }
+    
+    delete[] records;
+}
+
 void WebServerManager::handleCameraStream(AsyncWebServerRequest* request) {
     #ifndef DISABLE_CAMERA
     if (!cameraController->isInitialized()) {
@@ -296,6 +465,11 @@ String WebServerManager::getStatusJSON() {
     feeding["progress"] = feedingLogic->getFeedingProgress();
     feeding["compartment"] = stepperController->getCurrentCompartment();
     feeding["inProgress"] = feedingLogic->isFeedingInProgress();
+    feeding["queueDepth"] = feedingLogic->getQueueDepth();
+    feeding["queueWaitMs"] = feedingLogic->getQueueWaitTime();
+    feeding["lastWaitMs"] = feedingLogic->getLastJobWaitTime();
+    feeding["compartmentsFilled"] = feedingLogic->getInventory().getFilledCount();
+    feeding["inventoryLow"] = feedingLogic->getInventory().isLow();
     
     // Sensores
     EnvironmentData env = sensorManager->getEnvironmentData();
@@ -303,19 +477,37 @@ String WebServerManager::getStatusJSON() {
     sensors["temperature"] = env.temperature;
     sensors["humidity"] = env.humidity;
     sensors["presence"] = sensorManager->isPresenceDetected();
+    sensors["presenceConfidence"] = sensorManager->getPresenceConfidence();
     sensors["valid"] = env.valid;
     
+    DhtStats dht = sensorManager->getDhtStats();
+    sensors["readFailures"] = dht.failures;
+    sensors["readRetries"] = dht.retries;
+    sensors["readUs"] = dht.lastReadUs;
+    
     // Programación
     JsonObject schedule = doc["schedule"].to<JsonObject>();
-    schedule["nextFeeding"] = "Próximamente";
-    schedule["todayCount"] = globalConfig.feedingsToday;
+    schedule["nextFeeding"] = feedingScheduler->getNextFeedingString();
+    schedule["todayCount"] = feedingScheduler->getFeedingsTodayCount();
     schedule["maxPerDay"] = globalConfig.portionsPerDay;
     
     // Sistema
     JsonObject system = doc["system"].to<JsonObject>();
     system["wifi"] = String(WiFi.RSSI()) + " dBm";
     system["freeHeap"] = ESP.getFreeHeap();
-    system["uptime"] = millis();
+    system["uptime"] = MonotonicClock::nowMs();
+    
+    JsonObject power = system["power"].to<JsonObject>();
+    power["lightSleep"] = powerManager.isLightSleepEnabled();
+    power["idlePercent"] = powerManager.getIdleRatio() * 100;
+    power["wakeupsPerHour"] = powerManager.getWakeupsPerHour();
+    power["estimatedCurrentMa"] = powerManager.getEstimatedCurrentMa();
+    
+    JsonObject events = system["events"].to<JsonObject>();
+    events["depth"] = eventBus.getDepth();
+    events["highWater"] = eventBus.getHighWaterMark();
+    events["capacity"] = EVENT_QUEUE_SIZE;
+    events["dropped"] = eventBus.getDroppedCount();
     
     String output;
     serializeJson(doc, output);
@@ -329,7 +521,10 @@ String WebServerManager::getConfigJSON() {
     JsonObject config = doc["config"].to<JsonObject>();
     config["autoEnabled"] = globalConfig.autoFeedingEnabled;
     config["feedingInterval"] = globalConfig.feedingIntervalHours;
+    config["feedingSlots"] = globalConfig.feedingSlots;
     config["portionsPerDay"] = globalConfig.portionsPerDay;
+    config["portionsPerFeeding"] = globalConfig.portionsPerFeeding;
+    config["missedPolicy"] = globalConfig.missedFeedingPolicy;
     config["requirePresence"] = globalConfig.requirePresenceDetection;
     config["playSound"] = globalConfig.soundBeforeFeeding;
     config["tempAlerts"] = globalConfig.enableTemperatureAlerts;
@@ -340,6 +535,103 @@ String WebServerManager::getConfigJSON() {
     return output;
 }
 
+String WebServerManager::getFeedingTraceJSON(const TraceRecord* records, uint16_t count) {
+    JsonDocument doc;
+    doc["success"] = true;
+    doc["capacity"] = TRACE_CAPACITY;
+    doc["total"] = feedingTrace.getTotalRecorded();
+    doc["now"] = (uint32_t)MonotonicClock::nowMs();  // Misma base que los registros
+    
+    JsonArray list = doc["records"].to<JsonArray>();
+    for (uint16_t i = 0; i < count; i++) {
+        const TraceRecord& entry = records[i];
+        JsonObject item = list.add<JsonObject>();
+        item["t"] = entry.timestamp;
+        
+        if (entry.source == TRACE_SOURCE_FEEDING) {
+            item["source"] = "feeding";
+            item["state"] = FeedingLogic::getStateName((FeedingState)entry.state);
+            item["event"] = FeedingLogic::getEventName((FeedingEvent)entry.event);
+            item["next"] = FeedingLogic::getStateName((FeedingState)entry.next);
+            item["elapsedMs"] = entry.value;
+        } else {
+            item["source"] = "motor";
+            item["state"] = entry.state;
+            item["event"] = StepperController::getTraceEventName((MotorTraceEvent)entry.event);
+            item["next"] = entry.next;
+            item["position"] = entry.value;
+        }
+        
+        item["compartment"] = entry.compartment;
+        item["flags"] = entry.flags;
+        if (entry.temperature != TRACE_NO_TEMPERATURE) {
+            item["temperature"] = entry.temperature;
+            item["humidity"] = entry.humidity;
+        }
+    }
+    
+    String output;
+    serializeJson(doc, output);
+    return output;
+}
+
+String WebServerManager::getMotionDebugJSON() {
+    MotionStats stats = stepperController->getMotionStats();
+    
+    JsonDocument doc;
+    doc["success"] = true;
+    doc["moving"] = stepperController->isMotorMoving();
+    doc["sequences"] = stats.sequences;
+    
+    // Última secuencia (o la actual si el motor está en marcha)
+    JsonObject move = doc["lastMove"].to<JsonObject>();
+    move["steps"] = stats.stepsEmitted;
+    move["plannedMs"] = stats.plannedUs / 1000;
+    move["actualMs"] = stats.actualUs / 1000;
+    move["maxGapUs"] = stats.maxGapUs;
+    move["jamRetries"] = stats.jamRetries;
+    move["recoveryMs"] = stats.recoveryUs / 1000;
+    doc["jamsDetected"] = stats.jamsDetected;
+    
+    // Histograma de desviación de intervalos: cubeta i = [2^(i-1), 2^i) µs
+    JsonArray jitter = doc["jitterUs"].to<JsonArray>();
+    for (int i = 0; i < MOTION_JITTER_BUCKETS; i++) {
+        JsonObject bucket = jitter.add<JsonObject>();
+        bucket["from"] = i == 0 ? 0 : (1UL << (i - 1));
+        bucket["count"] = stats.jitterHistogram[i];
+    }
+    
+    String output;
+    serializeJson(doc, output);
+    return output;
+}
+
+String WebServerManager::getInventoryJSON() {
+    const CompartmentInventory& inventory = feedingLogic->getInventory();
+    
+    JsonDocument doc;
+    doc["success"] = true;
+    doc["filled"] = inventory.getFilledCount();
+    doc["total"] = TOTAL_COMPARTMENTS;
+    doc["grams"] = inventory.getFilledGrams();
+    doc["low"] = inventory.isLow();
+    doc["lowThreshold"] = LOW_INVENTORY_THRESHOLD;
+    
+    JsonArray compartments = doc["compartments"].to<JsonArray>();
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        const CompartmentInfo& info = inventory.get(i);
+        JsonObject item = compartments.add<JsonObject>();
+        item["index"] = i;
+        item["filled"] = info.filled;
+        item["filledAt"] = info.filledAt;
+        item["portionGrams"] = info.portionGrams;
+    }
+    
+    String output;
+    serializeJson(doc, output);
+    return output;
+}
+
 void WebServerManager::sendJSONResponse(AsyncWebServerRequest* request, bool success,
                                        const String& message, const String& data) {
     JsonDocument doc;
@@ -12,6 +12,7 @@
 #include "../hardware/StepperController.h"
 #include "../hardware/SensorManager.h"
 #include "../hardware/CameraController.h"
+#include "../utils/PowerManager.h"
 #include "WiFi.h"
 
 class WebServerManager {
@@ -54,6 +55,10 @@ private:
     void handleSaveAdvancedConfig(AsyncWebServerRequest* request, const String& body);
     void handleResetDaily(AsyncWebServerRequest* request);
     void handleReboot(AsyncWebServerRequest* request);
+    void handleGetMotionDebug(AsyncWebServerRequest* request);
+    void handleGetFeedingTrace(AsyncWebServerRequest* request);
+    void handleGetInventory(AsyncWebServerRequest* request);
+    void handleSaveInventory(AsyncWebServerRequest* request, const String& body);
     
     // Handlers de cámara
     void handleCameraStream(AsyncWebServerRequest* request);
@@ -62,6 +67,9 @@ private:
     // Utilidades
     String getStatusJSON();
     String getConfigJSON();
+    String getMotionDebugJSON();
+    String getFeedingTraceJSON(const TraceRecord* records, uint16_t count);
+    String getInventoryJSON();
     String formatTimeRemaining(unsigned long ms);
     void sendJSONResponse(AsyncWebServerRequest* request, bool success, 
                          const String& message = "", const String& data = "");
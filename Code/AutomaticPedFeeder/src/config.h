@@ -7,23 +7,33 @@
 
 // ========== CONFIGURACIÓN DE HARDWARE ==========
 
-// Pines del Motor Stepper
+// Pines del Motor Stepper (sin compartir con la cámara: lo comprueba
+// hardware/FastPin.h al compilar)
 #define STEPPER_STEP_PIN 14
-#define STEPPER_DIR_PIN 13 //Antes 15
-#define STEPPER_ENABLE_PIN 4
-// Pin para microstepping (MS1, MS2, MS3 juntos)
-#define STEPPER_MS_PIN 15
+#define STEPPER_DIR_PIN 1     // Antes 13 (PCLK de la cámara)
+#define STEPPER_ENABLE_PIN 2  // Antes 4 (SIOD de la cámara)
+// Pin para microstepping (MS1, MS2, MS3 juntos): HIGH = 1/16, LOW = paso completo
+// (antes 15, compartido con XCLK de la cámara)
+#define STEPPER_MS_PIN 42
 
 // Sensor DHT22 (Temperatura y Humedad)
 #define DHT_PIN 21
 #define DHT_TYPE DHT11
 
 // Sensor PIR (Movimiento Infrarrojo)
-#define PIR_PIN 18
+#define PIR_PIN 47  // Antes 18 (Y7 de la cámara)
 
 // Speaker/Buzzer
 #define BUZZER_PIN 19
 
+// Sensor de origen del carrusel (final de carrera o sensor hall)
+#define HOME_SENSOR_PIN 41
+#define HOME_SENSOR_ACTIVE_LOW true  // true = activo a nivel bajo (pull-up interno)
+
+// Salida DIAG del driver (p. ej. TMC2209 con StallGuard); -1 = sin ella
+#define STEPPER_DIAG_PIN -1
+#define STEPPER_DIAG_ACTIVE_HIGH true
+
 // ========== CONFIGURACIÓN DE CÁMARA ESP32S3_EYE ==========
 #define CAMERA_MODEL_ESP32S3_EYE
 
@@ -47,21 +57,86 @@
 // ========== CONFIGURACIÓN DEL CARRUSEL ==========
 
 #define TOTAL_COMPARTMENTS 5
-#define FEEDING_COMPARTMENT 4  // El compartimento con agujero (índice 0-4)
 #define STEPS_PER_REVOLUTION 200
 #define MICROSTEPS 16
-#define STEPS_PER_COMPARTMENT ((STEPS_PER_REVOLUTION * MICROSTEPS) / TOTAL_COMPARTMENTS)
+#define STEPS_PER_CAROUSEL_TURN (STEPS_PER_REVOLUTION * MICROSTEPS)
+#define STEPS_PER_COMPARTMENT (STEPS_PER_CAROUSEL_TURN / TOTAL_COMPARTMENTS)
+#define FULL_STEPS_PER_COMPARTMENT (STEPS_PER_REVOLUTION / TOTAL_COMPARTMENTS)
+
+// Microstepping dinámico: crucero en paso completo y aproximación final
+// en micropasos (las posiciones se cuentan siempre en micropasos)
+#define MICROSTEP_APPROACH_FULL_STEPS 1  // Pasos completos finales en micropasos
+#define MICROSTEP_APPROACH_SPEED 400     // micropasos/s en la aproximación
+#define MICROSTEP_SWITCH_SETTLE_US 1000  // Espera tras cambiar el pin MS
+
+// Sentido de giro del carrusel: 0 = ruta más corta, 1 = solo avance,
+// -1 = solo retroceso (p. ej. si la tolva solo admite un sentido)
+#define CAROUSEL_DIRECTION 0
+
+// Homing contra el sensor de origen: búsqueda rápida, retroceso y
+// aproximación lenta. Desactivado por defecto: sin sensor, la búsqueda
+// daría más de una vuelta completa al arrancar (y soltaría comida).
+// Se pueden fijar desde build_flags (env:native-homing los activa)
+#ifndef HOME_SENSOR_ENABLED
+#define HOME_SENSOR_ENABLED false
+#endif
+#define HOME_SENSOR_OFFSET_STEPS 0     // Posición del flanco del sensor respecto al compartimento 0
+#ifndef HOME_SENSOR_COMPARTMENT_MARKS
+#define HOME_SENSOR_COMPARTMENT_MARKS false  // Una marca por compartimento (la de origen, más ancha)
+#endif
+#define HOMING_SEEK_SPEED 800          // micropasos/s
+#define HOMING_APPROACH_SPEED 100      // micropasos/s
+#define HOMING_BACKOFF_STEPS (STEPS_PER_COMPARTMENT / 8)
+#define HOMING_MAX_STEPS (STEPS_PER_CAROUSEL_TURN + STEPS_PER_COMPARTMENT)
+#define COMPARTMENT_OFFSET_MAX (STEPS_PER_COMPARTMENT / 4)  // Corrección aprendida máxima
 
-// Velocidad y aceleración del motor
-#define STEPPER_MAX_SPEED 1000
-#define STEPPER_ACCELERATION 500
+// Detección de atascos: flanco del sensor fuera de su sitio (o que no llega)
+// con el carrusel referenciado, o la salida DIAG del driver. Tras un atasco
+// se retrocede, se agita y se repite lo que faltaba de la secuencia
+#define JAM_EDGE_TOLERANCE_STEPS (STEPS_PER_COMPARTMENT / 8)  // Desviación admitida del flanco
+#define JAM_MAX_RETRIES 3          // Reintentos antes de dar error (0 = sin reintentos)
+#define JAM_REVERSE_STEPS (STEPS_PER_COMPARTMENT / 4)  // Retroceso tras el atasco
+#define JAM_AGITATE_CYCLES 2       // Vaivenes de AGITATE_STEPS antes de reintentar
+
+// Velocidad, aceleración y jerk del motor (perfil en S, en micropasos)
+#define STEPPER_MAX_SPEED 2000     // pasos/s
+#define STEPPER_ACCELERATION 1200  // pasos/s²
+#define STEPPER_JERK 5000          // pasos/s³
+
+// Generación de pasos por timer hardware
+#define STEP_TIMER_TICK_US 20  // Periodo del tick del timer de pasos (µs)
 
 // ========== CONFIGURACIÓN DE ALIMENTACIÓN ==========
 
 #define DEFAULT_FEEDING_INTERVAL_HOURS 4
 #define DEFAULT_PORTIONS_PER_DAY 4
+#define DEFAULT_PORTIONS_PER_FEEDING 1  // Compartimentos dispensados en cada toma programada
+// Tomas a horas fijas (hora local): "HH:MM" con días opcionales (LMXJVSD),
+// p. ej. "08:00, 13:00 LMXJV, 20:00". Vacío = cada DEFAULT_FEEDING_INTERVAL_HOURS
+#define DEFAULT_FEEDING_SLOTS ""
+#define FEEDING_MAX_SLOTS 8
+// Tomas perdidas con el comedero apagado (se resuelven al arrancar)
+#define MISSED_FEEDING_SKIP 0   // Se omiten: se sigue por la próxima
+#define MISSED_FEEDING_ONCE 1   // Una sola toma de recuperación
+#define MISSED_FEEDING_ALL 2    // Todas, separadas MISSED_FEEDING_SPACING_MIN
+#define DEFAULT_MISSED_FEEDING_POLICY MISSED_FEEDING_ONCE
+#define MISSED_FEEDING_SPACING_MIN 30
+#define MISSED_FEEDING_LOOKBACK_H 24    // Las más antiguas no cuentan
 #define MAX_WAIT_TIME_AFTER_SOUND 300000  // 5 minutos en ms
 #define FEEDING_DURATION 5000  // Tiempo que el compartimento permanece abierto
+#define FEEDING_AGITATE_CYCLES 2  // Vaivenes tras dispensar (0 = desactivado)
+#define AGITATE_STEPS 40          // Amplitud de cada vaivén (pasos)
+
+// Cola de trabajos de alimentación
+#define FEEDING_QUEUE_SIZE 4         // Trabajos en espera (además del que está en curso)
+#define FEEDING_MAX_PORTIONS 4       // Raciones por trabajo (< TOTAL_COMPARTMENTS)
+#define FEEDING_COALESCE_MS 30000    // Peticiones más próximas se unifican en una
+
+// Inventario de compartimentos (TOTAL_COMPARTMENTS fija la geometría del
+// carrusel; los que no se usen basta con dejarlos vacíos)
+#define DEFAULT_PORTION_GRAMS 50     // Ración de un compartimento recién rellenado
+#define MAX_PORTION_GRAMS 1000
+#define LOW_INVENTORY_THRESHOLD 1    // Aviso al quedar este número de compartimentos llenos o menos
 
 // ========== CONFIGURACIÓN DE SENSORES ==========
 
@@ -69,7 +144,17 @@
 #define TEMP_MAX_ALERT 45.0  // °C
 #define HUMIDITY_MAX_ALERT 70.0  // %
 
-#define PIR_DETECTION_TIMEOUT 2000  // ms para confirmar presencia
+// El DHT se lee en su propia tarea: la lectura desactiva las interrupciones
+// de su núcleo unos ms, así que va en el 0 (loop() y la ISR de pasos van en el 1)
+#define DHT_READ_INTERVAL_MS 2000
+#define DHT_READ_RETRIES 2          // Reintentos tras una lectura fallida
+#define DHT_RETRY_DELAY_MS 1000     // Mínimo entre lecturas del DHT11
+#define DHT_TASK_CORE 0
+#define DHT_TASK_PRIORITY 1         // Por encima solo de la tarea ociosa
+#define DHT_TASK_STACK 3072
+
+#define PIR_DETECTION_TIMEOUT 2000  // ms de PIR activo para confirmar presencia (confianza 100 %)
+#define PIR_DEBOUNCE_MS 250         // Una subida antes de esto tras la bajada sigue la misma detección
 
 // ========== CONFIGURACIÓN DE SONIDO ==========
 
@@ -78,28 +163,62 @@
 #define SOUND_REPETITIONS 3
 #define SOUND_PAUSE 300       // ms entre repeticiones
 
+// ========== CONFIGURACIÓN DE ENERGÍA ==========
+
+// Sin nada que sondear, loop() duerme hasta el próximo plazo de timerQueue.
+// Con light sleep automático (esp_pm, si el SDK lo trae activado) el chip
+// duerme de verdad; el Wi-Fi en modem sleep sigue asociado en ambos casos
+#define POWER_IDLE_ENABLED true
+#define POWER_LIGHT_SLEEP_ENABLED true
+#define POWER_CPU_MAX_MHZ 240
+#define POWER_CPU_MIN_MHZ 40         // XTAL: frecuencia con la CPU ociosa
+#define POWER_MIN_IDLE_MS 2          // Plazos más cercanos no compensan dormir
+// Consumo estimado para el informe (no hay medida de corriente)
+#define POWER_ACTIVE_CURRENT_MA 120
+#define POWER_WAIT_CURRENT_MA 35     // CPU ociosa y Wi-Fi en modem sleep
+#define POWER_SLEEP_CURRENT_MA 5     // Light sleep despertando con cada beacon
+
 // ========== CONFIGURACIÓN DE RED ==========
 
 #define WEB_SERVER_PORT 80
 
+// Hora local (POSIX TZ: España peninsular, con horario de verano) y NTP
+#define TIMEZONE "CET-1CEST,M3.5.0/2,M10.5.0/3"
+#define NTP_SERVER_1 "pool.ntp.org"
+#define NTP_SERVER_2 "time.nist.gov"
+#define NTP_SERVER_3 "time.google.com"
+
 // ========== CONFIGURACIÓN DE ALMACENAMIENTO ==========
 
 #define PREFS_NAMESPACE "feeder"
 #define CONFIG_FILE "/config.json"
+#define CONFIG_SAVE_INTERVAL_MS 60000  // Guardado periódico de la posición y contadores
 
 // ========== CONFIGURACIÓN DE LOGS ==========
 
 #define ENABLE_SERIAL_LOG true
 #define ENABLE_FILE_LOG false
 #define LOG_LEVEL 2  // 0=ERROR, 1=WARNING, 2=INFO, 3=DEBUG
+#define MEMORY_REPORT_INTERVAL_MS 10000
 
 // ========== ESTRUCTURA DE CONFIGURACIÓN RUNTIME ==========
 
+// Contenido de un compartimento (índice = posición del carrusel en la que
+// ese compartimento queda sobre el agujero)
+struct CompartmentInfo {
+    bool filled;
+    unsigned long filledAt;  // Hora Unix del último rellenado (0 = desconocida)
+    int portionGrams;
+};
+
 struct FeederConfig {
     // Horarios de alimentación
     int feedingIntervalHours;
+    String feedingSlots;  // Horas fijas (ver DEFAULT_FEEDING_SLOTS)
     int portionsPerDay;
+    int portionsPerFeeding;
     bool autoFeedingEnabled;
+    int missedFeedingPolicy;  // MISSED_FEEDING_*
     
     // Comportamiento
     bool requirePresenceDetection;
@@ -122,11 +241,20 @@ struct FeederConfig {
     bool cameraEnabled;
     int cameraQuality;  // 10-63 (menor = mejor calidad, 10=óptimo con PSRAM)
     
+    // Referencia del carrusel (homing)
+    long homeOffset;
+    int compartmentOffsets[TOTAL_COMPARTMENTS];
+    
+    // Inventario
+    CompartmentInfo inventory[TOTAL_COMPARTMENTS];
+    
     // Estado del sistema
     int currentCompartment;
-    int feedingsToday;
-    unsigned long lastFeedingTime;
-    unsigned long nextFeedingTime;
+    int feedingsToday;              // Completadas (copia de FeedingScheduler::copyTo())
+    int32_t feedingsDay;            // Fecha local de feedingsToday (año * 1000 + día del año)
+    unsigned long lastFeedingTime;  // Hora Unix (sobrevive al reinicio)
+    unsigned long nextFeedingTime;  // Hora Unix de la próxima toma (0 = ninguna)
+    int32_t lastSlotKey;            // Última toma fija hecha (la hora repetida de octubre no se repite)
 };
 
 // ========== COMANDOS TELEGRAM ==========
@@ -141,6 +269,8 @@ struct FeederConfig {
 #define CMD_ENABLE_AUTO "/activar"
 #define CMD_DISABLE_AUTO "/desactivar"
 #define CMD_REFILL "/rellenar"
+#define CMD_EMPTY "/vaciar"
+#define CMD_INVENTORY "/inventario"
 #define CMD_HELP "/ayuda"
 
 #endif // CONFIG_H
\ No newline at end of file
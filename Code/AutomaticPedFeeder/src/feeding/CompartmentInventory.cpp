@@ -0,0 +1,174 @@
+#include "CompartmentInventory.h"
+
+CompartmentInventory::CompartmentInventory()
+    : lowNotifiedAt(-1) {
+    // Hasta cargar lo guardado, el supuesto de siempre: todo lleno
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        slots[i] = { true, 0, DEFAULT_PORTION_GRAMS };
+    }
+}
+
+// ========== PERSISTENCIA ==========
+
+void CompartmentInventory::load(const CompartmentInfo* saved) {
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        slots[i] = saved[i];
+        if (!isValidPortion(slots[i].portionGrams)) {
+            slots[i].portionGrams = DEFAULT_PORTION_GRAMS;
+        }
+    }
+    
+    // Si arranca ya bajo mínimos no se repite el aviso de antes del reinicio
+    lowNotifiedAt = isLow() ? getFilledCount() : -1;
+}
+
+void CompartmentInventory::copyTo(CompartmentInfo* out) const {
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        out[i] = slots[i];
+    }
+}
+
+// ========== EDICIÓN ==========
+
+bool CompartmentInventory::fill(int compartment, int portionGrams, unsigned long filledAt) {
+    if (!isValidCompartment(compartment) || !isValidPortion(portionGrams)) {
+        return false;
+    }
+    
+    slots[compartment] = { true, filledAt, portionGrams };
+    changed();
+    return true;
+}
+
+void CompartmentInventory::fillAll(int portionGrams, unsigned long filledAt) {
+    if (!isValidPortion(portionGrams)) portionGrams = DEFAULT_PORTION_GRAMS;
+    
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        slots[i] = { true, filledAt, portionGrams };
+    }
+    changed();
+}
+
+bool CompartmentInventory::markEmpty(int compartment) {
+    if (!isValidCompartment(compartment)) {
+        return false;
+    }
+    
+    if (slots[compartment].filled) {
+        slots[compartment].filled = false;
+        changed();
+    }
+    return true;
+}
+
+bool CompartmentInventory::setPortionGrams(int compartment, int portionGrams) {
+    if (!isValidCompartment(compartment) || !isValidPortion(portionGrams)) {
+        return false;
+    }
+    
+    slots[compartment].portionGrams = portionGrams;
+    changed();
+    return true;
+}
+
+void CompartmentInventory::changed() {
+    int filled = getFilledCount();
+    eventBus.publish(EVENT_INVENTORY_CHANGED, filled);
+    
+    if (filled > LOW_INVENTORY_THRESHOLD) {
+        lowNotifiedAt = -1;
+    } else if (lowNotifiedAt < 0 || (filled == 0 && lowNotifiedAt != 0)) {
+        lowNotifiedAt = filled;
+        eventBus.publish(EVENT_LOW_INVENTORY, filled);
+    }
+}
+
+// ========== CONSULTAS ==========
+
+bool CompartmentInventory::isFilled(int compartment) const {
+    return isValidCompartment(compartment) && slots[compartment].filled;
+}
+
+int CompartmentInventory::getFilledCount() const {
+    int count = 0;
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        if (slots[i].filled) count++;
+    }
+    return count;
+}
+
+int CompartmentInventory::getFilledGrams() const {
+    int grams = 0;
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        if (slots[i].filled) grams += slots[i].portionGrams;
+    }
+    return grams;
+}
+
+// ========== RUTAS ==========
+
+uint8_t CompartmentInventory::planRoute(int from, uint8_t portions, int* route, int& rest) const {
+    // Se planifica sobre una copia: lo ya dispensado cuenta como vacío
+    bool filled[TOTAL_COMPARTMENTS];
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        filled[i] = slots[i].filled;
+    }
+    
+    if (!isValidCompartment(from)) from = 0;
+    
+    uint8_t planned = 0;
+    int position = from;
+    while (planned < portions) {
+        int next = nearest(filled, position, true, NO_COMPARTMENT);
+        if (next == NO_COMPARTMENT) break;
+        
+        route[planned++] = next;
+        filled[next] = false;
+        position = next;
+    }
+    
+    // Apartarse del recién vaciado (aún puede soltar restos) si hay un
+    // vacío alcanzable; si no, quedarse donde está
+    rest = planned > 0 ? nearest(filled, position, false, position) : NO_COMPARTMENT;
+    if (rest == NO_COMPARTMENT) rest = position;
+    
+    return planned;
+}
+
+int CompartmentInventory::nearest(const bool* filled, int from, bool wantFilled, int exclude) {
+    if (wantFilled && filled[from] && from != exclude) {
+        return from;
+    }
+    
+    int best = NO_COMPARTMENT;
+    int bestDistance = TOTAL_COMPARTMENTS;
+    
+    // Hacia delante primero: a igual distancia gana el avance
+    const int directions[2] = { 1, -1 };
+    for (int d = 0; d < 2; d++) {
+        int direction = directions[d];
+        if (CAROUSEL_DIRECTION != 0 && direction != CAROUSEL_DIRECTION) continue;
+        
+        for (int distance = 1; distance < bestDistance; distance++) {
+            int compartment = ((from + direction * distance) % TOTAL_COMPARTMENTS + TOTAL_COMPARTMENTS)
+                              % TOTAL_COMPARTMENTS;
+            if (compartment == from) break;
+            
+            if (filled[compartment]) {
+                // No se puede cruzar: o es el destino o corta este sentido
+                if (wantFilled && compartment != exclude) {
+                    best = compartment;
+                    bestDistance = distance;
+                }
+                break;
+            }
+            if (!wantFilled && compartment != exclude) {
+                best = compartment;
+                bestDistance = distance;
+                break;
+            }
+        }
+    }
+    
+    return best;
+}
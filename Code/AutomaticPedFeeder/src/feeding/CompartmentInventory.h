@@ -0,0 +1,59 @@
+#ifndef COMPARTMENT_INVENTORY_H
+#define COMPARTMENT_INVENTORY_H
+
+#include <Arduino.h>
+#include "../config.h"
+#include "../utils/EventBus.h"
+
+#define NO_COMPARTMENT -1
+
+// Qué compartimentos tienen comida. Cada cambio publica
+// EVENT_INVENTORY_CHANGED (main lo guarda en NVS) y, al bajar hasta
+// LOW_INVENTORY_THRESHOLD compartimentos llenos, EVENT_LOW_INVENTORY (otra
+// vez al quedar vacío, y ya no más hasta el siguiente rellenado)
+class CompartmentInventory {
+private:
+    CompartmentInfo slots[TOTAL_COMPARTMENTS];
+    int lowNotifiedAt;  // Llenos en el último aviso (-1 = sin aviso pendiente)
+    
+public:
+    CompartmentInventory();
+    
+    // Persistencia (FeederConfig::inventory)
+    void load(const CompartmentInfo* saved);
+    void copyTo(CompartmentInfo* out) const;
+    
+    // Edición (filledAt: hora Unix, 0 si no hay NTP)
+    bool fill(int compartment, int portionGrams, unsigned long filledAt);
+    void fillAll(int portionGrams, unsigned long filledAt);
+    bool markEmpty(int compartment);
+    bool setPortionGrams(int compartment, int portionGrams);
+    
+    // Consultas
+    const CompartmentInfo& get(int compartment) const { return slots[compartment]; }
+    bool isFilled(int compartment) const;
+    int getFilledCount() const;
+    int getFilledGrams() const;
+    bool isLow() const { return getFilledCount() <= LOW_INVENTORY_THRESHOLD; }
+    
+    // Ruta de dispensado desde la posición actual: en cada paso el
+    // compartimento lleno más cercano y, al acabar, el reposo sobre uno
+    // vacío (sin el recién vaciado si hay otro). Nunca se pasa por encima de
+    // un compartimento lleno, que soltaría su comida al cruzar el agujero, y
+    // se respeta CAROUSEL_DIRECTION. Devuelve las raciones planificadas
+    // (menos que las pedidas si no hay tantos llenos)
+    uint8_t planRoute(int from, uint8_t portions, int* route, int& rest) const;
+    
+    static bool isValidCompartment(int compartment) {
+        return compartment >= 0 && compartment < TOTAL_COMPARTMENTS;
+    }
+    static bool isValidPortion(int portionGrams) {
+        return portionGrams > 0 && portionGrams <= MAX_PORTION_GRAMS;
+    }
+    
+private:
+    static int nearest(const bool* filled, int from, bool wantFilled, int exclude);
+    void changed();
+};
+
+#endif // COMPARTMENT_INVENTORY_H
@@ -1,4 +1,15 @@
 #include "FeedingLogic.h"
+#include "../utils/PowerManager.h"
+#include "../utils/TimeUtils.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+static portMUX_TYPE requestLock = portMUX_INITIALIZER_UNLOCKED;
+#define REQUEST_LOCK() portENTER_CRITICAL(&requestLock)
+#define REQUEST_UNLOCK() portEXIT_CRITICAL(&requestLock)
+#else
+#define REQUEST_LOCK()
+#define REQUEST_UNLOCK()
+#endif
 
 FeedingLogic::FeedingLogic(StepperController *stepper, SensorManager *sensors)
     : stepperController(stepper),
@@ -10,11 +21,20 @@ FeedingLogic::FeedingLogic(StepperController *stepper, SensorManager *sensors)
       presenceRequired(true),
       maxWaitTimeMs(MAX_WAIT_TIME_AFTER_SOUND),
       feedingDurationMs(FEEDING_DURATION),
-      feedingCompleteCallback(nullptr),
-      feedingErrorCallback(nullptr),
-      stateChangeCallback(nullptr),
-      targetCompartment(FEEDING_COMPARTMENT),
+      queueLength(0),
+      currentJob(),
+      jobActive(false),
+      lastJobWaitMs(0),
+      cancelRequested(false),
+      mergedPortions(0),
+      mergedManual(false),
       feedingInProgress(false),
+      presenceNeeded(true),
+      dispenseQueued(false),
+      dispenseCommandCount(0),
+      dispensePortions(0),
+      dispensedPortions(0),
+      commandsPerPortion(0),
       lastError("")
 {
     if (!stepperController || !sensorManager)
@@ -23,197 +43,583 @@ FeedingLogic::FeedingLogic(StepperController *stepper, SensorManager *sensors)
     }
 }
 
+// ========== TABLAS DE LA MÁQUINA DE ESTADOS ==========
+
+constexpr FeedingLogic::Table::StateInfo FeedingLogic::states[FEEDING_STATE_COUNT] = {
+    // Estado                  Nombre                  Entrada                              Salida                               Sondeo
+    { FEEDING_IDLE,             "Inactivo",             nullptr,                             &FeedingLogic::onLeaveIdle,          nullptr },
+    { FEEDING_SOUND_ALERT,      "Reproduciendo alerta", &FeedingLogic::onEnterSoundAlert,    &FeedingLogic::onLeaveSoundAlert,    &FeedingLogic::pollSoundAlert },
+    { FEEDING_WAITING_PRESENCE, "Esperando presencia",  nullptr,                             nullptr,                             &FeedingLogic::pollWaitingPresence },
+    { FEEDING_MOVING_CAROUSEL,  "Moviendo carrusel",    nullptr,                             nullptr,                             &FeedingLogic::pollMovingCarousel },
+    { FEEDING_DISPENSING,       "Dispensando comida",   nullptr,                             nullptr,                             &FeedingLogic::pollDispenseSequence },
+    { FEEDING_RETURNING,        "Regresando posición",  nullptr,                             nullptr,                             &FeedingLogic::pollDispenseSequence },
+    { FEEDING_COMPLETE,         "Completado",           &FeedingLogic::onEnterComplete,      nullptr,                             &FeedingLogic::pollFinished },
+    { FEEDING_ERROR,            "Error",                &FeedingLogic::onEnterError,         nullptr,                             &FeedingLogic::pollFinished },
+};
+
+constexpr FeedingLogic::Table::Transition FeedingLogic::transitions[] = {
+    // Origen                  Evento                 Guarda                              Destino
+    { FEEDING_IDLE,             FEEDING_EV_START,      &FeedingLogic::isSoundEnabled,      FEEDING_SOUND_ALERT },
+    { FEEDING_IDLE,             FEEDING_EV_START,      &FeedingLogic::isPresenceNeeded,    FEEDING_WAITING_PRESENCE },
+    { FEEDING_IDLE,             FEEDING_EV_START,      nullptr,                            FEEDING_MOVING_CAROUSEL },
+    
+    { FEEDING_SOUND_ALERT,      FEEDING_EV_ALERT_DONE, &FeedingLogic::isPresenceNeeded,    FEEDING_WAITING_PRESENCE },
+    { FEEDING_SOUND_ALERT,      FEEDING_EV_ALERT_DONE, nullptr,                            FEEDING_MOVING_CAROUSEL },
+    { FEEDING_SOUND_ALERT,      FEEDING_EV_CANCEL,     nullptr,                            FEEDING_ERROR },
+    
+    { FEEDING_WAITING_PRESENCE, FEEDING_EV_PRESENCE,   nullptr,                            FEEDING_MOVING_CAROUSEL },
+    { FEEDING_WAITING_PRESENCE, FEEDING_EV_FAILED,     nullptr,                            FEEDING_ERROR },
+    { FEEDING_WAITING_PRESENCE, FEEDING_EV_CANCEL,     nullptr,                            FEEDING_ERROR },
+    
+    { FEEDING_MOVING_CAROUSEL,  FEEDING_EV_AT_HOLE,    nullptr,                            FEEDING_DISPENSING },
+    { FEEDING_MOVING_CAROUSEL,  FEEDING_EV_RETURNING,  nullptr,                            FEEDING_RETURNING },
+    { FEEDING_MOVING_CAROUSEL,  FEEDING_EV_DONE,       nullptr,                            FEEDING_COMPLETE },
+    { FEEDING_MOVING_CAROUSEL,  FEEDING_EV_FAILED,     nullptr,                            FEEDING_ERROR },
+    { FEEDING_MOVING_CAROUSEL,  FEEDING_EV_CANCEL,     nullptr,                            FEEDING_ERROR },
+    
+    { FEEDING_DISPENSING,       FEEDING_EV_RETURNING,  nullptr,                            FEEDING_RETURNING },
+    { FEEDING_DISPENSING,       FEEDING_EV_DONE,       nullptr,                            FEEDING_COMPLETE },
+    { FEEDING_DISPENSING,       FEEDING_EV_FAILED,     nullptr,                            FEEDING_ERROR },
+    { FEEDING_DISPENSING,       FEEDING_EV_CANCEL,     nullptr,                            FEEDING_ERROR },
+    
+    { FEEDING_RETURNING,        FEEDING_EV_DONE,       nullptr,                            FEEDING_COMPLETE },
+    { FEEDING_RETURNING,        FEEDING_EV_FAILED,     nullptr,                            FEEDING_ERROR },
+    { FEEDING_RETURNING,        FEEDING_EV_CANCEL,     nullptr,                            FEEDING_ERROR },
+    
+    { FEEDING_COMPLETE,         FEEDING_EV_ACK,        nullptr,                            FEEDING_IDLE },
+    { FEEDING_ERROR,            FEEDING_EV_ACK,        nullptr,                            FEEDING_IDLE },
+};
+
+constexpr size_t FeedingLogic::transitionCount = sizeof(transitions) / sizeof(transitions[0]);
+
+// ========== MOTOR DE LA MÁQUINA DE ESTADOS ==========
+
 void FeedingLogic::begin() {
-    setState(FEEDING_IDLE);
+    static_assert(Table::indexed(states, FEEDING_STATE_COUNT), "Tabla de estados desordenada");
+    static_assert(Table::leavable(transitions, transitionCount, FEEDING_STATE_COUNT),
+                  "Estado de alimentación sin salida");
+    static_assert(Table::unshadowed(transitions, transitionCount),
+                  "Transición inalcanzable: otra sin guarda la precede");
+    
+    currentState = FEEDING_IDLE;
+    previousState = FEEDING_IDLE;
+    stateStartTime = MonotonicClock::nowMs();
 }
 
 void FeedingLogic::update() {
-    switch (currentState) {
-        case FEEDING_IDLE:
-            handleIdleState();
-            break;
-        case FEEDING_SOUND_ALERT:
-            handleSoundAlertState();
-            break;
-        case FEEDING_WAITING_PRESENCE:
-            handleWaitingPresenceState();
-            break;
-        case FEEDING_MOVING_CAROUSEL:
-            handleMovingCarouselState();
-            break;
-        case FEEDING_DISPENSING:
-            handleDispensingState();
-            break;
-        case FEEDING_RETURNING:
-            handleReturningState();
-            break;
-        case FEEDING_COMPLETE:
-            handleCompleteState();
-            break;
-        case FEEDING_ERROR:
-            handleErrorState();
-            break;
+    // Peticiones y cancelaciones llegadas desde otras tareas
+    applyRequests();
+    
+    // Solo se sondea el estado actual; la tabla se recorre si hay evento
+    Table::Poll poll = states[currentState].poll;
+    if (poll) {
+        FeedingEvent event = (this->*poll)();
+        if (event != FEEDING_EV_NONE) {
+            dispatch(event);
+        }
+    }
+    
+    // El siguiente trabajo arranca en la misma pasada en que el anterior
+    // vuelve a reposo
+    if (currentState == FEEDING_IDLE) {
+        startNextJob();
     }
 }
 
-bool FeedingLogic::startFeeding() {
-    if (feedingInProgress) {
+bool FeedingLogic::dispatch(FeedingEvent event) {
+    const Table::Transition* transition =
+        Table::find(transitions, transitionCount, *this, currentState, event);
+    if (!transition) {
         return false;
     }
     
-    feedingInProgress = true;
+    // Se registra antes de las acciones para que quede delante de lo que
+    // éstas provoquen (parada del motor, etc.)
+    traceDispatch(currentState, event, transition->to);
+    setState(transition->to);
+    return true;
+}
+
+void FeedingLogic::traceDispatch(FeedingState from, FeedingEvent event, FeedingState to) {
+    TraceRecord entry;
+    entry.timestamp = (uint32_t)MonotonicClock::nowMs();
+    entry.value = (int32_t)getStateElapsedTime();
+    entry.source = TRACE_SOURCE_FEEDING;
+    entry.state = from;
+    entry.event = event;
+    entry.next = to;
+    entry.compartment = stepperController ? stepperController->getCurrentCompartment() : -1;
+    entry.temperature = TRACE_NO_TEMPERATURE;
+    entry.humidity = TRACE_NO_HUMIDITY;
     
-    if (soundEnabled) {
-        setState(FEEDING_SOUND_ALERT);
-    } else if (presenceRequired) {
-        setState(FEEDING_WAITING_PRESENCE);
-    } else {
-        setState(FEEDING_MOVING_CAROUSEL);
+    uint8_t flags = 0;
+    if (soundEnabled) flags |= TRACE_FLAG_SOUND_ENABLED;
+    if (presenceNeeded) flags |= TRACE_FLAG_PRESENCE_NEEDED;
+    if (dispenseQueued) flags |= TRACE_FLAG_DISPENSE_QUEUED;
+    
+    if (sensorManager) {
+        if (sensorManager->isPresenceDetected()) flags |= TRACE_FLAG_PRESENCE;
+        
+        // Valores en caché: registrar no dispara lecturas del sensor
+        EnvironmentData env = sensorManager->getEnvironmentData();
+        if (env.valid) {
+            entry.temperature = (int8_t)constrain(lroundf(env.temperature), -127, 127);
+            entry.humidity = (uint8_t)constrain(lroundf(env.humidity), 0, 100);
+        }
+    }
+    if (stepperController) {
+        if (stepperController->isMotorMoving()) flags |= TRACE_FLAG_MOTOR_MOVING;
+        if (stepperController->isJammed()) flags |= TRACE_FLAG_JAMMED;
     }
+    entry.flags = flags;
     
-    return true;
+    feedingTrace.record(entry);
 }
 
-bool FeedingLogic::startFeedingManual() {
-    presenceRequired = false;
-    bool result = startFeeding();
-    presenceRequired = true;
-    return result;
+const char* FeedingLogic::getEventName(FeedingEvent event) {
+    static const char* const names[FEEDING_EVENT_COUNT] = {
+        "NONE", "START", "CANCEL", "ALERT_DONE", "PRESENCE",
+        "AT_HOLE", "RETURNING", "DONE", "FAILED", "ACK"
+    };
+    return event < FEEDING_EVENT_COUNT ? names[event] : "?";
 }
 
-void FeedingLogic::cancelFeeding() {
-    stepperController->stopMotor();
-    completeFeedingError("Alimentación cancelada por usuario");
+#ifndef ARDUINO_ARCH_ESP32
+int FeedingLogic::replay(const TraceRecord* records, uint16_t count) const {
+    // Las guardas se evalúan sobre una instancia aparte sin motor ni
+    // sensores, y los estados se siguen en una variable local: no se
+    // ejecutan acciones (sonido, motor, inventario), no se publican eventos
+    // ni se registra nada, y esta máquina queda tal cual
+    FeedingLogic guards(nullptr, nullptr);
+    FeedingState state = FEEDING_IDLE;
+    bool started = false;
+    
+    for (uint16_t i = 0; i < count; i++) {
+        const TraceRecord& entry = records[i];
+        if (entry.source != TRACE_SOURCE_FEEDING) continue;
+        
+        if (entry.state >= FEEDING_STATE_COUNT || entry.next >= FEEDING_STATE_COUNT ||
+            entry.event >= FEEDING_EVENT_COUNT) {
+            return i;
+        }
+        
+        // La traza puede empezar a mitad de una alimentación
+        if (!started) {
+            state = (FeedingState)entry.state;
+            started = true;
+        }
+        if (state != entry.state) {
+            return i;
+        }
+        
+        // Entradas de las guardas tal como estaban
+        guards.soundEnabled = entry.flags & TRACE_FLAG_SOUND_ENABLED;
+        guards.presenceNeeded = entry.flags & TRACE_FLAG_PRESENCE_NEEDED;
+        
+        const Table::Transition* transition =
+            Table::find(transitions, transitionCount, guards, state, (FeedingEvent)entry.event);
+        if (!transition || transition->to != entry.next) {
+            return i;
+        }
+        state = transition->to;
+    }
+    
+    return -1;
 }
+#endif
 
 void FeedingLogic::setState(FeedingState newState) {
-    if (currentState != newState) {
-        previousState = currentState;
-        currentState = newState;
-        stateStartTime = millis();
-        
-        if (stateChangeCallback) {
-            stateChangeCallback(newState);
+    if (currentState == newState) return;
+    
+    Table::Action exit = states[currentState].onExit;
+    if (exit) (this->*exit)();
+    
+    previousState = currentState;
+    currentState = newState;
+    stateStartTime = MonotonicClock::nowMs();
+    
+    Table::Action entry = states[newState].onEntry;
+    if (entry) (this->*entry)();
+    
+    eventBus.publish(EVENT_FEEDING_STATE, newState);
+}
+
+// ========== CONTROL DE ALIMENTACIÓN ==========
+
+FeedingRequestResult FeedingLogic::requestFeeding(FeedingSource source, uint8_t portions) {
+    if (portions == 0 || portions > FEEDING_MAX_PORTIONS) {
+        return FEEDING_REQUEST_REJECTED;
+    }
+    
+    if (inventory.getFilledCount() == 0) {
+        return FEEDING_REQUEST_NO_FOOD;
+    }
+    
+    // La alimentación manual no espera a la mascota
+    uint64_t now = MonotonicClock::nowMs();
+    FeedingJob job = { source, portions,
+                       source == FEEDING_SOURCE_SCHEDULED && presenceRequired, now };
+    FeedingRequestResult result;
+    
+    // Aquí solo se encola (la web llama desde su tarea); la máquina de
+    // estados, el motor y el sonido solo se tocan en update()
+    REQUEST_LOCK();
+    if (coalesce(source, portions, now)) {
+        result = FEEDING_REQUEST_MERGED;
+    } else {
+        bool idle = currentState == FEEDING_IDLE && !jobActive && queueLength == 0;
+        if (!enqueue(job)) {
+            result = FEEDING_REQUEST_REJECTED;
+        } else {
+            result = idle ? FEEDING_REQUEST_STARTED : FEEDING_REQUEST_QUEUED;
         }
     }
+    REQUEST_UNLOCK();
+    
+    // Arranca en la siguiente pasada de loop(), aunque esté en reposo
+    if (result != FEEDING_REQUEST_REJECTED) {
+        powerManager.wake();
+    }
+    return result;
 }
 
-void FeedingLogic::handleIdleState() {
-    // Espera inicio de alimentación
+void FeedingLogic::cancelFeeding() {
+    // La cola se vacía ya; el trabajo en curso se cancela en update()
+    REQUEST_LOCK();
+    queueLength = 0;
+    cancelRequested = true;
+    REQUEST_UNLOCK();
+    
+    powerManager.wake();
 }
 
-void FeedingLogic::handleSoundAlertState() {
-    if (sensorManager) {
-        sensorManager->playFeedingAlert();
+void FeedingLogic::applyRequests() {
+    REQUEST_LOCK();
+    bool cancel = cancelRequested;
+    uint8_t portions = mergedPortions;
+    bool manual = mergedManual;
+    cancelRequested = false;
+    mergedPortions = 0;
+    mergedManual = false;
+    REQUEST_UNLOCK();
+    
+    if (cancel) {
+        lastError = "Alimentación cancelada por usuario";
+        dispatch(FEEDING_EV_CANCEL);
+        return;
     }
     
-    if (presenceRequired) {
-        setState(FEEDING_WAITING_PRESENCE);
-    } else {
-        setState(FEEDING_MOVING_CAROUSEL);
+    if (jobActive) {
+        // Las raciones solo cambian mientras la secuencia no esté en marcha
+        if (!dispenseQueued && portions > currentJob.portions) currentJob.portions = portions;
+        if (manual) presenceNeeded = false;
     }
 }
 
-void FeedingLogic::handleWaitingPresenceState() {
-    if (sensorManager) {
-        sensorManager->update();
+bool FeedingLogic::editInventory(int compartment, bool filled, int portionGrams) {
+    // Con el carrusel girando no se sabe qué compartimento está en el agujero
+    if (feedingInProgress) {
+        return false;
+    }
+    
+    if (compartment == NO_COMPARTMENT) {
+        if (!filled || !CompartmentInventory::isValidPortion(portionGrams)) return false;
+        inventory.fillAll(portionGrams, TimeUtils::getUnixTime());
+        return true;
+    }
+    
+    if (filled) {
+        return inventory.fill(compartment, portionGrams, TimeUtils::getUnixTime());
+    }
+    if (!inventory.markEmpty(compartment)) {
+        return false;
+    }
+    return portionGrams <= 0 || inventory.setPortionGrams(compartment, portionGrams);
+}
+
+// ========== COLA DE TRABAJOS ==========
+
+bool FeedingLogic::coalesce(FeedingSource source, uint8_t portions, uint64_t now) {
+    // Dos peticiones casi simultáneas (doble pulsación, web y Telegram a la
+    // vez, la programada justo tras una manual) son la misma alimentación:
+    // se quedan las raciones mayores, no la suma. Con el cerrojo tomado
+    
+    if (jobActive && now - currentJob.requestedAt < FEEDING_COALESCE_MS) {
+        // El trabajo en curso es de loop(): se le aplica en update()
+        if (portions > mergedPortions) mergedPortions = portions;
+        if (source != FEEDING_SOURCE_SCHEDULED) mergedManual = true;
+        return true;
+    }
+    
+    for (uint8_t i = 0; i < queueLength; i++) {
+        if (now - queue[i].requestedAt >= FEEDING_COALESCE_MS) continue;
+        
+        FeedingJob job = queue[i];
+        if (portions > job.portions) job.portions = portions;
+        if (source != FEEDING_SOURCE_SCHEDULED) job.requirePresence = false;
+        if (priority(source) > priority(job.source)) job.source = source;
         
-        if (sensorManager->isPresenceDetected()) {
-            setState(FEEDING_MOVING_CAROUSEL);
-            return;
+        // Reinsertar por si ha subido de prioridad (conserva su hora de llegada)
+        for (uint8_t j = i; j + 1 < queueLength; j++) {
+            queue[j] = queue[j + 1];
         }
+        queueLength--;
+        enqueue(job);
+        return true;
+    }
+    return false;
+}
+
+bool FeedingLogic::enqueue(const FeedingJob& job) {
+    if (queueLength >= FEEDING_QUEUE_SIZE) {
+        return false;
     }
     
-    if (getStateElapsedTime() > maxWaitTimeMs) {
-        completeFeedingError("Timeout: mascota no detectada");
+    // Detrás de los de igual o mayor prioridad
+    uint8_t pos = queueLength;
+    while (pos > 0 && priority(queue[pos - 1].source) < priority(job.source)) {
+        queue[pos] = queue[pos - 1];
+        pos--;
     }
+    queue[pos] = job;
+    queueLength++;
+    return true;
 }
 
-void FeedingLogic::handleMovingCarouselState() {
-    if (!stepperController) {
-        completeFeedingError("Error: controlador de motor no disponible");
-        return;
+void FeedingLogic::startNextJob() {
+    REQUEST_LOCK();
+    bool available = queueLength > 0;
+    if (available) {
+        currentJob = queue[0];
+        for (uint8_t i = 1; i < queueLength; i++) {
+            queue[i - 1] = queue[i];
+        }
+        queueLength--;
+        jobActive = true;
+        mergedPortions = 0;
+        mergedManual = false;
     }
+    REQUEST_UNLOCK();
     
-    if (!stepperController->isMotorMoving()) {
-        if (stepperController->getCurrentCompartment() == targetCompartment) {
-            setState(FEEDING_DISPENSING);
-        } else {
-            stepperController->moveToCompartment(targetCompartment);
-        }
+    if (!available) return;
+    
+    presenceNeeded = currentJob.requirePresence;
+    lastJobWaitMs = (unsigned long)MonotonicClock::elapsedMs(currentJob.requestedAt);
+    
+    dispatch(FEEDING_EV_START);
+}
+
+uint8_t FeedingLogic::priority(FeedingSource source) {
+    // Quien pide a mano está esperando delante del comedero
+    return source == FEEDING_SOURCE_SCHEDULED ? 0 : 1;
+}
+
+unsigned long FeedingLogic::getQueueWaitTime() const {
+    uint64_t now = MonotonicClock::nowMs();
+    uint64_t longest = 0;
+    
+    REQUEST_LOCK();
+    for (uint8_t i = 0; i < queueLength; i++) {
+        uint64_t wait = now - queue[i].requestedAt;
+        if (wait > longest) longest = wait;
     }
+    REQUEST_UNLOCK();
+    return (unsigned long)longest;
 }
 
-void FeedingLogic::handleDispensingState() {
-    if (getStateElapsedTime() >= feedingDurationMs) {
-        setState(FEEDING_RETURNING);
+const char* FeedingLogic::getSourceName(FeedingSource source) {
+    switch (source) {
+        case FEEDING_SOURCE_SCHEDULED: return "Programada";
+        case FEEDING_SOURCE_WEB:       return "Web";
+        case FEEDING_SOURCE_TELEGRAM:  return "Telegram";
+        default:                       return "Desconocido";
     }
 }
 
+// ========== ACCIONES ==========
 
-void FeedingLogic::handleReturningState() {
-    if (!stepperController) {
-        completeFeedingError("Error: controlador de motor no disponible");
-        return;
+void FeedingLogic::onLeaveIdle() {
+    feedingInProgress = true;
+    dispenseQueued = false;
+    dispensePortions = 0;
+}
+
+void FeedingLogic::onEnterSoundAlert() {
+    if (sensorManager) {
+        sensorManager->playFeedingAlert();
     }
+}
+
+void FeedingLogic::onLeaveSoundAlert() {
+    // Si se cancela a mitad, que no siga sonando
+    if (sensorManager) {
+        sensorManager->stopSound();
+    }
+}
+
+void FeedingLogic::onEnterComplete() {
+    REQUEST_LOCK();
+    jobActive = false;
+    REQUEST_UNLOCK();
+    feedingInProgress = false;
+    dispenseQueued = false;
     
-    if (!stepperController->isMotorMoving()) {
-        int nextCompartment = (targetCompartment + 1) % TOTAL_COMPARTMENTS;
-        if (stepperController->getCurrentCompartment() == nextCompartment) {
-            completeFeedingSuccess();
-        } else {
-            stepperController->moveToCompartment(nextCompartment);
+    eventBus.publish(EVENT_FEEDING_COMPLETE, true);
+}
+
+void FeedingLogic::onEnterError() {
+    // Cancelación o fallo a mitad de secuencia: no dejar el carrusel girando
+    if (dispenseQueued) {
+        markDispensed(stepperController->getCompletedCommands());
+        if (stepperController->isMotorMoving()) {
+            stepperController->stopMotor();
         }
     }
+    
+    // El trabajo se da por terminado; la cola sigue
+    REQUEST_LOCK();
+    jobActive = false;
+    REQUEST_UNLOCK();
+    feedingInProgress = false;
+    dispenseQueued = false;
+    
+    eventBus.publish(EVENT_FEEDING_ERROR, lastError);
+    eventBus.publish(EVENT_FEEDING_COMPLETE, false);
 }
 
-void FeedingLogic::handleCompleteState() {
-    setState(FEEDING_IDLE);
+// ========== SONDEO ==========
+
+FeedingEvent FeedingLogic::pollSoundAlert() {
+    // La alerta se lanza en la entrada al estado y suena sin bloquear
+    // (las notas avanzan con timerQueue)
+    if (sensorManager && sensorManager->isSoundPlaying()) {
+        return FEEDING_EV_NONE;
+    }
+    return FEEDING_EV_ALERT_DONE;
 }
 
-void FeedingLogic::handleErrorState() {
-    setState(FEEDING_IDLE);
+FeedingEvent FeedingLogic::pollWaitingPresence() {
+    // Una petición manual unificada con esta deja de esperar a la mascota
+    if (!presenceNeeded) {
+        return FEEDING_EV_PRESENCE;
+    }
+    
+    // Los flancos del PIR (ISR) ya los consumió sensors.update() en esta pasada
+    if (sensorManager && sensorManager->isPresenceDetected()) {
+        return FEEDING_EV_PRESENCE;
+    }
+    
+    if (getStateElapsedTime() > (uint64_t)maxWaitTimeMs) {
+        return fail("Timeout: mascota no detectada");
+    }
+    return FEEDING_EV_NONE;
 }
 
-void FeedingLogic::completeFeedingSuccess() {
-    feedingInProgress = false;
-    setState(FEEDING_COMPLETE);
+FeedingEvent FeedingLogic::pollMovingCarousel() {
+    if (!stepperController) {
+        return fail("Error: controlador de motor no disponible");
+    }
     
-    if (feedingCompleteCallback) {
-        feedingCompleteCallback(true);
+    if (!dispenseQueued) {
+        // Esperar a que termine cualquier movimiento ajeno a la alimentación
+        if (stepperController->isMotorMoving()) return FEEDING_EV_NONE;
+        
+        // Se pudo vaciar mientras el trabajo esperaba en cola
+        if (inventory.getFilledCount() == 0) {
+            return fail("Sin comida: todos los compartimentos están vacíos");
+        }
+        
+        if (!startDispenseSequence()) {
+            return fail("No se pudo iniciar la secuencia de dispensado");
+        }
+        return FEEDING_EV_NONE;
     }
+    
+    return pollDispenseSequence();
 }
 
-void FeedingLogic::completeFeedingError(String error) {
-    feedingInProgress = false;
-    lastError = error;
-    setState(FEEDING_ERROR);
+FeedingEvent FeedingLogic::pollDispenseSequence() {
+    uint8_t completed = stepperController->getCompletedCommands();
+    markDispensed(completed);
     
-    if (feedingErrorCallback) {
-        feedingErrorCallback(error);
+    if (!stepperController->isMotorMoving()) {
+        if (completed >= dispenseCommandCount) {
+            return FEEDING_EV_DONE;
+        }
+        if (stepperController->isJammed()) {
+            return fail("Carrusel atascado: no se pudo completar el dispensado");
+        }
+        return fail("Movimiento del carrusel interrumpido");
     }
     
-    if (feedingCompleteCallback) {
-        feedingCompleteCallback(false);
+    if (completed >= dispenseCommandCount - 1) {
+        return FEEDING_EV_RETURNING;
     }
+    if (completed >= 1) {
+        return FEEDING_EV_AT_HOLE;
+    }
+    return FEEDING_EV_NONE;
 }
 
-unsigned long FeedingLogic::getStateElapsedTime() const {
-    return millis() - stateStartTime;
+FeedingEvent FeedingLogic::pollFinished() {
+    return FEEDING_EV_ACK;
 }
 
-String FeedingLogic::getStateString() const {
-    switch (currentState) {
-        case FEEDING_IDLE: return "Inactivo";
-        case FEEDING_SOUND_ALERT: return "Reproduciendo alerta";
-        case FEEDING_WAITING_PRESENCE: return "Esperando presencia";
-        case FEEDING_MOVING_CAROUSEL: return "Moviendo carrusel";
-        case FEEDING_DISPENSING: return "Dispensando comida";
-        case FEEDING_RETURNING: return "Regresando posición";
-        case FEEDING_COMPLETE: return "Completado";
-        case FEEDING_ERROR: return "Error";
-        default: return "Desconocido";
+bool FeedingLogic::startDispenseSequence() {
+    static_assert(3 * FEEDING_MAX_PORTIONS + 1 <= MOTION_MAX_COMMANDS,
+                  "La secuencia de FEEDING_MAX_PORTIONS raciones no cabe en MOTION_MAX_COMMANDS");
+    
+    // Por cada ración: ir directo al compartimento lleno más cercano,
+    // esperar y agitar; al final, apartarse a uno vacío. Una sola secuencia
+    // que el motor ejecuta sin pausas entre tramos
+    uint8_t requested = jobActive ? currentJob.portions : 1;
+    int rest;
+    uint8_t portions = inventory.planRoute(stepperController->getCurrentCompartment(),
+                                           requested, dispenseRoute, rest);
+    if (portions == 0) {
+        return false;
+    }
+    
+    MotionCommand sequence[MOTION_MAX_COMMANDS];
+    uint8_t count = 0;
+    
+    for (uint8_t portion = 0; portion < portions; portion++) {
+        sequence[count++] = { MOTION_MOVE_TO, dispenseRoute[portion], 0, 0 };
+        sequence[count++] = { MOTION_DWELL, 0, (uint32_t)feedingDurationMs, 0 };
+        if (FEEDING_AGITATE_CYCLES > 0) {
+            sequence[count++] = { MOTION_AGITATE, 0, 0, FEEDING_AGITATE_CYCLES };
+        }
+    }
+    sequence[count++] = { MOTION_MOVE_TO, rest, 0, 0 };
+    
+    if (!stepperController->runSequence(sequence, count)) {
+        return false;
     }
+    
+    dispenseQueued = true;
+    dispenseCommandCount = count;
+    dispensePortions = portions;
+    dispensedPortions = 0;
+    commandsPerPortion = (count - 1) / portions;
+    return true;
+}
+
+void FeedingLogic::markDispensed(uint8_t completedCommands) {
+    // La comida cae en cuanto el compartimento llega al agujero: se da por
+    // vacío al completarse su MOVE_TO, aunque después se cancele
+    while (dispensedPortions < dispensePortions &&
+           completedCommands > dispensedPortions * commandsPerPortion) {
+        inventory.markEmpty(dispenseRoute[dispensedPortions++]);
+    }
+}
+
+FeedingEvent FeedingLogic::fail(const String& error) {
+    lastError = error;
+    return FEEDING_EV_FAILED;
+}
+
+uint64_t FeedingLogic::getStateElapsedTime() const {
+    return MonotonicClock::elapsedMs(stateStartTime);
 }
 
 float FeedingLogic::getFeedingProgress() const {
@@ -225,11 +631,11 @@ float FeedingLogic::getFeedingProgress() const {
         case FEEDING_WAITING_PRESENCE:
             return 20.0 + (30.0 * getStateElapsedTime() / maxWaitTimeMs);
         case FEEDING_MOVING_CAROUSEL:
-            return 50.0 + (20.0 * stepperController->getProgress() / 100.0);
         case FEEDING_DISPENSING:
-            return 70.0 + (20.0 * getStateElapsedTime() / feedingDurationMs);
         case FEEDING_RETURNING:
-            return 90.0 + (10.0 * stepperController->getProgress() / 100.0);
+            // Toda la secuencia de dispensado sobre su línea de tiempo planificada
+            if (!dispenseQueued) return 50.0;
+            return 50.0 + (50.0 * stepperController->getProgress() / 100.0);
         case FEEDING_COMPLETE:
             return 100.0;
         default:
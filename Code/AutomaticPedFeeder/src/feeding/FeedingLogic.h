@@ -5,6 +5,11 @@
 #include "../config.h"
 #include "../hardware/StepperController.h"
 #include "../hardware/SensorManager.h"
+#include "CompartmentInventory.h"
+#include "../utils/StateTable.h"
+#include "../utils/EventBus.h"
+#include "../utils/FeedingTrace.h"
+#include "../utils/MonotonicClock.h"
 
 enum FeedingState {
     FEEDING_IDLE,
@@ -14,18 +19,61 @@ enum FeedingState {
     FEEDING_DISPENSING,
     FEEDING_RETURNING,
     FEEDING_COMPLETE,
-    FEEDING_ERROR
+    FEEDING_ERROR,
+    FEEDING_STATE_COUNT
+};
+
+enum FeedingEvent : uint8_t {
+    FEEDING_EV_NONE,
+    FEEDING_EV_START,
+    FEEDING_EV_CANCEL,
+    FEEDING_EV_ALERT_DONE,
+    FEEDING_EV_PRESENCE,
+    FEEDING_EV_AT_HOLE,      // Primera orden (ir al agujero) completada
+    FEEDING_EV_RETURNING,    // Solo falta la vuelta
+    FEEDING_EV_DONE,
+    FEEDING_EV_FAILED,       // Motivo en lastError
+    FEEDING_EV_ACK,          // Estados finales: volver a reposo
+    FEEDING_EVENT_COUNT
+};
+
+// Origen de una petición; las manuales tienen prioridad sobre las programadas
+enum FeedingSource : uint8_t {
+    FEEDING_SOURCE_SCHEDULED,
+    FEEDING_SOURCE_WEB,
+    FEEDING_SOURCE_TELEGRAM
+};
+
+enum FeedingRequestResult {
+    FEEDING_REQUEST_STARTED,
+    FEEDING_REQUEST_QUEUED,
+    FEEDING_REQUEST_MERGED,     // Unificada con otra dentro de FEEDING_COALESCE_MS
+    FEEDING_REQUEST_REJECTED,   // Cola llena o raciones fuera de rango
+    FEEDING_REQUEST_NO_FOOD     // Todos los compartimentos vacíos
+};
+
+struct FeedingJob {
+    FeedingSource source;
+    uint8_t portions;
+    bool requirePresence;
+    uint64_t requestedAt;  // MonotonicClock::nowMs() de la primera petición
 };
 
 class FeedingLogic {
 private:
+    typedef StateTable<FeedingLogic, FeedingState, FeedingEvent> Table;
+    static const Table::StateInfo states[FEEDING_STATE_COUNT];
+    static const Table::Transition transitions[];
+    static const size_t transitionCount;
+    
     StepperController* stepperController;
     SensorManager* sensorManager;
+    CompartmentInventory inventory;
     
     // Estado
     FeedingState currentState;
     FeedingState previousState;
-    unsigned long stateStartTime;
+    uint64_t stateStartTime;
     
     // Configuración
     bool soundEnabled;
@@ -33,14 +81,30 @@ private:
     int maxWaitTimeMs;
     int feedingDurationMs;
     
-    // Callbacks
-    void (*feedingCompleteCallback)(bool);
-    void (*feedingErrorCallback)(String);
-    void (*stateChangeCallback)(FeedingState);
+    // Cola de trabajos, ordenada por prioridad y después por llegada. Las
+    // peticiones llegan también desde la tarea del servidor web: la cola,
+    // jobActive, currentJob.requestedAt y lo pendiente se tocan con el
+    // cerrojo de peticiones; todo lo demás es solo de loop()
+    FeedingJob queue[FEEDING_QUEUE_SIZE];
+    volatile uint8_t queueLength;
+    FeedingJob currentJob;
+    bool jobActive;
+    unsigned long lastJobWaitMs;
+    
+    // Pendiente de aplicar en update()
+    bool cancelRequested;
+    uint8_t mergedPortions;  // Unificadas con el trabajo en curso
+    bool mergedManual;       // Y alguna era manual (deja de esperar presencia)
     
     // Datos de alimentación actual
-    int targetCompartment;
     bool feedingInProgress;
+    bool presenceNeeded;  // Esta alimentación espera a la mascota
+    bool dispenseQueued;
+    uint8_t dispenseCommandCount;
+    int dispenseRoute[FEEDING_MAX_PORTIONS];  // Compartimentos, en orden
+    uint8_t dispensePortions;
+    uint8_t dispensedPortions;  // Ya pasados por el agujero (vaciados)
+    uint8_t commandsPerPortion;
     String lastError;
     
 public:
@@ -50,17 +114,33 @@ public:
     void begin();
     void update();
     
-    // Control de alimentación
-    bool startFeeding();
-    bool startFeedingManual();
-    void cancelFeeding();
+    // Control de alimentación (seguro desde otras tareas): solo encolan; el
+    // trabajo arranca o se cancela en el siguiente update(), en loop()
+    FeedingRequestResult requestFeeding(FeedingSource source, uint8_t portions = 1);
+    void cancelFeeding();  // Cancela el trabajo en curso y vacía la cola
+    
+    // Edición del inventario (solo desde loop(); la web la manda con
+    // EVENT_INVENTORY_EDIT). compartment NO_COMPARTMENT = todos. false con
+    // una alimentación en curso o datos no válidos
+    bool editInventory(int compartment, bool filled, int portionGrams);
     
     // Estado
     FeedingState getState() const { return currentState; }
-    String getStateString() const;
+    const char* getStateString() const { return states[currentState].name; }
+    static const char* getStateName(FeedingState state) { return states[state].name; }
+    static const char* getEventName(FeedingEvent event);
     bool isFeedingInProgress() const { return feedingInProgress; }
     float getFeedingProgress() const;
     String getLastError() const { return lastError; }
+    uint8_t getCurrentPortions() const { return jobActive ? currentJob.portions : 0; }
+    uint8_t getQueueDepth() const { return queueLength; }
+    unsigned long getQueueWaitTime() const;  // Espera del trabajo más antiguo en cola
+    unsigned long getLastJobWaitTime() const { return lastJobWaitMs; }
+    static const char* getSourceName(FeedingSource source);
+    
+    // Inventario (se edita desde loop(): Telegram y editInventory(); main lo persiste)
+    CompartmentInventory& getInventory() { return inventory; }
+    const CompartmentInventory& getInventory() const { return inventory; }
     
     // Configuración
     void enableSound(bool enable) { soundEnabled = enable; }
@@ -68,31 +148,52 @@ public:
     void setMaxWaitTime(int timeMs) { maxWaitTimeMs = timeMs; }
     void setFeedingDuration(int timeMs) { feedingDurationMs = timeMs; }
     
-    // Callbacks
-    void setFeedingCompleteCallback(void (*callback)(bool)) { 
-        feedingCompleteCallback = callback; 
-    }
-    void setFeedingErrorCallback(void (*callback)(String)) { 
-        feedingErrorCallback = callback; 
-    }
-    void setStateChangeCallback(void (*callback)(FeedingState)) { 
-        stateChangeCallback = callback; 
-    }
+    // Eventos (EventBus): EVENT_FEEDING_STATE, EVENT_FEEDING_ERROR y
+    // EVENT_FEEDING_COMPLETE
+    
+#ifndef ARDUINO_ARCH_ESP32
+    // Reproduce una traza (feedingTrace o un volcado de /api/feeding/trace)
+    // sobre la tabla de transiciones: cada registro de alimentación aplica
+    // su evento con las guardas registradas y se comprueba el destino.
+    // Sin efectos: no toca el estado, el motor, el sonido ni el inventario.
+    // Devuelve el índice del primer registro que no coincide, o -1
+    int replay(const TraceRecord* records, uint16_t count) const;
+#endif
     
 private:
+    bool dispatch(FeedingEvent event);
     void setState(FeedingState newState);
-    void handleIdleState();
-    void handleSoundAlertState();
-    void handleWaitingPresenceState();
-    void handleMovingCarouselState();
-    void handleDispensingState();
-    void handleReturningState();
-    void handleCompleteState();
-    void handleErrorState();
-    
-    void completeFeedingSuccess();
-    void completeFeedingError(String error);
-    unsigned long getStateElapsedTime() const;
+    
+    // Cola de trabajos
+    void applyRequests();
+    bool coalesce(FeedingSource source, uint8_t portions, uint64_t now);
+    bool enqueue(const FeedingJob& job);
+    void startNextJob();
+    static uint8_t priority(FeedingSource source);
+    
+    // Guardas
+    bool isSoundEnabled() const { return soundEnabled; }
+    bool isPresenceNeeded() const { return presenceNeeded; }
+    
+    // Acciones de entrada y salida
+    void onLeaveIdle();
+    void onEnterSoundAlert();
+    void onLeaveSoundAlert();
+    void onEnterComplete();
+    void onEnterError();
+    
+    // Sondeo por estado
+    FeedingEvent pollSoundAlert();
+    FeedingEvent pollWaitingPresence();
+    FeedingEvent pollMovingCarousel();
+    FeedingEvent pollDispenseSequence();
+    FeedingEvent pollFinished();
+    
+    void traceDispatch(FeedingState from, FeedingEvent event, FeedingState to);
+    bool startDispenseSequence();
+    void markDispensed(uint8_t completedCommands);
+    FeedingEvent fail(const String& error);
+    uint64_t getStateElapsedTime() const;
 };
 
 #endif // FEEDING_LOGIC_H
\ No newline at end of file
@@ -5,44 +5,248 @@ FeedingScheduler::FeedingScheduler(FeedingLogic* logic)
       enabled(true),
       feedingIntervalHours(DEFAULT_FEEDING_INTERVAL_HOURS),
       maxFeedingsPerDay(DEFAULT_PORTIONS_PER_DAY),
-      lastFeedingTime(0),
+      portionsPerFeeding(DEFAULT_PORTIONS_PER_FEEDING),
+      slotCount(0),
+      nextWake(0),
       nextFeedingTime(0),
+      nextDayStart(0),
+      nextSlotKey(0),
+      intervalStart(0),
+      lastFeedingTime(0),
+      lastSlotKey(0),
+      currentDay(0),
+      lastWake(0),
+      lastWakeMs(0),
       feedingsTodayCount(0),
-      lastDay(-1),
-      scheduledFeedingCallback(nullptr) {
+      missedPolicy(DEFAULT_MISSED_FEEDING_POLICY),
+      restorePending(false),
+      restoredNext(0),
+      catchUpTime(0),
+      catchUpRemaining(0),
+      savedNext(0),
+      savedDay(0) {
 }
 
 void FeedingScheduler::begin() {
-    scheduleNextFeeding();
+    intervalStart = TimeUtils::now();
+    invalidate();
+    timerQueue.every(SCHEDULER_CHECK_MS, onTimer, this);
+}
+
+void FeedingScheduler::onTimer(void* context) {
+    static_cast<FeedingScheduler*>(context)->update();
 }
 
 void FeedingScheduler::update() {
+    // Caso normal: una sola comparación, sin consultar la hora local
+    time_t now = TimeUtils::now();
+    if (now < nextWake) return;
+    
+    shiftClock(now);
+    if (restorePending && TimeUtils::isValidTime(now)) {
+        resolveMissed(now);
+    }
+    
+    if (enabled && catchUpRemaining > 0 && now >= catchUpTime) {
+        // Recuperación de una toma perdida: no cuenta como toma fija hecha
+        if (!executeFeeding(now)) {
+            nextWake = now + SCHEDULER_RETRY_S;
+            return;
+        }
+        catchUpRemaining--;
+        catchUpTime = now + (time_t)MISSED_FEEDING_SPACING_MIN * 60;
+        intervalStart = now;
+    } else if (enabled && nextFeedingTime != 0 && now >= nextFeedingTime) {
+        if (now - nextFeedingTime >= SCHEDULER_LATE_GRACE_S) {
+            // La hora ha saltado hacia delante: lo que quedó atrás no se da
+            finishSlot(now);
+        } else if (!executeFeeding(now)) {
+            // Cola llena: la misma toma se reintenta más tarde
+            nextWake = now + SCHEDULER_RETRY_S;
+            return;
+        } else {
+            finishSlot(now);
+        }
+    }
+    
+    recompute(now);
+}
+
+void FeedingScheduler::recompute(time_t now) {
+    bool synced = TimeUtils::isValidTime(now);
+    
+    nextDayStart = synced ? rollDay(now) : 0;
+    
+    // Próxima toma: las horas fijas necesitan hora NTP; el intervalo no
+    if (slotCount > 0) {
+        nextFeedingTime = synced ? nextSlotAfter(now, nextSlotKey) : 0;
+    } else {
+        nextFeedingTime = intervalStart + (time_t)feedingIntervalHours * 3600;
+    }
+    
+    // Una recuperación que llegaría después de la próxima toma sobra
+    if (catchUpRemaining > 0 && nextFeedingTime != 0 && catchUpTime >= nextFeedingTime) {
+        catchUpRemaining = 0;
+    }
+    
+    // Sin nada pendiente se espera a EVENT_TIME_SYNC o a un cambio de configuración
+    nextWake = (time_t)LONG_MAX;
+    if (enabled && nextFeedingTime != 0 && nextFeedingTime < nextWake) nextWake = nextFeedingTime;
+    if (enabled && catchUpRemaining > 0 && catchUpTime < nextWake) nextWake = catchUpTime;
+    if (nextDayStart != 0 && nextDayStart < nextWake) nextWake = nextDayStart;
+    
+    lastWake = now;
+    lastWakeMs = MonotonicClock::nowMs();
+    publishIfChanged();
+}
+
+time_t FeedingScheduler::rollDay(time_t now) {
+    // Cambio de día (también si la hora ha saltado por encima de medianoche)
+    struct tm local;
+    localtime_r(&now, &local);
+    
+    int32_t day = (local.tm_year + 1900) * 1000 + local.tm_yday;
+    if (currentDay != 0 && day != currentDay) {
+        feedingsTodayCount = 0;
+        eventBus.publish(EVENT_NEW_DAY, local.tm_mday);
+    }
+    currentDay = day;
+    return startOfNextDay(local);
+}
+
+void FeedingScheduler::shiftClock(time_t now) {
+    // Antes del primer NTP el reloj cuenta desde el arranque: al sincronizar
+    // se trasladan los instantes del modo intervalo para no perder la espera
+    if (lastWake == 0 || TimeUtils::isValidTime(lastWake) || !TimeUtils::isValidTime(now)) {
+        return;
+    }
+    
+    time_t expected = lastWake + (time_t)(MonotonicClock::elapsedMs(lastWakeMs) / 1000);
+    time_t delta = now - expected;
+    
+    intervalStart += delta;
+    if (nextFeedingTime != 0) nextFeedingTime += delta;
+    // La última toma restaurada (restore()) ya es hora Unix
+    if (lastFeedingTime != 0 && !TimeUtils::isValidTime(lastFeedingTime)) lastFeedingTime += delta;
+}
+
+// ========== ESTADO GUARDADO ==========
+
+void FeedingScheduler::restore(time_t nextFeeding, time_t lastFeeding, int32_t day, int todayCount,
+                               int32_t slotKey) {
+    restoredNext = TimeUtils::isValidTime(nextFeeding) ? nextFeeding : 0;
+    restorePending = restoredNext != 0;
+    if (TimeUtils::isValidTime(lastFeeding)) lastFeedingTime = lastFeeding;
+    
+    // Sin ella, un reinicio en la hora repetida de octubre repetiría la toma
+    lastSlotKey = slotKey;
+    
+    // El contador sigue si es el mismo día; si no, recompute() publica EVENT_NEW_DAY
+    currentDay = day;
+    feedingsTodayCount = todayCount;
+    savedNext = restoredNext;
+    savedDay = day;
+    invalidate();
+    
+    time_t now = TimeUtils::now();
+    if (restorePending && TimeUtils::isValidTime(now)) {
+        resolveMissed(now);
+    }
+}
+
+void FeedingScheduler::copyTo(FeederConfig& config) const {
+    config.nextFeedingTime = (unsigned long)persistentNext();
+    config.feedingsDay = currentDay;
+    config.feedingsToday = feedingsTodayCount;
+    config.lastSlotKey = lastSlotKey;
+}
+
+void FeedingScheduler::resolveMissed(time_t now) {
+    time_t due = restoredNext;
+    restorePending = false;
+    restoredNext = 0;
+    
+    // Las recuperaciones cuentan en el tope del día de hoy
+    rollDay(now);
     if (!enabled) return;
     
-    // Verificar cambio de día
-    int currentDay = TimeUtils::getCurrentDay();
-    if (currentDay != lastDay) {
-        resetDailyCount();
-        lastDay = currentDay;
+    if (due > now) {
+        // Nada perdido: el intervalo sigue contando desde antes del apagado
+        if (slotCount == 0) intervalStart = due - (time_t)feedingIntervalHours * 3600;
+        return;
+    }
+    
+    intervalStart = now;
+    uint8_t missed = countMissed(due, now);
+    if (missed == 0) return;
+    
+    uint8_t recover = 0;
+    if (missedPolicy == MISSED_FEEDING_ALL) recover = missed;
+    else if (missedPolicy == MISSED_FEEDING_ONCE) recover = 1;
+    
+    // Las recuperaciones caben antes de la próxima toma fija
+    if (slotCount > 0) {
+        int32_t key;
+        time_t next = nextSlotAfter(now, key);
+        while (recover > 0 && next != 0 &&
+               now + (time_t)recover * MISSED_FEEDING_SPACING_MIN * 60 > next) {
+            recover--;
+        }
+    }
+    
+    catchUpRemaining = recover;
+    catchUpTime = now;
+    eventBus.publish(EVENT_MISSED_FEEDINGS, missed, recover);
+}
+
+uint8_t FeedingScheduler::countMissed(time_t due, time_t now) const {
+    time_t interval = (time_t)feedingIntervalHours * 3600;
+    time_t horizon = now - (time_t)MISSED_FEEDING_LOOKBACK_H * 3600;
+    int32_t key;
+    
+    // Un apagado largo solo cuenta desde el horizonte
+    if (due < horizon) {
+        due = slotCount > 0 ? nextSlotAfter(horizon - 1, key)
+                            : due + (horizon - due + interval - 1) / interval * interval;
     }
     
-    // Verificar si es hora de alimentar
-    if (shouldFeedNow()) {
-        executeFeeding();
+    // La guardada también es perdida salvo que se llegara a dar
+    uint8_t missed = 0;
+    while (due != 0 && due <= now && missed < UINT8_MAX) {
+        if (due > lastFeedingTime) missed++;
+        due = slotCount > 0 ? nextSlotAfter(due, key) : due + interval;
     }
+    return missed;
+}
+
+time_t FeedingScheduler::persistentNext() const {
+    if (!enabled) return 0;
+    if (restorePending) return restoredNext;
+    
+    // Una recuperación pendiente se guarda como la próxima toma
+    time_t next = TimeUtils::isValidTime(nextFeedingTime) ? nextFeedingTime : 0;
+    if (catchUpRemaining > 0 && (next == 0 || catchUpTime < next)) next = catchUpTime;
+    return next;
+}
+
+void FeedingScheduler::publishIfChanged() {
+    time_t next = persistentNext();
+    if (next == savedNext && currentDay == savedDay) return;
+    
+    savedNext = next;
+    savedDay = currentDay;
+    eventBus.publish(EVENT_SCHEDULE_CHANGED);
 }
 
 void FeedingScheduler::setEnabled(bool enable) {
     enabled = enable;
-    if (enabled) {
-        scheduleNextFeeding();
-    }
+    invalidate();
 }
 
 void FeedingScheduler::setFeedingInterval(int hours) {
     if (hours > 0 && hours <= 24) {
         feedingIntervalHours = hours;
-        scheduleNextFeeding();
+        invalidate();
     }
 }
 
@@ -52,31 +256,181 @@ void FeedingScheduler::setMaxFeedingsPerDay(int max) {
     }
 }
 
+void FeedingScheduler::setPortionsPerFeeding(int portions) {
+    if (portions > 0 && portions <= FEEDING_MAX_PORTIONS) {
+        portionsPerFeeding = portions;
+    }
+}
+
+bool FeedingScheduler::setFeedingSlots(const String& text) {
+    FeedingSlot parsed[FEEDING_MAX_SLOTS];
+    uint8_t count;
+    if (!parseSlots(text, parsed, count)) {
+        return false;
+    }
+    
+    for (uint8_t i = 0; i < count; i++) {
+        slots[i] = parsed[i];
+    }
+    slotCount = count;
+    invalidate();
+    return true;
+}
+
+void FeedingScheduler::setMissedFeedingPolicy(int policy) {
+    if (policy >= MISSED_FEEDING_SKIP && policy <= MISSED_FEEDING_ALL) {
+        missedPolicy = policy;
+    }
+}
+
 void FeedingScheduler::resetDailyCount() {
     feedingsTodayCount = 0;
-    scheduleNextFeeding();
+    invalidate();
 }
 
-void FeedingScheduler::scheduleNextFeeding() {
-    if (lastFeedingTime == 0) {
-        // Primera alimentación inmediata o en el próximo intervalo
-        nextFeedingTime = millis() + (feedingIntervalHours * 3600000UL);
-    } else {
-        nextFeedingTime = lastFeedingTime + (feedingIntervalHours * 3600000UL);
+void FeedingScheduler::recordFeeding() {
+    // Una que termina pasada la medianoche ya cuenta en el día nuevo
+    time_t now = TimeUtils::now();
+    if (TimeUtils::isValidTime(now)) rollDay(now);
+    feedingsTodayCount++;
+}
+
+// ========== CÁLCULO DE INSTANTES ==========
+
+time_t FeedingScheduler::nextSlotAfter(time_t from, int32_t& key) const {
+    struct tm today;
+    localtime_r(&from, &today);
+    
+    time_t best = 0;
+    for (int day = 0; day <= 7 && best == 0; day++) {
+        for (uint8_t i = 0; i < slotCount; i++) {
+            // mktime normaliza el fin de mes y decide el horario de verano;
+            // una hora inexistente (cambio de marzo) pasa a la siguiente
+            struct tm candidate = {};
+            candidate.tm_year = today.tm_year;
+            candidate.tm_mon = today.tm_mon;
+            candidate.tm_mday = today.tm_mday + day;
+            candidate.tm_hour = slots[i].hour;
+            candidate.tm_min = slots[i].minute;
+            candidate.tm_isdst = -1;
+            time_t t = mktime(&candidate);
+            
+            if (!(slots[i].weekdays & (1 << candidate.tm_wday))) continue;
+            
+            // La hora repetida del cambio de octubre no da dos tomas
+            int32_t slotKey = (candidate.tm_year * 400 + candidate.tm_yday) * 1440 +
+                              slots[i].hour * 60 + slots[i].minute;
+            if (t <= from || slotKey <= lastSlotKey) continue;
+            
+            if (best == 0 || t < best) {
+                best = t;
+                key = slotKey;
+            }
+        }
+    }
+    return best;
+}
+
+time_t FeedingScheduler::startOfNextDay(const struct tm& local) {
+    struct tm midnight = {};
+    midnight.tm_year = local.tm_year;
+    midnight.tm_mon = local.tm_mon;
+    midnight.tm_mday = local.tm_mday + 1;
+    midnight.tm_isdst = -1;
+    return mktime(&midnight);
+}
+
+// ========== HORARIO EN TEXTO ==========
+
+bool FeedingScheduler::parseSlots(const String& text, FeedingSlot* out, uint8_t& count) {
+    static const char dayLetters[] = "DLMXJVS";  // Índice = tm_wday
+    uint8_t parsed = 0;
+    const char* p = text.c_str();
+    
+    while (*p) {
+        while (*p == ' ' || *p == ',') p++;
+        if (!*p) break;
+        
+        int hour, minute, consumed;
+        if (sscanf(p, "%2d:%2d%n", &hour, &minute, &consumed) != 2 ||
+            hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+            return false;
+        }
+        p += consumed;
+        
+        uint8_t days = 0;
+        while (*p && *p != ',') {
+            char c = toupper(*p++);
+            if (c == ' ') continue;
+            
+            const char* letter = strchr(dayLetters, c);
+            if (!letter) return false;
+            days |= 1 << (letter - dayLetters);
+        }
+        
+        if (parsed >= FEEDING_MAX_SLOTS) return false;
+        out[parsed++] = { (uint8_t)hour, (uint8_t)minute, days ? days : (uint8_t)ALL_WEEKDAYS };
+    }
+    
+    count = parsed;
+    return true;
+}
+
+String FeedingScheduler::formatSlots(const FeedingSlot* slots, uint8_t count) {
+    static const char dayLetters[] = "DLMXJVS";
+    String text = "";
+    
+    for (uint8_t i = 0; i < count; i++) {
+        char buffer[20];
+        int length = snprintf(buffer, sizeof(buffer), "%s%02d:%02d",
+                              i > 0 ? ", " : "", slots[i].hour, slots[i].minute);
+        
+        if (slots[i].weekdays != ALL_WEEKDAYS) {
+            buffer[length++] = ' ';
+            // De lunes a domingo
+            for (int d = 1; d <= 7; d++) {
+                if (slots[i].weekdays & (1 << (d % 7))) buffer[length++] = dayLetters[d % 7];
+            }
+            buffer[length] = '\0';
+        }
+        text += buffer;
     }
+    return text;
 }
 
+// ========== ESTADO ==========
+
 unsigned long FeedingScheduler::getTimeUntilNextFeeding() const {
     if (!enabled || nextFeedingTime == 0) {
         return 0;
     }
     
-    unsigned long currentTime = millis();
-    if (currentTime >= nextFeedingTime) {
+    time_t now = TimeUtils::now();
+    if (now >= nextFeedingTime) {
         return 0;
     }
     
-    return nextFeedingTime - currentTime;
+    return (unsigned long)(nextFeedingTime - now) * 1000UL;
+}
+
+String FeedingScheduler::getNextFeedingString() const {
+    if (!enabled) {
+        return "Desactivada";
+    }
+    if (nextFeedingTime == 0) {
+        return slotCount > 0 ? "Esperando hora NTP" : "-";
+    }
+    
+    String remaining = "en " + formatTimeRemaining(getTimeUntilNextFeeding());
+    if (!TimeUtils::isValidTime(nextFeedingTime)) {
+        return remaining;
+    }
+    
+    struct tm local;
+    localtime_r(&nextFeedingTime, &local);
+    char buffer[16];
+    strftime(buffer, sizeof(buffer), "%H:%M", &local);
+    return String(buffer) + " (" + remaining + ")";
 }
 
 String FeedingScheduler::getScheduleStatus() const {
@@ -84,32 +438,39 @@ String FeedingScheduler::getScheduleStatus() const {
         return "Programación: Desactivada";
     }
     
-    String status = "Próxima alimentación en: ";
-    status += formatTimeRemaining(getTimeUntilNextFeeding());
+    String status = "Próxima alimentación: ";
+    status += getNextFeedingString();
     status += " | Hoy: " + String(feedingsTodayCount) + "/" + String(maxFeedingsPerDay);
     
     return status;
 }
 
-bool FeedingScheduler::shouldFeedNow() const {
-    if (!enabled) return false;
-    if (feedingLogic->isFeedingInProgress()) return false;
-    if (feedingsTodayCount >= maxFeedingsPerDay) return false;
-    if (nextFeedingTime == 0) return false;
-    
-    return millis() >= nextFeedingTime;
-}
-
-void FeedingScheduler::executeFeeding() {
-    if (feedingLogic->startFeeding()) {
-        lastFeedingTime = millis();
-        feedingsTodayCount++;
-        scheduleNextFeeding();
+bool FeedingScheduler::executeFeeding(time_t now) {
+    // Una toma que no se hace (tope diario, sin comida) se omite. El tope
+    // cuenta las completadas (recordFeeding()), también las manuales
+    if (feedingsTodayCount < maxFeedingsPerDay) {
+        // Si hay otra en curso queda en cola en lugar de perderse
+        FeedingRequestResult result = feedingLogic->requestFeeding(FEEDING_SOURCE_SCHEDULED, portionsPerFeeding);
+        
+        if (result == FEEDING_REQUEST_REJECTED) {
+            return false;
+        }
         
-        if (scheduledFeedingCallback) {
-            scheduledFeedingCallback();
+        if (result == FEEDING_REQUEST_NO_FOOD) {
+            eventBus.publish(EVENT_FEEDING_ERROR, String("Toma programada omitida: comedero vacío"));
+        } else {
+            lastFeedingTime = now;
+            eventBus.publish(EVENT_SCHEDULED_FEEDING, portionsPerFeeding);
         }
     }
+    
+    return true;
+}
+
+// La siguiente toma se calcula desde ahora
+void FeedingScheduler::finishSlot(time_t now) {
+    intervalStart = now;
+    if (slotCount > 0) lastSlotKey = nextSlotKey;
 }
 
 String FeedingScheduler::formatTimeRemaining(unsigned long milliseconds) const {
@@ -127,14 +488,14 @@ String FeedingScheduler::formatTimeRemaining(unsigned long milliseconds) const {
     String result = "";
     
     if (hours > 0) {
-        result += String(hours) + "h ";
+        result += String(hours) + "h";
     }
     if (minutes > 0) {
-        result += String(minutes) + "m ";
+        result += String(result.length() > 0 ? " " : "") + String(minutes) + "m";
     }
     if (hours == 0 && seconds > 0) {
-        result += String(seconds) + "s";
+        result += String(result.length() > 0 ? " " : "") + String(seconds) + "s";
     }
     
     return result.length() > 0 ? result : "0s";
-}
\ No newline at end of file
+}
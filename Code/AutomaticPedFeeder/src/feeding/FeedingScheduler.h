@@ -5,8 +5,28 @@
 #include "../config.h"
 #include "FeedingLogic.h"
 #include "../utils/TimeUtils.h"
+#include "../utils/EventBus.h"
+#include "../utils/MonotonicClock.h"
+#include "../utils/TimerQueue.h"
 
+#define ALL_WEEKDAYS 0x7F
+#define SCHEDULER_CHECK_MS 1000     // Periodo de update() en timerQueue (la hora va en segundos)
+#define SCHEDULER_RETRY_S 60        // Reintento si la cola de alimentación está llena
+#define SCHEDULER_LATE_GRACE_S 900  // Una toma vencida hace más (salto de hora) se omite
 
+// Toma a una hora fija (hora local)
+struct FeedingSlot {
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t weekdays;  // Bit tm_wday (bit 0 = domingo)
+};
+
+// Programación de tomas a horas fijas (si hay) o cada N horas. Todos los
+// instantes se precalculan sobre TimeUtils::now(): update() solo compara
+// con el siguiente y recalcula al llegar a él, a medianoche, al cambiar la
+// configuración o tras un salto de hora (invalidate() con EVENT_TIME_SYNC).
+// La próxima toma y el día se guardan en FeederConfig (EVENT_SCHEDULE_CHANGED);
+// al arrancar, restore() decide qué hacer con las tomas perdidas
 class FeedingScheduler {
 private:
     FeedingLogic* feedingLogic;
@@ -15,20 +35,38 @@ private:
     bool enabled;
     int feedingIntervalHours;
     int maxFeedingsPerDay;
+    int portionsPerFeeding;
+    FeedingSlot slots[FEEDING_MAX_SLOTS];
+    uint8_t slotCount;
+    
+    // Instantes precalculados (segundos de TimeUtils::now())
+    time_t nextWake;           // Próxima vez que update() hace algo (0 = recalcular)
+    time_t nextFeedingTime;    // 0 = ninguna prevista
+    time_t nextDayStart;       // Medianoche local (0 = sin hora NTP)
+    int32_t nextSlotKey;
     
     // Estado
-    unsigned long lastFeedingTime;
-    unsigned long nextFeedingTime;
-    int feedingsTodayCount;
-    int lastDay;
+    time_t intervalStart;      // Última toma o arranque (modo cada N horas)
+    time_t lastFeedingTime;
+    int32_t lastSlotKey;       // Última toma fija hecha (fecha local y hora)
+    int32_t currentDay;        // Fecha local (año * 1000 + día del año)
+    time_t lastWake;
+    uint64_t lastWakeMs;       // MonotonicClock en lastWake
+    int feedingsTodayCount;    // Alimentaciones completadas hoy (recordFeeding())
     
-    // Callbacks
-    void (*scheduledFeedingCallback)();
+    // Tomas perdidas con el comedero apagado (restore())
+    int missedPolicy;          // MISSED_FEEDING_*
+    bool restorePending;       // Esperando hora válida para resolverlas
+    time_t restoredNext;       // Próxima toma guardada antes de apagarse
+    time_t catchUpTime;        // Próxima toma de recuperación
+    uint8_t catchUpRemaining;
+    time_t savedNext;          // Lo último publicado con EVENT_SCHEDULE_CHANGED
+    int32_t savedDay;
     
 public:
     FeedingScheduler(FeedingLogic* logic);
     
-    // Inicialización
+    // Inicialización: begin() registra update() en timerQueue
     void begin();
     void update();
     
@@ -36,26 +74,55 @@ public:
     void setEnabled(bool enable);
     void setFeedingInterval(int hours);
     void setMaxFeedingsPerDay(int max);
+    void setPortionsPerFeeding(int portions);
+    bool setFeedingSlots(const String& text);  // false si no se entiende (no cambia nada)
     void resetDailyCount();
-    void scheduleNextFeeding();
+    void recordFeeding();  // EVENT_FEEDING_COMPLETE con éxito (programada o manual)
+    void invalidate() { nextWake = 0; }        // La hora ha saltado o cambió la configuración
+    void setMissedFeedingPolicy(int policy);
+    
+    // Estado guardado (hora Unix). restore() va tras configurar y begin(),
+    // sin esperar a la red: con hora válida (RTC tras un reinicio en
+    // caliente) resuelve ya las tomas perdidas; si no, al sincronizar
+    void restore(time_t nextFeeding, time_t lastFeeding, int32_t day, int todayCount,
+                 int32_t slotKey);
+    void copyTo(FeederConfig& config) const;
     
     // Estado
     bool isEnabled() const { return enabled; }
     int getFeedingInterval() const { return feedingIntervalHours; }
-    unsigned long getNextFeedingTime() const { return nextFeedingTime; }
-    unsigned long getTimeUntilNextFeeding() const;
-    int getFeedingsTodayCount() const { return feedingsTodayCount; }
+    int getPortionsPerFeeding() const { return portionsPerFeeding; }
+    bool usesFixedTimes() const { return slotCount > 0; }
+    String getFeedingSlots() const { return formatSlots(slots, slotCount); }
+    time_t getNextFeedingTime() const { return nextFeedingTime; }
+    unsigned long getTimeUntilNextFeeding() const;  // ms
+    int getFeedingsTodayCount() const { return feedingsTodayCount; }  // El del tope diario
+    int getMissedFeedingPolicy() const { return missedPolicy; }
+    uint8_t getPendingCatchUp() const { return catchUpRemaining; }
+    String getNextFeedingString() const;
     String getScheduleStatus() const;
     
-    // Callbacks
-    void setScheduledFeedingCallback(void (*callback)()) { 
-        scheduledFeedingCallback = callback; 
-    }
+    // "08:00, 13:00 LMXJV, 20:00": días opcionales (L M X J V S D)
+    static bool parseSlots(const String& text, FeedingSlot* out, uint8_t& count);
+    static String formatSlots(const FeedingSlot* slots, uint8_t count);
+    
+    // Eventos (EventBus): EVENT_SCHEDULED_FEEDING, EVENT_NEW_DAY,
+    // EVENT_MISSED_FEEDINGS y EVENT_SCHEDULE_CHANGED
     
 private:
-    bool shouldFeedNow() const;
-    void executeFeeding();
+    static void onTimer(void* context);
+    void recompute(time_t now);
+    time_t rollDay(time_t now);  // Devuelve la próxima medianoche local
+    void shiftClock(time_t now);
+    void resolveMissed(time_t now);
+    uint8_t countMissed(time_t due, time_t now) const;
+    time_t persistentNext() const;
+    void publishIfChanged();
+    bool executeFeeding(time_t now);
+    void finishSlot(time_t now);
+    time_t nextSlotAfter(time_t from, int32_t& key) const;
+    static time_t startOfNextDay(const struct tm& local);
     String formatTimeRemaining(unsigned long milliseconds) const;
 };
 
-#endif // FEEDING_SCHEDULER_H
\ No newline at end of file
+#endif // FEEDING_SCHEDULER_H
@@ -0,0 +1,100 @@
+#ifndef FAST_PIN_H
+#define FAST_PIN_H
+
+#include <Arduino.h>
+#include "../config.h"
+
+#include <soc/gpio_reg.h>
+
+// GPIO libres en el ESP32-S3 con PSRAM octal (qio_opi): 22-25 no existen,
+// 26-32 van a la flash SPI y 33-37 a la PSRAM octal
+constexpr bool isUsableGpio(int pin) {
+    return pin >= 0 && pin <= 48 && (pin < 22 || pin > 37);
+}
+
+// GPIO con el número de pin fijado en compilación. Escribe directamente
+// los registros W1TS/W1TC (una sola escritura, apta para la ISR de pasos);
+// fuera del target son los registros simulados de sim/shims/soc/gpio_reg.h.
+template <int Pin>
+class FastPin {
+    static_assert(isUsableGpio(Pin),
+                  "GPIO inexistente o reservado para flash/PSRAM en el ESP32-S3");
+
+public:
+    static void output() { pinMode(Pin, OUTPUT); }
+    static void input(uint8_t mode = INPUT) { pinMode(Pin, mode); }
+
+    static inline void ARDUINO_ISR_ATTR high() {
+        if (Pin < 32) REG_WRITE(GPIO_OUT_W1TS_REG, 1UL << (Pin & 31));
+        else REG_WRITE(GPIO_OUT1_W1TS_REG, 1UL << (Pin & 31));
+    }
+
+    static inline void ARDUINO_ISR_ATTR low() {
+        if (Pin < 32) REG_WRITE(GPIO_OUT_W1TC_REG, 1UL << (Pin & 31));
+        else REG_WRITE(GPIO_OUT1_W1TC_REG, 1UL << (Pin & 31));
+    }
+
+    static inline bool ARDUINO_ISR_ATTR read() {
+        uint32_t in = Pin < 32 ? REG_READ(GPIO_IN_REG) : REG_READ(GPIO_IN1_REG);
+        return (in >> (Pin & 31)) & 1;
+    }
+
+    static inline void ARDUINO_ISR_ATTR write(bool level) {
+        if (level) high();
+        else low();
+    }
+};
+
+// ========== COMPROBACIÓN DE PINES EN COMPILACIÓN ==========
+
+namespace PinCheck {
+    // Todos los GPIO asignados en config.h (-1 = sin conectar)
+    constexpr int assigned[] = {
+        STEPPER_STEP_PIN, STEPPER_DIR_PIN, STEPPER_ENABLE_PIN, STEPPER_MS_PIN,
+        STEPPER_DIAG_PIN, HOME_SENSOR_PIN, DHT_PIN, PIR_PIN, BUZZER_PIN,
+#ifndef DISABLE_CAMERA
+        PWDN_GPIO_NUM, RESET_GPIO_NUM, XCLK_GPIO_NUM, SIOD_GPIO_NUM, SIOC_GPIO_NUM,
+        Y2_GPIO_NUM, Y3_GPIO_NUM, Y4_GPIO_NUM, Y5_GPIO_NUM, Y6_GPIO_NUM,
+        Y7_GPIO_NUM, Y8_GPIO_NUM, Y9_GPIO_NUM, VSYNC_GPIO_NUM, HREF_GPIO_NUM, PCLK_GPIO_NUM,
+#endif
+    };
+
+    constexpr int uses(int pin) {
+        int count = 0;
+        for (int assignedPin : assigned) {
+            if (assignedPin == pin) count++;
+        }
+        return count;
+    }
+
+    // También los que no pasan por FastPin (cámara, DHT, buzzer...)
+    constexpr bool allUsable() {
+        for (int assignedPin : assigned) {
+            if (assignedPin >= 0 && !isUsableGpio(assignedPin)) return false;
+        }
+        return true;
+    }
+}
+
+static_assert(PinCheck::allUsable(), "Pin de config.h inexistente o reservado para flash/PSRAM");
+
+#define PIN_CHECK_UNIQUE(pin) \
+    static_assert((pin) < 0 || PinCheck::uses(pin) == 1, #pin " comparte GPIO con otro periférico")
+
+PIN_CHECK_UNIQUE(STEPPER_STEP_PIN);
+PIN_CHECK_UNIQUE(STEPPER_DIR_PIN);
+PIN_CHECK_UNIQUE(STEPPER_ENABLE_PIN);
+PIN_CHECK_UNIQUE(STEPPER_MS_PIN);
+PIN_CHECK_UNIQUE(STEPPER_DIAG_PIN);
+PIN_CHECK_UNIQUE(HOME_SENSOR_PIN);
+PIN_CHECK_UNIQUE(DHT_PIN);
+PIN_CHECK_UNIQUE(PIR_PIN);
+PIN_CHECK_UNIQUE(BUZZER_PIN);
+
+// Pines del motor, usados desde la ISR de pasos
+typedef FastPin<STEPPER_STEP_PIN> StepPin;
+typedef FastPin<STEPPER_DIR_PIN> DirPin;
+typedef FastPin<STEPPER_ENABLE_PIN> EnablePin;
+typedef FastPin<STEPPER_MS_PIN> MicrostepPin;
+
+#endif // FAST_PIN_H
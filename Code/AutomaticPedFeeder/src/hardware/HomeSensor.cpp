@@ -0,0 +1,78 @@
+#include "HomeSensor.h"
+#include "FastPin.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+
+void HomeSensor::begin() {
+    FastPin<HOME_SENSOR_PIN>::input(HOME_SENSOR_ACTIVE_LOW ? INPUT_PULLUP : INPUT_PULLDOWN);
+}
+
+bool ARDUINO_ISR_ATTR HomeSensor::isActive() {
+    return FastPin<HOME_SENSOR_PIN>::read() != HOME_SENSOR_ACTIVE_LOW;
+}
+
+#else  // Modelo simulado para compilación nativa
+
+struct SimulatedMark {
+    int32_t position;
+    uint16_t width;
+};
+
+static SimulatedMark simulatedMarks[HOME_SENSOR_MAX_SIMULATED_MARKS];
+static uint8_t simulatedMarkCount = 0;
+static int32_t physicalPosition = 0;
+static int32_t jamPosition = 0;
+static uint8_t jamHolds = 0;
+static bool jamContact = false;
+
+void HomeSensor::begin() {
+}
+
+bool HomeSensor::isActive() {
+    for (uint8_t i = 0; i < simulatedMarkCount; i++) {
+        int32_t offset = (physicalPosition - simulatedMarks[i].position) % STEPS_PER_CAROUSEL_TURN;
+        if (offset < 0) offset += STEPS_PER_CAROUSEL_TURN;
+        if (offset < simulatedMarks[i].width) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HomeSensor::simulateMark(int32_t position, uint16_t width) {
+    if (simulatedMarkCount < HOME_SENSOR_MAX_SIMULATED_MARKS) {
+        simulatedMarks[simulatedMarkCount++] = { position, width };
+    }
+}
+
+void HomeSensor::simulateClear() {
+    simulatedMarkCount = 0;
+}
+
+void HomeSensor::simulateMove(int32_t steps) {
+    if (jamHolds > 0) {
+        if (steps > 0 && physicalPosition <= jamPosition && physicalPosition + steps > jamPosition) {
+            // El pienso bloquea el carrusel: el pulso se pierde
+            physicalPosition = jamPosition;
+            jamContact = true;
+            return;
+        }
+        if (steps < 0 && jamContact) {
+            jamContact = false;
+            jamHolds--;
+        }
+    }
+    physicalPosition += steps;
+}
+
+void HomeSensor::simulateJam(int32_t position, uint8_t holds) {
+    jamPosition = position;
+    jamHolds = holds;
+    jamContact = false;
+}
+
+int32_t HomeSensor::simulatedPosition() {
+    return physicalPosition;
+}
+
+#endif
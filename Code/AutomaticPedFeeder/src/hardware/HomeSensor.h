@@ -0,0 +1,33 @@
+#ifndef HOME_SENSOR_H
+#define HOME_SENSOR_H
+
+#include <Arduino.h>
+#include "../config.h"
+
+#define HOME_SENSOR_MAX_SIMULATED_MARKS 8
+
+// Entrada del sensor de origen del carrusel (final de carrera o hall).
+// La lee la ISR de pasos durante el homing; fuera del target se compila
+// un modelo simulado con marcas en posiciones físicas del carrusel.
+class HomeSensor {
+public:
+    // Inicialización
+    static void begin();
+    
+    // Estado (seguro en ISR)
+    static bool isActive();
+    
+#ifndef ARDUINO_ARCH_ESP32
+    // Modelo nativo: marcas de 'width' micropasos a partir de 'position'
+    // (posición física, independiente del contador del motor)
+    static void simulateMark(int32_t position, uint16_t width);
+    static void simulateClear();
+    static void simulateMove(int32_t steps);  // Lo llama el generador de pasos
+    // Atasco: el carrusel no pasa de 'position' avanzando hasta que se
+    // retrocede desde el tope 'holds' veces (0 = sin atasco)
+    static void simulateJam(int32_t position, uint8_t holds);
+    static int32_t simulatedPosition();
+#endif
+};
+
+#endif // HOME_SENSOR_H
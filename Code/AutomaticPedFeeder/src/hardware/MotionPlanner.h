@@ -0,0 +1,106 @@
+#ifndef MOTION_PLANNER_H
+#define MOTION_PLANNER_H
+
+#include <Arduino.h>
+
+// Planificador de perfiles en S (jerk limitado). El perfil es simétrico:
+// la aceleración sube con jerk constante, se mantiene, y baja hasta cero
+// al alcanzar la velocidad de pico; la frenada es su imagen en el tiempo.
+// Todo es constexpr para poder generar las tablas durante la compilación.
+
+struct SCurveProfile {
+    double peakSpeed;     // pasos/s
+    double peakAccel;     // pasos/s² (menor que el límite en movimientos cortos)
+    double jerkTime;      // s, cada tramo de jerk
+    double accelTime;     // s, tramo de aceleración constante
+    double rampTime;      // s, rampa completa 0 → peakSpeed
+    double rampDistance;  // pasos recorridos en la rampa
+};
+
+namespace MotionPlanner {
+
+constexpr double constSqrt(double x) {
+    if (x <= 0) return 0;
+    double root = x > 1 ? x : 1;
+    for (int i = 0; i < 64; i++) {
+        double next = 0.5 * (root + x / root);
+        if (next == root) break;
+        root = next;
+    }
+    return root;
+}
+
+constexpr SCurveProfile rampTo(double speed, double maxAccel, double jerk) {
+    SCurveProfile profile{};
+    profile.peakSpeed = speed;
+    // Si no da tiempo a llegar a la aceleración máxima, el perfil es solo jerk
+    profile.peakAccel = speed * jerk < maxAccel * maxAccel ? constSqrt(speed * jerk) : maxAccel;
+    profile.jerkTime = profile.peakAccel / jerk;
+    profile.accelTime = speed > 0 ? speed / profile.peakAccel - profile.jerkTime : 0;
+    if (profile.accelTime < 0) profile.accelTime = 0;
+    profile.rampTime = 2 * profile.jerkTime + profile.accelTime;
+    profile.rampDistance = speed * profile.rampTime / 2;
+    return profile;
+}
+
+// Perfil para recorrer 'distance' pasos: si no cabe la rampa completa se
+// busca (bisección) la velocidad de pico cuya rampa ocupa media distancia
+constexpr SCurveProfile plan(double distance, double maxSpeed, double maxAccel, double jerk) {
+    SCurveProfile profile = rampTo(maxSpeed, maxAccel, jerk);
+    if (profile.rampDistance <= distance / 2) {
+        return profile;
+    }
+    
+    double low = 0;
+    double high = maxSpeed;
+    for (int i = 0; i < 60; i++) {
+        double mid = (low + high) / 2;
+        if (rampTo(mid, maxAccel, jerk).rampDistance < distance / 2) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return rampTo(low, maxAccel, jerk);
+}
+
+// Posición (pasos) en el instante t de la rampa de aceleración
+constexpr double positionAt(const SCurveProfile& p, double t) {
+    const double jerk = p.jerkTime > 0 ? p.peakAccel / p.jerkTime : 0;
+    
+    if (t <= p.jerkTime) {
+        return jerk * t * t * t / 6;
+    }
+    
+    const double x1 = jerk * p.jerkTime * p.jerkTime * p.jerkTime / 6;
+    const double v1 = jerk * p.jerkTime * p.jerkTime / 2;
+    if (t <= p.jerkTime + p.accelTime) {
+        double tau = t - p.jerkTime;
+        return x1 + v1 * tau + p.peakAccel * tau * tau / 2;
+    }
+    
+    const double x2 = x1 + v1 * p.accelTime + p.peakAccel * p.accelTime * p.accelTime / 2;
+    const double v2 = v1 + p.peakAccel * p.accelTime;
+    double tau = t - p.jerkTime - p.accelTime;
+    if (tau > p.jerkTime) tau = p.jerkTime;
+    return x2 + v2 * tau + p.peakAccel * tau * tau / 2 - jerk * tau * tau * tau / 6;
+}
+
+// Instante en que la rampa alcanza 'position' pasos (bisección sobre t)
+constexpr double timeAt(const SCurveProfile& p, double position, double fromTime) {
+    double low = fromTime;
+    double high = p.rampTime;
+    for (int i = 0; i < 40; i++) {
+        double mid = (low + high) / 2;
+        if (positionAt(p, mid) < position) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return high;
+}
+
+} // namespace MotionPlanner
+
+#endif // MOTION_PLANNER_H
@@ -0,0 +1,8 @@
+#include "MotionTables.h"
+
+namespace MotionTables {
+
+// Evaluada por completo durante la compilación; queda en .rodata (flash)
+constexpr std::array<MoveTable, MOTION_MAX_COMPARTMENT_MOVE> TABLES = buildAllTables();
+
+} // namespace MotionTables
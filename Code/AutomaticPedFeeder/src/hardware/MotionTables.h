@@ -0,0 +1,108 @@
+#ifndef MOTION_TABLES_H
+#define MOTION_TABLES_H
+
+#include <Arduino.h>
+#include <array>
+#include "../config.h"
+#include "MotionPlanner.h"
+
+// Tablas de intervalos entre pasos generadas en tiempo de compilación a
+// partir de STEPPER_MAX_SPEED / STEPPER_ACCELERATION / STEPPER_JERK. Hay una
+// tabla por cada movimiento posible de 1..(TOTAL_COMPARTMENTS - 1)
+// compartimentos, así el generador de pasos solo reproduce enteros y no se
+// calcula ninguna raíz en tiempo de ejecución.
+//
+// El crucero se hace en paso completo: las tablas están en pasos completos
+// y cubren el recorrido menos la aproximación final en micropasos.
+
+#define MOTION_MAX_COMPARTMENT_MOVE (TOTAL_COMPARTMENTS - 1)
+
+namespace MotionTables {
+
+// Límites del perfil convertidos a pasos completos
+constexpr double COARSE_MAX_SPEED = (double)STEPPER_MAX_SPEED / MICROSTEPS;
+constexpr double COARSE_ACCELERATION = (double)STEPPER_ACCELERATION / MICROSTEPS;
+constexpr double COARSE_JERK = (double)STEPPER_JERK / MICROSTEPS;
+
+// Pasos completos de crucero de un movimiento de k compartimentos
+constexpr uint32_t coarseSteps(int compartments) {
+    return compartments * FULL_STEPS_PER_COMPARTMENT - MICROSTEP_APPROACH_FULL_STEPS;
+}
+
+constexpr uint32_t rampCapacity() {
+    double fullRamp = MotionPlanner::rampTo(COARSE_MAX_SPEED, COARSE_ACCELERATION, COARSE_JERK).rampDistance;
+    uint32_t halfLongestMove = coarseSteps(MOTION_MAX_COMPARTMENT_MOVE) / 2;
+    return fullRamp < halfLongestMove ? (uint32_t)fullRamp + 1 : halfLongestMove;
+}
+
+} // namespace MotionTables
+
+struct MoveTable {
+    uint32_t totalSteps;              // Pasos completos
+    uint32_t durationTicks;           // Duración planificada del movimiento
+    uint32_t rampTicks;               // Suma de los intervalos de la rampa
+    uint16_t rampSteps;
+    uint16_t cruiseTicks;             // Intervalo en el pico de velocidad
+    uint16_t ramp[MotionTables::rampCapacity()];  // Ticks antes de cada paso
+};
+
+namespace MotionTables {
+
+constexpr uint16_t toTicks(double us) {
+    double ticks = us / STEP_TIMER_TICK_US + 0.5;
+    if (ticks < 2) return 2;  // Un tick de pulso y al menos uno en bajo
+    if (ticks > 65535) return 65535;
+    return (uint16_t)ticks;
+}
+
+constexpr MoveTable buildMoveTable(uint32_t totalSteps) {
+    MoveTable table{};
+    table.totalSteps = totalSteps;
+    
+    // Se planifica un paso menos para que la misma rampa sirva cuando hace
+    // falta un micropaso de alineación al salir (el crucero absorbe la diferencia)
+    SCurveProfile profile = MotionPlanner::plan(totalSteps - 1, COARSE_MAX_SPEED,
+                                                COARSE_ACCELERATION, COARSE_JERK);
+    uint32_t rampSteps = (uint32_t)profile.rampDistance;
+    if (rampSteps > (totalSteps - 1) / 2) rampSteps = (totalSteps - 1) / 2;
+    if (rampSteps > rampCapacity()) rampSteps = rampCapacity();
+    
+    double previousTime = 0;
+    for (uint32_t n = 0; n < rampSteps; n++) {
+        double stepTime = MotionPlanner::timeAt(profile, n + 1, previousTime);
+        table.ramp[n] = toTicks((stepTime - previousTime) * 1000000.0);
+        table.rampTicks += table.ramp[n];
+        previousTime = stepTime;
+    }
+    
+    table.rampSteps = rampSteps;
+    table.cruiseTicks = profile.peakSpeed > 0 ? toTicks(1000000.0 / profile.peakSpeed) : 2;
+    table.durationTicks = 2 * table.rampTicks + (totalSteps - 2 * rampSteps) * table.cruiseTicks;
+    return table;
+}
+
+constexpr std::array<MoveTable, MOTION_MAX_COMPARTMENT_MOVE> buildAllTables() {
+    std::array<MoveTable, MOTION_MAX_COMPARTMENT_MOVE> tables{};
+    for (int k = 1; k <= MOTION_MAX_COMPARTMENT_MOVE; k++) {
+        tables[k - 1] = buildMoveTable(coarseSteps(k));
+    }
+    return tables;
+}
+
+// Definidas (constexpr, en flash) en MotionTables.cpp para que solo se
+// evalúen en una unidad de compilación
+extern const std::array<MoveTable, MOTION_MAX_COMPARTMENT_MOVE> TABLES;
+
+// Tabla más larga cuya rampa cabe en 'steps' pasos completos
+inline const MoveTable& forSteps(uint32_t steps) {
+    for (int k = MOTION_MAX_COMPARTMENT_MOVE; k > 1; k--) {
+        if (2UL * TABLES[k - 1].rampSteps <= steps) {
+            return TABLES[k - 1];
+        }
+    }
+    return TABLES[0];
+}
+
+} // namespace MotionTables
+
+#endif // MOTION_TABLES_H
@@ -0,0 +1,105 @@
+#include "PirSensor.h"
+#include "FastPin.h"
+#include "../utils/MonotonicClock.h"
+#include "../utils/PowerManager.h"
+
+#define PIR_EDGE_QUEUE_MASK (PIR_EDGE_QUEUE_SIZE - 1)
+
+static_assert((PIR_EDGE_QUEUE_SIZE & PIR_EDGE_QUEUE_MASK) == 0,
+              "PIR_EDGE_QUEUE_SIZE debe ser potencia de 2");
+
+// La ISR solo escribe edgeHead y el consumidor solo edgeTail
+static PirEdge edges[PIR_EDGE_QUEUE_SIZE];
+static volatile uint8_t edgeHead = 0;
+static volatile uint8_t edgeTail = 0;
+static volatile uint32_t droppedEdges = 0;
+static volatile bool lastLevel = false;
+
+static void ARDUINO_ISR_ATTR pushEdge(bool level, uint64_t timeUs) {
+    uint8_t next = (edgeHead + 1) & PIR_EDGE_QUEUE_MASK;
+    if (next == edgeTail) {
+        // Cola llena: el consumidor se resincroniza con el nivel del pin
+        droppedEdges++;
+        return;
+    }
+    edges[edgeHead].timeUs = timeUs;
+    edges[edgeHead].level = level;
+    edgeHead = next;
+}
+
+bool PirSensor::pop(PirEdge& edge) {
+    if (edgeTail == edgeHead) {
+        return false;
+    }
+    edge.timeUs = edges[edgeTail].timeUs;
+    edge.level = edges[edgeTail].level;
+    edgeTail = (edgeTail + 1) & PIR_EDGE_QUEUE_MASK;
+    return true;
+}
+
+bool PirSensor::hasPending() {
+    return edgeTail != edgeHead;
+}
+
+uint32_t PirSensor::getDroppedCount() {
+    return droppedEdges;
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <hal/gpio_ll.h>
+
+// Interrupción por nivel, armada siempre en el contrario al actual: es la
+// única que despierta del light sleep y es la misma que arma
+// PowerManager::armWakePins() con gpio_wakeup_enable() antes de dormir, así
+// que ambos conviven sin pisarse. Cada disparo equivale a un flanco.
+static void ARDUINO_ISR_ATTR onPirInterrupt() {
+    uint64_t now = MonotonicClock::nowUs();
+    bool level = FastPin<PIR_PIN>::read();
+    gpio_ll_set_intr_type(&GPIO, PIR_PIN, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+
+    if (level != lastLevel) {
+        lastLevel = level;
+        pushEdge(level, now);
+        powerManager.wake();
+    }
+}
+
+void PirSensor::begin() {
+    FastPin<PIR_PIN>::input(INPUT);
+
+    lastLevel = FastPin<PIR_PIN>::read();
+    if (lastLevel) {
+        pushEdge(true, MonotonicClock::nowUs());
+    }
+    attachInterrupt(PIR_PIN, onPirInterrupt, lastLevel ? ONLOW : ONHIGH);
+}
+
+bool PirSensor::isActive() {
+    return FastPin<PIR_PIN>::read();
+}
+
+#else  // Modelo simulado para compilación nativa
+
+void PirSensor::begin() {
+    if (lastLevel) {
+        pushEdge(true, MonotonicClock::nowUs());
+    }
+}
+
+bool PirSensor::isActive() {
+    return lastLevel;
+}
+
+void PirSensor::simulateEdge(bool level, uint64_t timeUs) {
+    lastLevel = level;
+    pushEdge(level, timeUs);
+}
+
+void PirSensor::simulateLevel(bool level) {
+    if (level != lastLevel) {
+        simulateEdge(level, MonotonicClock::nowUs());
+    }
+}
+
+#endif
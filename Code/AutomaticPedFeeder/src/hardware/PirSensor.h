@@ -0,0 +1,40 @@
+#ifndef PIR_SENSOR_H
+#define PIR_SENSOR_H
+
+#include <Arduino.h>
+#include "../config.h"
+
+#define PIR_EDGE_QUEUE_SIZE 16  // Flancos en cola (potencia de 2)
+
+struct PirEdge {
+    uint64_t timeUs;  // MonotonicClock::nowUs() en la ISR
+    bool level;       // Nivel tras el flanco
+};
+
+// Salida del sensor PIR. Cada cambio de nivel lo captura una ISR con su
+// marca en µs y lo deja en una cola de un solo productor (la ISR) y un
+// solo consumidor (loop(), a través de SensorManager::update()); la ISR
+// despierta a loop() con powerManager.wake(). Fuera del target no hay ISR:
+// los flancos se inyectan con simulateEdge()/simulateLevel().
+class PirSensor {
+public:
+    // Inicialización: si el PIR ya está activo se encola un flanco de subida
+    static void begin();
+
+    // Nivel actual del pin
+    static bool isActive();
+
+    // Cola de flancos (solo el consumidor)
+    static bool pop(PirEdge& edge);
+    static bool hasPending();
+    static uint32_t getDroppedCount();  // Flancos perdidos con la cola llena
+
+#ifndef ARDUINO_ARCH_ESP32
+    // Modelo nativo: flanco con marca arbitraria (no decreciente) o al
+    // nivel dado ahora mismo (solo encola si el nivel cambia)
+    static void simulateEdge(bool level, uint64_t timeUs);
+    static void simulateLevel(bool level);
+#endif
+};
+
+#endif // PIR_SENSOR_H
@@ -1,183 +1,281 @@
 #include "SensorManager.h"
+#include "../utils/PowerManager.h"
 
 SensorManager::SensorManager() 
     : dht(DHT_PIN, DHT_TYPE),
+      acquiredAlert(ALERT_NONE),
+      checkedSequence(0),
       alertsEnabled(true),
       tempMinAlert(TEMP_MIN_ALERT),
       tempMaxAlert(TEMP_MAX_ALERT),
       humidityMaxAlert(HUMIDITY_MAX_ALERT),
-      lastDHTRead(0),
-      lastPIRCheck(0),
-      presenceCallback(nullptr),
-      environmentAlertCallback(nullptr),
       lastPIRState(false),
-      presenceStartTime(0),
+      detectionOpen(false),
+      presenceStartUs(0),
+      lastRiseUs(0),
+      lastFallUs(0),
+      activeUs(0),
+      droppedEdges(0),
       lastAlert(ALERT_NONE) {
     
-    environmentData.temperature = 0;
-    environmentData.humidity = 0;
-    environmentData.lastUpdate = 0;
-    environmentData.valid = false;
+    memset(&acquired, 0, sizeof(acquired));
     
     presenceData.isDetected = false;
     presenceData.lastDetectionTime = 0;
     presenceData.detectionDuration = 0;
+    presenceData.confidence = 0;
 }
 
 bool SensorManager::begin() {
     // Inicializar DHT22
     dht.begin();
     
-    // Configurar PIR
-    pinMode(PIR_PIN, INPUT);
+    // Configurar PIR (flancos por ISR, se consumen en update())
+    PirSensor::begin();
     
-    // Configurar Buzzer
-    pinMode(BUZZER_PIN, OUTPUT);
-    digitalWrite(BUZZER_PIN, LOW);
+    // Configurar Buzzer (tono por LEDC)
+    buzzer.begin(BUZZER_PIN);
     
-    // Primera lectura del DHT
-    delay(2000);
-    updateDHT();
+    // Lecturas del DHT fuera de loop(); la primera llega tras
+    // DHT_READ_INTERVAL_MS, lo que pide el sensor tras el encendido
+#ifdef ARDUINO_ARCH_ESP32
+    if (xTaskCreatePinnedToCore(dhtTask, "dht", DHT_TASK_STACK, this,
+                                DHT_TASK_PRIORITY, nullptr, DHT_TASK_CORE) != pdPASS) {
+        return false;
+    }
+#else
+    timerQueue.every(DHT_READ_INTERVAL_MS, onDHTTimer, this);
+#endif
     
     return true;
 }
 
-void SensorManager::update() {
-    unsigned long currentTime = millis();
+#ifdef ARDUINO_ARCH_ESP32
+
+void SensorManager::dhtTask(void* context) {
+    SensorManager* self = static_cast<SensorManager*>(context);
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(DHT_READ_INTERVAL_MS));
+        self->acquireDHT();
+    }
+}
+
+#else  // En nativo no hay tareas: el temporizador hace sus veces
+
+void SensorManager::onDHTTimer(void* context) {
+    static_cast<SensorManager*>(context)->acquireDHT();
+}
+
+#endif
+
+void SensorManager::acquireDHT() {
+    DhtStats& stats = acquired.stats;
+    float temp = NAN;
+    float hum = NAN;
+    bool ok = false;
     
-    // Actualizar DHT22
-    if (currentTime - lastDHTRead >= DHT_READ_INTERVAL) {
-        updateDHT();
-        lastDHTRead = currentTime;
+    for (uint8_t attempt = 0; attempt <= DHT_READ_RETRIES && !ok; attempt++) {
+        if (attempt > 0) {
+            stats.retries++;
+#ifdef ARDUINO_ARCH_ESP32
+            vTaskDelay(pdMS_TO_TICKS(DHT_RETRY_DELAY_MS));
+#endif
+        }
         
-        if (alertsEnabled) {
-            checkEnvironmentAlerts();
+        // La única parte con las interrupciones desactivadas
+        uint64_t start = MonotonicClock::nowUs();
+        ok = dht.read(true);
+        stats.lastReadUs = (uint32_t)(MonotonicClock::nowUs() - start);
+        stats.maxReadUs = max(stats.maxReadUs, stats.lastReadUs);
+        stats.reads++;
+        
+        if (ok) {
+            // Ya leídos: no vuelven a tocar el bus
+            temp = dht.readTemperature();
+            hum = dht.readHumidity();
+            ok = !isnan(temp) && !isnan(hum);
         }
     }
     
-    // Actualizar PIR
-    if (currentTime - lastPIRCheck >= PIR_CHECK_INTERVAL) {
-        updatePIR();
-        lastPIRCheck = currentTime;
+    EnvironmentData& env = acquired.environment;
+    if (ok) {
+        env.temperature = temp;
+        env.humidity = hum;
+        env.lastUpdate = MonotonicClock::nowMs();
+        env.valid = true;
+    } else {
+        env.valid = false;
+        stats.failures++;
+    }
+    dhtSnapshot.write(acquired);
+    
+    // loop() solo se despierta si cambia la alerta; si no, revisa la
+    // lectura en su próxima pasada
+    AlertType alert = evaluateEnvironment(env);
+    if (alert != acquiredAlert) {
+        acquiredAlert = alert;
+        powerManager.wake();
     }
 }
 
-void SensorManager::updateDHT() {
-    float temp = dht.readTemperature();
-    float hum = dht.readHumidity();
+void SensorManager::update() {
+    // Lectura nueva del DHT
+    uint32_t sequence = dhtSnapshot.getSequence();
+    if (sequence != checkedSequence && !(sequence & 1)) {
+        checkedSequence = sequence;
+        if (alertsEnabled) {
+            checkEnvironmentAlerts();
+        }
+    }
     
-    if (!isnan(temp) && !isnan(hum)) {
-        environmentData.temperature = temp;
-        environmentData.humidity = hum;
-        environmentData.lastUpdate = millis();
-        environmentData.valid = true;
-    } else {
-        environmentData.valid = false;
+    PirEdge edge;
+    while (PirSensor::pop(edge)) {
+        handlePIREdge(edge);
+    }
+    
+    // Con flancos perdidos (cola llena) manda el nivel actual del pin
+    if (PirSensor::getDroppedCount() != droppedEdges) {
+        droppedEdges = PirSensor::getDroppedCount();
+        PirEdge current = { MonotonicClock::nowUs(), PirSensor::isActive() };
+        handlePIREdge(current);
     }
 }
 
-void SensorManager::updatePIR() {
-    bool currentState = digitalRead(PIR_PIN);
+void SensorManager::handlePIREdge(const PirEdge& edge) {
+    // Un flanco al mismo nivel solo aparece tras perder otros con la cola llena
+    if (edge.level == lastPIRState) return;
+    lastPIRState = edge.level;
+    presenceData.isDetected = edge.level;
     
-    if (currentState && !lastPIRState) {
-        // Detección iniciada
-        presenceData.isDetected = true;
-        presenceData.lastDetectionTime = millis();
-        presenceStartTime = millis();
-        
-        if (presenceCallback) {
-            presenceCallback();
+    if (edge.level) {
+        // Detección iniciada; una subida dentro del antirrebote continúa la anterior
+        if (!detectionOpen || edge.timeUs - lastFallUs > (uint64_t)PIR_DEBOUNCE_MS * 1000) {
+            detectionOpen = true;
+            presenceStartUs = edge.timeUs;
+            activeUs = 0;
+            presenceData.lastDetectionTime = edge.timeUs / 1000;
+            presenceData.detectionDuration = 0;
+            
+            eventBus.publish(EVENT_PRESENCE);
         }
-    } else if (!currentState && lastPIRState) {
-        // Detección terminada
-        presenceData.detectionDuration = millis() - presenceStartTime;
+        lastRiseUs = edge.timeUs;
+    } else {
+        // Pulso terminado
+        activeUs += edge.timeUs - lastRiseUs;
+        lastFallUs = edge.timeUs;
+        presenceData.detectionDuration = (unsigned long)((edge.timeUs - presenceStartUs) / 1000);
     }
-    
-    presenceData.isDetected = currentState;
-    lastPIRState = currentState;
+}
+
+uint64_t SensorManager::getActiveUs(uint64_t nowUs) const {
+    if (!detectionOpen) return 0;
+    return lastPIRState && nowUs > lastRiseUs ? activeUs + (nowUs - lastRiseUs) : activeUs;
 }
 
 void SensorManager::checkEnvironmentAlerts() {
-    AlertType currentAlert = evaluateEnvironment();
+    EnvironmentData env = getEnvironmentData();
+    AlertType currentAlert = evaluateEnvironment(env);
     
     if (currentAlert != ALERT_NONE && currentAlert != lastAlert) {
-        if (environmentAlertCallback) {
-            environmentAlertCallback(getAlertMessage(currentAlert));
-        }
+        eventBus.publish(EVENT_ENVIRONMENT_ALERT, getAlertMessage(currentAlert, env));
         lastAlert = currentAlert;
     } else if (currentAlert == ALERT_NONE) {
         lastAlert = ALERT_NONE;
     }
 }
 
-AlertType SensorManager::evaluateEnvironment() const {
-    if (!environmentData.valid) return ALERT_NONE;
+AlertType SensorManager::evaluateEnvironment(const EnvironmentData& env) const {
+    if (!env.valid) return ALERT_NONE;
     
-    if (environmentData.temperature < tempMinAlert) {
+    if (env.temperature < tempMinAlert) {
         return ALERT_TEMP_LOW;
     }
-    if (environmentData.temperature > tempMaxAlert) {
+    if (env.temperature > tempMaxAlert) {
         return ALERT_TEMP_HIGH;
     }
-    if (environmentData.humidity > humidityMaxAlert) {
+    if (env.humidity > humidityMaxAlert) {
         return ALERT_HUMIDITY_HIGH;
     }
     
     return ALERT_NONE;
 }
 
-String SensorManager::getAlertMessage(AlertType alert) {
+String SensorManager::getAlertMessage(AlertType alert, const EnvironmentData& env) {
     switch (alert) {
         case ALERT_TEMP_LOW:
-            return "Temperatura baja: " + String(environmentData.temperature, 1) + "°C";
+            return "Temperatura baja: " + String(env.temperature, 1) + "°C";
         case ALERT_TEMP_HIGH:
-            return "Temperatura alta: " + String(environmentData.temperature, 1) + "°C";
+            return "Temperatura alta: " + String(env.temperature, 1) + "°C";
         case ALERT_HUMIDITY_HIGH:
-            return "Humedad alta: " + String(environmentData.humidity, 1) + "%";
+            return "Humedad alta: " + String(env.humidity, 1) + "%";
         default:
             return "";
     }
 }
 
 EnvironmentData SensorManager::getEnvironmentData() {
-    return environmentData;
+    return dhtSnapshot.read().environment;
+}
+
+DhtStats SensorManager::getDhtStats() {
+    return dhtSnapshot.read().stats;
 }
 
 PresenceData SensorManager::getPresenceData() {
-    return presenceData;
+    PresenceData data = presenceData;
+    uint64_t now = MonotonicClock::nowUs();
+    
+    // Con el PIR activo, duración y confianza hasta ahora
+    if (data.isDetected) {
+        data.detectionDuration = (unsigned long)((now - presenceStartUs) / 1000);
+    }
+    data.confidence = getPresenceConfidence();
+    return data;
 }
 
 bool SensorManager::isPresenceDetected() {
     return presenceData.isDetected;
 }
 
+uint8_t SensorManager::getPresenceConfidence() {
+    uint64_t activeMs = getActiveUs(MonotonicClock::nowUs()) / 1000;
+    return activeMs >= PIR_DETECTION_TIMEOUT ? 100 : (uint8_t)(activeMs * 100 / PIR_DETECTION_TIMEOUT);
+}
+
 bool SensorManager::waitForPresence(unsigned long timeoutMs) {
-    unsigned long startTime = millis();
+    uint64_t deadline = MonotonicClock::nowMs() + timeoutMs;
     
-    while (millis() - startTime < timeoutMs) {
+    // Bloquea loop(), pero en reposo: cada flanco del PIR despierta antes
+    while (true) {
         update();
+        uint64_t now = MonotonicClock::nowMs();
+        uint64_t activeMs = getActiveUs(now * 1000) / 1000;
+        if (isPresenceDetected() && activeMs >= PIR_DETECTION_TIMEOUT) {
+            return true;
+        }
+        if (now >= deadline) {
+            return false;
+        }
+        
+        // Con el PIR activo, hasta que se confirme la presencia
+        uint64_t wakeAt = deadline;
         if (isPresenceDetected()) {
-            delay(PIR_DETECTION_TIMEOUT); // Confirmar presencia estable
-            update();
-            if (isPresenceDetected()) {
-                return true;
-            }
+            wakeAt = min(wakeAt, now + PIR_DETECTION_TIMEOUT - activeMs);
         }
-        delay(100);
+        powerManager.idleUntil(wakeAt);
     }
-    
-    return false;
 }
 
 String SensorManager::getEnvironmentStatus() const {
-    if (!environmentData.valid) {
+    EnvironmentData env = dhtSnapshot.read().environment;
+    if (!env.valid) {
         return "Sensores: Sin datos válidos";
     }
     
-    String status = "Temp: " + String(environmentData.temperature, 1) + "°C | ";
-    status += "Hum: " + String(environmentData.humidity, 1) + "%";
+    String status = "Temp: " + String(env.temperature, 1) + "°C | ";
+    status += "Hum: " + String(env.humidity, 1) + "%";
     
-    if (!isEnvironmentOk()) {
+    if (evaluateEnvironment(env) != ALERT_NONE) {
         status += " [ALERTA]";
     }
     
@@ -185,19 +283,16 @@ String SensorManager::getEnvironmentStatus() const {
 }
 
 bool SensorManager::isEnvironmentOk() const {
-    return evaluateEnvironment() == ALERT_NONE;
+    return evaluateEnvironment(dhtSnapshot.read().environment) == ALERT_NONE;
 }
 
 void SensorManager::playSound(int frequency, int duration, int repetitions) {
-    for (int i = 0; i < repetitions; i++) {
-        tone(BUZZER_PIN, frequency, duration);
-        delay(duration);
-        
-        if (i < repetitions - 1) {
-            delay(SOUND_PAUSE);
-        }
-    }
-    noTone(BUZZER_PIN);
+    // Tono y pausa; la pausa tras la última repetición se omite
+    ToneNote pattern[2] = {
+        { (uint16_t)frequency, (uint16_t)duration },
+        { 0, SOUND_PAUSE }
+    };
+    buzzer.play(pattern, 2, repetitions);
 }
 
 void SensorManager::playFeedingAlert() {
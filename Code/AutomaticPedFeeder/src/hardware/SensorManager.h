@@ -4,18 +4,34 @@
 #include <Arduino.h>
 #include <DHT.h>
 #include "../config.h"
+#include "PirSensor.h"
+#include "ToneSequencer.h"
+#include "../utils/EventBus.h"
+#include "../utils/MonotonicClock.h"
+#include "../utils/Seqlock.h"
+#include "../utils/TimerQueue.h"
 
 struct EnvironmentData {
     float temperature;
     float humidity;
-    unsigned long lastUpdate;
+    uint64_t lastUpdate;  // MonotonicClock::nowMs()
     bool valid;
 };
 
+// Estadísticas de lectura del DHT (acumuladas desde el arranque)
+struct DhtStats {
+    uint32_t reads;       // Lecturas del bus, reintentos incluidos
+    uint32_t retries;
+    uint32_t failures;    // Sin datos tras agotar los reintentos
+    uint32_t lastReadUs;  // Duración de la última lectura del bus
+    uint32_t maxReadUs;
+};
+
 struct PresenceData {
     bool isDetected;
-    unsigned long lastDetectionTime;
-    unsigned long detectionDuration;
+    uint64_t lastDetectionTime;       // Inicio de la detección (MonotonicClock::nowMs())
+    unsigned long detectionDuration;  // ms desde el inicio (hasta la última bajada)
+    uint8_t confidence;               // 0-100: tiempo activo (de la última detección) frente a PIR_DETECTION_TIMEOUT
 };
 
 enum AlertType {
@@ -28,9 +44,18 @@ enum AlertType {
 class SensorManager {
 private:
     DHT dht;
+    ToneSequencer buzzer;
     
-    // Estado de sensores
-    EnvironmentData environmentData;
+    // Estado de sensores: el DHT lo escribe su tarea ('acquired' es solo
+    // suyo) y se publica en una instantánea que se lee sin bloquear
+    struct DhtSnapshot {
+        EnvironmentData environment;
+        DhtStats stats;
+    };
+    DhtSnapshot acquired;
+    Seqlock<DhtSnapshot> dhtSnapshot;
+    AlertType acquiredAlert;     // Última evaluación de la tarea del DHT
+    uint32_t checkedSequence;    // Instantánea ya revisada por loop()
     PresenceData presenceData;
     
     // Configuración
@@ -39,32 +64,34 @@ private:
     float tempMaxAlert;
     float humidityMaxAlert;
     
-    // Control de lecturas
-    unsigned long lastDHTRead;
-    unsigned long lastPIRCheck;
-    const unsigned long DHT_READ_INTERVAL = 2000;
-    const unsigned long PIR_CHECK_INTERVAL = 100;
-    
-    // Callbacks
-    void (*presenceCallback)();
-    void (*environmentAlertCallback)(String);
-    
-    // Estado interno
+    // Estado interno (marcas en µs de los flancos del PIR)
     bool lastPIRState;
-    unsigned long presenceStartTime;
+    bool detectionOpen;       // Detección en curso o dentro del antirrebote
+    uint64_t presenceStartUs;
+    uint64_t lastRiseUs;
+    uint64_t lastFallUs;
+    uint64_t activeUs;        // Tiempo activo de la detección hasta la última bajada
+    uint32_t droppedEdges;    // PirSensor::getDroppedCount() ya resincronizados
     AlertType lastAlert;
     
 public:
     SensorManager();
     
-    // Inicialización
+    // Inicialización: arranca la tarea del DHT (en nativo, un temporizador
+    // de timerQueue) sin esperar a la primera lectura
     bool begin();
+    
+    // Consume los flancos del PIR y revisa las alertas con cada lectura
+    // nueva del DHT (en cada pasada de loop(); la ISR y la tarea lo despiertan)
     void update();
     
     // Lecturas
-    EnvironmentData getEnvironmentData();
+    EnvironmentData getEnvironmentData();  // Sin bloquear, desde cualquier tarea
+    DhtStats getDhtStats();
     PresenceData getPresenceData();
     bool isPresenceDetected();
+    uint8_t getPresenceConfidence();
+    // Espera en reposo (sin sondear) a una presencia confirmada
     bool waitForPresence(unsigned long timeoutMs);
     
     // Configuración de alertas
@@ -76,22 +103,26 @@ public:
     String getEnvironmentStatus() const;
     bool isEnvironmentOk() const;
     
-    // Callbacks
-    void setPresenceCallback(void (*callback)()) { presenceCallback = callback; }
-    void setEnvironmentAlertCallback(void (*callback)(String)) { 
-        environmentAlertCallback = callback; 
-    }
+    // Eventos (EventBus): EVENT_PRESENCE y EVENT_ENVIRONMENT_ALERT
     
-    // Buzzer/Speaker
+    // Buzzer/Speaker (no bloquean: el sonido avanza con timerQueue)
     void playSound(int frequency, int duration, int repetitions = 1);
     void playFeedingAlert();
+    void stopSound() { buzzer.stop(); }
+    bool isSoundPlaying() const { return buzzer.isPlaying(); }
     
 private:
-    void updateDHT();
-    void updatePIR();
+#ifdef ARDUINO_ARCH_ESP32
+    static void dhtTask(void* context);
+#else
+    static void onDHTTimer(void* context);
+#endif
+    void acquireDHT();
+    void handlePIREdge(const PirEdge& edge);
+    uint64_t getActiveUs(uint64_t nowUs) const;
     void checkEnvironmentAlerts();
-    AlertType evaluateEnvironment() const;
-    String getAlertMessage(AlertType alert);
+    AlertType evaluateEnvironment(const EnvironmentData& env) const;
+    String getAlertMessage(AlertType alert, const EnvironmentData& env);
 };
 
 #endif // SENSOR_MANAGER_H
\ No newline at end of file
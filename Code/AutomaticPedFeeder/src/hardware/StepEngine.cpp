@@ -0,0 +1,420 @@
+#include "StepEngine.h"
+
+#define QUEUE_MASK (MOTION_QUEUE_SIZE - 1)
+
+StepEngine* StepEngine::instance = nullptr;
+
+StepEngine::StepEngine()
+    : queueHead(0),
+      queueTail(0),
+      completedHead(0),
+      completedTail(0),
+      running(false),
+      pulseHigh(false),
+      position(0),
+      microsteps(MICROSTEPS),
+      stepsDone(0),
+      elapsedTicks(0),
+      ticksToNextStep(0),
+      sensorWasActive(false),
+      sensorTriggered(false),
+      sensorMissed(false),
+      sensorPosition(0),
+      sensorMarkCount(0),
+      expectedMarkCount(0),
+      stallWindow(0),
+      lastEdgePosition(0),
+      stallCause(STALL_NONE),
+      stallPosition(0),
+      stallDirection(1),
+      runStartUs(0),
+      lastStepUs(0),
+      plannedIntervalUs(0) {
+    current.type = SEGMENT_DWELL;
+    current.schedule.ramp = nullptr;
+    current.schedule.rampSteps = 0;
+    current.schedule.cruiseTicks = 0;
+    current.schedule.totalSteps = 0;
+    current.schedule.direction = 1;
+    current.stepSize = 1;
+    current.sensorAction = SENSOR_IGNORE;
+    current.microsteps = MICROSTEPS;
+    current.dwellTicks = 0;
+    current.notifyCommand = -1;
+    memset(&stats, 0, sizeof(stats));
+    instance = this;
+}
+
+bool StepEngine::begin() {
+    StepPin::output();
+    DirPin::output();
+    MicrostepPin::output();
+    StepPin::low();
+    setMicrosteps(MICROSTEPS);
+    HomeSensor::begin();
+#if STEPPER_DIAG_PIN >= 0
+    DiagPin::input();
+#endif
+    
+    return StepTimer::begin(STEP_TIMER_TICK_US, onTimerTick);
+}
+
+bool StepEngine::enqueue(const MotionSegment& segment) {
+    uint8_t next = (queueHead + 1) & QUEUE_MASK;
+    if (next == queueTail) {
+        return false;  // Cola llena
+    }
+    
+    queue[queueHead] = segment;
+    queueHead = next;  // Publicar después de copiar el segmento
+    return true;
+}
+
+bool StepEngine::run(bool resume) {
+    if (running) {
+        return true;  // La ISR recogerá los segmentos nuevos
+    }
+    if (queueHead == queueTail) {
+        return false;
+    }
+    
+    // Tras un atasco la secuencia continúa: tiempo y estadísticas siguen sumando
+    if (!resume) {
+        elapsedTicks = 0;
+        stats.stepsEmitted = 0;
+        stats.maxGapUs = 0;
+        runStartUs = StepTimer::nowMicros();
+    }
+    pulseHigh = false;
+    sensorMissed = false;
+    stallCause = STALL_NONE;
+    loadSegment(queue[queueTail]);
+    queueTail = (queueTail + 1) & QUEUE_MASK;
+    
+    running = true;
+    if (!StepTimer::start()) {
+        running = false;
+        queueTail = queueHead;
+        return false;
+    }
+    return true;
+}
+
+void StepEngine::stop() {
+    StepTimer::stop();
+    running = false;
+    pulseHigh = false;
+    StepPin::low();
+    queueTail = queueHead;
+    
+    // Las posiciones de reposo y la aproximación siempre son en micropasos
+    setMicrosteps(MICROSTEPS);
+}
+
+void StepEngine::releaseTimer() {
+    if (!running && StepTimer::isEnabled()) {
+        StepTimer::stop();
+    }
+}
+
+void StepEngine::setPosition(int32_t newPosition) {
+    if (!running) {
+        // El último flanco visto se desplaza con el contador
+        lastEdgePosition += newPosition - position;
+        position = newPosition;
+    }
+}
+
+bool StepEngine::popCompleted(int8_t& command) {
+    if (completedTail == completedHead) {
+        return false;
+    }
+    command = completed[completedTail];
+    completedTail = (completedTail + 1) & QUEUE_MASK;
+    return true;
+}
+
+void StepEngine::setStallSupervision(const int32_t* marks, uint8_t count, uint32_t window) {
+    if (running) {
+        return;
+    }
+    
+    expectedMarkCount = 0;
+    for (uint8_t i = 0; i < count && i < TOTAL_COMPARTMENTS; i++) {
+        expectedMarks[expectedMarkCount++] = marks[i];
+    }
+    stallWindow = window;
+    
+    // Sin flanco conocido se cuenta desde aquí (como mucho, una ventana de más)
+    lastEdgePosition = position;
+    sensorWasActive = HomeSensor::isActive();
+}
+
+SensorMark StepEngine::getSensorMark(uint8_t index) const {
+    SensorMark mark = { 0, 0 };
+    if (index < sensorMarkCount) {
+        mark.position = sensorMarks[index].position;
+        mark.width = sensorMarks[index].width;
+    }
+    return mark;
+}
+
+uint8_t StepEngine::getFreeSlots() const {
+    return MOTION_QUEUE_SIZE - 1 - ((queueHead - queueTail) & QUEUE_MASK);
+}
+
+MotionStats StepEngine::getStats() const {
+    return stats;
+}
+
+void StepEngine::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+}
+
+void ARDUINO_ISR_ATTR StepEngine::onTimerTick() {
+    if (instance) {
+        instance->tick();
+    }
+}
+
+void ARDUINO_ISR_ATTR StepEngine::tick() {
+    if (!running) return;
+    elapsedTicks++;
+    
+    // El pulso dura un tick: se baja en la interrupción siguiente
+    if (pulseHigh) {
+        StepPin::low();
+        pulseHigh = false;
+        
+        if (stepsDone >= current.schedule.totalSteps) {
+            finishSegment();
+            return;
+        }
+    }
+    
+    if (--ticksToNextStep > 0) return;
+    
+    if (current.type != SEGMENT_MOVE) {
+        finishSegment();
+        return;
+    }
+    
+    StepPin::high();
+    pulseHigh = true;
+    
+    // El primer paso de cada segmento no tiene intervalo de referencia
+    uint64_t now = StepTimer::nowMicros();
+    if (stepsDone > 0) {
+        recordInterval(now - lastStepUs);
+    }
+    lastStepUs = now;
+    
+    int32_t delta = current.schedule.direction * current.stepSize;
+    position += delta;
+    stepsDone++;
+    stats.stepsEmitted++;
+    
+#ifndef ARDUINO_ARCH_ESP32
+    HomeSensor::simulateMove(delta);
+#endif
+    if (current.sensorAction != SENSOR_IGNORE || expectedMarkCount > 0) {
+        sampleSensor();
+    }
+#if STEPPER_DIAG_PIN >= 0
+    if (DiagPin::read() == STEPPER_DIAG_ACTIVE_HIGH) {
+        flagStall(STALL_DIAG);
+    }
+#endif
+    
+    ticksToNextStep = intervalForStep(stepsDone);
+    plannedIntervalUs = ticksToNextStep * STEP_TIMER_TICK_US;
+}
+
+void ARDUINO_ISR_ATTR StepEngine::sampleSensor() {
+    bool active = HomeSensor::isActive();
+    bool rising = active && !sensorWasActive;
+    
+    if (current.sensorAction == SENSOR_STOP) {
+        if (rising) {
+            // Flanco encontrado: el segmento termina tras bajar este pulso
+            sensorTriggered = true;
+            sensorPosition = position;
+            stepsDone = current.schedule.totalSteps;
+        }
+    } else if (current.sensorAction == SENSOR_IGNORE) {
+        superviseSensor(rising, current.stepSize);
+    } else if (rising) {
+        if (sensorMarkCount < MOTION_MAX_SENSOR_MARKS) {
+            sensorMarks[sensorMarkCount].position = position;
+            sensorMarks[sensorMarkCount].width = 0;
+            sensorMarkCount++;
+        }
+    } else if (!active && sensorWasActive && sensorMarkCount > 0) {
+        SensorMark& mark = sensorMarks[sensorMarkCount - 1];
+        mark.width = position - mark.position;
+    }
+    
+    if (rising) {
+        lastEdgePosition = position;
+    }
+    sensorWasActive = active;
+}
+
+void ARDUINO_ISR_ATTR StepEngine::superviseSensor(bool rising, uint8_t stepSize) {
+    // Solo en avance: hacia atrás el flanco de activación es el final de la marca
+    bool forward = current.schedule.direction > 0;
+    
+    if (rising) {
+        if (forward && edgeDeviation(position) > JAM_EDGE_TOLERANCE_STEPS) {
+            flagStall(STALL_SENSOR);  // Flanco fuera de su sitio
+        }
+        return;
+    }
+    
+    // Pasada la tolerancia de una marca sin haber visto su flanco
+    if (forward && position - lastEdgePosition > 2 * JAM_EDGE_TOLERANCE_STEPS + stepSize &&
+        markBehind(JAM_EDGE_TOLERANCE_STEPS, JAM_EDGE_TOLERANCE_STEPS + stepSize)) {
+        flagStall(STALL_SENSOR);
+        return;
+    }
+    
+    if ((uint32_t)abs(position - lastEdgePosition) > stallWindow) {
+        flagStall(STALL_SENSOR);  // Ningún flanco en el recorrido máximo entre marcas
+    }
+}
+
+bool ARDUINO_ISR_ATTR StepEngine::markBehind(uint32_t from, uint32_t to) const {
+    // ¿Hay una marca esperada entre 'from' y 'to' micropasos por detrás?
+    for (uint8_t i = 0; i < expectedMarkCount; i++) {
+        int32_t past = (position - expectedMarks[i]) % STEPS_PER_CAROUSEL_TURN;
+        if (past < 0) past += STEPS_PER_CAROUSEL_TURN;
+        if ((uint32_t)past >= from && (uint32_t)past < to) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t ARDUINO_ISR_ATTR StepEngine::edgeDeviation(int32_t edge) const {
+    // Distancia circular a la marca esperada más cercana
+    uint32_t best = STEPS_PER_CAROUSEL_TURN;
+    for (uint8_t i = 0; i < expectedMarkCount; i++) {
+        int32_t distance = (edge - expectedMarks[i]) % STEPS_PER_CAROUSEL_TURN;
+        if (distance < 0) distance += STEPS_PER_CAROUSEL_TURN;
+        if (distance > STEPS_PER_CAROUSEL_TURN / 2) distance = STEPS_PER_CAROUSEL_TURN - distance;
+        if ((uint32_t)distance < best) best = distance;
+    }
+    return best;
+}
+
+void ARDUINO_ISR_ATTR StepEngine::flagStall(StallCause cause) {
+    if (stallCause != STALL_NONE) return;
+    
+    // El segmento termina tras bajar este pulso; el resto de la secuencia
+    // lo replanifica StepperController después de recuperarse
+    stallCause = cause;
+    stallPosition = position;
+    stallDirection = current.schedule.direction;
+    stepsDone = current.schedule.totalSteps;
+    queueTail = queueHead;
+}
+
+void ARDUINO_ISR_ATTR StepEngine::recordInterval(uint64_t actualUs) {
+    uint32_t deviation;
+    if (actualUs > plannedIntervalUs) {
+        deviation = actualUs - plannedIntervalUs;
+        if (deviation > stats.maxGapUs) {
+            stats.maxGapUs = deviation;
+        }
+    } else {
+        deviation = plannedIntervalUs - actualUs;
+    }
+    
+    // Cubeta = número de bits significativos de la desviación
+    uint32_t bucket = deviation == 0 ? 0 : 32 - __builtin_clz(deviation);
+    if (bucket >= MOTION_JITTER_BUCKETS) {
+        bucket = MOTION_JITTER_BUCKETS - 1;
+    }
+    stats.jitterHistogram[bucket]++;
+}
+
+void ARDUINO_ISR_ATTR StepEngine::loadSegment(const MotionSegment& segment) {
+    current = segment;
+    stepsDone = 0;
+    
+    if (current.type == SEGMENT_MOVE) {
+        DirPin::write(current.schedule.direction > 0);
+        ticksToNextStep = intervalForStep(0);
+        
+        if (current.sensorAction != SENSOR_IGNORE) {
+            // Solo cuentan los flancos: se parte del estado actual del sensor
+            sensorWasActive = HomeSensor::isActive();
+            sensorTriggered = false;
+            if (current.sensorAction == SENSOR_RECORD) {
+                sensorMarkCount = 0;
+            }
+        }
+    } else if (current.type == SEGMENT_MODE) {
+        // El driver necesita un tiempo antes del siguiente flanco de STEP
+        setMicrosteps(current.microsteps);
+        ticksToNextStep = current.dwellTicks > 0 ? current.dwellTicks : 1;
+    } else {
+        ticksToNextStep = current.dwellTicks > 0 ? current.dwellTicks : 1;
+    }
+}
+
+void ARDUINO_ISR_ATTR StepEngine::finishSegment() {
+    if (current.type == SEGMENT_MOVE && current.sensorAction == SENSOR_IGNORE &&
+        current.notifyCommand >= 0 && current.schedule.direction > 0 && expectedMarkCount > 0 &&
+        position - lastEdgePosition > 2 * JAM_EDGE_TOLERANCE_STEPS &&
+        markBehind(0, JAM_EDGE_TOLERANCE_STEPS + 1)) {
+        // Llegada sobre una marca cuyo flanco no se ha visto. Un flanco que
+        // tarda un paso de más también cae aquí, pero solo cuesta un reintento
+        flagStall(STALL_SENSOR);
+    }
+    
+    if (current.type == SEGMENT_MOVE && current.sensorAction == SENSOR_STOP && !sensorTriggered) {
+        // Sin referencia el resto de la cola no tiene sentido
+        sensorMissed = true;
+        queueTail = queueHead;
+    }
+    
+    if (current.notifyCommand >= 0 && stallCause == STALL_NONE) {
+        uint8_t next = (completedHead + 1) & QUEUE_MASK;
+        if (next != completedTail) {
+            completed[completedHead] = current.notifyCommand;
+            completedHead = next;
+        }
+    }
+    
+    if (queueTail == queueHead) {
+        stats.actualUs = StepTimer::nowMicros() - runStartUs;
+        if (stallCause == STALL_NONE) {
+            stats.sequences++;
+        }
+        running = false;
+        StepTimer::halt();  // La parada completa, en releaseTimer()
+        return;
+    }
+    
+    loadSegment(queue[queueTail]);
+    queueTail = (queueTail + 1) & QUEUE_MASK;
+}
+
+void ARDUINO_ISR_ATTR StepEngine::setMicrosteps(uint8_t mode) {
+    // MS1-MS3 van unidos: solo caben paso completo (LOW) o 1/16 (HIGH)
+    microsteps = mode > 1 ? MICROSTEPS : 1;
+    MicrostepPin::write(mode > 1);
+}
+
+uint16_t ARDUINO_ISR_ATTR StepEngine::intervalForStep(uint32_t step) const {
+    const StepSchedule& schedule = current.schedule;
+    if (step < schedule.rampSteps) {
+        return schedule.ramp[step];
+    }
+    if (step + schedule.rampSteps >= schedule.totalSteps) {
+        uint32_t mirrored = schedule.totalSteps - 1 - step;
+        return mirrored < schedule.rampSteps ? schedule.ramp[mirrored] : schedule.cruiseTicks;
+    }
+    return schedule.cruiseTicks;
+}
@@ -0,0 +1,176 @@
+#ifndef STEP_ENGINE_H
+#define STEP_ENGINE_H
+
+#include <Arduino.h>
+#include "../config.h"
+#include "StepTimer.h"
+#include "HomeSensor.h"
+#include "FastPin.h"
+
+#if STEPPER_DIAG_PIN >= 0
+typedef FastPin<STEPPER_DIAG_PIN> DiagPin;
+#endif
+
+#define MOTION_QUEUE_SIZE 64      // Segmentos en cola (potencia de 2)
+#define MOTION_JITTER_BUCKETS 12  // Histograma: 0, 1, 2-3, 4-7 ... >=1024 µs
+#define MOTION_MAX_SENSOR_MARKS 8 // Marcas registradas en un barrido
+
+// Perfil de un movimiento ya calculado. Los intervalos se expresan en ticks
+// de STEP_TIMER_TICK_US; la deceleración recorre la rampa en orden inverso.
+struct StepSchedule {
+    const uint16_t* ramp;     // Intervalos de la rampa de aceleración
+    uint16_t rampSteps;       // Pasos de la rampa (<= totalSteps / 2)
+    uint16_t cruiseTicks;     // Intervalo a velocidad de crucero
+    uint32_t totalSteps;
+    int8_t direction;         // +1 o -1
+};
+
+enum SegmentType : uint8_t {
+    SEGMENT_MOVE,
+    SEGMENT_DWELL,
+    SEGMENT_MODE              // Cambio de microstepping + espera de asentamiento
+};
+
+// Uso del sensor de origen durante un SEGMENT_MOVE
+enum SensorAction : uint8_t {
+    SENSOR_IGNORE,
+    SENSOR_STOP,              // Parar en el flanco de activación; si no llega, abortar la cola
+    SENSOR_RECORD             // Registrar inicio y ancho de cada marca (barrido hacia delante)
+};
+
+// Origen de un atasco detectado por la ISR
+enum StallCause : uint8_t {
+    STALL_NONE,
+    STALL_SENSOR,             // Flanco fuera de su sitio o que no llega: pasos perdidos
+    STALL_DIAG                // El driver señaló bloqueo por su salida DIAG
+};
+
+// Marca del sensor vista durante un barrido
+struct SensorMark {
+    int32_t position;         // Flanco de activación
+    uint16_t width;           // 0 si el barrido terminó dentro de la marca
+};
+
+// Unidad de trabajo de la ISR. Una orden de alto nivel (p. ej. agitar)
+// puede ocupar varios segmentos; el último lleva notifyCommand >= 0.
+struct MotionSegment {
+    SegmentType type;
+    StepSchedule schedule;    // SEGMENT_MOVE
+    uint8_t stepSize;         // SEGMENT_MOVE: micropasos por pulso (1 o MICROSTEPS)
+    SensorAction sensorAction;  // SEGMENT_MOVE
+    uint8_t microsteps;       // SEGMENT_MODE: 1 = paso completo, MICROSTEPS = fino
+    uint32_t dwellTicks;      // SEGMENT_DWELL y SEGMENT_MODE
+    int8_t notifyCommand;     // Orden completada al terminar (-1 = ninguna)
+};
+
+// Instrumentación de la temporización de pasos. La ISR solo suma
+// contadores, así que puede quedarse activa en producción.
+struct MotionStats {
+    uint32_t jitterHistogram[MOTION_JITTER_BUCKETS];  // |real - planificado|
+    uint32_t stepsEmitted;   // Pasos de la última secuencia
+    uint32_t maxGapUs;       // Mayor retraso de un paso respecto al plan
+    uint32_t plannedUs;      // Duración planificada de la última secuencia
+    uint32_t actualUs;       // Duración real de la última secuencia
+    uint32_t sequences;      // Secuencias completadas desde el arranque
+    uint32_t jamRetries;     // Reintentos por atasco de la última secuencia
+    uint32_t recoveryUs;     // Tiempo invertido en recuperarse de atascos
+    uint32_t jamsDetected;   // Atascos detectados desde el arranque
+};
+
+// Generador de pasos: la ISR del timer consume una cola de segmentos
+// precalculados y los encadena sin pasar por loop().
+class StepEngine {
+private:
+    // Cola de segmentos (productor: loop, consumidor: ISR)
+    MotionSegment queue[MOTION_QUEUE_SIZE];
+    volatile uint8_t queueHead;
+    volatile uint8_t queueTail;
+    
+    // Órdenes completadas (productor: ISR, consumidor: loop)
+    volatile int8_t completed[MOTION_QUEUE_SIZE];
+    volatile uint8_t completedHead;
+    volatile uint8_t completedTail;
+    
+    // Estado compartido con la ISR
+    MotionSegment current;
+    volatile bool running;
+    volatile bool pulseHigh;
+    volatile int32_t position;    // Siempre en micropasos
+    volatile uint8_t microsteps;  // Modo actual del driver
+    volatile uint32_t stepsDone;
+    volatile uint32_t elapsedTicks;
+    uint32_t ticksToNextStep;
+    
+    // Sensor de origen
+    bool sensorWasActive;
+    volatile bool sensorTriggered;
+    volatile bool sensorMissed;
+    volatile int32_t sensorPosition;
+    SensorMark sensorMarks[MOTION_MAX_SENSOR_MARKS];
+    volatile uint8_t sensorMarkCount;
+    
+    // Vigilancia de atascos (flancos esperados en [0, vuelta))
+    int32_t expectedMarks[TOTAL_COMPARTMENTS];
+    uint8_t expectedMarkCount;    // 0 = sin vigilancia por sensor
+    uint32_t stallWindow;         // Recorrido máximo sin ver un flanco
+    int32_t lastEdgePosition;
+    volatile StallCause stallCause;
+    volatile int32_t stallPosition;
+    volatile int8_t stallDirection;
+    
+    // Instrumentación
+    MotionStats stats;
+    uint64_t runStartUs;
+    uint64_t lastStepUs;
+    uint32_t plannedIntervalUs;
+    
+    static StepEngine* instance;  // Para la ISR estática
+    
+public:
+    StepEngine();
+    
+    // Inicialización
+    bool begin();
+    
+    // Control
+    bool enqueue(const MotionSegment& segment);
+    bool run(bool resume = false);  // resume: continúa la misma secuencia
+    void stop();
+    void releaseTimer();  // Tras terminar en la ISR: para y libera el timer
+    void setPosition(int32_t newPosition);
+    bool popCompleted(int8_t& command);
+    void setStallSupervision(const int32_t* marks, uint8_t count, uint32_t window);
+    
+    // Estado
+    bool isRunning() const { return running; }
+    int32_t getPosition() const { return position; }
+    uint32_t getStepsDone() const { return stepsDone; }
+    uint32_t getElapsedTicks() const { return elapsedTicks; }
+    uint8_t getMicrosteps() const { return microsteps; }
+    bool wasSensorMissed() const { return sensorMissed; }
+    int32_t getSensorPosition() const { return sensorPosition; }
+    uint8_t getSensorMarkCount() const { return sensorMarkCount; }
+    SensorMark getSensorMark(uint8_t index) const;
+    StallCause getStallCause() const { return stallCause; }
+    int32_t getStallPosition() const { return stallPosition; }
+    int8_t getStallDirection() const { return stallDirection; }
+    uint8_t getFreeSlots() const;
+    MotionStats getStats() const;
+    void resetStats();
+    
+private:
+    static void onTimerTick();
+    void tick();
+    void loadSegment(const MotionSegment& segment);
+    void finishSegment();
+    void setMicrosteps(uint8_t mode);
+    void sampleSensor();
+    void superviseSensor(bool rising, uint8_t stepSize);
+    bool markBehind(uint32_t from, uint32_t to) const;
+    uint32_t edgeDeviation(int32_t edge) const;
+    void flagStall(StallCause cause);
+    void recordInterval(uint64_t actualUs);
+    uint16_t intervalForStep(uint32_t step) const;
+};
+
+#endif // STEP_ENGINE_H
@@ -0,0 +1,153 @@
+#include "StepTimer.h"
+#include "../utils/MonotonicClock.h"
+
+static uint32_t timerTickUs = 0;
+static StepTimer::TickHandler timerHandler = nullptr;
+static volatile bool timerRunning = false;  // Se entregan ticks
+static bool timerEnabled = false;           // Hardware encendido
+
+#ifdef ARDUINO_ARCH_ESP32
+
+static hw_timer_t* hwTimer = nullptr;
+
+// Tras halt() el timer sigue contando hasta el stop() de la tarea
+static void ARDUINO_ISR_ATTR onAlarm() {
+    if (timerRunning) {
+        timerHandler();
+    }
+}
+
+bool StepTimer::begin(uint32_t tickUs, TickHandler handler) {
+    timerTickUs = tickUs;
+    timerHandler = handler;
+    timerRunning = false;
+    
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    // Se crea en cada start(): aquí solo se comprueba que hay uno libre
+    hwTimer = timerBegin(1000000);
+    if (!hwTimer) return false;
+    timerEnd(hwTimer);
+    hwTimer = nullptr;
+#else
+    // El driver antiguo no toma cerrojos de energía: se crea una vez
+    hwTimer = timerBegin(0, 80, true);  // APB 80 MHz / 80 = 1 µs
+    if (!hwTimer) return false;
+    timerStop(hwTimer);
+    timerAttachInterrupt(hwTimer, onAlarm, true);
+    timerAlarmWrite(hwTimer, tickUs, true);
+    timerAlarmEnable(hwTimer);
+#endif
+    return true;
+}
+
+bool StepTimer::start() {
+    if (timerRunning) return true;
+    if (timerEnabled) stop();  // Parado por halt() y aún sin liberar
+    
+    timerRunning = true;
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    // timerBegin() habilita el gptimer (toma el cerrojo APB) y lo arranca;
+    // la primera alarma llega un tick después de programarla
+    hwTimer = timerBegin(1000000);  // 1 MHz → 1 cuenta = 1 µs
+    if (!hwTimer) {
+        timerRunning = false;
+        return false;
+    }
+    timerAttachInterrupt(hwTimer, onAlarm);
+    timerAlarm(hwTimer, timerTickUs, true, 0);
+#else
+    if (!hwTimer) {
+        timerRunning = false;
+        return false;
+    }
+    timerWrite(hwTimer, 0);
+    timerAlarmEnable(hwTimer);
+    timerStart(hwTimer);
+#endif
+    timerEnabled = true;
+    return true;
+}
+
+void StepTimer::stop() {
+    timerRunning = false;
+    if (!timerEnabled) return;
+    
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    timerEnd(hwTimer);  // gptimer_disable(): suelta el cerrojo APB
+    hwTimer = nullptr;
+#else
+    timerStop(hwTimer);
+#endif
+    timerEnabled = false;
+}
+
+void ARDUINO_ISR_ATTR StepTimer::halt() {
+    // timerStop() no está en IRAM y toma cerrojos: aquí solo se corta la
+    // entrega en onAlarm() y, en el core 3.x, la alarma pasa a ser de un
+    // solo disparo (gptimer_set_alarm_action() admite contexto de ISR)
+    timerRunning = false;
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    if (hwTimer) timerAlarm(hwTimer, timerTickUs, false, 0);
+#endif
+}
+
+#else  // Sustituto para compilación nativa
+
+bool StepTimer::begin(uint32_t tickUs, TickHandler handler) {
+    timerTickUs = tickUs;
+    timerHandler = handler;
+    timerRunning = false;
+    return true;
+}
+
+static bool startFails = false;
+
+bool StepTimer::start() {
+    if (startFails) {
+        startFails = false;
+        return false;
+    }
+    timerRunning = true;
+    timerEnabled = true;
+    return true;
+}
+
+void StepTimer::stop() {
+    timerRunning = false;
+    timerEnabled = false;
+}
+
+void StepTimer::halt() {
+    timerRunning = false;
+}
+
+void StepTimer::failNextStart() {
+    startFails = true;
+}
+
+void StepTimer::advance(uint32_t ticks) {
+    for (uint32_t i = 0; i < ticks; i++) {
+        MonotonicClock::advance(timerTickUs);
+        if (timerRunning && timerHandler) {
+            timerHandler();
+        }
+    }
+}
+
+#endif
+
+uint64_t ARDUINO_ISR_ATTR StepTimer::nowMicros() {
+    return MonotonicClock::nowUs();
+}
+
+bool StepTimer::isRunning() {
+    return timerRunning;
+}
+
+bool StepTimer::isEnabled() {
+    return timerEnabled;
+}
+
+uint32_t StepTimer::getTickUs() {
+    return timerTickUs;
+}
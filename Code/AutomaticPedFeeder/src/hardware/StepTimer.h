@@ -0,0 +1,40 @@
+#ifndef STEP_TIMER_H
+#define STEP_TIMER_H
+
+#include <Arduino.h>
+
+// Timer periódico que marca el ritmo del generador de pasos.
+// En el ESP32 usa un timer hardware (gptimer en core 3.x); fuera del
+// target se compila un sustituto que avanza el MonotonicClock simulado.
+// Encendido, el gptimer retiene un cerrojo de gestión de energía
+// (APB_FREQ_MAX) que impide el light sleep: start() lo crea antes de cada
+// movimiento y stop() lo destruye, así que en reposo no existe.
+class StepTimer {
+public:
+    typedef void (*TickHandler)();
+    
+    // Inicialización
+    static bool begin(uint32_t tickUs, TickHandler handler);
+    
+    // Control (desde tareas): start() arranca el timer y stop() lo para y
+    // lo libera. false si no se pudo crear
+    static bool start();
+    static void stop();
+    
+    // Desde la ISR de pasos: deja de entregar ticks (las alarmas que aún
+    // lleguen se ignoran); la tarea completa la parada con stop()
+    static void halt();
+    static bool isRunning();
+    static bool isEnabled();  // Encendido (aún sin stop() tras halt())
+    static uint32_t getTickUs();
+    static uint64_t nowMicros();  // MonotonicClock::nowUs() (seguro en ISR)
+    
+#ifndef ARDUINO_ARCH_ESP32
+    // Sustituto nativo: ejecuta 'ticks' interrupciones simuladas
+    static void advance(uint32_t ticks);
+    // El próximo start() falla, como sin timers libres en el target
+    static void failNextStart();
+#endif
+};
+
+#endif // STEP_TIMER_H
@@ -1,23 +1,42 @@
 #include "StepperController.h"
 
 StepperController::StepperController() 
-    : stepper(AccelStepper::DRIVER, STEPPER_STEP_PIN, STEPPER_DIR_PIN),
-      currentCompartment(0),
+    : currentCompartment(0),
       state(MOTOR_IDLE),
       enabled(false),
-      movementCompleteCallback(nullptr),
-      errorCallback(nullptr),
       targetPosition(0),
-      lastMovementTime(0) {
+      lastMovementTime(0),
+      phaseOrigin(0),
+      homingPhase(HOMING_IDLE),
+      homed(false),
+      homeOffset(HOME_SENSOR_OFFSET_STEPS),
+      lastHomingError(0),
+      commandCount(0),
+      completedCommands(0),
+      plannedDurationTicks(0),
+      recovering(false),
+      recoverySeek(false),
+      jammed(false),
+      jamRetries(0),
+      jamDirection(1),
+      jamPosition(0),
+      recoveryStartUs(0),
+      recoveryUs(0),
+      jamsDetected(0) {
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        compartmentOffsets[i] = 0;
+    }
 }
 
 bool StepperController::begin() {
-    pinMode(STEPPER_ENABLE_PIN, OUTPUT);
-    digitalWrite(STEPPER_ENABLE_PIN, HIGH); // Deshabilitado por defecto
+    EnablePin::output();
+    EnablePin::high(); // Deshabilitado por defecto
     
-    stepper.setMaxSpeed(STEPPER_MAX_SPEED);
-    stepper.setAcceleration(STEPPER_ACCELERATION);
-    stepper.setCurrentPosition(0);
+    if (!engine.begin()) {
+        return false;
+    }
+    engine.setPosition(0);
+    phaseOrigin = 0;
     
     enabled = false;
     state = MOTOR_IDLE;
@@ -30,24 +49,59 @@ void StepperController::update() {
         return;
     }
     
-    if (state == MOTOR_MOVING) {
-        if (stepper.distanceToGo() == 0) {
-            handleMovementComplete();
+    // Los pasos los genera la ISR; aquí solo se notifican las órdenes
+    // completadas y el final de la secuencia
+    int8_t command;
+    while (engine.popCompleted(command)) {
+        completedCommands = command + 1;
+        if (commands[command].type == MOTION_MOVE_TO) {
+            currentCompartment = commands[command].compartment;
+        }
+        trace(MOTOR_TRACE_COMMAND, state);
+        eventBus.publish(EVENT_COMMAND_COMPLETE, command, commands[command].type);
+    }
+    
+    // La ISR solo corta los ticks al acabar; el timer se apaga aquí para
+    // que no retenga el cerrojo de energía (y el light sleep) en reposo.
+    // Si la ISR acaba justo después, lo liberan los finales de abajo
+    engine.releaseTimer();
+    
+    if (state == MOTOR_MOVING && !engine.isRunning()) {
+        if (engine.getStallCause() != STALL_NONE || (recovering && engine.wasSensorMissed())) {
+            handleStall();
+        } else if (recovering) {
+            resumeAfterJam();
         } else {
-            stepper.run();
+            handleMovementComplete();
         }
     }
     
-    // Timeout de seguridad (30 segundos)
-    if (state == MOTOR_MOVING && (millis() - lastMovementTime > 30000)) {
+    if (state == MOTOR_CALIBRATING && !engine.isRunning()) {
+        handleHomingStep();
+    }
+    
+    // Timeout de seguridad (duración planificada + 30 segundos)
+    if ((state == MOTOR_MOVING || state == MOTOR_CALIBRATING) &&
+        (MonotonicClock::elapsedMs(lastMovementTime) > getPlannedDuration() + 30000)) {
+        if (state == MOTOR_CALIBRATING) {
+            trace(MOTOR_TRACE_TIMEOUT, state);
+            finishHoming(false, "Timeout en la búsqueda del origen");
+            return;
+        }
+        trace(MOTOR_TRACE_TIMEOUT, state);
         triggerError("Timeout en movimiento del motor");
         stopMotor();
     }
 }
 
 bool StepperController::moveToCompartment(int compartmentIndex) {
-    if (compartmentIndex < 0 || compartmentIndex >= TOTAL_COMPARTMENTS) {
-        triggerError("Índice de compartimento inválido: " + String(compartmentIndex));
+    MotionCommand command = { MOTION_MOVE_TO, compartmentIndex, 0, 0 };
+    return runSequence(&command, 1);
+}
+
+bool StepperController::runSequence(const MotionCommand* sequence, uint8_t count) {
+    if (count == 0 || count > MOTION_MAX_COMMANDS) {
+        triggerError("Secuencia de movimiento inválida");
         return false;
     }
     
@@ -56,17 +110,93 @@ bool StepperController::moveToCompartment(int compartmentIndex) {
         return false;
     }
     
+    if (state == MOTOR_CALIBRATING) {
+        // Sin triggerError: el homing en curso no debe pasar a MOTOR_ERROR
+        eventBus.publish(EVENT_MOTOR_ERROR, "Calibración del carrusel en curso");
+        return false;
+    }
+    
+    uint8_t segmentsNeeded = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        const MotionCommand& command = sequence[i];
+        if (command.type == MOTION_MOVE_TO &&
+            (command.compartment < 0 || command.compartment >= TOTAL_COMPARTMENTS)) {
+            triggerError("Índice de compartimento inválido: " + String(command.compartment));
+            return false;
+        }
+        segmentsNeeded += segmentsFor(command);
+    }
+    
+    if (segmentsNeeded > engine.getFreeSlots()) {
+        triggerError("Secuencia demasiado larga para la cola de movimiento");
+        return false;
+    }
+    
     enableMotor(true);
     
-    targetPosition = compartmentToSteps(compartmentIndex);
-    stepper.moveTo(targetPosition);
+    for (uint8_t i = 0; i < count; i++) {
+        commands[i] = sequence[i];
+    }
+    commandCount = count;
+    completedCommands = 0;
+    
+    // Toda la secuencia se planifica ahora; la ISR la encadena sin pausas
+    long plannedPosition = engine.getPosition();
+    plannedDurationTicks = queueCommands(0, plannedPosition);
+    targetPosition = plannedPosition;
     
+    jammed = false;
+    jamRetries = 0;
+    recoveryUs = 0;
+    
+    // Sin timer no hay pasos: no se entra en MOTOR_MOVING, o update() daría
+    // por completada una secuencia que nunca se movió
+    if (!engine.run()) {
+        stopMotor();
+        triggerError("No se pudo arrancar el timer de pasos");
+        return false;
+    }
+    MotorState from = state;
     state = MOTOR_MOVING;
-    lastMovementTime = millis();
+    lastMovementTime = MonotonicClock::nowMs();
+    trace(MOTOR_TRACE_START, from);
     
     return true;
 }
 
+uint32_t StepperController::queueCommands(uint8_t first, long& plannedPosition) {
+    uint32_t ticks = 0;
+    
+    for (uint8_t i = first; i < commandCount; i++) {
+        const MotionCommand& command = commands[i];
+        
+        switch (command.type) {
+            case MOTION_MOVE_TO: {
+                long distance = routeSteps(plannedPosition - compartmentOffsets[command.compartment],
+                                           command.compartment);
+                ticks += distance != 0 ? queueRoute(plannedPosition, distance, i) : queueDwell(1, i);
+                plannedPosition += distance;
+                break;
+            }
+            case MOTION_DWELL:
+                ticks += queueDwell(command.durationMs * 1000UL / STEP_TIMER_TICK_US, i);
+                break;
+            case MOTION_AGITATE:
+                for (uint8_t cycle = 0; cycle < command.cycles; cycle++) {
+                    bool last = cycle == command.cycles - 1;
+                    ticks += queueFineMove(AGITATE_STEPS, -1);
+                    ticks += queueFineMove(-AGITATE_STEPS, last ? i : -1);
+                }
+                if (command.cycles == 0) {
+                    ticks += queueDwell(1, i);
+                }
+                break;
+        }
+    }
+    
+    return ticks;
+}
+
 bool StepperController::moveToNextCompartment() {
     int nextCompartment = (currentCompartment + 1) % TOTAL_COMPARTMENTS;
     return moveToCompartment(nextCompartment);
@@ -78,76 +208,614 @@ bool StepperController::moveToPreviousCompartment() {
 }
 
 void StepperController::stopMotor() {
-    stepper.stop();
-    stepper.setCurrentPosition(stepper.currentPosition());
+    engine.stop();
+    
+    int8_t command;
+    while (engine.popCompleted(command)) {}
+    
+    currentCompartment = positionToCompartment(engine.getPosition());
+    homingPhase = HOMING_IDLE;
+    recovering = false;
+    MotorState from = state;
     state = MOTOR_IDLE;
     enableMotor(false);
+    trace(MOTOR_TRACE_STOP, from);
 }
 
 void StepperController::enableMotor(bool enable) {
     enabled = enable;
-    digitalWrite(STEPPER_ENABLE_PIN, enable ? LOW : HIGH);
+    EnablePin::write(!enable);
 }
 
 bool StepperController::calibrate() {
+    if (!HOME_SENSOR_ENABLED) {
+        // Sin sensor se asume que el carrusel está alineado en el compartimento 0
+        state = MOTOR_CALIBRATING;
+        redefinePosition(0);
+        currentCompartment = 0;
+        targetPosition = 0;
+        state = MOTOR_IDLE;
+        eventBus.publish(EVENT_CALIBRATION_COMPLETE, true);
+        return true;
+    }
+    
+    if (state == MOTOR_MOVING || state == MOTOR_CALIBRATING) {
+        return false;
+    }
+    
+    enableMotor(true);
+    MotorState from = state;
     state = MOTOR_CALIBRATING;
-    stepper.setCurrentPosition(0);
-    currentCompartment = 0;
-    targetPosition = 0;
-    state = MOTOR_IDLE;
+    trace(MOTOR_TRACE_CALIBRATE, from);
+    engine.setStallSupervision(nullptr, 0, 0);  // Las marcas se vuelven a aprender
+    commandCount = 0;
+    completedCommands = 0;
+    
+    if (HOME_SENSOR_COMPARTMENT_MARKS) {
+        // Una vuelta (más un compartimento por si se empieza dentro de una marca)
+        plannedDurationTicks = queueFineMove(STEPS_PER_CAROUSEL_TURN + STEPS_PER_COMPARTMENT, -1,
+                                             HOMING_SEEK_SPEED, SENSOR_RECORD);
+        homingPhase = HOMING_SWEEP;
+    } else {
+        plannedDurationTicks = queueFineMove(HOMING_MAX_STEPS, -1, HOMING_SEEK_SPEED, SENSOR_STOP);
+        homingPhase = HOMING_SEEK;
+    }
+    
+    if (!engine.run()) {
+        finishHoming(false, "No se pudo arrancar el timer de pasos");
+        return false;
+    }
+    lastMovementTime = MonotonicClock::nowMs();
+    return true;
+}
+
+void StepperController::handleHomingStep() {
+    long position = engine.getPosition();
+    
+    switch (homingPhase) {
+        case HOMING_SWEEP: {
+            long homeEdge;
+            if (!learnCompartmentOffsets(homeEdge)) {
+                finishHoming(false, "Sensor de origen no detectado");
+                return;
+            }
+            
+            // Volver por detrás del flanco para la aproximación lenta
+            long distance = wrapDistance(homeEdge - HOMING_BACKOFF_STEPS - position);
+            plannedDurationTicks = distance != 0 ? queueRoute(position, distance, -1) : 0;
+            plannedDurationTicks += queueFineMove(2 * HOMING_BACKOFF_STEPS, -1,
+                                                  HOMING_APPROACH_SPEED, SENSOR_STOP);
+            homingPhase = HOMING_APPROACH;
+            break;
+        }
+        
+        case HOMING_SEEK:
+            if (engine.wasSensorMissed()) {
+                finishHoming(false, "Sensor de origen no detectado");
+                return;
+            }
+            plannedDurationTicks = queueFineMove(-HOMING_BACKOFF_STEPS, -1, HOMING_SEEK_SPEED);
+            plannedDurationTicks += queueFineMove(2 * HOMING_BACKOFF_STEPS, -1,
+                                                  HOMING_APPROACH_SPEED, SENSOR_STOP);
+            homingPhase = HOMING_APPROACH;
+            break;
+        
+        case HOMING_APPROACH: {
+            if (engine.wasSensorMissed()) {
+                finishHoming(false, "Flanco de origen perdido en la aproximación");
+                return;
+            }
+            
+            // Desviación respecto a la posición que se creía tener (p. ej.
+            // tras un corte de luz a mitad de movimiento)
+            long edge = engine.getSensorPosition();
+            lastHomingError = wrapDistance(edge - homeOffset);
+            redefinePosition(homeOffset + position - edge);
+            
+            position = engine.getPosition();
+            long distance = routeSteps(position - compartmentOffsets[0], 0);
+            plannedDurationTicks = distance != 0 ? queueRoute(position, distance, -1) : queueDwell(1, -1);
+            homingPhase = HOMING_PARK;
+            break;
+        }
+        
+        case HOMING_PARK:
+            finishHoming(true, "");
+            return;
+        
+        default:
+            return;
+    }
+    
+    if (!engine.run()) {
+        finishHoming(false, "No se pudo arrancar el timer de pasos");
+        return;
+    }
+    lastMovementTime = MonotonicClock::nowMs();
+}
+
+bool StepperController::learnCompartmentOffsets(long& homeEdge) {
+    // La marca de origen es la más ancha; el resto da la desviación real de
+    // cada compartimento respecto a su posición nominal
+    int home = -1;
+    uint16_t homeWidth = 0;
+    for (uint8_t i = 0; i < engine.getSensorMarkCount(); i++) {
+        SensorMark mark = engine.getSensorMark(i);
+        if (mark.width > homeWidth) {
+            home = i;
+            homeWidth = mark.width;
+        }
+    }
+    if (home < 0) {
+        return false;
+    }
+    homeEdge = engine.getSensorMark(home).position;
+    
+    int offsets[TOTAL_COMPARTMENTS] = { 0 };
+    for (uint8_t i = 0; i < engine.getSensorMarkCount(); i++) {
+        SensorMark mark = engine.getSensorMark(i);
+        if (mark.width == 0 || mark.width == homeWidth) {
+            continue;
+        }
+        long distance = normalizePosition(mark.position - homeEdge);
+        int compartment = positionToCompartment(distance);
+        long offset = wrapDistance(distance - compartment * STEPS_PER_COMPARTMENT);
+        if (compartment != 0 && abs(offset) <= COMPARTMENT_OFFSET_MAX) {
+            offsets[compartment] = offset;
+        }
+    }
+    
+    setCompartmentOffsets(offsets);
     return true;
 }
 
+void StepperController::finishHoming(bool success, const String& error) {
+    homingPhase = HOMING_IDLE;
+    homed = success;
+    
+    if (success) {
+        long position = normalizePosition(engine.getPosition());
+        engine.setPosition(position);
+        targetPosition = position;
+        currentCompartment = positionToCompartment(position);
+        engine.releaseTimer();
+        state = MOTOR_IDLE;
+        enableMotor(false);
+        armStallSupervision();
+    } else {
+        engine.stop();
+        enableMotor(false);
+        triggerError(error);
+    }
+    
+    trace(MOTOR_TRACE_HOMED, MOTOR_CALIBRATING);
+    eventBus.publish(EVENT_CALIBRATION_COMPLETE, success);
+}
+
 float StepperController::getProgress() {
     if (state != MOTOR_MOVING) {
         return 100.0;
     }
     
-    long remainingSteps = abs(stepper.distanceToGo());
-    if (remainingSteps == 0) {
+    // Progreso sobre la línea de tiempo planificada (no sobre los pasos:
+    // en un perfil en S la mitad de los pasos no es la mitad del tiempo)
+    if (!engine.isRunning() || plannedDurationTicks == 0) {
         return 100.0;
     }
     
-    long totalSteps = abs(targetPosition);
-    if (totalSteps == 0) {
-        return 100.0;
+    float progress = 100.0 * engine.getElapsedTicks() / plannedDurationTicks;
+    return min(progress, 100.0f);
+}
+
+long StepperController::getStepsToTarget() {
+    return targetPosition - engine.getPosition();
+}
+
+unsigned long StepperController::getPlannedDuration() const {
+    return (unsigned long)((uint64_t)plannedDurationTicks * STEP_TIMER_TICK_US / 1000);
+}
+
+unsigned long StepperController::getRemainingTime() const {
+    if (!engine.isRunning()) {
+        return 0;
     }
     
-    return 100.0 * (1.0 - (float)remainingSteps / totalSteps);
+    uint32_t elapsed = engine.getElapsedTicks();
+    if (elapsed >= plannedDurationTicks) {
+        return 0;
+    }
+    return (unsigned long)((uint64_t)(plannedDurationTicks - elapsed) * STEP_TIMER_TICK_US / 1000);
 }
 
-long StepperController::getStepsToTarget() {
-    return stepper.distanceToGo();
+MotionStats StepperController::getMotionStats() const {
+    MotionStats stats = engine.getStats();
+    stats.plannedUs = plannedDurationTicks * STEP_TIMER_TICK_US;
+    stats.jamRetries = jamRetries;
+    stats.recoveryUs = recovering ? recoveryUs + (StepTimer::nowMicros() - recoveryStartUs) : recoveryUs;
+    stats.jamsDetected = jamsDetected;
+    return stats;
+}
+
+void StepperController::resetMotionStats() {
+    engine.resetStats();
+    jamsDetected = 0;
+}
+
+void StepperController::setCurrentCompartment(int compartment) {
+    if (state == MOTOR_MOVING || compartment < 0 || compartment >= TOTAL_COMPARTMENTS) {
+        return;
+    }
+    currentCompartment = compartment;
+    targetPosition = compartmentToSteps(compartment);
+    redefinePosition(targetPosition);
 }
 
-void StepperController::setMaxSpeed(float speed) {
-    stepper.setMaxSpeed(speed);
+void StepperController::redefinePosition(long newPosition) {
+    // El rotor no se mueve: la fase del driver se desplaza con el contador
+    phaseOrigin += newPosition - engine.getPosition();
+    engine.setPosition(newPosition);
 }
 
-void StepperController::setAcceleration(float acceleration) {
-    stepper.setAcceleration(acceleration);
+void StepperController::setHomeOffset(long offset) {
+    homeOffset = offset;
+    armStallSupervision();
+}
+
+void StepperController::setCompartmentOffsets(const int* offsets) {
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        compartmentOffsets[i] = constrain(offsets[i], -COMPARTMENT_OFFSET_MAX, COMPARTMENT_OFFSET_MAX);
+    }
+    armStallSupervision();
+}
+
+int StepperController::getCompartmentOffset(int compartment) const {
+    if (compartment < 0 || compartment >= TOTAL_COMPARTMENTS) {
+        return 0;
+    }
+    return compartmentOffsets[compartment];
 }
 
 long StepperController::compartmentToSteps(int compartment) {
-    return compartment * STEPS_PER_COMPARTMENT;
+    return compartment * STEPS_PER_COMPARTMENT + compartmentOffsets[compartment];
+}
+
+long StepperController::normalizePosition(long steps) {
+    long position = steps % STEPS_PER_CAROUSEL_TURN;
+    return position < 0 ? position + STEPS_PER_CAROUSEL_TURN : position;
+}
+
+int StepperController::positionToCompartment(long steps) {
+    // Redondeo al compartimento más cercano sobre la posición normalizada
+    long position = normalizePosition(steps) + STEPS_PER_COMPARTMENT / 2;
+    return (position / STEPS_PER_COMPARTMENT) % TOTAL_COMPARTMENTS;
+}
+
+long StepperController::wrapDistance(long steps) {
+    long distance = normalizePosition(steps);
+    return distance > STEPS_PER_CAROUSEL_TURN / 2 ? distance - STEPS_PER_CAROUSEL_TURN : distance;
+}
+
+long StepperController::routeSteps(long fromSteps, int toCompartment, int direction) {
+    // Distancia hacia delante en [0, vuelta) y elección del sentido
+    long forward = normalizePosition(toCompartment * STEPS_PER_COMPARTMENT - fromSteps);
+    if (forward == 0) {
+        return 0;
+    }
+    
+    long backward = forward - STEPS_PER_CAROUSEL_TURN;
+    if (direction > 0) return forward;
+    if (direction < 0) return backward;
+    return forward <= -backward ? forward : backward;
+}
+
+uint32_t StepperController::planMove(long steps, StepSchedule& schedule) {
+    // Perfil en S precalculado en compilación (pasos completos); los
+    // movimientos que no son un múltiplo exacto de compartimento alargan
+    // o recortan el crucero
+    uint32_t totalSteps = abs(steps);
+    const MoveTable& table = MotionTables::forSteps(totalSteps);
+    
+    uint16_t rampSteps = table.rampSteps;
+    uint16_t cruiseTicks = table.cruiseTicks;
+    uint32_t rampTicks = table.rampTicks;
+    
+    if (rampSteps > totalSteps / 2) {
+        // Movimientos cortos (tras una parada): rampa recortada
+        rampSteps = totalSteps / 2;
+        cruiseTicks = rampSteps > 0 ? table.ramp[rampSteps - 1] : table.ramp[0];
+        rampTicks = 0;
+        for (uint16_t i = 0; i < rampSteps; i++) {
+            rampTicks += table.ramp[i];
+        }
+    }
+    
+    schedule.ramp = table.ramp;
+    schedule.rampSteps = rampSteps;
+    schedule.cruiseTicks = cruiseTicks;
+    schedule.totalSteps = totalSteps;
+    schedule.direction = steps > 0 ? 1 : -1;
+    
+    // +1: el último pulso se baja en el tick siguiente
+    return 2 * rampTicks + (totalSteps - 2 * rampSteps) * cruiseTicks + 1;
+}
+
+uint32_t StepperController::queueRoute(long fromPosition, long steps, int8_t notifyCommand) {
+    // Micropasos hasta el siguiente paso completo en el sentido de la marcha,
+    // crucero en paso completo y aproximación final en micropasos
+    int direction = steps > 0 ? 1 : -1;
+    long distance = abs(steps);
+    long phase = (fromPosition - phaseOrigin) % MICROSTEPS;
+    if (phase < 0) phase += MICROSTEPS;
+    long prefix = direction > 0 ? (MICROSTEPS - phase) % MICROSTEPS : phase;
+    long approach = MICROSTEP_APPROACH_FULL_STEPS * MICROSTEPS;
+    
+    long coarseSteps = (distance - prefix - approach) / MICROSTEPS;
+    if (coarseSteps < 2) {
+        return queueFineMove(steps, notifyCommand);  // No compensa cambiar de modo
+    }
+    long suffix = distance - prefix - coarseSteps * MICROSTEPS;
+    
+    uint32_t ticks = 0;
+    if (prefix > 0) {
+        ticks += queueFineMove(direction * prefix, -1);
+    }
+    ticks += queueMode(1);
+    ticks += queueMove(direction * coarseSteps, -1);
+    ticks += queueMode(MICROSTEPS);
+    ticks += queueFineMove(direction * suffix, notifyCommand);
+    return ticks;
+}
+
+uint32_t StepperController::queueMove(long steps, int8_t notifyCommand) {
+    MotionSegment segment;
+    segment.type = SEGMENT_MOVE;
+    segment.stepSize = MICROSTEPS;
+    segment.sensorAction = SENSOR_IGNORE;
+    segment.microsteps = 1;
+    segment.dwellTicks = 0;
+    segment.notifyCommand = notifyCommand;
+    uint32_t ticks = planMove(steps, segment.schedule);
+    
+    engine.enqueue(segment);
+    return ticks;
+}
+
+uint32_t StepperController::queueFineMove(long steps, int8_t notifyCommand,
+                                         uint16_t speed, SensorAction sensorAction) {
+    // Velocidad constante y baja: arranca y para sin rampa
+    MotionSegment segment;
+    segment.type = SEGMENT_MOVE;
+    segment.schedule.ramp = nullptr;
+    segment.schedule.rampSteps = 0;
+    segment.schedule.cruiseTicks = MotionTables::toTicks(1000000.0 / speed);
+    segment.schedule.totalSteps = abs(steps);
+    segment.schedule.direction = steps > 0 ? 1 : -1;
+    segment.stepSize = 1;
+    segment.sensorAction = sensorAction;
+    segment.microsteps = MICROSTEPS;
+    segment.dwellTicks = 0;
+    segment.notifyCommand = notifyCommand;
+    
+    engine.enqueue(segment);
+    return segment.schedule.totalSteps * segment.schedule.cruiseTicks + 1;
+}
+
+uint32_t StepperController::queueMode(uint8_t microsteps) {
+    MotionSegment segment;
+    segment.type = SEGMENT_MODE;
+    segment.schedule.ramp = nullptr;
+    segment.schedule.rampSteps = 0;
+    segment.schedule.cruiseTicks = 0;
+    segment.schedule.totalSteps = 0;
+    segment.schedule.direction = 1;
+    segment.stepSize = 1;
+    segment.sensorAction = SENSOR_IGNORE;
+    segment.microsteps = microsteps;
+    segment.dwellTicks = (MICROSTEP_SWITCH_SETTLE_US + STEP_TIMER_TICK_US - 1) / STEP_TIMER_TICK_US;
+    segment.notifyCommand = -1;
+    
+    engine.enqueue(segment);
+    return segment.dwellTicks;
+}
+
+uint32_t StepperController::queueDwell(uint32_t ticks, int8_t notifyCommand) {
+    MotionSegment segment;
+    segment.type = SEGMENT_DWELL;
+    segment.schedule.ramp = nullptr;
+    segment.schedule.rampSteps = 0;
+    segment.schedule.cruiseTicks = 0;
+    segment.schedule.totalSteps = 0;
+    segment.schedule.direction = 1;
+    segment.stepSize = 1;
+    segment.sensorAction = SENSOR_IGNORE;
+    segment.microsteps = MICROSTEPS;
+    segment.dwellTicks = ticks > 0 ? ticks : 1;
+    segment.notifyCommand = notifyCommand;
+    
+    engine.enqueue(segment);
+    return segment.dwellTicks;
+}
+
+uint8_t StepperController::segmentsFor(const MotionCommand& command) const {
+    if (command.type == MOTION_AGITATE && command.cycles > 0) {
+        return command.cycles * 2;
+    }
+    if (command.type == MOTION_MOVE_TO) {
+        return 5;  // Alineación, modo, crucero, modo y aproximación
+    }
+    return 1;
 }
 
 void StepperController::handleMovementComplete() {
-    // Calcular en qué compartimento estamos
-    long currentPos = stepper.currentPosition();
-    currentCompartment = (currentPos / STEPS_PER_COMPARTMENT) % TOTAL_COMPARTMENTS;
+    // Normalizar el contador a una vuelta para que no crezca sin límite
+    long currentPos = normalizePosition(engine.getPosition());
+    engine.setPosition(currentPos);
+    targetPosition = normalizePosition(targetPosition);
+    currentCompartment = positionToCompartment(currentPos);
+    completedCommands = commandCount;
     
+    // En reposo update() ya no pasa de la primera línea
+    engine.releaseTimer();
     state = MOTOR_IDLE;
     enableMotor(false);
     
-    if (movementCompleteCallback) {
-        movementCompleteCallback();
+    trace(MOTOR_TRACE_DONE, MOTOR_MOVING);
+    eventBus.publish(EVENT_MOVEMENT_COMPLETE);
+}
+
+void StepperController::handleStall() {
+    StallCause cause = engine.getStallCause();
+    trace(cause == STALL_DIAG ? MOTOR_TRACE_STALL_DIAG : MOTOR_TRACE_STALL_SENSOR, state);
+    
+    if (!recovering) {
+        jamsDetected++;
+        recoveryStartUs = StepTimer::nowMicros();
+        jamPosition = engine.getStallPosition();
+        jamDirection = engine.getStallDirection();
+    } else if (cause == STALL_NONE) {
+        // Búsqueda sin flanco: el carrusel ha vuelto contra el mismo atasco
+        // y el avance de la búsqueda solo existe en el contador
+        redefinePosition(jamPosition);
+    }
+    
+    if (jamRetries >= JAM_MAX_RETRIES) {
+        recoveryUs += StepTimer::nowMicros() - recoveryStartUs;
+        if (cause != STALL_DIAG) {
+            // Con pasos perdidos el contador ya no coincide con las marcas
+            homed = false;
+            engine.setStallSupervision(nullptr, 0, 0);
+        }
+        stopMotor();
+        jammed = true;
+        triggerError("Atasco del carrusel tras " + String(jamRetries) + " reintentos");
+        return;
+    }
+    
+    // Retroceder, agitar para soltar el pienso y, si se perdieron pasos,
+    // buscar el flanco siguiente para resincronizar el contador
+    jamRetries++;
+    recovering = true;
+    uint32_t ticks = queueFineMove(-jamDirection * JAM_REVERSE_STEPS, -1);
+    for (uint8_t cycle = 0; cycle < JAM_AGITATE_CYCLES; cycle++) {
+        ticks += queueFineMove(AGITATE_STEPS, -1);
+        ticks += queueFineMove(-AGITATE_STEPS, -1);
+    }
+    recoverySeek = cause != STALL_DIAG && homed;
+    if (recoverySeek) {
+        // Hasta resincronizar, el contador no sirve para vigilar las marcas
+        engine.setStallSupervision(nullptr, 0, 0);
+        ticks += queueFineMove(stallWindow(), -1, HOMING_SEEK_SPEED, SENSOR_STOP);
+    }
+    
+    plannedDurationTicks += ticks;
+    if (!engine.run(true)) {
+        recoveryUs += StepTimer::nowMicros() - recoveryStartUs;
+        stopMotor();
+        jammed = true;
+        triggerError("No se pudo arrancar el timer de pasos");
     }
 }
 
+void StepperController::resumeAfterJam() {
+    trace(MOTOR_TRACE_RESUME, state);
+    recovering = false;
+    recoveryUs += StepTimer::nowMicros() - recoveryStartUs;
+    
+    if (recoverySeek) {
+        long edge = engine.getSensorPosition();
+        redefinePosition(engine.getPosition() + markCorrection(edge, jamDirection));
+        armStallSupervision();
+    }
+    
+    // Repetir lo que faltaba desde la posición real
+    long plannedPosition = engine.getPosition();
+    plannedDurationTicks += queueCommands(completedCommands, plannedPosition);
+    targetPosition = plannedPosition;
+    
+    if (engine.getFreeSlots() == MOTION_QUEUE_SIZE - 1) {
+        handleMovementComplete();  // No quedaba nada por hacer
+    } else if (!engine.run(true)) {
+        stopMotor();
+        triggerError("No se pudo arrancar el timer de pasos");
+    }
+}
+
+void StepperController::armStallSupervision() {
+    if (!HOME_SENSOR_ENABLED || !homed) {
+        return;
+    }
+    
+    int32_t marks[TOTAL_COMPARTMENTS];
+    uint8_t count = HOME_SENSOR_COMPARTMENT_MARKS ? TOTAL_COMPARTMENTS : 1;
+    for (uint8_t i = 0; i < count; i++) {
+        marks[i] = normalizePosition(expectedMark(i));
+    }
+    engine.setStallSupervision(marks, count, stallWindow());
+}
+
+long StepperController::expectedMark(int compartment) const {
+    // La marca de origen define homeOffset; las demás llevan su desviación aprendida
+    if (compartment == 0) {
+        return homeOffset;
+    }
+    return homeOffset + compartment * STEPS_PER_COMPARTMENT + compartmentOffsets[compartment];
+}
+
+uint32_t StepperController::stallWindow() const {
+    // Mayor separación posible entre dos flancos consecutivos, más la tolerancia
+    if (HOME_SENSOR_COMPARTMENT_MARKS) {
+        return STEPS_PER_COMPARTMENT + 2 * COMPARTMENT_OFFSET_MAX + JAM_EDGE_TOLERANCE_STEPS;
+    }
+    return STEPS_PER_CAROUSEL_TURN + JAM_EDGE_TOLERANCE_STEPS;
+}
+
+long StepperController::markCorrection(long edge, int direction) const {
+    // Los pasos perdidos dejan el carrusel por detrás del contador en el
+    // sentido de la marcha: la marca real es la más cercana en ese lado
+    long best = STEPS_PER_CAROUSEL_TURN;
+    int marks = HOME_SENSOR_COMPARTMENT_MARKS ? TOTAL_COMPARTMENTS : 1;
+    for (int i = 0; i < marks; i++) {
+        long behind = normalizePosition(direction * (edge - expectedMark(i)) + JAM_EDGE_TOLERANCE_STEPS);
+        if (behind < best) {
+            best = behind;
+        }
+    }
+    return -direction * (best - JAM_EDGE_TOLERANCE_STEPS);
+}
+
 void StepperController::triggerError(String error) {
+    MotorState from = state;
     state = MOTOR_ERROR;
-    if (errorCallback) {
-        errorCallback(error);
-    }
+    trace(MOTOR_TRACE_ERROR, from);
+    eventBus.publish(EVENT_MOTOR_ERROR, error);
+}
+
+void StepperController::trace(MotorTraceEvent event, MotorState from) {
+    TraceRecord entry;
+    entry.timestamp = (uint32_t)MonotonicClock::nowMs();
+    entry.value = engine.getPosition();
+    entry.source = TRACE_SOURCE_MOTOR;
+    entry.state = from;
+    entry.event = event;
+    entry.next = state;
+    entry.compartment = currentCompartment;
+    entry.temperature = TRACE_NO_TEMPERATURE;
+    entry.humidity = TRACE_NO_HUMIDITY;
+    
+    uint8_t flags = 0;
+    if (state == MOTOR_MOVING) flags |= TRACE_FLAG_MOTOR_MOVING;
+    if (jammed) flags |= TRACE_FLAG_JAMMED;
+    if (recovering) flags |= TRACE_FLAG_RECOVERING;
+    if (HOME_SENSOR_ENABLED && HomeSensor::isActive()) flags |= TRACE_FLAG_HOME_SENSOR;
+    entry.flags = flags;
+    
+    feedingTrace.record(entry);
+}
+
+const char* StepperController::getTraceEventName(MotorTraceEvent event) {
+    static const char* const names[MOTOR_TRACE_EVENT_COUNT] = {
+        "START", "COMMAND", "DONE", "STOP", "STALL_SENSOR", "STALL_DIAG",
+        "RESUME", "TIMEOUT", "ERROR", "CALIBRATE", "HOMED"
+    };
+    return event < MOTOR_TRACE_EVENT_COUNT ? names[event] : "?";
 }
\ No newline at end of file
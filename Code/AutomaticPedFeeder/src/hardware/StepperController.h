@@ -2,8 +2,14 @@
 #define STEPPER_CONTROLLER_H
 
 #include <Arduino.h>
-#include <AccelStepper.h>
 #include "../config.h"
+#include "StepEngine.h"
+#include "MotionTables.h"
+#include "../utils/EventBus.h"
+#include "../utils/FeedingTrace.h"
+#include "../utils/MonotonicClock.h"
+
+#define MOTION_MAX_COMMANDS 16  // Órdenes por secuencia (dispensado de varias raciones)
 
 enum MotorState {
     MOTOR_IDLE,
@@ -12,20 +18,78 @@ enum MotorState {
     MOTOR_ERROR
 };
 
+// Eventos del motor en feedingTrace
+enum MotorTraceEvent : uint8_t {
+    MOTOR_TRACE_START,         // Secuencia lanzada
+    MOTOR_TRACE_COMMAND,       // Orden completada
+    MOTOR_TRACE_DONE,          // Secuencia terminada
+    MOTOR_TRACE_STOP,
+    MOTOR_TRACE_STALL_SENSOR,  // Atasco por el sensor de marcas
+    MOTOR_TRACE_STALL_DIAG,    // Atasco por la salida DIAG del driver
+    MOTOR_TRACE_RESUME,        // Recuperación terminada, se repite lo pendiente
+    MOTOR_TRACE_TIMEOUT,
+    MOTOR_TRACE_ERROR,
+    MOTOR_TRACE_CALIBRATE,
+    MOTOR_TRACE_HOMED,         // Homing terminado (bien o mal según next)
+    MOTOR_TRACE_EVENT_COUNT
+};
+
+enum HomingPhase {
+    HOMING_IDLE,
+    HOMING_SWEEP,     // Vuelta completa registrando las marcas del sensor
+    HOMING_SEEK,      // Búsqueda rápida del flanco de origen
+    HOMING_APPROACH,  // Retroceso y aproximación lenta al flanco
+    HOMING_PARK       // Ir al compartimento 0 ya referenciado
+};
+
+enum MotionCommandType {
+    MOTION_MOVE_TO,   // Ir a un compartimento (ruta circular)
+    MOTION_DWELL,     // Mantener la posición con el motor habilitado
+    MOTION_AGITATE    // Vaivén corto alrededor de la posición actual
+};
+
+struct MotionCommand {
+    MotionCommandType type;
+    int compartment;      // MOTION_MOVE_TO
+    uint32_t durationMs;  // MOTION_DWELL
+    uint8_t cycles;       // MOTION_AGITATE
+};
+
 class StepperController {
 private:
-    AccelStepper stepper;
+    StepEngine engine;
     int currentCompartment;
     MotorState state;
     bool enabled;
     
-    // Callbacks
-    void (*movementCompleteCallback)();
-    void (*errorCallback)(String);
-    
     // Control interno
     long targetPosition;
-    unsigned long lastMovementTime;
+    uint64_t lastMovementTime;
+    long phaseOrigin;  // Posición con el driver en un paso completo exacto
+    
+    // Referencia del carrusel
+    HomingPhase homingPhase;
+    bool homed;
+    long homeOffset;          // Posición del flanco de origen
+    long lastHomingError;     // Desviación corregida en el último homing
+    int compartmentOffsets[TOTAL_COMPARTMENTS];
+    
+    // Secuencia en curso
+    MotionCommand commands[MOTION_MAX_COMMANDS];
+    uint8_t commandCount;
+    uint8_t completedCommands;
+    uint32_t plannedDurationTicks;
+    
+    // Atascos
+    bool recovering;          // Retroceso y agitación en curso
+    bool recoverySeek;        // La recuperación acaba buscando un flanco para resincronizar
+    bool jammed;              // Reintentos agotados en la última secuencia
+    uint8_t jamRetries;       // Reintentos de la secuencia actual
+    int8_t jamDirection;      // Sentido de la marcha al atascarse
+    long jamPosition;         // Contador en el momento del atasco
+    uint64_t recoveryStartUs;
+    uint32_t recoveryUs;      // Tiempo en recuperación de la secuencia actual
+    uint32_t jamsDetected;    // Desde el arranque
     
 public:
     StepperController();
@@ -38,6 +102,7 @@ public:
     bool moveToCompartment(int compartmentIndex);
     bool moveToNextCompartment();
     bool moveToPreviousCompartment();
+    bool runSequence(const MotionCommand* sequence, uint8_t count);
     void stopMotor();
     void enableMotor(bool enable);
     bool calibrate();
@@ -46,23 +111,63 @@ public:
     int getCurrentCompartment() const { return currentCompartment; }
     MotorState getState() const { return state; }
     bool isMotorMoving() const { return state == MOTOR_MOVING; }
+    bool isCalibrating() const { return state == MOTOR_CALIBRATING; }
+    bool isHomed() const { return homed; }
+    bool isJammed() const { return jammed; }
+    bool isRecoveringJam() const { return recovering; }
+    long getLastHomingError() const { return lastHomingError; }
     bool isEnabled() const { return enabled; }
+    uint8_t getCompletedCommands() const { return completedCommands; }
+    uint8_t getCommandCount() const { return commandCount; }
     float getProgress();
     long getStepsToTarget();
+    unsigned long getPlannedDuration() const;  // ms de la secuencia actual
+    unsigned long getRemainingTime() const;    // ms según el perfil planificado
+    MotionStats getMotionStats() const;
+    void resetMotionStats();
+    
+    // Configuración (velocidad y aceleración se fijan en config.h)
+    void setCurrentCompartment(int compartment);
+    void setHomeOffset(long offset);
+    long getHomeOffset() const { return homeOffset; }
+    void setCompartmentOffsets(const int* offsets);
+    int getCompartmentOffset(int compartment) const;
     
-    // Configuración
-    void setMaxSpeed(float speed);
-    void setAcceleration(float acceleration);
-    void setCurrentCompartment(int compartment) { currentCompartment = compartment; }
+    // Modelo de posición circular del carrusel
+    static long normalizePosition(long steps);
+    static int positionToCompartment(long steps);
+    static long routeSteps(long fromSteps, int toCompartment, int direction = CAROUSEL_DIRECTION);
+    static long wrapDistance(long steps);  // Distancia con signo en media vuelta
+    static const char* getTraceEventName(MotorTraceEvent event);
     
-    // Callbacks
-    void setMovementCompleteCallback(void (*callback)()) { movementCompleteCallback = callback; }
-    void setErrorCallback(void (*callback)(String)) { errorCallback = callback; }
+    // Eventos (EventBus): EVENT_MOVEMENT_COMPLETE, EVENT_MOTOR_ERROR,
+    // EVENT_COMMAND_COMPLETE y EVENT_CALIBRATION_COMPLETE
     
 private:
+    void trace(MotorTraceEvent event, MotorState from);
     long compartmentToSteps(int compartment);
+    uint32_t planMove(long steps, StepSchedule& schedule);
+    uint32_t queueCommands(uint8_t first, long& plannedPosition);
+    uint32_t queueRoute(long fromPosition, long steps, int8_t notifyCommand);
+    uint32_t queueMove(long steps, int8_t notifyCommand);
+    uint32_t queueFineMove(long steps, int8_t notifyCommand,
+                           uint16_t speed = MICROSTEP_APPROACH_SPEED,
+                           SensorAction sensorAction = SENSOR_IGNORE);
+    uint32_t queueMode(uint8_t microsteps);
+    uint32_t queueDwell(uint32_t ticks, int8_t notifyCommand);
+    void redefinePosition(long newPosition);
+    uint8_t segmentsFor(const MotionCommand& command) const;
     void handleMovementComplete();
+    void handleStall();
+    void resumeAfterJam();
+    void armStallSupervision();
+    long expectedMark(int compartment) const;
+    uint32_t stallWindow() const;
+    long markCorrection(long edge, int direction) const;
+    void handleHomingStep();
+    bool learnCompartmentOffsets(long& homeEdge);
+    void finishHoming(bool success, const String& error);
     void triggerError(String error);
 };
 
-#endif // STEPPER_CONTROLLER_H
\ No newline at end of file
+#endif // STEPPER_CONTROLLER_H
@@ -0,0 +1,127 @@
+#include "ToneSequencer.h"
+
+#define TONE_LEDC_CHANNEL 0
+#define TONE_LEDC_RESOLUTION 8
+
+ToneSequencer::ToneSequencer()
+    : pin(0),
+      noteCount(0),
+      currentNote(0),
+      repeatsLeft(0),
+      playing(false),
+      noteStartTime(0),
+      noteTimer(TIMER_NONE),
+      completeCallback(nullptr) {
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+
+bool ToneSequencer::begin(uint8_t outputPin) {
+    pin = outputPin;
+    if (noteTimer == TIMER_NONE) noteTimer = timerQueue.add(onNoteTimer, this);
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    if (!ledcAttach(pin, SOUND_FREQUENCY, TONE_LEDC_RESOLUTION)) return false;
+#else
+    ledcSetup(TONE_LEDC_CHANNEL, SOUND_FREQUENCY, TONE_LEDC_RESOLUTION);
+    ledcAttachPin(pin, TONE_LEDC_CHANNEL);
+#endif
+    writeTone(0);
+    return true;
+}
+
+void ToneSequencer::writeTone(uint16_t frequency) {
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    ledcWriteTone(pin, frequency);
+#else
+    ledcWriteTone(TONE_LEDC_CHANNEL, frequency);
+#endif
+}
+
+#else  // Sustituto para compilación nativa
+
+static uint16_t currentFrequency = 0;
+
+bool ToneSequencer::begin(uint8_t outputPin) {
+    pin = outputPin;
+    if (noteTimer == TIMER_NONE) noteTimer = timerQueue.add(onNoteTimer, this);
+    writeTone(0);
+    return true;
+}
+
+void ToneSequencer::writeTone(uint16_t frequency) {
+    currentFrequency = frequency;
+}
+
+uint16_t ToneSequencer::simulatedFrequency() {
+    return currentFrequency;
+}
+
+#endif
+
+bool ToneSequencer::play(const ToneNote* pattern, uint8_t count, uint8_t repeats) {
+    if (count == 0 || count > TONE_MAX_NOTES || repeats == 0) {
+        return false;
+    }
+
+    // Un patrón nuevo sustituye al que esté sonando
+    for (uint8_t i = 0; i < count; i++) {
+        notes[i] = pattern[i];
+    }
+    noteCount = count;
+    repeatsLeft = repeats - 1;
+    playing = true;
+    startNote(0);
+    return true;
+}
+
+void ToneSequencer::stop() {
+    if (!playing) return;
+    timerQueue.stop(noteTimer);
+    writeTone(0);
+    playing = false;
+}
+
+void ToneSequencer::update() {
+    if (!playing || MonotonicClock::elapsedMs(noteStartTime) < notes[currentNote].durationMs) {
+        return;
+    }
+
+    uint8_t next = currentNote + 1;
+    if (next >= noteCount) {
+        if (repeatsLeft == 0) {
+            finish();
+            return;
+        }
+        repeatsLeft--;
+        next = 0;
+    }
+
+    // La pausa final de la última repetición no se espera
+    if (next == noteCount - 1 && repeatsLeft == 0 && notes[next].frequency == 0) {
+        finish();
+        return;
+    }
+
+    startNote(next);
+}
+
+void ToneSequencer::startNote(uint8_t index) {
+    currentNote = index;
+    noteStartTime = MonotonicClock::nowMs();
+    timerQueue.start(noteTimer, notes[index].durationMs);
+    writeTone(notes[index].frequency);
+}
+
+void ToneSequencer::onNoteTimer(void* context) {
+    static_cast<ToneSequencer*>(context)->update();
+}
+
+void ToneSequencer::finish() {
+    timerQueue.stop(noteTimer);
+    writeTone(0);
+    playing = false;
+
+    if (completeCallback) {
+        completeCallback();
+    }
+}
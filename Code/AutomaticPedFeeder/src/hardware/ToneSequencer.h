@@ -0,0 +1,64 @@
+#ifndef TONE_SEQUENCER_H
+#define TONE_SEQUENCER_H
+
+#include <Arduino.h>
+#include "../config.h"
+#include "../utils/MonotonicClock.h"
+#include "../utils/TimerQueue.h"
+
+#define TONE_MAX_NOTES 16  // Notas por patrón (copiado al empezar)
+
+// Nota de un patrón; frequency 0 = silencio
+struct ToneNote {
+    uint16_t frequency;   // Hz
+    uint16_t durationMs;
+};
+
+// Reproduce patrones de notas sin bloquear: el LEDC genera el tono y un
+// temporizador de timerQueue llama a update() cuando vence la nota actual
+// (update() se puede seguir llamando a mano). Como timerQueue, solo se
+// usa desde loop(): otras tareas piden sonidos a través de FeedingLogic o
+// del EventBus. Fuera del target
+// se compila un sustituto que solo recuerda la frecuencia actual.
+class ToneSequencer {
+private:
+    uint8_t pin;
+    ToneNote notes[TONE_MAX_NOTES];
+    uint8_t noteCount;
+    uint8_t currentNote;
+    uint8_t repeatsLeft;
+    bool playing;
+    uint64_t noteStartTime;
+    TimerId noteTimer;
+
+    void (*completeCallback)();
+
+public:
+    ToneSequencer();
+
+    // Inicialización
+    bool begin(uint8_t outputPin);
+    void update();
+
+    // Control
+    bool play(const ToneNote* pattern, uint8_t count, uint8_t repeats = 1);
+    void stop();
+
+    // Estado
+    bool isPlaying() const { return playing; }
+
+    // Callbacks
+    void setCompleteCallback(void (*callback)()) { completeCallback = callback; }
+
+#ifndef ARDUINO_ARCH_ESP32
+    static uint16_t simulatedFrequency();
+#endif
+
+private:
+    static void onNoteTimer(void* context);
+    void startNote(uint8_t index);
+    void finish();
+    void writeTone(uint16_t frequency);
+};
+
+#endif // TONE_SEQUENCER_H
@@ -12,6 +12,10 @@
 #include "storage/ConfigManager.h"
 #include "utils/Logger.h"
 #include "utils/TimeUtils.h"
+#include "utils/EventBus.h"
+#include "utils/MonotonicClock.h"
+#include "utils/TimerQueue.h"
+#include "utils/PowerManager.h"
 #include <time.h>
 
 // ========== OBJETOS GLOBALES ==========
@@ -22,20 +26,24 @@ FeedingLogic feedingLogic(&stepperController, &sensorManager);
 FeedingScheduler feedingScheduler(&feedingLogic);
 ConfigManager configManager;
 WebServerManager webServer(&feedingLogic, &stepperController, &sensorManager, &cameraController, &feedingScheduler, &configManager);
-TelegramBotManager telegramBot(&feedingLogic, &stepperController, &sensorManager, &cameraController);
+TelegramBotManager telegramBot(&feedingLogic, &feedingScheduler, &stepperController, &sensorManager, &cameraController);
 Logger logger;
 
 // Configuración global
 FeederConfig globalConfig;
 
-// ========== CALLBACKS ==========
+// ========== SUSCRIPTORES DE EVENTOS ==========
+// Se ejecutan en eventBus.dispatch(), al final de loop(), nunca dentro del
+// update() del módulo que publicó el evento
 
-void onFeedingComplete(bool success) {
+void onFeedingComplete(const Event& event) {
+    bool success = event.success();
     logger.info("Alimentación completada: " + String(success ? "Éxito" : "Fallo"));
     
     if (success) {
-        globalConfig.feedingsToday++;
-        globalConfig.lastFeedingTime = millis();
+        feedingScheduler.recordFeeding();
+        feedingScheduler.copyTo(globalConfig);
+        globalConfig.lastFeedingTime = (unsigned long)TimeUtils::now();
         configManager.saveConfig(globalConfig);
         
         // Notificar por Telegram
@@ -49,7 +57,8 @@ void onFeedingComplete(bool success) {
     }
 }
 
-void onFeedingError(String error) {
+void onFeedingError(const Event& event) {
+    String error = event.text;
     logger.error("Error en alimentación: " + error);
     
     if (globalConfig.telegramEnabled) {
@@ -57,7 +66,8 @@ void onFeedingError(String error) {
     }
 }
 
-void onEnvironmentAlert(String alert) {
+void onEnvironmentAlert(const Event& event) {
+    String alert = event.text;
     logger.warning("Alerta ambiental: " + alert);
     
     if (globalConfig.telegramEnabled) {
@@ -65,16 +75,161 @@ void onEnvironmentAlert(String alert) {
     }
 }
 
-void onPresenceDetected() {
+void onPresenceDetected(const Event& event) {
     logger.info("Presencia detectada");
 }
 
-void onStepperMovementComplete() {
+void onStepperMovementComplete(const Event& event) {
     logger.debug("Movimiento del motor completado");
 }
 
-void onFeedingStateChange(FeedingState newState) {
-    logger.info("Estado de alimentación: " + feedingLogic.getStateString());
+void onMotorError(const Event& event) {
+    logger.error("Error del motor: " + String(event.text));
+}
+
+void onCalibrationComplete(const Event& event) {
+    if (!event.success()) {
+        // Sin referencia se vuelve a la última posición guardada
+        logger.error("No se pudo referenciar el carrusel");
+        stepperController.setCurrentCompartment(globalConfig.currentCompartment);
+        return;
+    }
+    
+    logger.info("Carrusel referenciado (desviación corregida: " +
+                String(stepperController.getLastHomingError()) + " pasos)");
+    
+    globalConfig.homeOffset = stepperController.getHomeOffset();
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        globalConfig.compartmentOffsets[i] = stepperController.getCompartmentOffset(i);
+    }
+    globalConfig.currentCompartment = stepperController.getCurrentCompartment();
+    configManager.saveConfig(globalConfig);
+}
+
+void onInventoryChanged(const Event& event) {
+    // Los cambios llegan de la alimentación, la web y Telegram; se guardan aquí
+    feedingLogic.getInventory().copyTo(globalConfig.inventory);
+    configManager.saveConfig(globalConfig);
+    logger.info("Inventario: " + String(event.value) + "/" + String(TOTAL_COMPARTMENTS) +
+                " compartimentos llenos");
+}
+
+void onInventoryEdit(const Event& event) {
+    // Pedida desde la web (otra tarea); se aplica aquí, en loop()
+    bool filled = event.detail > 0;
+    if (!feedingLogic.editInventory(event.value, filled, filled ? event.detail : -event.detail)) {
+        logger.warning("Edición del inventario descartada: alimentación en curso o datos no válidos");
+    }
+}
+
+void onLowInventory(const Event& event) {
+    String msg = event.value == 0
+        ? "Comedero vacío: no quedan compartimentos con comida"
+        : "Queda comida en " + String(event.value) + " compartimento(s)";
+    logger.warning(msg);
+    
+    if (globalConfig.telegramEnabled) {
+        telegramBot.sendMessage("⚠️ " + msg + ". Rellena y usa /rellenar");
+    }
+}
+
+void onTimeSync(const Event& event) {
+    // NTP puede corregir la hora: la programación recalcula sus instantes
+    logger.info("Hora sincronizada: " + TimeUtils::getTimeString());
+    feedingScheduler.invalidate();
+}
+
+void onNewDay(const Event& event) {
+    // El programador ya ha puesto su contador a cero
+    feedingScheduler.copyTo(globalConfig);
+    configManager.saveConfig(globalConfig);
+    logger.info("Nuevo día - contador reiniciado");
+}
+
+void onMissedFeedings(const Event& event) {
+    String msg = "Tomas perdidas con el comedero apagado: " + String(event.value) +
+                 " (se recuperan " + String(event.detail) + ")";
+    logger.warning(msg);
+    
+    if (globalConfig.telegramEnabled) {
+        telegramBot.sendMessage("⏰ " + msg);
+    }
+}
+
+void onScheduleChanged(const Event& event) {
+    // Próxima toma en hora Unix: sobrevive al reinicio (ver restore())
+    feedingScheduler.copyTo(globalConfig);
+    configManager.saveConfig(globalConfig);
+}
+
+void onFeedingStateChange(const Event& event) {
+    // El estado viaja en el evento: al entregarlo la máquina puede ir por otro
+    logger.info("Estado de alimentación: " +
+                String(FeedingLogic::getStateName((FeedingState)event.value)));
+}
+
+// ========== TAREAS PERIÓDICAS ==========
+// Registradas en timerQueue al final de setup()
+
+void monitorMemory(void* context) {
+    static uint32_t minHeap = 363000; // Inicializar con RAM actual
+    
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t minFreeHeap = ESP.getMinFreeHeap();
+    
+    if (minFreeHeap < minHeap) {
+        minHeap = minFreeHeap;
+    }
+    
+    logger.info("──────────────────────────────");
+    logger.info("RAM Libre:    " + String(freeHeap/1024) + " KB");
+    logger.info("RAM Mínima:   " + String(minHeap/1024) + " KB");
+    logger.info("Fragmentación: " + String(100 - (freeHeap*100)/363000) + "%");
+    logger.info("Eventos:      máx. " + String(eventBus.getHighWaterMark()) + "/" +
+                String(EVENT_QUEUE_SIZE) + " en cola, " +
+                String(eventBus.getDroppedCount()) + " descartados");
+    
+    static uint32_t lastDropped = 0;
+    if (eventBus.getDroppedCount() > lastDropped) {
+        logger.warning("⚠️ Cola de eventos desbordada: aumenta EVENT_QUEUE_SIZE");
+        lastDropped = eventBus.getDroppedCount();
+    }
+    
+    logger.info("Energía:      " + String(powerManager.getIdleRatio() * 100, 1) + "% en reposo, " +
+                String(powerManager.getWakeupsPerHour(), 0) + " despertares/h, ~" +
+                String(powerManager.getEstimatedCurrentMa(), 1) + " mA (estimado)");
+    
+    // ⚠️ Alerta si queda poca RAM
+    if (freeHeap < 50000) {
+        logger.error("⚠️⚠️⚠️ MEMORIA CRÍTICA ⚠️⚠️⚠️");
+        // Liberar recursos no críticos
+        if (globalConfig.cameraEnabled) {
+            logger.warning("Deshabilitando cámara temporalmente");
+            cameraController.releaseFrameBuffer();
+        }
+    } else if (freeHeap < 100000) {
+        logger.warning("⚠️ Memoria baja");
+    }
+}
+
+void saveRuntimeState(void* context) {
+    // Actualizar configuración global periódicamente
+    globalConfig.currentCompartment = stepperController.getCurrentCompartment();
+    configManager.saveConfig(globalConfig);
+}
+
+// ========== REPOSO ==========
+
+// Nada que sondear en cada pasada: sin eventos pendientes, motor parado,
+// sin alimentación en curso ni en cola y sin sonido (el LEDC se pararía)
+bool isSystemIdle() {
+    return POWER_IDLE_ENABLED &&
+           eventBus.getDepth() == 0 &&
+           !stepperController.isMotorMoving() &&
+           !stepperController.isCalibrating() &&
+           feedingLogic.getState() == FEEDING_IDLE &&
+           feedingLogic.getQueueDepth() == 0 &&
+           !sensorManager.isSoundPlaying();
 }
 
 // ========== SETUP ==========
@@ -88,6 +243,22 @@ void setup() {
     logger.info("Cargando configuración...");
     globalConfig = configManager.loadConfig();
     
+    // Programador antes que la red: las tomas perdidas se deciden con la
+    // hora que conserve el RTC (o al sincronizar) y la primera pasada de
+    // loop() ya puede recuperarlas
+    feedingScheduler.begin();
+    feedingScheduler.setFeedingInterval(globalConfig.feedingIntervalHours);
+    if (!feedingScheduler.setFeedingSlots(globalConfig.feedingSlots)) {
+        logger.warning("Horario guardado no válido: se usa el intervalo");
+    }
+    feedingScheduler.setMaxFeedingsPerDay(globalConfig.portionsPerDay);
+    feedingScheduler.setPortionsPerFeeding(globalConfig.portionsPerFeeding);
+    feedingScheduler.setEnabled(globalConfig.autoFeedingEnabled);
+    feedingScheduler.setMissedFeedingPolicy(globalConfig.missedFeedingPolicy);
+    feedingScheduler.restore(globalConfig.nextFeedingTime, globalConfig.lastFeedingTime,
+                             globalConfig.feedingsDay, globalConfig.feedingsToday,
+                             globalConfig.lastSlotKey);
+    
     // Inicializar WiFi
     logger.info("Conectando a WiFi...");
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
@@ -114,20 +285,36 @@ void setup() {
         logger.error("No se pudo conectar a WiFi");
     }
     
+    // Suscripciones antes de arrancar módulos que ya publican (calibración)
+    eventBus.subscribe(EVENT_FEEDING_COMPLETE, onFeedingComplete);
+    eventBus.subscribe(EVENT_FEEDING_ERROR, onFeedingError);
+    eventBus.subscribe(EVENT_FEEDING_STATE, onFeedingStateChange);
+    eventBus.subscribe(EVENT_ENVIRONMENT_ALERT, onEnvironmentAlert);
+    eventBus.subscribe(EVENT_PRESENCE, onPresenceDetected);
+    eventBus.subscribe(EVENT_MOVEMENT_COMPLETE, onStepperMovementComplete);
+    eventBus.subscribe(EVENT_MOTOR_ERROR, onMotorError);
+    eventBus.subscribe(EVENT_CALIBRATION_COMPLETE, onCalibrationComplete);
+    eventBus.subscribe(EVENT_INVENTORY_CHANGED, onInventoryChanged);
+    eventBus.subscribe(EVENT_INVENTORY_EDIT, onInventoryEdit);
+    eventBus.subscribe(EVENT_LOW_INVENTORY, onLowInventory);
+    eventBus.subscribe(EVENT_TIME_SYNC, onTimeSync);
+    eventBus.subscribe(EVENT_NEW_DAY, onNewDay);
+    eventBus.subscribe(EVENT_MISSED_FEEDINGS, onMissedFeedings);
+    eventBus.subscribe(EVENT_SCHEDULE_CHANGED, onScheduleChanged);
+    
     // Inicializar hardware
     logger.info("Inicializando hardware...");
     
     if (stepperController.begin()) {
         logger.info("✓ Motor stepper inicializado");
-        stepperController.setMovementCompleteCallback(onStepperMovementComplete);
+        stepperController.setHomeOffset(globalConfig.homeOffset);
+        stepperController.setCompartmentOffsets(globalConfig.compartmentOffsets);
     } else {
         logger.error("✗ Error al inicializar motor stepper");
     }
     
     if (sensorManager.begin()) {
         logger.info("✓ Sensores inicializados");
-        sensorManager.setPresenceCallback(onPresenceDetected);
-        sensorManager.setEnvironmentAlertCallback(onEnvironmentAlert);
     } else {
         logger.error("✗ Error al inicializar sensores");
     }
@@ -144,14 +331,9 @@ void setup() {
     feedingLogic.enableSound(globalConfig.soundBeforeFeeding);
     feedingLogic.requirePresence(globalConfig.requirePresenceDetection);
     feedingLogic.setMaxWaitTime(globalConfig.maxWaitTimeMs);
-    feedingLogic.setFeedingCompleteCallback(onFeedingComplete);
-    feedingLogic.setFeedingErrorCallback(onFeedingError);
-    feedingLogic.setStateChangeCallback(onFeedingStateChange);
-    
-    // Inicializar programador
-    feedingScheduler.begin();
-    feedingScheduler.setFeedingInterval(globalConfig.feedingIntervalHours);
-    feedingScheduler.setEnabled(globalConfig.autoFeedingEnabled);
+    feedingLogic.getInventory().load(globalConfig.inventory);
+    logger.info("Compartimentos llenos: " + String(feedingLogic.getInventory().getFilledCount()) +
+                "/" + String(TOTAL_COMPARTMENTS));
     
     // Inicializar servidor web
     if (webServer.begin()) {
@@ -167,12 +349,30 @@ void setup() {
         telegramBot.sendMessage("🐕 Comedero automático iniciado y listo");
     }
     
-    // Calibración inicial (opcional)
-    if (globalConfig.currentCompartment == -1) {
+    // Restaurar la posición guardada para que la ruta más corta sea correcta
+    // (y para medir la desviación si después se hace homing)
+    if (globalConfig.currentCompartment != -1) {
+        stepperController.setCurrentCompartment(globalConfig.currentCompartment);
+    }
+    
+    // Calibración inicial: con sensor de origen siempre (un corte de luz a
+    // mitad de movimiento deja la posición guardada desfasada); sin él,
+    // solo si no hay posición guardada. Termina en onCalibrationComplete
+    if (HOME_SENSOR_ENABLED || globalConfig.currentCompartment == -1) {
         logger.info("Realizando calibración inicial...");
         stepperController.calibrate();
-        globalConfig.currentCompartment = 0;
-        configManager.saveConfig(globalConfig);
+    }
+    
+    // Trabajo periódico propio de main (los módulos registran el suyo en begin())
+    timerQueue.every(MEMORY_REPORT_INTERVAL_MS, monitorMemory);
+    timerQueue.every(CONFIG_SAVE_INTERVAL_MS, saveRuntimeState);
+    
+    // Reposo entre plazos: despiertan el timer, el Wi-Fi y el PIR
+    powerManager.addWakePin(PIR_PIN);
+    if (powerManager.begin()) {
+        logger.info("✓ Light sleep automático activo");
+    } else {
+        logger.warning("Light sleep no disponible: solo reposo de la CPU");
     }
     
     logger.info("=== Sistema listo ===");
@@ -180,91 +380,28 @@ void setup() {
     logger.info(sensorManager.getEnvironmentStatus());
 }
 
-void monitorMemory() {
-    static unsigned long lastReport = 0;
-    static uint32_t minHeap = 363000; // Inicializar con RAM actual
-    
-    if (millis() - lastReport > 10000) {  // Cada 10 segundos
-        uint32_t freeHeap = ESP.getFreeHeap();
-        uint32_t minFreeHeap = ESP.getMinFreeHeap();
-        
-        if (minFreeHeap < minHeap) {
-            minHeap = minFreeHeap;
-        }
-        
-        logger.info("──────────────────────────────");
-        logger.info("RAM Libre:    " + String(freeHeap/1024) + " KB");
-        logger.info("RAM Mínima:   " + String(minHeap/1024) + " KB");
-        logger.info("Fragmentación: " + String(100 - (freeHeap*100)/363000) + "%");
-        
-        // ⚠️ Alerta si queda poca RAM
-        if (freeHeap < 50000) {
-            logger.error("⚠️⚠️⚠️ MEMORIA CRÍTICA ⚠️⚠️⚠️");
-            // Liberar recursos no críticos
-            if (globalConfig.cameraEnabled) {
-                logger.warning("Deshabilitando cámara temporalmente");
-                cameraController.releaseFrameBuffer();
-            }
-        } else if (freeHeap < 100000) {
-            logger.warning("⚠️ Memoria baja");
-        }
-        
-        lastReport = millis();
-    }
-}
-
 // ========== LOOP ==========
 void loop() {
-    monitorMemory();
-    // Actualizar todos los módulos
-    stepperController.update();
+    // Solo lo que ha vencido: sensores, Telegram, programador, guardado...
+    timerQueue.run();
+    
+    // Flancos del PIR (la ISR despierta a loop()); el movimiento y la
+    // alimentación se sondean en cada pasada
     sensorManager.update();
+    stepperController.update();
     feedingLogic.update();
-    feedingScheduler.update();
     webServer.update();
     
-    if (globalConfig.telegramEnabled) {
-        telegramBot.update();
-    }
-    
-    // Actualizar configuración global periódicamente
-    static unsigned long lastConfigSave = 0;
-    if (millis() - lastConfigSave > 60000) {  // Cada minuto
-        globalConfig.currentCompartment = stepperController.getCurrentCompartment();
-        configManager.saveConfig(globalConfig);
-        lastConfigSave = millis();
-    }
+    // Notificaciones (Telegram, NVS, logs) fuera de los update() de arriba
+    eventBus.dispatch();
 
-    // Reset diario del contador de alimentaciones
-    // En el inicio del loop():
-    static int lastDay = TimeUtils::getCurrentDay(); // ✅ Inicializar con valor real
-    static bool dailyResetEnabled = (lastDay != -1);
-
-    if (dailyResetEnabled)
-    {
-        int currentDay = TimeUtils::getCurrentDay();
-        if (currentDay != -1 && currentDay != lastDay)
-        {
-            globalConfig.feedingsToday = 0;
-            feedingScheduler.resetDailyCount();
-            configManager.saveConfig(globalConfig);
-            lastDay = currentDay;
-            logger.info("Nuevo día - contador reiniciado");
-        }
-    }
-    else
-    {
-        // Intentar habilitar si NTP se sincroniza después
-        int currentDay = TimeUtils::getCurrentDay();
-        if (currentDay != -1)
-        {
-            lastDay = currentDay;
-            dailyResetEnabled = true;
-            logger.info("NTP sincronizado - reset diario activado");
-        }
+    // Sin nada que sondear se duerme hasta el próximo plazo; un evento
+    // publicado desde otra tarea (web, Telegram) despierta antes
+    if (isSystemIdle()) {
+        powerManager.idleUntil(timerQueue.getNextDeadline());
+    } else {
+        yield(); // Dar tiempo a otras tareas
     }
-
-    yield(); // Dar tiempo a otras tareas
 }
 
 // ========== FUNCIONES AUXILIARES ==========
@@ -285,15 +422,19 @@ String getSystemStatus() {
     String status = "=== Estado del Sistema ===\n";
     status += "WiFi: " + String(WiFi.status() == WL_CONNECTED ? "Conectado" : "Desconectado") + "\n";
     status += "IP: " + WiFi.localIP().toString() + "\n";
-    status += "Uptime: " + String(millis() / 1000) + "s\n";
+    status += "Uptime: " + String(MonotonicClock::nowMs() / 1000) + "s\n";
     status += "Memoria libre: " + String(ESP.getFreeHeap()) + " bytes\n";
     status += "\n";
     
     status += "=== Alimentación ===\n";
-    status += "Estado: " + feedingLogic.getStateString() + "\n";
+    status += "Estado: ";
+    status += feedingLogic.getStateString();
+    status += "\n";
     status += "Progreso: " + String(feedingLogic.getFeedingProgress(), 1) + "%\n";
+    status += "En cola: " + String(feedingLogic.getQueueDepth()) +
+              " (espera " + String(feedingLogic.getQueueWaitTime() / 1000) + " s)\n";
     status += "Automático: " + String(globalConfig.autoFeedingEnabled ? "Activado" : "Desactivado") + "\n";
-    status += "Alimentaciones hoy: " + String(globalConfig.feedingsToday) + "/" + String(globalConfig.portionsPerDay) + "\n";
+    status += "Alimentaciones hoy: " + String(feedingScheduler.getFeedingsTodayCount()) + "/" + String(globalConfig.portionsPerDay) + "\n";
     status += feedingScheduler.getScheduleStatus() + "\n";
     status += "\n";
     
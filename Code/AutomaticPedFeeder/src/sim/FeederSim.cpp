@@ -0,0 +1,467 @@
+#include "FeederSim.h"
+#include <chrono>
+#include "../hardware/PirSensor.h"
+#include "../utils/EventBus.h"
+#include "../utils/MonotonicClock.h"
+#include "../utils/PowerManager.h"
+#include "../utils/TimerQueue.h"
+#include "../utils/TimeUtils.h"
+
+FeederSim* FeederSim::active = nullptr;
+
+FeederSim::FeederSim()
+    : feeding(&stepper, &sensors),
+      scheduler(&feeding),
+      startTime(0),
+      days(1),
+      quiet(false),
+      startMs(0),
+      stats() {
+    memset(feedingsPerDay, 0, sizeof(feedingsPerDay));
+}
+
+// ========== GUION ==========
+
+bool FeederSim::loadScript(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "No se puede abrir %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    int number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        number++;
+        ok = parseLine(line, number);
+    }
+    fclose(file);
+
+    if (ok && startTime == 0) {
+        fprintf(stderr, "%s: falta 'inicio'\n", path);
+        ok = false;
+    }
+    return ok;
+}
+
+bool FeederSim::parseLine(char* line, int number) {
+    char* comment = strchr(line, '#');
+    if (comment) *comment = '\0';
+
+    char command[16];
+    int consumed;
+    if (sscanf(line, "%15s%n", command, &consumed) != 1) return true;  // Vacía
+    char* cursor = line + consumed;
+
+    bool ok = false;
+    if (strcmp(command, "inicio") == 0) {
+        struct tm local = {};
+        ok = sscanf(cursor, "%d-%d-%d %d:%d", &local.tm_year, &local.tm_mon, &local.tm_mday,
+                    &local.tm_hour, &local.tm_min) == 5;
+        local.tm_year -= 1900;
+        local.tm_mon -= 1;
+        local.tm_isdst = -1;
+        startTime = ok ? mktime(&local) : 0;
+    } else if (strcmp(command, "dias") == 0) {
+        ok = sscanf(cursor, "%d", &days) == 1 && days > 0 && days <= SIM_MAX_DAYS;
+    } else if (strcmp(command, "config") == 0) {
+        while (*cursor == ' ') cursor++;
+        configJson.push_back(String(cursor));
+        ok = true;
+    } else if (strcmp(command, "comprobar") == 0) {
+        char name[32], op[3];
+        long value;
+        ok = sscanf(cursor, "%31s %2s %ld", name, op, &value) == 3;
+        if (ok) checks.push_back({ String(name), String(op), value, number });
+    } else {
+        SimAction action = {};
+        ok = parseWhen(cursor, action.day, action.minuteOfDay);
+        if (!ok) {
+            // Sin hora válida no se sigue
+        } else if (strcmp(command, "presencia") == 0) {
+            action.type = SIM_PRESENCE;
+            ok = sscanf(cursor, "%f", &action.a) == 1 && action.a > 0;
+        } else if (strcmp(command, "dht") == 0) {
+            action.type = SIM_DHT;
+            ok = sscanf(cursor, "%f %f", &action.a, &action.b) == 2;
+        } else if (strcmp(command, "rellenar") == 0) {
+            action.type = SIM_REFILL;
+        } else if (strcmp(command, "alimentar") == 0) {
+            action.type = SIM_FEED;
+            action.a = 1;
+            sscanf(cursor, "%f", &action.a);
+        } else {
+            ok = false;
+        }
+        if (ok) actions.push_back(action);
+    }
+
+    if (!ok) fprintf(stderr, "Guion, línea %d: no se entiende '%s'\n", number, command);
+    return ok;
+}
+
+bool FeederSim::parseWhen(char*& cursor, int& day, int& minuteOfDay) {
+    int hour, minute, consumed;
+    day = 0;
+
+    while (*cursor == ' ') cursor++;
+    if (*cursor == 'd') {
+        if (sscanf(cursor, "d%d%n", &day, &consumed) != 1 || day < 1) return false;
+        cursor += consumed;
+    }
+    if (sscanf(cursor, "%d:%d%n", &hour, &minute, &consumed) != 2 ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+        return false;
+    }
+    cursor += consumed;
+    minuteOfDay = hour * 60 + minute;
+    return true;
+}
+
+void FeederSim::expandActions() {
+    steps.clear();
+    for (const SimAction& action : actions) {
+        for (int day = 0; day <= days; day++) {
+            if (action.day != 0 && action.day != day + 1) continue;
+
+            time_t at = localTime(day, action.minuteOfDay);
+            if (at < startTime) continue;
+
+            steps.push_back({ at, action.type, true, action.a, action.b });
+            if (action.type == SIM_PRESENCE) {
+                steps.push_back({ at + (time_t)action.a, action.type, false, 0, 0 });
+            }
+        }
+    }
+
+    // Mismo instante: en el orden del guion
+    std::stable_sort(steps.begin(), steps.end(),
+                     [](const SimStep& a, const SimStep& b) { return a.at < b.at; });
+}
+
+void FeederSim::apply(const SimStep& step) {
+    switch (step.type) {
+        case SIM_PRESENCE:
+            PirSensor::simulateLevel(step.on);
+            break;
+        case SIM_DHT:
+            simDhtTemperature = step.a;
+            simDhtHumidity = step.b;
+            break;
+        case SIM_REFILL:
+            feeding.getInventory().fillAll(DEFAULT_PORTION_GRAMS, (unsigned long)TimeUtils::now());
+            log("Rellenado");
+            break;
+        case SIM_FEED: {
+            FeedingRequestResult result = feeding.requestFeeding(FEEDING_SOURCE_WEB, (uint8_t)step.a);
+            log("Alimentación manual pedida (" + String((int)result) + ")");
+            break;
+        }
+    }
+}
+
+// ========== ARRANQUE Y BUCLE ==========
+
+void FeederSim::setup() {
+    active = this;
+    TimeUtils::init();
+    startMs = MonotonicClock::nowMs();
+    TimeUtils::setSimulatedTime(startTime);
+
+    // Configuración: NVS del simulador + campos del guion (ida y vuelta por
+    // ConfigManager, como tras guardar desde la web y reiniciar)
+    config = configManager.loadConfig();
+    for (const String& json : configJson) {
+        if (!configManager.jsonToConfig(json, config)) {
+            fprintf(stderr, "config no válida: %s\n", json.c_str());
+        }
+    }
+    configManager.saveConfig(config);
+    config = configManager.loadConfig();
+
+    // Programador antes que el hardware (como en setup())
+    scheduler.begin();
+    scheduler.setFeedingInterval(config.feedingIntervalHours);
+    scheduler.setFeedingSlots(config.feedingSlots);
+    scheduler.setMaxFeedingsPerDay(config.portionsPerDay);
+    scheduler.setPortionsPerFeeding(config.portionsPerFeeding);
+    scheduler.setEnabled(config.autoFeedingEnabled);
+    scheduler.setMissedFeedingPolicy(config.missedFeedingPolicy);
+    scheduler.restore(config.nextFeedingTime, config.lastFeedingTime,
+                      config.feedingsDay, config.feedingsToday, config.lastSlotKey);
+
+    eventBus.subscribe(EVENT_FEEDING_COMPLETE, onFeedingComplete);
+    eventBus.subscribe(EVENT_FEEDING_ERROR, onFeedingError);
+    eventBus.subscribe(EVENT_SCHEDULED_FEEDING, onScheduledFeeding);
+    eventBus.subscribe(EVENT_ENVIRONMENT_ALERT, onEnvironmentAlert);
+    eventBus.subscribe(EVENT_PRESENCE, onPresence);
+    eventBus.subscribe(EVENT_MOVEMENT_COMPLETE, onMovementComplete);
+    eventBus.subscribe(EVENT_MOTOR_ERROR, onMotorError);
+    eventBus.subscribe(EVENT_INVENTORY_CHANGED, onInventoryChanged);
+    eventBus.subscribe(EVENT_LOW_INVENTORY, onLowInventory);
+    eventBus.subscribe(EVENT_NEW_DAY, onNewDay);
+    eventBus.subscribe(EVENT_MISSED_FEEDINGS, onMissedFeedings);
+    eventBus.subscribe(EVENT_SCHEDULE_CHANGED, onScheduleChanged);
+
+    stepper.begin();
+    stepper.setHomeOffset(config.homeOffset);
+    stepper.setCompartmentOffsets(config.compartmentOffsets);
+    stepper.setCurrentCompartment(config.currentCompartment);
+    sensors.begin();
+
+    feeding.begin();
+    feeding.enableSound(config.soundBeforeFeeding);
+    feeding.requirePresence(config.requirePresenceDetection);
+    feeding.setMaxWaitTime(config.maxWaitTimeMs);
+    feeding.getInventory().load(config.inventory);
+
+    powerManager.addWakePin(PIR_PIN);
+    powerManager.begin();
+    expandActions();
+}
+
+int FeederSim::run() {
+    setup();
+
+    uint64_t endMs = msAt(startTime + (time_t)days * 86400);
+
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    size_t next = 0;
+
+    while (MonotonicClock::nowMs() < endMs) {
+        TimeUtils::setSimulatedTime(wallTime());
+        while (next < steps.size() && steps[next].at <= TimeUtils::now()) {
+            apply(steps[next++]);
+        }
+
+        uint64_t deadline = endMs;
+        if (next < steps.size()) deadline = min(deadline, msAt(steps[next].at));
+        loopOnce(deadline);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - wallStart;
+    report(elapsed.count());
+    return evaluateChecks();
+}
+
+void FeederSim::loopOnce(uint64_t deadlineMs) {
+    // Lo mismo que loop()
+    timerQueue.run();
+    sensors.update();
+    stepper.update();
+    feeding.update();
+    eventBus.dispatch();
+
+    deadlineMs = min(deadlineMs, timerQueue.getNextDeadline());
+    if (isIdle()) {
+        powerManager.idleUntil(deadlineMs);
+    } else if (StepTimer::isRunning()) {
+        StepTimer::advance(SIM_STEP_TICKS);
+    } else {
+        // Esperas de la alimentación (sonido, presencia, dispensado)
+        uint64_t now = MonotonicClock::nowMs();
+        uint64_t stepUs = SIM_BUSY_STEP_US;
+        if (deadlineMs > now && (deadlineMs - now) * 1000 < stepUs) stepUs = (deadlineMs - now) * 1000;
+        MonotonicClock::advance(stepUs > 0 ? stepUs : 1);
+    }
+}
+
+bool FeederSim::isIdle() {
+    // Como isSystemIdle() en main.cpp
+    return eventBus.getDepth() == 0 &&
+           !stepper.isMotorMoving() &&
+           !stepper.isCalibrating() &&
+           feeding.getState() == FEEDING_IDLE &&
+           feeding.getQueueDepth() == 0 &&
+           !sensors.isSoundPlaying();
+}
+
+// ========== TIEMPO ==========
+
+time_t FeederSim::wallTime() const {
+    return startTime + (time_t)((MonotonicClock::nowMs() - startMs) / 1000);
+}
+
+uint64_t FeederSim::msAt(time_t t) const {
+    return t <= startTime ? startMs : startMs + (uint64_t)(t - startTime) * 1000;
+}
+
+time_t FeederSim::localTime(int dayOffset, int minuteOfDay) const {
+    struct tm local;
+    localtime_r(&startTime, &local);
+
+    // mktime normaliza el fin de mes y el horario de verano
+    struct tm target = {};
+    target.tm_year = local.tm_year;
+    target.tm_mon = local.tm_mon;
+    target.tm_mday = local.tm_mday + dayOffset;
+    target.tm_hour = minuteOfDay / 60;
+    target.tm_min = minuteOfDay % 60;
+    target.tm_isdst = -1;
+    return mktime(&target);
+}
+
+int FeederSim::dayIndex(time_t t) const {
+    // Medianoches locales desde el arranque (los días de 23 o 25 h cuentan uno)
+    int day = (int)((t - localTime(0, 0)) / 86400);
+    while (day > 0 && localTime(day, 0) > t) day--;
+    while (localTime(day + 1, 0) <= t) day++;
+    return day;
+}
+
+// ========== RESULTADOS ==========
+
+void FeederSim::log(const String& text) {
+    if (quiet) return;
+
+    time_t now = TimeUtils::now();
+    struct tm local;
+    localtime_r(&now, &local);
+    printf("[d%02d %02d:%02d:%02d] %s\n", dayIndex(now) + 1,
+           local.tm_hour, local.tm_min, local.tm_sec, text.c_str());
+}
+
+void FeederSim::report(double seconds) {
+    double simulatedDays = (double)(MonotonicClock::nowMs() - startMs) / 86400000.0;
+
+    printf("\n=== Resumen (%d días) ===\n", days);
+    printf("Tomas: %u (fallidas %u, programadas %u, perdidas apagado %u)\n",
+           stats.feedings, stats.failures, stats.scheduled, stats.missed);
+    printf("Errores: %u | Alertas: %u | Inventario bajo: %u\n",
+           stats.errors, stats.alerts, stats.lowInventory);
+    printf("Movimientos: %u | Presencias: %u | Lecturas DHT: %u\n",
+           stats.moves, stats.presences, simDhtReads);
+    printf("Energía: %.2f%% en reposo, %.0f despertares/h, ~%.1f mA estimados\n",
+           powerManager.getIdleRatio() * 100, powerManager.getWakeupsPerHour(),
+           powerManager.getEstimatedCurrentMa());
+    printf("Rendimiento: %.1f días simulados en %.2f s (%.1f días/s)\n",
+           simulatedDays, seconds, seconds > 0 ? simulatedDays / seconds : 0.0);
+}
+
+long FeederSim::metric(const String& name, bool& found) const {
+    found = true;
+    if (name == "tomas") return stats.feedings;
+    if (name == "fallos") return stats.failures;
+    if (name == "programadas") return stats.scheduled;
+    if (name == "perdidas") return stats.missed;
+    if (name == "errores") return stats.errors;
+    if (name == "alertas") return stats.alerts;
+    if (name == "inventario_bajo") return stats.lowInventory;
+    if (name == "movimientos") return stats.moves;
+    if (name == "presencias") return stats.presences;
+
+    // Solo días completos (el primero empieza a la hora de 'inicio')
+    if (name == "tomas_dia_min" || name == "tomas_dia_max") {
+        bool wantMin = name == "tomas_dia_min";
+        long result = -1;
+        int first = startTime == localTime(0, 0) ? 0 : 1;
+        for (int day = first; day < days; day++) {
+            long count = feedingsPerDay[day];
+            if (result < 0 || (wantMin ? count < result : count > result)) result = count;
+        }
+        return result < 0 ? 0 : result;
+    }
+
+    found = false;
+    return 0;
+}
+
+int FeederSim::evaluateChecks() {
+    int failed = 0;
+    for (const SimCheck& check : checks) {
+        bool found;
+        long value = metric(check.metric, found);
+
+        bool pass = false;
+        if (check.op == "==") pass = value == check.value;
+        else if (check.op == "!=") pass = value != check.value;
+        else if (check.op == "<") pass = value < check.value;
+        else if (check.op == "<=") pass = value <= check.value;
+        else if (check.op == ">") pass = value > check.value;
+        else if (check.op == ">=") pass = value >= check.value;
+        pass = pass && found;
+
+        printf("%s línea %d: %s %s %ld (valor %s)\n", pass ? "OK   " : "FALLO", check.line,
+               check.metric.c_str(), check.op.c_str(), check.value,
+               found ? String(value).c_str() : "métrica desconocida");
+        if (!pass) failed++;
+    }
+    return failed;
+}
+
+// ========== SUSCRIPTORES ==========
+
+void FeederSim::onFeedingComplete(const Event& event) {
+    FeederSim* sim = active;
+    if (!event.success()) {
+        sim->stats.failures++;
+        sim->log("Alimentación fallida");
+        return;
+    }
+
+    sim->stats.feedings++;
+    int day = sim->dayIndex(TimeUtils::now());
+    if (day >= 0 && day <= SIM_MAX_DAYS) sim->feedingsPerDay[day]++;
+    sim->log("Alimentación completada");
+
+    sim->scheduler.recordFeeding();
+    sim->scheduler.copyTo(sim->config);
+    sim->config.lastFeedingTime = (unsigned long)TimeUtils::now();
+    sim->configManager.saveConfig(sim->config);
+}
+
+void FeederSim::onFeedingError(const Event& event) {
+    active->stats.errors++;
+    active->log("Error en alimentación: " + String(event.text));
+}
+
+void FeederSim::onScheduledFeeding(const Event& event) {
+    active->stats.scheduled++;
+    active->log("Toma programada (" + String(event.value) + " raciones)");
+}
+
+void FeederSim::onEnvironmentAlert(const Event& event) {
+    active->stats.alerts++;
+    active->log("Alerta ambiental: " + String(event.text));
+}
+
+void FeederSim::onPresence(const Event& /*event*/) {
+    active->stats.presences++;
+    active->log("Presencia detectada");
+}
+
+void FeederSim::onMovementComplete(const Event& /*event*/) {
+    active->stats.moves++;
+    active->log("Motor en compartimento " + String(active->stepper.getCurrentCompartment()));
+}
+
+void FeederSim::onMotorError(const Event& event) {
+    active->stats.errors++;
+    active->log("Error del motor: " + String(event.text));
+}
+
+void FeederSim::onInventoryChanged(const Event& /*event*/) {
+    active->feeding.getInventory().copyTo(active->config.inventory);
+    active->configManager.saveConfig(active->config);
+}
+
+void FeederSim::onLowInventory(const Event& event) {
+    active->stats.lowInventory++;
+    active->log("Inventario bajo: " + String(event.value) + " compartimento(s) con comida");
+}
+
+void FeederSim::onNewDay(const Event& /*event*/) {
+    active->scheduler.copyTo(active->config);
+    active->configManager.saveConfig(active->config);
+}
+
+void FeederSim::onMissedFeedings(const Event& event) {
+    active->stats.missed += event.value;
+    active->log("Tomas perdidas: " + String(event.value) + " (se recuperan " + String(event.detail) + ")");
+}
+
+void FeederSim::onScheduleChanged(const Event& /*event*/) {
+    active->scheduler.copyTo(active->config);
+    active->configManager.saveConfig(active->config);
+}
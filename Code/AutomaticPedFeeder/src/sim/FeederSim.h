@@ -0,0 +1,148 @@
+#ifndef FEEDER_SIM_H
+#define FEEDER_SIM_H
+
+#include <Arduino.h>
+#include <vector>
+#include "../config.h"
+#include "../feeding/FeedingLogic.h"
+#include "../feeding/FeedingScheduler.h"
+#include "../hardware/StepperController.h"
+#include "../hardware/SensorManager.h"
+#include "../storage/ConfigManager.h"
+
+#define SIM_STEP_TICKS 50         // Ticks del timer de pasos por pasada con el motor en marcha
+#define SIM_BUSY_STEP_US 10000    // Avance por pasada con algo en curso y el motor parado
+#define SIM_MAX_DAYS 366
+
+// Acciones del guion (se repiten cada día salvo que lleven día)
+enum SimActionType {
+    SIM_PRESENCE,  // a: segundos con el PIR activo
+    SIM_DHT,       // a: temperatura; b: humedad (desde esa hora)
+    SIM_REFILL,
+    SIM_FEED       // a: raciones (petición manual)
+};
+
+struct SimAction {
+    SimActionType type;
+    int day;          // 1 = primer día; 0 = todos
+    int minuteOfDay;
+    float a;
+    float b;
+};
+
+// Cambio puntual ya situado en el tiempo (las acciones desplegadas)
+struct SimStep {
+    time_t at;
+    SimActionType type;
+    bool on;          // PIR: flanco de subida o de bajada
+    float a;
+    float b;
+};
+
+struct SimCheck {
+    String metric;
+    String op;
+    long value;
+    int line;
+};
+
+// Métricas de la línea de tiempo (las que admite 'comprobar')
+struct SimStats {
+    uint32_t feedings;
+    uint32_t failures;
+    uint32_t errors;
+    uint32_t alerts;
+    uint32_t lowInventory;
+    uint32_t moves;
+    uint32_t scheduled;
+    uint32_t presences;
+    uint32_t missed;
+};
+
+// Comedero completo en el PC con reloj de eventos discretos: en reposo el
+// reloj salta al próximo plazo (timerQueue o guion) como haría el light
+// sleep; con el motor en marcha avanza tick a tick del timer de pasos.
+// Los módulos son los del firmware y se conectan como en setup(); la red,
+// la cámara y el logger no se simulan.
+//
+// Guion (una orden por línea, '#' comenta):
+//   inicio 2026-10-16 07:00        hora local de arranque
+//   dias 30                        duración
+//   config {"feedingSlots": "08:00, 20:00"}   campos de configToJson()
+//   presencia [dN] HH:MM segundos  el PIR se activa (cada día o el día N)
+//   dht [dN] HH:MM temp hum        lecturas desde esa hora
+//   rellenar [dN] HH:MM            llena todos los compartimentos
+//   alimentar [dN] HH:MM [raciones]
+//   comprobar métrica op valor     al final; op: == != < <= > >=
+class FeederSim {
+private:
+    StepperController stepper;
+    SensorManager sensors;
+    FeedingLogic feeding;
+    FeedingScheduler scheduler;
+    ConfigManager configManager;
+    FeederConfig config;
+
+    // Guion
+    time_t startTime;
+    int days;
+    std::vector<String> configJson;
+    std::vector<SimAction> actions;
+    std::vector<SimCheck> checks;
+    std::vector<SimStep> steps;
+
+    // Resultados
+    bool quiet;
+    uint64_t startMs;
+    SimStats stats;
+    uint16_t feedingsPerDay[SIM_MAX_DAYS + 1];
+
+    static FeederSim* active;  // Para los suscriptores de eventBus
+
+public:
+    FeederSim();
+
+    // false (con la línea en stderr) si el guion no se entiende
+    bool loadScript(const char* path);
+    void setQuiet(bool enable) { quiet = enable; }
+
+    // Simula el guion entero; devuelve las comprobaciones fallidas
+    int run();
+
+    const SimStats& getStats() const { return stats; }
+
+private:
+    void setup();
+    void loopOnce(uint64_t deadlineMs);
+    bool isIdle();
+    void expandActions();
+    void apply(const SimStep& step);
+    time_t wallTime() const;
+    uint64_t msAt(time_t t) const;
+    int dayIndex(time_t t) const;
+    time_t localTime(int dayOffset, int minuteOfDay) const;
+
+    void log(const String& text);
+    void report(double seconds);
+    long metric(const String& name, bool& found) const;
+    int evaluateChecks();
+
+    bool parseLine(char* line, int number);
+    static bool parseWhen(char*& cursor, int& day, int& minuteOfDay);
+
+    // Suscriptores (como los de main.cpp, sin Telegram)
+    static void onFeedingComplete(const Event& event);
+    static void onFeedingError(const Event& event);
+    static void onScheduledFeeding(const Event& event);
+    static void onEnvironmentAlert(const Event& event);
+    static void onPresence(const Event& event);
+    static void onMovementComplete(const Event& event);
+    static void onMotorError(const Event& event);
+    static void onInventoryChanged(const Event& event);
+    static void onLowInventory(const Event& event);
+    static void onNewDay(const Event& event);
+    static void onMissedFeedings(const Event& event);
+    static void onScheduleChanged(const Event& event);
+};
+
+#endif // FEEDER_SIM_H
@@ -0,0 +1,33 @@
+// Simulador del comedero con tiempo acelerado (env:native)
+//   pio run -e native && .pio/build/native/program src/sim/scenarios/month.txt [-q]
+// Devuelve el número de comprobaciones fallidas (0 = todo correcto)
+
+#include "FeederSim.h"
+
+// Las pruebas (pio test -e native) traen su propio main()
+#ifndef PIO_UNIT_TESTING
+
+int main(int argc, char** argv) {
+    const char* script = nullptr;
+    bool quiet = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) quiet = true;
+        else script = argv[i];
+    }
+
+    if (!script) {
+        fprintf(stderr, "Uso: %s <guion> [-q]\n", argv[0]);
+        return 2;
+    }
+
+    static FeederSim sim;
+    if (!sim.loadScript(script)) {
+        return 2;
+    }
+
+    sim.setQuiet(quiet);
+    return sim.run();
+}
+
+#endif
@@ -0,0 +1,16 @@
+#include <Arduino.h>
+#include "../../utils/MonotonicClock.h"
+
+// 32 bits como en el ESP32 (unsigned long es de 64 en el host): así la
+// vuelta de millis() también se da aquí
+unsigned long millis() {
+    return (uint32_t)MonotonicClock::nowMs();
+}
+
+unsigned long micros() {
+    return (uint32_t)MonotonicClock::nowUs();
+}
+
+void delay(unsigned long ms) {
+    MonotonicClock::advance((uint64_t)ms * 1000);
+}
@@ -0,0 +1,112 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// API de Arduino para el simulador nativo (env:native): lo justo para
+// compilar los módulos del comedero en el PC. Los pines son niveles en
+// memoria (el PIR va por PirSensor::simulateLevel()) y el tiempo es el
+// MonotonicClock simulado (delay() lo avanza)
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <ctime>
+#include <string>
+#include <algorithm>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+
+#define ARDUINO_ISR_ATTR
+#define IRAM_ATTR
+
+#define SIM_PIN_COUNT 64
+
+using std::min;
+using std::max;
+using std::isnan;
+
+template <class T, class L, class H>
+T constrain(T value, L low, H high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+// Tiempo (MonotonicClock simulado)
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+inline void yield() {}
+
+// Pines: el simulador escribe las entradas con simSetPin()
+inline int simPinLevels[SIM_PIN_COUNT];
+
+inline void pinMode(int pin, int mode) {
+    if (pin >= 0 && pin < SIM_PIN_COUNT && mode == INPUT_PULLUP) simPinLevels[pin] = HIGH;
+}
+inline void digitalWrite(int pin, int level) {
+    if (pin >= 0 && pin < SIM_PIN_COUNT) simPinLevels[pin] = level;
+}
+inline int digitalRead(int pin) {
+    return pin >= 0 && pin < SIM_PIN_COUNT ? simPinLevels[pin] : LOW;
+}
+inline void simSetPin(int pin, int level) { digitalWrite(pin, level); }
+
+// String de Arduino sobre std::string (también la usa ArduinoJson con
+// ARDUINOJSON_ENABLE_ARDUINO_STRING)
+class String : public std::string {
+public:
+    String() {}
+    String(const char* text) : std::string(text ? text : "") {}
+    String(const char* text, size_t length) : std::string(text ? text : "", text ? length : 0) {}
+    String(const std::string& text) : std::string(text) {}
+    String(char c) : std::string(1, c) {}
+    String(int value) : std::string(std::to_string(value)) {}
+    String(unsigned int value) : std::string(std::to_string(value)) {}
+    String(long value) : std::string(std::to_string(value)) {}
+    String(unsigned long value) : std::string(std::to_string(value)) {}
+    String(long long value) : std::string(std::to_string(value)) {}
+    String(unsigned long long value) : std::string(std::to_string(value)) {}
+    String(double value, int decimals = 2) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+        assign(buffer);
+    }
+    String(bool value) : std::string(value ? "1" : "0") {}
+
+    String& operator=(const char* text) {
+        assign(text ? text : "");
+        return *this;
+    }
+
+    unsigned int length() const { return (unsigned int)size(); }
+    const char* c_str() const { return std::string::c_str(); }
+    bool concat(const char* text) { if (text) append(text); return true; }
+    bool concat(char c) { push_back(c); return true; }
+
+    String operator+(const String& other) const { return String(std::string(*this) + std::string(other)); }
+    String operator+(const char* other) const { return String(std::string(*this) + other); }
+    friend String operator+(const char* a, const String& b) { return String(std::string(a) + std::string(b)); }
+};
+
+class StringSumHelper : public String {};
+
+// Serie: a la salida estándar
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+    template <class T> void print(const T& value) { fputs(String(value).c_str(), stdout); }
+    template <class T> void println(const T& value) { print(value); fputc('\n', stdout); }
+    void println() { fputc('\n', stdout); }
+    template <class... Args> void printf(const char* format, Args... args) { ::printf(format, args...); }
+};
+
+inline HardwareSerial Serial;
+
+#endif // SIM_ARDUINO_H
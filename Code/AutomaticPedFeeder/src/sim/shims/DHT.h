@@ -0,0 +1,26 @@
+#ifndef SIM_DHT_H
+#define SIM_DHT_H
+
+#include <Arduino.h>
+
+#define DHT11 11
+#define DHT22 22
+
+// Lecturas que fija el guion del simulador (NAN = fallo del sensor)
+inline float simDhtTemperature = 22.0f;
+inline float simDhtHumidity = 50.0f;
+inline uint32_t simDhtReads = 0;
+
+class DHT {
+public:
+    DHT(uint8_t /*pin*/, uint8_t /*type*/) {}
+    void begin() {}
+    bool read(bool /*force*/ = false) {
+        simDhtReads++;
+        return !isnan(simDhtTemperature) && !isnan(simDhtHumidity);
+    }
+    float readTemperature(bool /*fahrenheit*/ = false, bool /*force*/ = false) { return simDhtTemperature; }
+    float readHumidity(bool /*force*/ = false) { return simDhtHumidity; }
+};
+
+#endif // SIM_DHT_H
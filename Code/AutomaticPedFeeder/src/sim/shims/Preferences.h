@@ -0,0 +1,79 @@
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+
+// NVS en memoria: los valores se guardan como texto por espacio de nombres
+// y duran lo que el proceso (sobreviven a reinicios simulados)
+class Preferences {
+private:
+    typedef std::map<std::string, std::string> Namespace;
+    Namespace* store = nullptr;
+    bool readOnly = false;
+
+    static std::map<std::string, Namespace>& storage() {
+        static std::map<std::string, Namespace> namespaces;
+        return namespaces;
+    }
+
+    size_t put(const char* key, const std::string& value) {
+        if (!store || readOnly) return 0;
+        (*store)[key] = value;
+        return value.size() ? value.size() : 1;
+    }
+
+    const std::string* find(const char* key) const {
+        if (!store) return nullptr;
+        Namespace::const_iterator it = store->find(key);
+        return it == store->end() ? nullptr : &it->second;
+    }
+
+    template <class T>
+    T get(const char* key, T defaultValue, T (*parse)(const char*)) const {
+        const std::string* value = find(key);
+        return value ? parse(value->c_str()) : defaultValue;
+    }
+
+    static int32_t parseInt(const char* text) { return (int32_t)strtol(text, nullptr, 10); }
+    static uint32_t parseUInt(const char* text) { return (uint32_t)strtoul(text, nullptr, 10); }
+    static float parseFloat(const char* text) { return strtof(text, nullptr); }
+    static bool parseBool(const char* text) { return text[0] == '1'; }
+
+public:
+    bool begin(const char* name, bool readOnlyMode = false) {
+        store = &storage()[name];
+        readOnly = readOnlyMode;
+        return true;
+    }
+    void end() { store = nullptr; }
+
+    bool clear() {
+        if (!store || readOnly) return false;
+        store->clear();
+        return true;
+    }
+    bool remove(const char* key) { return store && !readOnly && store->erase(key) > 0; }
+    bool isKey(const char* key) const { return find(key) != nullptr; }
+
+    size_t putInt(const char* key, int32_t value) { return put(key, std::to_string(value)); }
+    size_t putUInt(const char* key, uint32_t value) { return put(key, std::to_string(value)); }
+    size_t putLong(const char* key, int32_t value) { return put(key, std::to_string(value)); }
+    size_t putULong(const char* key, uint32_t value) { return put(key, std::to_string(value)); }
+    size_t putFloat(const char* key, float value) { return put(key, String((double)value, 6)); }
+    size_t putBool(const char* key, bool value) { return put(key, value ? "1" : "0"); }
+    size_t putString(const char* key, const String& value) { return put(key, value); }
+
+    int32_t getInt(const char* key, int32_t defaultValue = 0) const { return get(key, defaultValue, parseInt); }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) const { return get(key, defaultValue, parseUInt); }
+    int32_t getLong(const char* key, int32_t defaultValue = 0) const { return get(key, defaultValue, parseInt); }
+    uint32_t getULong(const char* key, uint32_t defaultValue = 0) const { return get(key, defaultValue, parseUInt); }
+    float getFloat(const char* key, float defaultValue = 0) const { return get(key, defaultValue, parseFloat); }
+    bool getBool(const char* key, bool defaultValue = false) const { return get(key, defaultValue, parseBool); }
+    String getString(const char* key, const String& defaultValue = String()) const {
+        const std::string* value = find(key);
+        return value ? String(*value) : defaultValue;
+    }
+};
+
+#endif // SIM_PREFERENCES_H
@@ -0,0 +1,7 @@
+#ifndef SIM_CREDENTIALS_H
+#define SIM_CREDENTIALS_H
+
+// El simulador no usa la red: sin src/credentials.h valen los de ejemplo
+#include "../../credentials.example.h"
+
+#endif // SIM_CREDENTIALS_H
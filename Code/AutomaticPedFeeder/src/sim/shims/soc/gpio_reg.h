@@ -0,0 +1,52 @@
+#ifndef SIM_SOC_GPIO_REG_H
+#define SIM_SOC_GPIO_REG_H
+
+// Registros de GPIO del ESP32-S3 para el simulador nativo: mismas
+// direcciones que en el SDK, pero REG_WRITE/REG_READ van a simPinLevels.
+// W1TS/W1TC ponen y quitan los bits marcados de OUT (GPIO 0-31) y OUT1
+// (GPIO 32+); IN/IN1 devuelven los niveles actuales
+
+#include <Arduino.h>
+
+#define DR_REG_GPIO_BASE   0x60004000
+#define GPIO_OUT_REG       (DR_REG_GPIO_BASE + 0x0004)
+#define GPIO_OUT_W1TS_REG  (DR_REG_GPIO_BASE + 0x0008)
+#define GPIO_OUT_W1TC_REG  (DR_REG_GPIO_BASE + 0x000C)
+#define GPIO_OUT1_REG      (DR_REG_GPIO_BASE + 0x0010)
+#define GPIO_OUT1_W1TS_REG (DR_REG_GPIO_BASE + 0x0014)
+#define GPIO_OUT1_W1TC_REG (DR_REG_GPIO_BASE + 0x0018)
+#define GPIO_IN_REG        (DR_REG_GPIO_BASE + 0x003C)
+#define GPIO_IN1_REG       (DR_REG_GPIO_BASE + 0x0040)
+
+// Última escritura y total (para comprobar el registro y la máscara)
+inline uint32_t simRegLastAddress = 0;
+inline uint32_t simRegLastValue = 0;
+inline uint32_t simRegWrites = 0;
+
+inline uint32_t simRegRead(uint32_t address) {
+    int first = address == GPIO_IN1_REG || address == GPIO_OUT1_REG ? 32 : 0;
+    uint32_t value = 0;
+    for (int bit = 0; bit < 32 && first + bit < SIM_PIN_COUNT; bit++) {
+        if (simPinLevels[first + bit]) value |= 1UL << bit;
+    }
+    return value;
+}
+
+inline void simRegWrite(uint32_t address, uint32_t value) {
+    simRegLastAddress = address;
+    simRegLastValue = value;
+    simRegWrites++;
+
+    int first = address == GPIO_OUT1_W1TS_REG || address == GPIO_OUT1_W1TC_REG ? 32 : 0;
+    bool set = address == GPIO_OUT_W1TS_REG || address == GPIO_OUT1_W1TS_REG;
+    bool clear = address == GPIO_OUT_W1TC_REG || address == GPIO_OUT1_W1TC_REG;
+    if (!set && !clear) return;
+    for (uint32_t bits = value; bits; bits &= bits - 1) {
+        simPinLevels[first + __builtin_ctz(bits)] = set ? HIGH : LOW;
+    }
+}
+
+#define REG_READ(address) simRegRead(address)
+#define REG_WRITE(address, value) simRegWrite((address), (value))
+
+#endif // SIM_SOC_GPIO_REG_H
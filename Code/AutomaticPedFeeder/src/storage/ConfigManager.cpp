@@ -13,8 +13,11 @@ FeederConfig ConfigManager::loadConfig() {
     FeederConfig config = getDefaultConfig();
     
     config.feedingIntervalHours = getInt("feedInterval", DEFAULT_FEEDING_INTERVAL_HOURS);
+    config.feedingSlots = getString("feedSlots", DEFAULT_FEEDING_SLOTS);
     config.portionsPerDay = getInt("portionsDay", DEFAULT_PORTIONS_PER_DAY);
+    config.portionsPerFeeding = getInt("portionsFeed", DEFAULT_PORTIONS_PER_FEEDING);
     config.autoFeedingEnabled = getBool("autoEnabled", true);
+    config.missedFeedingPolicy = getInt("missedPolicy", DEFAULT_MISSED_FEEDING_POLICY);
     
     config.requirePresenceDetection = getBool("reqPresence", true);
     config.soundBeforeFeeding = getBool("soundBefore", true);
@@ -33,10 +36,24 @@ FeederConfig ConfigManager::loadConfig() {
     config.cameraEnabled = getBool("camEnabled", true);
     config.cameraQuality = getInt("camQuality", 10);
     
+    config.homeOffset = getLong("homeOffset", HOME_SENSOR_OFFSET_STEPS);
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        config.compartmentOffsets[i] = getInt(("compOff" + String(i)).c_str(), 0);
+    }
+    
+    // Sin inventario guardado se supone todo lleno (comportamiento anterior)
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        config.inventory[i].filled = getBool(("invFill" + String(i)).c_str(), true);
+        config.inventory[i].filledAt = getULong(("invTime" + String(i)).c_str(), 0);
+        config.inventory[i].portionGrams = getInt(("invGrams" + String(i)).c_str(), DEFAULT_PORTION_GRAMS);
+    }
+    
     config.currentCompartment = getInt("curCompart", 0);
     config.feedingsToday = getInt("feedToday", 0);
+    config.feedingsDay = getInt("feedDay", 0);
     config.lastFeedingTime = getULong("lastFeedTime", 0);
     config.nextFeedingTime = getULong("nextFeedTime", 0);
+    config.lastSlotKey = getInt("lastSlot", 0);
     
     preferences.end();
     
@@ -47,8 +64,11 @@ bool ConfigManager::saveConfig(const FeederConfig& config) {
     begin();
     
     saveInt("feedInterval", config.feedingIntervalHours);
+    saveString("feedSlots", config.feedingSlots);
     saveInt("portionsDay", config.portionsPerDay);
+    saveInt("portionsFeed", config.portionsPerFeeding);
     saveBool("autoEnabled", config.autoFeedingEnabled);
+    saveInt("missedPolicy", config.missedFeedingPolicy);
     
     saveBool("reqPresence", config.requirePresenceDetection);
     saveBool("soundBefore", config.soundBeforeFeeding);
@@ -66,10 +86,23 @@ bool ConfigManager::saveConfig(const FeederConfig& config) {
     saveBool("camEnabled", config.cameraEnabled);
     saveInt("camQuality", config.cameraQuality);
     
+    saveLong("homeOffset", config.homeOffset);
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        saveInt(("compOff" + String(i)).c_str(), config.compartmentOffsets[i]);
+    }
+    
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        saveBool(("invFill" + String(i)).c_str(), config.inventory[i].filled);
+        saveULong(("invTime" + String(i)).c_str(), config.inventory[i].filledAt);
+        saveInt(("invGrams" + String(i)).c_str(), config.inventory[i].portionGrams);
+    }
+    
     saveInt("curCompart", config.currentCompartment);
     saveInt("feedToday", config.feedingsToday);
+    saveInt("feedDay", config.feedingsDay);
     saveULong("lastFeedTime", config.lastFeedingTime);
     saveULong("nextFeedTime", config.nextFeedingTime);
+    saveInt("lastSlot", config.lastSlotKey);
     
     preferences.end();
     
@@ -137,8 +170,11 @@ FeederConfig ConfigManager::getDefaultConfig() {
     FeederConfig config;
     
     config.feedingIntervalHours = DEFAULT_FEEDING_INTERVAL_HOURS;
+    config.feedingSlots = DEFAULT_FEEDING_SLOTS;
     config.portionsPerDay = DEFAULT_PORTIONS_PER_DAY;
+    config.portionsPerFeeding = DEFAULT_PORTIONS_PER_FEEDING;
     config.autoFeedingEnabled = true;
+    config.missedFeedingPolicy = DEFAULT_MISSED_FEEDING_POLICY;
     
     config.requirePresenceDetection = true;
     config.soundBeforeFeeding = true;
@@ -157,10 +193,21 @@ FeederConfig ConfigManager::getDefaultConfig() {
     config.cameraEnabled = true;
     config.cameraQuality = 10;
     
+    config.homeOffset = HOME_SENSOR_OFFSET_STEPS;
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        config.compartmentOffsets[i] = 0;
+    }
+    
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        config.inventory[i] = { true, 0, DEFAULT_PORTION_GRAMS };
+    }
+    
     config.currentCompartment = 0;
     config.feedingsToday = 0;
+    config.feedingsDay = 0;
     config.lastFeedingTime = 0;
     config.nextFeedingTime = 0;
+    config.lastSlotKey = 0;
     
     return config;
 }
@@ -182,8 +229,11 @@ String ConfigManager::configToJson(const FeederConfig& config) {
     JsonDocument doc;
     
     doc["feedingIntervalHours"] = config.feedingIntervalHours;
+    doc["feedingSlots"] = config.feedingSlots;
     doc["portionsPerDay"] = config.portionsPerDay;
+    doc["portionsPerFeeding"] = config.portionsPerFeeding;
     doc["autoFeedingEnabled"] = config.autoFeedingEnabled;
+    doc["missedFeedingPolicy"] = config.missedFeedingPolicy;
     doc["requirePresenceDetection"] = config.requirePresenceDetection;
     doc["soundBeforeFeeding"] = config.soundBeforeFeeding;
     doc["maxWaitTimeMs"] = config.maxWaitTimeMs;
@@ -203,17 +253,23 @@ bool ConfigManager::jsonToConfig(const String& json, FeederConfig& config) {
         return false;
     }
     
-    if (doc.containsKey("feedingIntervalHours"))
+    if (doc["feedingIntervalHours"].is<int>())
         config.feedingIntervalHours = doc["feedingIntervalHours"];
-    if (doc.containsKey("portionsPerDay"))
+    if (doc["feedingSlots"].is<const char*>())
+        config.feedingSlots = doc["feedingSlots"].as<String>();
+    if (doc["portionsPerDay"].is<int>())
         config.portionsPerDay = doc["portionsPerDay"];
-    if (doc.containsKey("autoFeedingEnabled"))
+    if (doc["portionsPerFeeding"].is<int>())
+        config.portionsPerFeeding = doc["portionsPerFeeding"];
+    if (doc["autoFeedingEnabled"].is<bool>())
         config.autoFeedingEnabled = doc["autoFeedingEnabled"];
-    if (doc.containsKey("requirePresenceDetection"))
+    if (doc["missedFeedingPolicy"].is<int>())
+        config.missedFeedingPolicy = doc["missedFeedingPolicy"];
+    if (doc["requirePresenceDetection"].is<bool>())
         config.requirePresenceDetection = doc["requirePresenceDetection"];
-    if (doc.containsKey("soundBeforeFeeding"))
+    if (doc["soundBeforeFeeding"].is<bool>())
         config.soundBeforeFeeding = doc["soundBeforeFeeding"];
-    if (doc.containsKey("maxWaitTimeMs"))
+    if (doc["maxWaitTimeMs"].is<int>())
         config.maxWaitTimeMs = doc["maxWaitTimeMs"];
     
     return true;
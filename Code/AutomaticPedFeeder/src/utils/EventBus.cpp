@@ -0,0 +1,103 @@
+#include "EventBus.h"
+#include "PowerManager.h"
+
+EventBus eventBus;
+
+#ifdef ARDUINO_ARCH_ESP32
+static portMUX_TYPE queueLock = portMUX_INITIALIZER_UNLOCKED;
+#define QUEUE_LOCK() portENTER_CRITICAL(&queueLock)
+#define QUEUE_UNLOCK() portEXIT_CRITICAL(&queueLock)
+#else
+#define QUEUE_LOCK()
+#define QUEUE_UNLOCK()
+#endif
+
+EventBus::EventBus()
+    : subscriberCount(0),
+      queueHead(0),
+      queueTail(0),
+      queueDepth(0),
+      highWaterMark(0),
+      published(0),
+      dropped(0) {
+}
+
+bool EventBus::subscribe(EventType type, EventHandler handler) {
+    if (!handler || type >= EVENT_TYPE_COUNT || subscriberCount >= EVENT_MAX_SUBSCRIBERS) {
+        return false;
+    }
+
+    subscribers[subscriberCount++] = { type, handler };
+    return true;
+}
+
+bool EventBus::publish(EventType type, int32_t value, int32_t detail) {
+    Event event;
+    event.type = type;
+    event.timestamp = MonotonicClock::nowMs();
+    event.value = value;
+    event.detail = detail;
+    event.text[0] = '\0';
+    return enqueue(event);
+}
+
+bool EventBus::publish(EventType type, const String& text, int32_t value) {
+    Event event;
+    event.type = type;
+    event.timestamp = MonotonicClock::nowMs();
+    event.value = value;
+    event.detail = 0;
+    strncpy(event.text, text.c_str(), EVENT_TEXT_SIZE - 1);
+    event.text[EVENT_TEXT_SIZE - 1] = '\0';
+    return enqueue(event);
+}
+
+void EventBus::dispatch() {
+    // Lo que publiquen los suscriptores espera a la siguiente pasada
+    uint8_t pending = queueDepth;
+    Event event;
+
+    while (pending-- > 0 && dequeue(event)) {
+        for (uint8_t i = 0; i < subscriberCount; i++) {
+            if (subscribers[i].type == event.type) {
+                subscribers[i].handler(event);
+            }
+        }
+    }
+}
+
+bool EventBus::enqueue(const Event& event) {
+    bool queued = false;
+
+    QUEUE_LOCK();
+    published++;
+    if (queueDepth < EVENT_QUEUE_SIZE) {
+        queue[queueHead] = event;
+        queueHead = (queueHead + 1) % EVENT_QUEUE_SIZE;
+        queueDepth++;
+        if (queueDepth > highWaterMark) highWaterMark = queueDepth;
+        queued = true;
+    } else {
+        dropped++;
+    }
+    QUEUE_UNLOCK();
+
+    // Si loop() está en reposo, que entregue el evento ya
+    if (queued) powerManager.wake();
+    return queued;
+}
+
+bool EventBus::dequeue(Event& event) {
+    bool available = false;
+
+    QUEUE_LOCK();
+    if (queueDepth > 0) {
+        event = queue[queueTail];
+        queueTail = (queueTail + 1) % EVENT_QUEUE_SIZE;
+        queueDepth--;
+        available = true;
+    }
+    QUEUE_UNLOCK();
+
+    return available;
+}
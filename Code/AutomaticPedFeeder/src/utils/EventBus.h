@@ -0,0 +1,97 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <Arduino.h>
+#include "MonotonicClock.h"
+
+#define EVENT_QUEUE_SIZE 16       // Eventos pendientes de entregar
+#define EVENT_MAX_SUBSCRIBERS 16  // Suscripciones en total
+#define EVENT_TEXT_SIZE 64        // Mensajes de error y alertas (se truncan)
+
+enum EventType : uint8_t {
+    EVENT_FEEDING_COMPLETE,      // value: 1 = éxito
+    EVENT_FEEDING_ERROR,         // text: motivo
+    EVENT_FEEDING_STATE,         // value: FeedingState nuevo
+    EVENT_SCHEDULED_FEEDING,     // value: raciones pedidas
+    EVENT_PRESENCE,
+    EVENT_ENVIRONMENT_ALERT,     // text: mensaje de la alerta
+    EVENT_MOVEMENT_COMPLETE,
+    EVENT_MOTOR_ERROR,           // text: motivo
+    EVENT_COMMAND_COMPLETE,      // value: índice de la orden; detail: MotionCommandType
+    EVENT_CALIBRATION_COMPLETE,  // value: 1 = éxito
+    EVENT_INVENTORY_CHANGED,     // value: compartimentos llenos
+    EVENT_INVENTORY_EDIT,        // value: compartimento (-1 = todos); detail: gramos (> 0 rellenar, <= 0 vaciar con -detail g de ración, 0 = sin cambiarla)
+    EVENT_LOW_INVENTORY,         // value: compartimentos llenos
+    EVENT_TIME_SYNC,             // value: hora Unix tras sincronizar (NTP)
+    EVENT_NEW_DAY,               // value: día del mes
+    EVENT_MISSED_FEEDINGS,       // value: tomas perdidas apagado; detail: las que se recuperan
+    EVENT_SCHEDULE_CHANGED,      // Próxima toma o día a guardar (FeedingScheduler::copyTo)
+    EVENT_TYPE_COUNT
+};
+
+// Copia autocontenida: se entrega después, cuando el emisor ya ha seguido
+struct Event {
+    EventType type;
+    uint64_t timestamp;  // MonotonicClock::nowMs() al publicar
+    int32_t value;
+    int32_t detail;
+    char text[EVENT_TEXT_SIZE];
+
+    bool success() const { return value != 0; }
+};
+
+typedef void (*EventHandler)(const Event&);
+
+// Publicación/suscripción con entrega diferida. Los módulos solo encolan
+// (sin reservar memoria) y loop() entrega la cola con dispatch() al final
+// de la pasada, así que un suscriptor lento (Telegram, NVS) nunca corre
+// dentro del update() que generó el evento. Se puede publicar desde otras
+// tareas (servidor web asíncrono); la entrega siempre es en loop().
+class EventBus {
+private:
+    struct Subscription {
+        EventType type;
+        EventHandler handler;
+    };
+
+    Subscription subscribers[EVENT_MAX_SUBSCRIBERS];
+    uint8_t subscriberCount;
+
+    Event queue[EVENT_QUEUE_SIZE];
+    uint8_t queueHead;
+    uint8_t queueTail;
+    volatile uint8_t queueDepth;
+
+    // Estadísticas
+    uint8_t highWaterMark;
+    uint32_t published;
+    uint32_t dropped;
+
+public:
+    EventBus();
+
+    // Suscripción (varias por tipo; se entregan en orden de suscripción)
+    bool subscribe(EventType type, EventHandler handler);
+
+    // Publicación: false si la cola está llena (el evento se descarta)
+    bool publish(EventType type, int32_t value = 0, int32_t detail = 0);
+    bool publish(EventType type, const String& text, int32_t value = 0);
+
+    // Entrega los eventos pendientes al empezar la llamada
+    void dispatch();
+
+    // Estado
+    uint8_t getDepth() const { return queueDepth; }
+    uint8_t getHighWaterMark() const { return highWaterMark; }
+    uint32_t getPublishedCount() const { return published; }
+    uint32_t getDroppedCount() const { return dropped; }
+    void resetHighWaterMark() { highWaterMark = queueDepth; }
+
+private:
+    bool enqueue(const Event& event);
+    bool dequeue(Event& event);
+};
+
+extern EventBus eventBus;
+
+#endif // EVENT_BUS_H
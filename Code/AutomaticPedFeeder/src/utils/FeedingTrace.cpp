@@ -0,0 +1,77 @@
+#include "FeedingTrace.h"
+
+FeedingTrace feedingTrace;
+
+#ifdef ARDUINO_ARCH_ESP32
+static portMUX_TYPE traceLock = portMUX_INITIALIZER_UNLOCKED;
+#define TRACE_LOCK() portENTER_CRITICAL(&traceLock)
+#define TRACE_UNLOCK() portEXIT_CRITICAL(&traceLock)
+#else
+#define TRACE_LOCK()
+#define TRACE_UNLOCK()
+#endif
+
+FeedingTrace::FeedingTrace()
+    : head(0),
+      count(0),
+      total(0) {
+}
+
+void FeedingTrace::record(const TraceRecord& entry) {
+    TRACE_LOCK();
+    records[head] = entry;
+    head = (head + 1) % TRACE_CAPACITY;
+    if (count < TRACE_CAPACITY) count++;
+    total++;
+    TRACE_UNLOCK();
+}
+
+void FeedingTrace::clear() {
+    TRACE_LOCK();
+    head = 0;
+    count = 0;
+    TRACE_UNLOCK();
+}
+
+uint16_t FeedingTrace::snapshot(TraceRecord* out, uint16_t maxRecords) const {
+    TRACE_LOCK();
+    uint16_t copied = count < maxRecords ? count : maxRecords;
+    // Los más recientes si no caben todos
+    uint16_t first = (head + TRACE_CAPACITY - copied) % TRACE_CAPACITY;
+    for (uint16_t i = 0; i < copied; i++) {
+        out[i] = records[(first + i) % TRACE_CAPACITY];
+    }
+    TRACE_UNLOCK();
+
+    return copied;
+}
+
+#ifndef ARDUINO_ARCH_ESP32
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+uint16_t FeedingTrace::parseHex(const char* hex, TraceRecord* out, uint16_t maxRecords) {
+    uint8_t* bytes = (uint8_t*)out;
+    size_t capacity = (size_t)maxRecords * sizeof(TraceRecord);
+    size_t length = 0;
+
+    // Se ignora todo lo que no sea un dígito hexadecimal (saltos de línea, espacios)
+    int high = -1;
+    for (const char* c = hex; *c && length < capacity; c++) {
+        int digit = hexDigit(*c);
+        if (digit < 0) continue;
+        if (high < 0) {
+            high = digit;
+        } else {
+            bytes[length++] = (high << 4) | digit;
+            high = -1;
+        }
+    }
+
+    return length / sizeof(TraceRecord);
+}
+#endif
@@ -0,0 +1,74 @@
+#ifndef FEEDING_TRACE_H
+#define FEEDING_TRACE_H
+
+#include <Arduino.h>
+
+#define TRACE_CAPACITY 128  // Registros en RAM (16 bytes cada uno)
+
+enum TraceSource : uint8_t {
+    TRACE_SOURCE_FEEDING,  // state/next: FeedingState; event: FeedingEvent
+    TRACE_SOURCE_MOTOR     // state/next: MotorState; event: MotorTraceEvent
+};
+
+// Instantánea de entradas en flags
+#define TRACE_FLAG_PRESENCE        0x01  // PIR activo
+#define TRACE_FLAG_SOUND_ENABLED   0x02  // Guarda isSoundEnabled
+#define TRACE_FLAG_PRESENCE_NEEDED 0x04  // Guarda isPresenceNeeded
+#define TRACE_FLAG_DISPENSE_QUEUED 0x08  // Secuencia de dispensado lanzada
+#define TRACE_FLAG_MOTOR_MOVING    0x10
+#define TRACE_FLAG_JAMMED          0x20
+#define TRACE_FLAG_HOME_SENSOR     0x40  // Sensor de origen activo
+#define TRACE_FLAG_RECOVERING      0x80  // Recuperación de atasco en curso
+
+#define TRACE_NO_TEMPERATURE INT8_MIN
+#define TRACE_NO_HUMIDITY 0xFF
+
+// Registro binario compacto; el volcado binario es este struct tal cual
+// (little-endian), del más antiguo al más reciente
+struct TraceRecord {
+    uint32_t timestamp;   // MonotonicClock::nowMs() truncado a 32 bits
+    int32_t value;        // Alimentación: ms en el estado de origen; motor: posición (micropasos)
+    uint8_t source;       // TraceSource
+    uint8_t state;        // Estado de origen
+    uint8_t event;
+    uint8_t next;         // Estado de destino
+    int8_t compartment;
+    uint8_t flags;        // TRACE_FLAG_*
+    int8_t temperature;   // °C redondeados
+    uint8_t humidity;     // %
+};
+
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord debe ocupar 16 bytes");
+
+// Búfer circular en RAM con el historial reciente de la máquina de
+// alimentación y del motor. Registrar es copiar 16 bytes bajo un cerrojo
+// breve: no reserva memoria y se puede llamar desde cualquier tarea.
+class FeedingTrace {
+private:
+    TraceRecord records[TRACE_CAPACITY];
+    uint16_t head;        // Siguiente posición a escribir
+    uint16_t count;
+    uint32_t total;       // Registros desde el arranque (incluye sobrescritos)
+
+public:
+    FeedingTrace();
+
+    void record(const TraceRecord& entry);
+    void clear();
+
+    // Copia los registros, del más antiguo al más reciente
+    uint16_t snapshot(TraceRecord* out, uint16_t maxRecords) const;
+
+    uint16_t size() const { return count; }
+    uint32_t getTotalRecorded() const { return total; }
+
+#ifndef ARDUINO_ARCH_ESP32
+    // Carga un volcado de /api/feeding/trace?format=hex para reproducirlo
+    // con FeedingLogic::replay() (ESP32 y PC son little-endian)
+    static uint16_t parseHex(const char* hex, TraceRecord* out, uint16_t maxRecords);
+#endif
+};
+
+extern FeedingTrace feedingTrace;
+
+#endif // FEEDING_TRACE_H
@@ -1,4 +1,5 @@
 #include "Logger.h"
+#include "MonotonicClock.h"
 
 Logger::Logger() 
     : currentLevel((LogLevel)LOG_LEVEL),
@@ -55,8 +56,7 @@ String Logger::getLevelString(LogLevel level) {
 }
 
 String Logger::getTimestamp() {
-    unsigned long ms = millis();
-    unsigned long seconds = ms / 1000;
+    unsigned long seconds = (unsigned long)(MonotonicClock::nowMs() / 1000);
     unsigned long minutes = seconds / 60;
     unsigned long hours = minutes / 60;
     
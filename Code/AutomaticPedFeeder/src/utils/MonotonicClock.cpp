@@ -0,0 +1,27 @@
+#include "MonotonicClock.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <esp_timer.h>
+
+uint64_t ARDUINO_ISR_ATTR MonotonicClock::nowUs() {
+    return esp_timer_get_time();
+}
+
+#else  // Sustituto para compilación nativa
+
+static uint64_t simulatedMicros = 0;
+
+uint64_t MonotonicClock::nowUs() {
+    return simulatedMicros;
+}
+
+void MonotonicClock::set(uint64_t us) {
+    simulatedMicros = us;
+}
+
+void MonotonicClock::advance(uint64_t us) {
+    simulatedMicros += us;
+}
+
+#endif
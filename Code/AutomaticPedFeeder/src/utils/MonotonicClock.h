@@ -0,0 +1,28 @@
+#ifndef MONOTONIC_CLOCK_H
+#define MONOTONIC_CLOCK_H
+
+#include <Arduino.h>
+
+// Reloj monotónico de 64 bits en microsegundos para todos los plazos y
+// marcas de tiempo internas. millis() da la vuelta a los ~49,7 días y una
+// resta mal puesta se convierte en un plazo que nunca vence (o vence ya);
+// con 64 bits la vuelta queda a cientos de miles de años. En el ESP32 es
+// esp_timer_get_time(); fuera del target, un reloj simulado controlable.
+// No sigue a la hora NTP: para horas del día está TimeUtils.
+class MonotonicClock {
+public:
+    static uint64_t nowUs();  // µs desde el arranque (seguro en ISR)
+    static uint64_t nowMs() { return nowUs() / 1000; }
+
+    // Tiempo transcurrido desde una marca tomada con nowMs()
+    static uint64_t elapsedMs(uint64_t sinceMs) { return nowMs() - sinceMs; }
+
+#ifndef ARDUINO_ARCH_ESP32
+    // Reloj simulado para compilaciones nativas (p. ej. saltar hasta justo
+    // antes de la vuelta de 32 bits de millis())
+    static void set(uint64_t us);
+    static void advance(uint64_t us);
+#endif
+};
+
+#endif // MONOTONIC_CLOCK_H
@@ -0,0 +1,154 @@
+#include "PowerManager.h"
+
+PowerManager powerManager;
+
+PowerManager::PowerManager()
+    : lightSleep(false),
+      wakePinCount(0),
+      statsStartMs(0),
+      idleMs(0),
+      wakeups(0),
+      earlyWakeups(0) {
+}
+
+void PowerManager::addWakePin(uint8_t pin) {
+    if (wakePinCount >= POWER_MAX_WAKE_PINS) return;
+    wakePins[wakePinCount++] = pin;
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <WiFi.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+
+#define POWER_MAX_IDLE_MS 3600000UL
+
+static TaskHandle_t loopTask = nullptr;
+
+bool PowerManager::begin() {
+    loopTask = xTaskGetCurrentTaskHandle();
+    resetStats();
+    
+    // Modem sleep: el Wi-Fi sigue asociado y solo enciende la radio en los
+    // beacons, así que la web y Telegram responden aunque el chip duerma
+    WiFi.setSleep(true);
+    
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    esp_pm_config_t pm = {};
+#else
+    esp_pm_config_esp32s3_t pm = {};
+#endif
+    pm.max_freq_mhz = POWER_CPU_MAX_MHZ;
+    pm.min_freq_mhz = POWER_CPU_MIN_MHZ;
+    pm.light_sleep_enable = POWER_LIGHT_SLEEP_ENABLED;
+    
+    // Sin CONFIG_PM_ENABLE en el SDK devuelve ESP_ERR_NOT_SUPPORTED: se
+    // sigue durmiendo la tarea (CPU ociosa), pero sin light sleep. Aun
+    // aceptado, el chip solo duerme si nadie retiene un cerrojo de energía:
+    // por eso StepTimer apaga el gptimer entre movimientos
+    lightSleep = esp_pm_configure(&pm) == ESP_OK && POWER_LIGHT_SLEEP_ENABLED;
+    if (lightSleep) {
+        esp_sleep_enable_gpio_wakeup();
+    }
+    return lightSleep;
+}
+
+void PowerManager::armWakePins() {
+    // El despertar por GPIO es por nivel: se arma el contrario al actual
+    for (uint8_t i = 0; i < wakePinCount; i++) {
+        gpio_num_t pin = (gpio_num_t)wakePins[i];
+        gpio_wakeup_enable(pin, gpio_get_level(pin) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    }
+}
+
+void PowerManager::idleUntil(uint64_t deadlineMs) {
+    uint64_t start = MonotonicClock::nowMs();
+    if (deadlineMs <= start + POWER_MIN_IDLE_MS || !loopTask) {
+        yield();
+        return;
+    }
+    
+    if (lightSleep) armWakePins();
+    
+    // Tope para no desbordar pdMS_TO_TICKS (también sin plazo): al vencer
+    // solo se da otra vuelta a loop()
+    uint64_t waitMs = deadlineMs - start;
+    if (waitMs > POWER_MAX_IDLE_MS) waitMs = POWER_MAX_IDLE_MS;
+    bool woken = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((uint32_t)waitMs)) > 0;
+    
+    idleMs += MonotonicClock::nowMs() - start;
+    wakeups++;
+    if (woken) earlyWakeups++;
+}
+
+void ARDUINO_ISR_ATTR PowerManager::wake() {
+    if (!loopTask) return;
+    
+    if (xPortInIsrContext()) {
+        BaseType_t higherPriorityWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(loopTask, &higherPriorityWoken);
+        if (higherPriorityWoken) portYIELD_FROM_ISR();
+    } else if (xTaskGetCurrentTaskHandle() != loopTask) {
+        xTaskNotifyGive(loopTask);
+    }
+}
+
+#else  // Sustituto para compilación nativa
+
+bool PowerManager::begin() {
+    resetStats();
+    lightSleep = POWER_LIGHT_SLEEP_ENABLED;
+    return lightSleep;
+}
+
+void PowerManager::armWakePins() {
+}
+
+void PowerManager::idleUntil(uint64_t deadlineMs) {
+    uint64_t start = MonotonicClock::nowMs();
+    if (deadlineMs == TIMER_NEVER || deadlineMs <= start) {
+        return;
+    }
+    
+    // El tiempo pasa igual, pero un plazo muy cercano no cuenta como reposo
+    // (en el target solo se cede la CPU)
+    MonotonicClock::set(deadlineMs * 1000);
+    if (deadlineMs <= start + POWER_MIN_IDLE_MS) {
+        return;
+    }
+    
+    idleMs += deadlineMs - start;
+    wakeups++;
+}
+
+void PowerManager::wake() {
+    // En nativo todo corre en la tarea de loop(), como una llamada desde
+    // ella en el target: no hay reposo que cortar
+}
+
+#endif
+
+float PowerManager::getIdleRatio() const {
+    uint64_t elapsed = MonotonicClock::nowMs() - statsStartMs;
+    return elapsed > 0 ? (float)idleMs / elapsed : 0;
+}
+
+float PowerManager::getWakeupsPerHour() const {
+    uint64_t elapsed = MonotonicClock::nowMs() - statsStartMs;
+    return elapsed > 0 ? wakeups * 3600000.0f / elapsed : 0;
+}
+
+float PowerManager::getEstimatedCurrentMa() const {
+    float idle = getIdleRatio();
+    float idleCurrent = lightSleep ? POWER_SLEEP_CURRENT_MA : POWER_WAIT_CURRENT_MA;
+    return idle * idleCurrent + (1 - idle) * POWER_ACTIVE_CURRENT_MA;
+}
+
+void PowerManager::resetStats() {
+    statsStartMs = MonotonicClock::nowMs();
+    idleMs = 0;
+    wakeups = 0;
+    earlyWakeups = 0;
+}
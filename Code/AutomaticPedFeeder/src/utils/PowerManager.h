@@ -0,0 +1,59 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include "../config.h"
+#include "MonotonicClock.h"
+#include "TimerQueue.h"
+
+#define POWER_MAX_WAKE_PINS 2
+
+// Reposo entre plazos: loop() llama a idleUntil() cuando no hay nada que
+// sondear y la tarea se bloquea hasta el vencimiento (o hasta wake()). Con
+// todas las tareas bloqueadas, el light sleep automático de esp_pm duerme
+// el chip y lo despiertan el timer, el Wi-Fi (beacons en modem sleep) y los
+// pines de despertar; así el servidor web y Telegram siguen accesibles.
+// Fuera del target, idleUntil() salta el MonotonicClock simulado hasta el
+// plazo, de modo que se puede simular un día entero y contar despertares.
+class PowerManager {
+private:
+    bool lightSleep;  // esp_pm aceptó el light sleep automático (no implica
+                      // que se duerma: cualquier cerrojo de energía lo impide)
+    uint8_t wakePins[POWER_MAX_WAKE_PINS];
+    uint8_t wakePinCount;
+
+    // Estadísticas
+    uint64_t statsStartMs;
+    uint64_t idleMs;
+    uint32_t wakeups;
+    uint32_t earlyWakeups;  // Por wake() antes del plazo
+
+public:
+    PowerManager();
+
+    // Inicialización (desde la tarea de loop(): es la que se despierta)
+    bool begin();
+    void addWakePin(uint8_t pin);  // Un cambio del pin saca al chip del light sleep (PIR)
+
+    // Reposo hasta 'deadlineMs' (MonotonicClock::nowMs()); TIMER_NEVER = sin plazo
+    void idleUntil(uint64_t deadlineMs);
+
+    // Despierta a loop() antes del plazo; seguro desde otras tareas e ISR
+    void wake();
+
+    // Estado
+    bool isLightSleepEnabled() const { return lightSleep; }
+    uint32_t getWakeupCount() const { return wakeups; }
+    uint32_t getEarlyWakeupCount() const { return earlyWakeups; }
+    float getIdleRatio() const;          // Fracción del tiempo en reposo
+    float getWakeupsPerHour() const;
+    float getEstimatedCurrentMa() const; // Con POWER_*_CURRENT_MA, no medida
+    void resetStats();
+
+private:
+    void armWakePins();
+};
+
+extern PowerManager powerManager;
+
+#endif // POWER_MANAGER_H
@@ -0,0 +1,59 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <Arduino.h>
+
+// Instantánea con un solo escritor (otra tarea) y lectores que nunca
+// esperan al escritor: la secuencia es impar mientras se copia y el lector
+// repite si la vio impar o cambió durante su copia. En el ESP32 el escritor
+// copia dentro de una sección crítica, así que un lector de más prioridad
+// en su mismo núcleo nunca lo interrumpe a medias (y no gira en vano).
+template <class T>
+class Seqlock {
+private:
+    volatile uint32_t sequence;
+    T value;
+#ifdef ARDUINO_ARCH_ESP32
+    portMUX_TYPE writeLock;
+#endif
+
+public:
+    Seqlock() : sequence(0), value() {
+#ifdef ARDUINO_ARCH_ESP32
+        writeLock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+    }
+
+    // Solo el escritor
+    void write(const T& next) {
+#ifdef ARDUINO_ARCH_ESP32
+        portENTER_CRITICAL(&writeLock);
+#endif
+        sequence = sequence + 1;
+        __sync_synchronize();
+        value = next;
+        __sync_synchronize();
+        sequence = sequence + 1;
+#ifdef ARDUINO_ARCH_ESP32
+        portEXIT_CRITICAL(&writeLock);
+#endif
+    }
+
+    // Cualquier tarea; no bloquea
+    T read() const {
+        T copy;
+        uint32_t before;
+        do {
+            before = sequence;
+            __sync_synchronize();
+            copy = value;
+            __sync_synchronize();
+        } while ((before & 1) || before != sequence);
+        return copy;
+    }
+
+    // Cambia con cada write() (para saber si hay datos nuevos)
+    uint32_t getSequence() const { return sequence; }
+};
+
+#endif // SEQLOCK_H
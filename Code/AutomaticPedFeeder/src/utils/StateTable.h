@@ -0,0 +1,78 @@
+#ifndef STATE_TABLE_H
+#define STATE_TABLE_H
+
+#include <stddef.h>
+
+// Máquina de estados declarativa: una tabla de estados (nombre y acciones
+// de entrada, salida y sondeo) y otra de transiciones (origen, evento,
+// guarda y destino). Las tablas son constexpr y viven en flash; en cada
+// tick solo se sondea el estado actual y se recorre la tabla si hay evento.
+template <typename Owner, typename State, typename Event>
+struct StateTable {
+    typedef void (Owner::*Action)();
+    typedef Event (Owner::*Poll)();
+    typedef bool (Owner::*Guard)() const;
+
+    struct StateInfo {
+        State state;          // Debe coincidir con su índice en la tabla
+        const char* name;
+        Action onEntry;       // nullptr = sin acción
+        Action onExit;
+        Poll poll;            // Genera el evento del tick (nullptr = ninguno)
+    };
+
+    struct Transition {
+        State from;
+        Event event;
+        Guard guard;          // nullptr = siempre; se aplica la primera que cumple
+        State to;
+    };
+
+    // Primera transición aplicable a (from, event)
+    static const Transition* find(const Transition* table, size_t count,
+                                  const Owner& owner, State from, Event event) {
+        for (size_t i = 0; i < count; i++) {
+            const Transition& transition = table[i];
+            if (transition.from == from && transition.event == event &&
+                (!transition.guard || (owner.*transition.guard)())) {
+                return &transition;
+            }
+        }
+        return nullptr;
+    }
+
+    // ===== Comprobaciones en compilación =====
+
+    // Cada entrada de la tabla de estados está en su índice
+    static constexpr bool indexed(const StateInfo* states, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            if ((size_t)states[i].state != i) return false;
+        }
+        return true;
+    }
+
+    // Todos los estados tienen alguna salida (ninguno es un callejón)
+    static constexpr bool leavable(const Transition* table, size_t count, size_t states) {
+        for (size_t state = 0; state < states; state++) {
+            bool found = false;
+            for (size_t i = 0; i < count; i++) {
+                if ((size_t)table[i].from == state && (size_t)table[i].to != state) found = true;
+            }
+            if (!found) return false;
+        }
+        return true;
+    }
+
+    // Una transición sin guarda tapa las siguientes con el mismo origen y evento
+    static constexpr bool unshadowed(const Transition* table, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            if (table[i].guard) continue;
+            for (size_t j = i + 1; j < count; j++) {
+                if (table[j].from == table[i].from && table[j].event == table[i].event) return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif // STATE_TABLE_H
@@ -1,11 +1,31 @@
 #include "TimeUtils.h"
+#include "../config.h"
+#include "EventBus.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <esp_sntp.h>
+
+// Corre en la tarea de SNTP: solo encola
+static void onTimeSync(struct timeval* tv) {
+    eventBus.publish(EVENT_TIME_SYNC, (int32_t)tv->tv_sec);
+}
+#else
+static time_t simulatedTime = 0;
+
+void TimeUtils::setSimulatedTime(time_t t) {
+    simulatedTime = t;
+}
+
+void TimeUtils::stepSimulatedTime(time_t t) {
+    simulatedTime = t;
+    eventBus.publish(EVENT_TIME_SYNC, (int32_t)t);
+}
+#endif
 
 void TimeUtils::init() {
-    
-    configTzTime("CET-1CEST,M3.5.0/2,M10.5.0/3",
-                 "pool.ntp.org",
-                 "time.nist.gov",
-                 "time.google.com");
+#ifdef ARDUINO_ARCH_ESP32
+    sntp_set_time_sync_notification_cb(onTimeSync);
+    configTzTime(TIMEZONE, NTP_SERVER_1, NTP_SERVER_2, NTP_SERVER_3);
     
     // Intentar sincronizar de forma no bloqueante
     struct tm timeinfo;
@@ -16,20 +36,35 @@ void TimeUtils::init() {
         delay(500);
     }
     // Continuar sin bloquear - la sincronización seguirá en background
+#else
+    setenv("TZ", TIMEZONE, 1);
+    tzset();
+#endif
+}
+
+time_t TimeUtils::now() {
+#ifdef ARDUINO_ARCH_ESP32
+    return time(nullptr);
+#else
+    return simulatedTime;
+#endif
 }
 
 // ✅ Agregar método para verificar si NTP está sincronizado
 bool TimeUtils::isSynced() {
-    struct tm timeinfo;
-    if (!getLocalTimeSafe(timeinfo)) return false;
-    return timeinfo.tm_year > (2020 - 1900);  // Año válido
+    return isValidTime(now());
 }
 
 bool TimeUtils::getLocalTimeSafe(struct tm &timeinfo) {
+#ifdef ARDUINO_ARCH_ESP32
     if (getLocalTime(&timeinfo)) {
         return true;
     }
     return false;
+#else
+    time_t t = now();
+    return isValidTime(t) && localtime_r(&t, &timeinfo) != nullptr;
+#endif
 }
 
 int TimeUtils::getCurrentDay() {
@@ -10,7 +10,8 @@ private:
     static bool getLocalTimeSafe(struct tm &timeinfo);
 
 public:
-    // Inicializar zona horaria y NTP
+    // Inicializar zona horaria y NTP. Cada sincronización publica
+    // EVENT_TIME_SYNC (la hora puede haber saltado)
     static void init();
 
     // Fecha/Hora actual
@@ -22,10 +23,19 @@ public:
 
     // Tiempos tipo UNIX
     static unsigned long getUnixTime();  // Timestamp actual
+    static time_t now();                 // Reloj del sistema sin esperas (antes de NTP: segundos desde el arranque)
+    static bool isValidTime(time_t t) { return t > 1600000000; }  // Posterior a 2020: hora NTP
 
     // Formatos de tiempo legible
     static String getTimeString();       // HH:MM:SS
     static String timeAgo(unsigned long pastUnixTime); // "hace X min"
+
+#ifndef ARDUINO_ARCH_ESP32
+    // Reloj simulado para compilaciones nativas: setSimulatedTime avanza sin
+    // saltos; stepSimulatedTime imita una corrección NTP (EVENT_TIME_SYNC)
+    static void setSimulatedTime(time_t t);
+    static void stepSimulatedTime(time_t t);
+#endif
 };
 
 #endif // TIME_UTILS_H
@@ -0,0 +1,143 @@
+#include "TimerQueue.h"
+
+TimerQueue timerQueue;
+
+#if defined(ARDUINO_ARCH_ESP32) && !defined(NDEBUG)
+
+#include <assert.h>
+
+// El primer uso (setup(), que corre en la tarea de loop()) fija la tarea
+// dueña; llamar desde otra (AsyncTCP, DHT...) corrompería el montículo
+static TaskHandle_t ownerTask = nullptr;
+
+static void checkOwner() {
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    if (!ownerTask) ownerTask = current;
+    assert(current == ownerTask && "timerQueue usado fuera de loop()");
+}
+
+#define CHECK_OWNER() checkOwner()
+#else
+#define CHECK_OWNER()
+#endif
+
+TimerQueue::TimerQueue()
+    : timerCount(0),
+      heapSize(0) {
+}
+
+TimerId TimerQueue::add(TimerHandler handler, void* context) {
+    CHECK_OWNER();
+    if (!handler || timerCount >= TIMER_QUEUE_SIZE) {
+        return TIMER_NONE;
+    }
+
+    timers[timerCount] = { 0, 0, handler, context, -1 };
+    return timerCount++;
+}
+
+TimerId TimerQueue::every(uint32_t periodMs, TimerHandler handler, void* context) {
+    TimerId id = add(handler, context);
+    if (id != TIMER_NONE) {
+        start(id, periodMs, periodMs);
+    }
+    return id;
+}
+
+bool TimerQueue::start(TimerId id, uint32_t delayMs, uint32_t periodMs) {
+    CHECK_OWNER();
+    if (!isValid(id)) return false;
+
+    stop(id);
+    timers[id].deadline = MonotonicClock::nowMs() + delayMs;
+    timers[id].periodMs = periodMs;
+    push(id);
+    return true;
+}
+
+void TimerQueue::stop(TimerId id) {
+    CHECK_OWNER();
+    if (!isValid(id) || timers[id].heapIndex < 0) return;
+    remove(timers[id].heapIndex);
+}
+
+bool TimerQueue::isActive(TimerId id) const {
+    return isValid(id) && timers[id].heapIndex >= 0;
+}
+
+void TimerQueue::run() {
+    CHECK_OWNER();
+    uint64_t now = MonotonicClock::nowMs();
+
+    // Un manejador que se re-arranca con plazo 0 no debe bloquear loop()
+    for (uint8_t budget = timerCount; budget > 0 && heapSize > 0; budget--) {
+        uint8_t id = heap[0];
+        Timer& timer = timers[id];
+        if (timer.deadline > now) break;
+
+        // Se re-arma antes de llamar para que el manejador pueda pararlo o
+        // moverlo. Un periódico atrasado no recupera las vueltas perdidas
+        remove(0);
+        if (timer.periodMs > 0) {
+            timer.deadline += timer.periodMs;
+            if (timer.deadline <= now) timer.deadline = now + timer.periodMs;
+            push(id);
+        }
+
+        timer.handler(timer.context);
+    }
+}
+
+uint64_t TimerQueue::getNextDeadline() const {
+    return heapSize > 0 ? timers[heap[0]].deadline : TIMER_NEVER;
+}
+
+// ========== MONTÍCULO ==========
+
+void TimerQueue::push(uint8_t id) {
+    place(heapSize++, id);
+    siftUp(heapSize - 1);
+}
+
+void TimerQueue::remove(uint8_t pos) {
+    timers[heap[pos]].heapIndex = -1;
+    heapSize--;
+    if (pos == heapSize) return;
+
+    // El último ocupa el hueco y se recoloca hacia arriba o hacia abajo
+    uint8_t moved = heap[heapSize];
+    place(pos, moved);
+    siftUp(pos);
+    siftDown(timers[moved].heapIndex);
+}
+
+void TimerQueue::siftUp(uint8_t pos) {
+    uint8_t id = heap[pos];
+    while (pos > 0) {
+        uint8_t parent = (pos - 1) / 2;
+        if (timers[heap[parent]].deadline <= timers[id].deadline) break;
+        place(pos, heap[parent]);
+        pos = parent;
+    }
+    place(pos, id);
+}
+
+void TimerQueue::siftDown(uint8_t pos) {
+    uint8_t id = heap[pos];
+    while (true) {
+        uint8_t child = 2 * pos + 1;
+        if (child >= heapSize) break;
+        if (child + 1 < heapSize && timers[heap[child + 1]].deadline < timers[heap[child]].deadline) {
+            child++;
+        }
+        if (timers[id].deadline <= timers[heap[child]].deadline) break;
+        place(pos, heap[child]);
+        pos = child;
+    }
+    place(pos, id);
+}
+
+void TimerQueue::place(uint8_t pos, uint8_t id) {
+    heap[pos] = id;
+    timers[id].heapIndex = pos;
+}
@@ -0,0 +1,68 @@
+#ifndef TIMER_QUEUE_H
+#define TIMER_QUEUE_H
+
+#include <Arduino.h>
+#include "MonotonicClock.h"
+
+#define TIMER_QUEUE_SIZE 12  // Temporizadores registrados en total
+#define TIMER_NONE -1
+#define TIMER_NEVER UINT64_MAX
+
+typedef int8_t TimerId;
+typedef void (*TimerHandler)(void* context);
+
+// Plazos de todo el trabajo periódico (sensores, Telegram, programador,
+// guardado...) en un montículo ordenado por vencimiento. Cada módulo
+// registra sus temporizadores una vez y loop() solo ejecuta lo vencido con
+// run(); getNextDeadline() dice cuándo hay que volver a mirar. Los
+// registros son fijos (sin reservar memoria); parar un temporizador no lo
+// libera. Solo se usa desde loop(): no es seguro desde otras tareas (en
+// depuración un assert comprueba en el ESP32 que la tarea es la de setup()).
+class TimerQueue {
+private:
+    struct Timer {
+        uint64_t deadline;    // MonotonicClock::nowMs()
+        uint32_t periodMs;    // 0 = una sola vez
+        TimerHandler handler;
+        void* context;
+        int8_t heapIndex;     // -1 = parado
+    };
+
+    Timer timers[TIMER_QUEUE_SIZE];
+    uint8_t timerCount;
+
+    uint8_t heap[TIMER_QUEUE_SIZE];  // Índices de timers, el primero vence antes
+    uint8_t heapSize;
+
+public:
+    TimerQueue();
+
+    // Registro: add() deja el temporizador parado; every() lo arranca ya
+    // periódico (primera vez tras un periodo). TIMER_NONE si no caben
+    TimerId add(TimerHandler handler, void* context = nullptr);
+    TimerId every(uint32_t periodMs, TimerHandler handler, void* context = nullptr);
+
+    // Control (re-arrancar uno activo mueve su vencimiento)
+    bool start(TimerId id, uint32_t delayMs, uint32_t periodMs = 0);
+    void stop(TimerId id);
+    bool isActive(TimerId id) const;
+
+    // Ejecuta los vencidos, cada uno como mucho una vez por llamada
+    void run();
+
+    // Próximo vencimiento (TIMER_NEVER si no hay ninguno activo)
+    uint64_t getNextDeadline() const;
+    uint8_t getActiveCount() const { return heapSize; }
+
+private:
+    bool isValid(TimerId id) const { return id >= 0 && id < timerCount; }
+    void push(uint8_t id);
+    void remove(uint8_t pos);
+    void siftUp(uint8_t pos);
+    void siftDown(uint8_t pos);
+    void place(uint8_t pos, uint8_t id);
+};
+
+extern TimerQueue timerQueue;
+
+#endif // TIMER_QUEUE_H
@@ -0,0 +1,127 @@
+// Modelo circular del carrusel y elección del sentido de giro (env:native)
+//   pio test -e native -f test_carousel_route
+
+#include <unity.h>
+#include "hardware/StepperController.h"
+
+static StepperController stepper;
+
+static void runUntilIdle() {
+    for (uint32_t i = 0; i < 5000000 && stepper.isMotorMoving(); i++) {
+        StepTimer::advance(50);
+        stepper.update();
+    }
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_normalize_position(void) {
+    TEST_ASSERT_EQUAL(0, StepperController::normalizePosition(0));
+    TEST_ASSERT_EQUAL(5, StepperController::normalizePosition(STEPS_PER_CAROUSEL_TURN + 5));
+    TEST_ASSERT_EQUAL(STEPS_PER_CAROUSEL_TURN - 1, StepperController::normalizePosition(-1));
+    TEST_ASSERT_EQUAL(STEPS_PER_COMPARTMENT, StepperController::normalizePosition(STEPS_PER_COMPARTMENT - 3 * STEPS_PER_CAROUSEL_TURN));
+    TEST_ASSERT_EQUAL(0, StepperController::normalizePosition(-STEPS_PER_CAROUSEL_TURN));
+}
+
+void test_position_to_compartment(void) {
+    for (int k = 0; k < TOTAL_COMPARTMENTS; k++) {
+        long center = k * STEPS_PER_COMPARTMENT;
+        TEST_ASSERT_EQUAL(k, StepperController::positionToCompartment(center));
+        TEST_ASSERT_EQUAL(k, StepperController::positionToCompartment(center + STEPS_PER_COMPARTMENT / 2 - 1));
+        TEST_ASSERT_EQUAL(k, StepperController::positionToCompartment(center - STEPS_PER_COMPARTMENT / 2));
+
+        // Posiciones negativas o de varias vueltas (antes truncaban mal)
+        TEST_ASSERT_EQUAL(k, StepperController::positionToCompartment(center - STEPS_PER_CAROUSEL_TURN));
+        TEST_ASSERT_EQUAL(k, StepperController::positionToCompartment(center + 7 * STEPS_PER_CAROUSEL_TURN));
+    }
+    TEST_ASSERT_EQUAL(0, StepperController::positionToCompartment(-1));
+}
+
+void test_wrap_distance(void) {
+    TEST_ASSERT_EQUAL(0, StepperController::wrapDistance(0));
+    TEST_ASSERT_EQUAL(10, StepperController::wrapDistance(10));
+    TEST_ASSERT_EQUAL(-10, StepperController::wrapDistance(-10));
+    TEST_ASSERT_EQUAL(-10, StepperController::wrapDistance(STEPS_PER_CAROUSEL_TURN - 10));
+    TEST_ASSERT_EQUAL(STEPS_PER_CAROUSEL_TURN / 2, StepperController::wrapDistance(STEPS_PER_CAROUSEL_TURN / 2));
+    TEST_ASSERT_EQUAL(-(STEPS_PER_CAROUSEL_TURN / 2 - 1), StepperController::wrapDistance(STEPS_PER_CAROUSEL_TURN / 2 + 1));
+}
+
+void test_route_shortest_direction(void) {
+    for (int from = 0; from < TOTAL_COMPARTMENTS; from++) {
+        for (int to = 0; to < TOTAL_COMPARTMENTS; to++) {
+            long start = from * STEPS_PER_COMPARTMENT;
+            long steps = StepperController::routeSteps(start, to, 0);
+
+            TEST_ASSERT_TRUE(labs(steps) <= STEPS_PER_CAROUSEL_TURN / 2);
+            TEST_ASSERT_EQUAL(to * STEPS_PER_COMPARTMENT, StepperController::normalizePosition(start + steps));
+            if (from == to) {
+                TEST_ASSERT_EQUAL(0, steps);
+            }
+        }
+    }
+
+    // Volver de 4 a 0 es un compartimento hacia delante, no casi una vuelta atrás
+    TEST_ASSERT_EQUAL(STEPS_PER_COMPARTMENT, StepperController::routeSteps(4 * STEPS_PER_COMPARTMENT, 0, 0));
+    TEST_ASSERT_EQUAL(-STEPS_PER_COMPARTMENT, StepperController::routeSteps(STEPS_PER_COMPARTMENT, 0, 0));
+}
+
+void test_route_one_way(void) {
+    for (int from = 0; from < TOTAL_COMPARTMENTS; from++) {
+        for (int to = 0; to < TOTAL_COMPARTMENTS; to++) {
+            long start = from * STEPS_PER_COMPARTMENT + 3;  // Contador fuera de la rejilla
+            long forward = StepperController::routeSteps(start, to, 1);
+            long backward = StepperController::routeSteps(start, to, -1);
+
+            TEST_ASSERT_TRUE(forward > 0 && forward <= STEPS_PER_CAROUSEL_TURN);
+            TEST_ASSERT_TRUE(backward < 0 && backward >= -STEPS_PER_CAROUSEL_TURN);
+            TEST_ASSERT_EQUAL(STEPS_PER_CAROUSEL_TURN, forward - backward);
+            TEST_ASSERT_EQUAL(to * STEPS_PER_COMPARTMENT, StepperController::normalizePosition(start + forward));
+        }
+    }
+}
+
+void test_sweep_all_pairs(void) {
+    stepper.begin();
+    stepper.calibrate();
+    int32_t origin = HomeSensor::simulatedPosition();
+    long travel = 0;
+    long shortest = 0;
+
+    for (int from = 0; from < TOTAL_COMPARTMENTS; from++) {
+        for (int to = 0; to < TOTAL_COMPARTMENTS; to++) {
+            TEST_ASSERT_TRUE(stepper.moveToCompartment(from));
+            runUntilIdle();
+            int32_t before = HomeSensor::simulatedPosition();
+
+            TEST_ASSERT_TRUE(stepper.moveToCompartment(to));
+            runUntilIdle();
+
+            long moved = HomeSensor::simulatedPosition() - before;
+            travel += labs(moved);
+            int hops = abs(to - from);
+            shortest += min(hops, TOTAL_COMPARTMENTS - hops) * STEPS_PER_COMPARTMENT;
+            TEST_ASSERT_TRUE(labs(moved) <= STEPS_PER_CAROUSEL_TURN / 2);
+            TEST_ASSERT_EQUAL(to, stepper.getCurrentCompartment());
+            TEST_ASSERT_EQUAL(to * STEPS_PER_COMPARTMENT,
+                              StepperController::normalizePosition(HomeSensor::simulatedPosition() - origin));
+        }
+    }
+
+    // Cada par por el camino más corto, sin vueltas de más
+    TEST_ASSERT_EQUAL(shortest, travel);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_normalize_position);
+    RUN_TEST(test_position_to_compartment);
+    RUN_TEST(test_wrap_distance);
+    RUN_TEST(test_route_shortest_direction);
+    RUN_TEST(test_route_one_way);
+    RUN_TEST(test_sweep_all_pairs);
+    return UNITY_END();
+}
@@ -0,0 +1,181 @@
+// Instantánea del DHT: seqlock y lecturas fuera de loop() (env:native)
+//   pio test -e native -f test_dht_snapshot
+
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "hardware/SensorManager.h"
+#include "utils/Seqlock.h"
+
+static SensorManager sensors;
+static int alerts;
+
+static void onAlert(const Event& /*event*/) {
+    alerts++;
+}
+
+// Anota la secuencia que ve cada copia (la del escritor debe verla impar)
+struct Probe;
+static Seqlock<Probe>* probeLock = nullptr;
+static int oddCopies;
+static int evenCopies;
+
+struct Probe {
+    uint32_t value = 0;
+
+    Probe() = default;
+    Probe(const Probe&) = default;
+    Probe& operator=(const Probe& other) {
+        if (probeLock) {
+            if (probeLock->getSequence() & 1) oddCopies++;
+            else evenCopies++;
+        }
+        value = other.value;
+        return *this;
+    }
+};
+
+// Bastante más grande que una palabra: una copia a medias se notaría
+struct Wide {
+    uint64_t words[8];
+};
+
+static void runInterval() {
+    MonotonicClock::advance((uint64_t)DHT_READ_INTERVAL_MS * 1000);
+    timerQueue.run();
+    sensors.update();
+    eventBus.dispatch();
+}
+
+void setUp(void) {
+    simDhtTemperature = 22.0f;
+    simDhtHumidity = 50.0f;
+    alerts = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_seqlock_sequence(void) {
+    Seqlock<Probe> lock;
+    probeLock = &lock;
+    oddCopies = evenCopies = 0;
+    TEST_ASSERT_EQUAL_UINT32(0, lock.getSequence());
+
+    Probe next;
+    next.value = 7;
+    lock.write(next);
+    TEST_ASSERT_EQUAL_UINT32(2, lock.getSequence());
+    TEST_ASSERT_EQUAL(1, oddCopies);
+
+    TEST_ASSERT_EQUAL_UINT32(7, lock.read().value);
+    TEST_ASSERT_EQUAL(1, evenCopies);
+    probeLock = nullptr;
+}
+
+void test_seqlock_concurrent_reader(void) {
+    Seqlock<Wide> lock;
+    std::atomic<bool> done(false);
+    long reads = 0;
+    long torn = 0;
+
+    std::thread writer([&] {
+        Wide next = {};
+        for (uint64_t i = 1; i <= 500000; i++) {
+            for (uint64_t& word : next.words) word = i;
+            lock.write(next);
+        }
+        done = true;
+    });
+
+    // El lector nunca espera al escritor ni ve una copia a medias
+    while (!done) {
+        Wide copy = lock.read();
+        reads++;
+        for (uint64_t word : copy.words) {
+            if (word != copy.words[0]) {
+                torn++;
+                break;
+            }
+        }
+    }
+    writer.join();
+
+    TEST_ASSERT_TRUE(reads > 0);
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_EQUAL_UINT64(500000, lock.read().words[7]);
+    TEST_ASSERT_EQUAL_UINT32(1000000, lock.getSequence());
+}
+
+void test_first_read_after_interval(void) {
+    // Hasta DHT_READ_INTERVAL_MS no hay lectura (ni se espera por ella)
+    TEST_ASSERT_FALSE(sensors.getEnvironmentData().valid);
+    TEST_ASSERT_EQUAL_UINT32(0, sensors.getDhtStats().reads);
+
+    runInterval();
+    EnvironmentData env = sensors.getEnvironmentData();
+    DhtStats stats = sensors.getDhtStats();
+    TEST_ASSERT_TRUE(env.valid);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 22.0f, env.temperature);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 50.0f, env.humidity);
+    TEST_ASSERT_EQUAL_UINT64(MonotonicClock::nowMs(), env.lastUpdate);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.reads);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.retries);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.failures);
+    TEST_ASSERT_TRUE(sensors.isEnvironmentOk());
+}
+
+void test_failed_read_retries(void) {
+    DhtStats before = sensors.getDhtStats();
+    simDhtTemperature = NAN;
+    runInterval();
+
+    DhtStats stats = sensors.getDhtStats();
+    TEST_ASSERT_FALSE(sensors.getEnvironmentData().valid);
+    TEST_ASSERT_EQUAL_UINT32(before.reads + 1 + DHT_READ_RETRIES, stats.reads);
+    TEST_ASSERT_EQUAL_UINT32(before.retries + DHT_READ_RETRIES, stats.retries);
+    TEST_ASSERT_EQUAL_UINT32(before.failures + 1, stats.failures);
+    TEST_ASSERT_EQUAL(0, alerts);
+
+    // La siguiente lectura buena vuelve a dar datos válidos
+    simDhtTemperature = 22.0f;
+    runInterval();
+    TEST_ASSERT_TRUE(sensors.getEnvironmentData().valid);
+    TEST_ASSERT_EQUAL_UINT32(before.failures + 1, sensors.getDhtStats().failures);
+}
+
+void test_alert_once_per_condition(void) {
+    simDhtTemperature = TEMP_MAX_ALERT + 5.0f;
+    runInterval();
+    TEST_ASSERT_EQUAL(1, alerts);
+
+    // La misma alerta en lecturas nuevas no se repite
+    runInterval();
+    runInterval();
+    TEST_ASSERT_EQUAL(1, alerts);
+
+    // Sin lectura nueva, update() no vuelve a revisar nada
+    sensors.update();
+    eventBus.dispatch();
+    TEST_ASSERT_EQUAL(1, alerts);
+
+    // Tras volver a la normalidad, otra vez
+    simDhtTemperature = 22.0f;
+    runInterval();
+    simDhtHumidity = HUMIDITY_MAX_ALERT + 10.0f;
+    runInterval();
+    TEST_ASSERT_EQUAL(2, alerts);
+}
+
+int main() {
+    eventBus.subscribe(EVENT_ENVIRONMENT_ALERT, onAlert);
+    sensors.begin();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_seqlock_sequence);
+    RUN_TEST(test_seqlock_concurrent_reader);
+    RUN_TEST(test_first_read_after_interval);
+    RUN_TEST(test_failed_read_retries);
+    RUN_TEST(test_alert_once_per_condition);
+    return UNITY_END();
+}
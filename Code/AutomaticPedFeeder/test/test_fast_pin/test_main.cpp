@@ -0,0 +1,141 @@
+// Comprobación de pines del ESP32-S3 y acceso directo a GPIO (env:native)
+//   pio test -e native -f test_fast_pin
+
+#include <unity.h>
+#include <chrono>
+#include "hardware/FastPin.h"
+
+#define BENCH_TOGGLES 2000000
+
+// Tiempo real: el MonotonicClock nativo es simulado y no avanza solo
+static uint64_t wallNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Impide que el compilador funda las escrituras del bucle en una sola
+static inline void barrier() {
+    asm volatile("" ::: "memory");
+}
+
+// Los límites, también en compilación: FastPin<26> no debe compilar
+static_assert(isUsableGpio(21) && !isUsableGpio(22), "22-25 no existen");
+static_assert(!isUsableGpio(26) && !isUsableGpio(32), "26-32 son de la flash SPI");
+static_assert(!isUsableGpio(33) && !isUsableGpio(37), "33-37 son de la PSRAM octal");
+static_assert(isUsableGpio(38) && isUsableGpio(48) && !isUsableGpio(49), "38-48 libres");
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_usable_gpio_ranges(void) {
+    for (int pin = -2; pin <= 50; pin++) {
+        bool expected = (pin >= 0 && pin <= 21) || (pin >= 38 && pin <= 48);
+        TEST_ASSERT_EQUAL(expected, isUsableGpio(pin));
+    }
+}
+
+void test_assigned_pins(void) {
+    TEST_ASSERT_TRUE(PinCheck::allUsable());
+
+    // Cada pin conectado se asigna una sola vez
+    for (int pin : PinCheck::assigned) {
+        if (pin >= 0) {
+            TEST_ASSERT_EQUAL(1, PinCheck::uses(pin));
+        }
+    }
+    TEST_ASSERT_EQUAL(0, PinCheck::uses(22));
+}
+
+void test_register_writes(void) {
+    static_assert(STEPPER_STEP_PIN < 32 && STEPPER_MS_PIN >= 32, "un pin de cada banco");
+    uint32_t writes = simRegWrites;
+
+    // Banco bajo: una escritura en OUT_W1TS/W1TC con el bit del pin
+    StepPin::high();
+    TEST_ASSERT_EQUAL_UINT32(GPIO_OUT_W1TS_REG, simRegLastAddress);
+    TEST_ASSERT_EQUAL_UINT32(1UL << STEPPER_STEP_PIN, simRegLastValue);
+    StepPin::low();
+    TEST_ASSERT_EQUAL_UINT32(GPIO_OUT_W1TC_REG, simRegLastAddress);
+    TEST_ASSERT_EQUAL_UINT32(1UL << STEPPER_STEP_PIN, simRegLastValue);
+
+    // Banco alto (GPIO >= 32): OUT1_W1TS/W1TC con el bit desplazado
+    MicrostepPin::write(true);
+    TEST_ASSERT_EQUAL_UINT32(GPIO_OUT1_W1TS_REG, simRegLastAddress);
+    TEST_ASSERT_EQUAL_UINT32(1UL << (STEPPER_MS_PIN - 32), simRegLastValue);
+    TEST_ASSERT_EQUAL(HIGH, simPinLevels[STEPPER_MS_PIN]);
+    TEST_ASSERT_TRUE(MicrostepPin::read());
+    MicrostepPin::write(false);
+    TEST_ASSERT_EQUAL_UINT32(GPIO_OUT1_W1TC_REG, simRegLastAddress);
+    TEST_ASSERT_EQUAL_UINT32(1UL << (STEPPER_MS_PIN - 32), simRegLastValue);
+    TEST_ASSERT_EQUAL(LOW, simPinLevels[STEPPER_MS_PIN]);
+
+    // Una sola escritura por flanco, y sin tocar los pines vecinos
+    TEST_ASSERT_EQUAL_UINT32(writes + 4, simRegWrites);
+    TEST_ASSERT_EQUAL(LOW, simPinLevels[STEPPER_MS_PIN - 32]);
+}
+
+void test_write_and_read(void) {
+    StepPin::output();
+    StepPin::high();
+    TEST_ASSERT_EQUAL(HIGH, simPinLevels[STEPPER_STEP_PIN]);
+    TEST_ASSERT_TRUE(StepPin::read());
+
+    StepPin::write(false);
+    TEST_ASSERT_EQUAL(LOW, simPinLevels[STEPPER_STEP_PIN]);
+    TEST_ASSERT_FALSE(StepPin::read());
+
+    // Banco alto (GPIO >= 32)
+    MicrostepPin::output();
+    MicrostepPin::write(true);
+    TEST_ASSERT_EQUAL(HIGH, simPinLevels[STEPPER_MS_PIN]);
+    MicrostepPin::low();
+    TEST_ASSERT_EQUAL(LOW, simPinLevels[STEPPER_MS_PIN]);
+
+    // Entrada con pull-up: en reposo se lee en alto
+    FastPin<HOME_SENSOR_PIN>::input(INPUT_PULLUP);
+    TEST_ASSERT_TRUE(FastPin<HOME_SENSOR_PIN>::read());
+}
+
+void test_toggle_rate(void) {
+    // Orientativo: en el PC se comparan los registros simulados con el
+    // digitalWrite del shim; en el target la diferencia es la de
+    // gpio_set_level() frente a una escritura en W1TS/W1TC
+    uint32_t writes = simRegWrites;
+    uint64_t start = wallNs();
+    for (uint32_t i = 0; i < BENCH_TOGGLES; i++) {
+        StepPin::high();
+        barrier();
+        StepPin::low();
+        barrier();
+    }
+    uint64_t fastNs = wallNs() - start;
+    TEST_ASSERT_EQUAL_UINT32(writes + 2 * BENCH_TOGGLES, simRegWrites);
+
+    start = wallNs();
+    for (uint32_t i = 0; i < BENCH_TOGGLES; i++) {
+        digitalWrite(STEPPER_STEP_PIN, HIGH);
+        barrier();
+        digitalWrite(STEPPER_STEP_PIN, LOW);
+        barrier();
+    }
+    uint64_t digitalNs = wallNs() - start;
+    TEST_ASSERT_EQUAL(LOW, simPinLevels[STEPPER_STEP_PIN]);
+
+    char message[96];
+    snprintf(message, sizeof(message), "FastPin %.2f ns/conmutación, digitalWrite %.2f ns/conmutación",
+             (double)fastNs / BENCH_TOGGLES, (double)digitalNs / BENCH_TOGGLES);
+    TEST_MESSAGE(message);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_usable_gpio_ranges);
+    RUN_TEST(test_assigned_pins);
+    RUN_TEST(test_register_writes);
+    RUN_TEST(test_write_and_read);
+    RUN_TEST(test_toggle_rate);
+    return UNITY_END();
+}
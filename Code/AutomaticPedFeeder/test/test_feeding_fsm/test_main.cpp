@@ -0,0 +1,271 @@
+// Máquina de estados de la alimentación: comprobaciones de StateTable y
+// recorrido de todos los estados por la API pública (env:native)
+//   pio test -e native -f test_feeding_fsm
+
+#include <unity.h>
+#include "feeding/FeedingLogic.h"
+#include "hardware/StepperController.h"
+#include "hardware/SensorManager.h"
+#include "utils/TimerQueue.h"
+
+static StepperController stepper;
+static SensorManager sensors;
+static FeedingLogic logic(&stepper, &sensors);
+
+static bool visited[FEEDING_STATE_COUNT];
+static int completions;
+
+static void onFeedingState(const Event& event) {
+    visited[event.value] = true;
+}
+
+static void onFeedingComplete(const Event& event) {
+    if (event.success()) completions++;
+}
+
+static void step() {
+    StepTimer::advance(50);
+    timerQueue.run();
+    sensors.update();
+    stepper.update();
+    logic.update();
+    eventBus.dispatch();
+}
+
+static void runUntil(FeedingState state, uint32_t maxSteps = 2000000) {
+    for (uint32_t i = 0; i < maxSteps && logic.getState() != state; i++) {
+        step();
+    }
+}
+
+// El compartimento bajo el agujero vacío: la ración está en otro y la
+// vuelta a uno vacío es un movimiento de verdad (pasa por RETURNING)
+static void emptyCurrentCompartment() {
+    TEST_ASSERT_TRUE(logic.editInventory(stepper.getCurrentCompartment(), false, 0));
+}
+
+static void runUntilIdle() {
+    for (uint32_t i = 0; i < 2000000; i++) {
+        step();
+        if (logic.getState() == FEEDING_IDLE && !logic.isFeedingInProgress() && !stepper.isMotorMoving()) {
+            break;
+        }
+    }
+}
+
+// ===== Tabla de juguete para las comprobaciones en compilación =====
+
+enum ToyState { TOY_A, TOY_B, TOY_C, TOY_STATE_COUNT };
+enum ToyEvent { TOY_GO, TOY_BACK };
+
+struct Toy {
+    bool flag = false;
+    bool isFlag() const { return flag; }
+};
+
+typedef StateTable<Toy, ToyState, ToyEvent> ToyTable;
+
+static constexpr ToyTable::StateInfo toyStates[] = {
+    { TOY_A, "A", nullptr, nullptr, nullptr },
+    { TOY_B, "B", nullptr, nullptr, nullptr },
+    { TOY_C, "C", nullptr, nullptr, nullptr },
+};
+
+static constexpr ToyTable::StateInfo toyStatesSwapped[] = {
+    { TOY_A, "A", nullptr, nullptr, nullptr },
+    { TOY_C, "C", nullptr, nullptr, nullptr },
+    { TOY_B, "B", nullptr, nullptr, nullptr },
+};
+
+static constexpr ToyTable::Transition toyTransitions[] = {
+    { TOY_A, TOY_GO,   &Toy::isFlag, TOY_C },
+    { TOY_A, TOY_GO,   nullptr,      TOY_B },
+    { TOY_B, TOY_GO,   nullptr,      TOY_C },
+    { TOY_C, TOY_BACK, nullptr,      TOY_A },
+};
+
+// C solo vuelve a sí mismo: callejón sin salida
+static constexpr ToyTable::Transition toyDeadEnd[] = {
+    { TOY_A, TOY_GO,   nullptr, TOY_B },
+    { TOY_B, TOY_GO,   nullptr, TOY_C },
+    { TOY_C, TOY_BACK, nullptr, TOY_C },
+};
+
+// La segunda de A con TOY_GO nunca se aplica
+static constexpr ToyTable::Transition toyShadowed[] = {
+    { TOY_A, TOY_GO,   nullptr,      TOY_B },
+    { TOY_A, TOY_GO,   &Toy::isFlag, TOY_C },
+    { TOY_B, TOY_GO,   nullptr,      TOY_C },
+    { TOY_C, TOY_BACK, nullptr,      TOY_A },
+};
+
+static_assert(ToyTable::indexed(toyStates, TOY_STATE_COUNT), "indexed");
+static_assert(!ToyTable::indexed(toyStatesSwapped, TOY_STATE_COUNT), "indexed (desordenada)");
+static_assert(ToyTable::leavable(toyTransitions, 4, TOY_STATE_COUNT), "leavable");
+static_assert(!ToyTable::leavable(toyDeadEnd, 3, TOY_STATE_COUNT), "leavable (callejón)");
+static_assert(ToyTable::unshadowed(toyTransitions, 4), "unshadowed");
+static_assert(!ToyTable::unshadowed(toyShadowed, 4), "unshadowed (tapada)");
+
+void setUp(void) {
+    memset(visited, 0, sizeof(visited));
+    completions = 0;
+    logic.enableSound(true);
+    logic.requirePresence(true);
+    logic.setMaxWaitTime(MAX_WAIT_TIME_AFTER_SOUND);
+    logic.getInventory().fillAll(50, 0);
+    PirSensor::simulateLevel(false);
+}
+
+void tearDown(void) {
+    runUntilIdle();
+}
+
+void test_table_find_uses_guards(void) {
+    Toy toy;
+    const ToyTable::Transition* transition = ToyTable::find(toyTransitions, 4, toy, TOY_A, TOY_GO);
+    TEST_ASSERT_NOT_NULL(transition);
+    TEST_ASSERT_EQUAL(TOY_B, transition->to);
+
+    toy.flag = true;
+    transition = ToyTable::find(toyTransitions, 4, toy, TOY_A, TOY_GO);
+    TEST_ASSERT_NOT_NULL(transition);
+    TEST_ASSERT_EQUAL(TOY_C, transition->to);
+
+    // Evento sin transición desde ese estado: se ignora
+    TEST_ASSERT_NULL(ToyTable::find(toyTransitions, 4, toy, TOY_B, TOY_BACK));
+}
+
+void test_scheduled_feeding_with_alert_and_presence(void) {
+    emptyCurrentCompartment();
+    TEST_ASSERT_EQUAL(FEEDING_REQUEST_STARTED, logic.requestFeeding(FEEDING_SOURCE_SCHEDULED));
+    runUntil(FEEDING_WAITING_PRESENCE);
+    TEST_ASSERT_EQUAL(FEEDING_WAITING_PRESENCE, logic.getState());
+    TEST_ASSERT_TRUE(visited[FEEDING_SOUND_ALERT]);
+
+    // Sin mascota no se mueve nada
+    for (int i = 0; i < 1000; i++) step();
+    TEST_ASSERT_EQUAL(FEEDING_WAITING_PRESENCE, logic.getState());
+    TEST_ASSERT_FALSE(stepper.isMotorMoving());
+
+    PirSensor::simulateLevel(true);
+    runUntilIdle();
+
+    for (int state = FEEDING_SOUND_ALERT; state <= FEEDING_COMPLETE; state++) {
+        TEST_ASSERT_TRUE_MESSAGE(visited[state], FeedingLogic::getStateName((FeedingState)state));
+    }
+    TEST_ASSERT_FALSE(visited[FEEDING_ERROR]);
+    TEST_ASSERT_TRUE(visited[FEEDING_IDLE]);
+    TEST_ASSERT_EQUAL(1, completions);
+    TEST_ASSERT_EQUAL(TOTAL_COMPARTMENTS - 2, logic.getInventory().getFilledCount());
+}
+
+void test_manual_feeding_skips_alert_wait(void) {
+    logic.enableSound(false);
+    TEST_ASSERT_EQUAL(FEEDING_REQUEST_STARTED, logic.requestFeeding(FEEDING_SOURCE_WEB));
+    runUntilIdle();
+
+    TEST_ASSERT_FALSE(visited[FEEDING_SOUND_ALERT]);
+    TEST_ASSERT_FALSE(visited[FEEDING_WAITING_PRESENCE]);
+    TEST_ASSERT_TRUE(visited[FEEDING_MOVING_CAROUSEL]);
+    TEST_ASSERT_TRUE(visited[FEEDING_COMPLETE]);
+    TEST_ASSERT_EQUAL(1, completions);
+}
+
+void test_presence_timeout_fails(void) {
+    logic.enableSound(false);
+    logic.setMaxWaitTime(500);
+    TEST_ASSERT_EQUAL(FEEDING_REQUEST_STARTED, logic.requestFeeding(FEEDING_SOURCE_SCHEDULED));
+    runUntilIdle();
+
+    TEST_ASSERT_TRUE(visited[FEEDING_WAITING_PRESENCE]);
+    TEST_ASSERT_TRUE(visited[FEEDING_ERROR]);
+    TEST_ASSERT_FALSE(visited[FEEDING_MOVING_CAROUSEL]);
+    TEST_ASSERT_EQUAL(0, completions);
+    TEST_ASSERT_EQUAL(TOTAL_COMPARTMENTS, logic.getInventory().getFilledCount());
+}
+
+void test_cancel_while_moving(void) {
+    logic.enableSound(false);
+    TEST_ASSERT_EQUAL(FEEDING_REQUEST_STARTED, logic.requestFeeding(FEEDING_SOURCE_WEB));
+    runUntil(FEEDING_MOVING_CAROUSEL);
+    step();
+    TEST_ASSERT_TRUE(stepper.isMotorMoving());
+
+    logic.cancelFeeding();
+    runUntilIdle();
+
+    TEST_ASSERT_TRUE(visited[FEEDING_ERROR]);
+    TEST_ASSERT_FALSE(visited[FEEDING_COMPLETE]);
+    TEST_ASSERT_FALSE(stepper.isMotorMoving());
+    TEST_ASSERT_EQUAL(0, completions);
+}
+
+void test_timer_failure_dispenses_nothing(void) {
+    logic.enableSound(false);
+    int compartment = stepper.getCurrentCompartment();
+    StepTimer::failNextStart();
+    TEST_ASSERT_EQUAL(FEEDING_REQUEST_STARTED, logic.requestFeeding(FEEDING_SOURCE_WEB));
+    runUntilIdle();
+
+    // Sin pasos no hay movimiento completado ni compartimentos vaciados
+    TEST_ASSERT_TRUE(visited[FEEDING_ERROR]);
+    TEST_ASSERT_FALSE(visited[FEEDING_DISPENSING]);
+    TEST_ASSERT_EQUAL(0, completions);
+    TEST_ASSERT_EQUAL(TOTAL_COMPARTMENTS, logic.getInventory().getFilledCount());
+    TEST_ASSERT_EQUAL(compartment, stepper.getCurrentCompartment());
+    TEST_ASSERT_FALSE(StepTimer::isEnabled());
+
+    // La siguiente ya arranca
+    memset(visited, 0, sizeof(visited));
+    TEST_ASSERT_EQUAL(FEEDING_REQUEST_STARTED, logic.requestFeeding(FEEDING_SOURCE_WEB));
+    runUntilIdle();
+    TEST_ASSERT_EQUAL(1, completions);
+}
+
+void test_every_state_reachable_and_left(void) {
+    bool reached[FEEDING_STATE_COUNT] = {};
+    TraceRecord records[TRACE_CAPACITY];
+
+    feedingTrace.clear();
+    emptyCurrentCompartment();
+    logic.requestFeeding(FEEDING_SOURCE_SCHEDULED);
+    runUntil(FEEDING_WAITING_PRESENCE);
+    PirSensor::simulateLevel(true);
+    runUntilIdle();
+    PirSensor::simulateLevel(false);
+    logic.requestFeeding(FEEDING_SOURCE_WEB);
+    runUntil(FEEDING_MOVING_CAROUSEL);
+    logic.cancelFeeding();
+    runUntilIdle();
+
+    // Cada estado se alcanza y se abandona, y la traza cuadra con la tabla
+    uint16_t count = feedingTrace.snapshot(records, TRACE_CAPACITY);
+    for (uint16_t i = 0; i < count; i++) {
+        if (records[i].source != TRACE_SOURCE_FEEDING) continue;
+        reached[records[i].next] = true;
+        TEST_ASSERT_NOT_EQUAL(records[i].state, records[i].next);
+    }
+    for (int state = 0; state < FEEDING_STATE_COUNT; state++) {
+        TEST_ASSERT_TRUE_MESSAGE(reached[state], FeedingLogic::getStateName((FeedingState)state));
+    }
+    TEST_ASSERT_EQUAL(-1, logic.replay(records, count));
+}
+
+int main() {
+    eventBus.subscribe(EVENT_FEEDING_STATE, onFeedingState);
+    eventBus.subscribe(EVENT_FEEDING_COMPLETE, onFeedingComplete);
+    stepper.begin();
+    sensors.begin();
+    stepper.calibrate();
+    logic.begin();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_table_find_uses_guards);
+    RUN_TEST(test_scheduled_feeding_with_alert_and_presence);
+    RUN_TEST(test_manual_feeding_skips_alert_wait);
+    RUN_TEST(test_presence_timeout_fails);
+    RUN_TEST(test_cancel_while_moving);
+    RUN_TEST(test_timer_failure_dispenses_nothing);
+    RUN_TEST(test_every_state_reachable_and_left);
+    return UNITY_END();
+}
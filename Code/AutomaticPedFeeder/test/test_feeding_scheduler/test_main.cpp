@@ -0,0 +1,183 @@
+// Tomas a horas fijas y cambios de horario de verano (env:native)
+//   pio test -e native -f test_feeding_scheduler
+
+#include <unity.h>
+#include "feeding/FeedingScheduler.h"
+#include "utils/TimeUtils.h"
+
+static StepperController stepper;
+static SensorManager sensors;
+static FeedingLogic logic(&stepper, &sensors);
+
+#define MAX_FEEDS 32
+
+static struct tm fed[MAX_FEEDS];
+static int feedCount;
+static int newDays;
+
+static void onScheduledFeeding(const Event& /*event*/) {
+    time_t now = TimeUtils::now();
+    if (feedCount < MAX_FEEDS) localtime_r(&now, &fed[feedCount]);
+    feedCount++;
+}
+
+static void onNewDay(const Event& /*event*/) {
+    newDays++;
+}
+
+static time_t localTime(int year, int month, int day, int hour, int minute) {
+    struct tm local = {};
+    local.tm_year = year - 1900;
+    local.tm_mon = month - 1;
+    local.tm_mday = day;
+    local.tm_hour = hour;
+    local.tm_min = minute;
+    local.tm_isdst = -1;
+    return mktime(&local);
+}
+
+// Avanza la hora de 30 en 30 s; las peticiones se descartan sin mover nada
+static void runUntil(FeedingScheduler& scheduler, time_t end) {
+    while (TimeUtils::now() < end) {
+        TimeUtils::setSimulatedTime(TimeUtils::now() + 30);
+        MonotonicClock::advance(30000000ULL);
+        scheduler.update();
+        eventBus.dispatch();
+        logic.cancelFeeding();
+        logic.update();
+        eventBus.dispatch();
+    }
+}
+
+void setUp(void) {
+    feedCount = 0;
+    newDays = 0;
+    logic.getInventory().fillAll(50, 0);
+}
+
+void tearDown(void) {
+}
+
+void test_parse_and_format_slots(void) {
+    FeedingSlot slots[FEEDING_MAX_SLOTS];
+    uint8_t count = 0;
+    TEST_ASSERT_TRUE(FeedingScheduler::parseSlots("08:00, 13:00 lmxjv,20:30", slots, count));
+    TEST_ASSERT_EQUAL(3, count);
+    TEST_ASSERT_EQUAL(13, slots[1].hour);
+    TEST_ASSERT_EQUAL(0x3E, slots[1].weekdays);  // Lunes a viernes
+    TEST_ASSERT_EQUAL(ALL_WEEKDAYS, slots[2].weekdays);
+    TEST_ASSERT_EQUAL(30, slots[2].minute);
+    TEST_ASSERT_EQUAL_STRING("08:00, 13:00 LMXJV, 20:30", FeedingScheduler::formatSlots(slots, count).c_str());
+
+    // Domingo al final, como se lee de lunes a domingo
+    TEST_ASSERT_TRUE(FeedingScheduler::parseSlots("9:05 DS", slots, count));
+    TEST_ASSERT_EQUAL_STRING("09:05 SD", FeedingScheduler::formatSlots(slots, count).c_str());
+
+    // Vacío: modo cada N horas
+    TEST_ASSERT_TRUE(FeedingScheduler::parseSlots("", slots, count));
+    TEST_ASSERT_EQUAL(0, count);
+
+    TEST_ASSERT_FALSE(FeedingScheduler::parseSlots("25:00", slots, count));
+    TEST_ASSERT_FALSE(FeedingScheduler::parseSlots("08:60", slots, count));
+    TEST_ASSERT_FALSE(FeedingScheduler::parseSlots("08:00 Q", slots, count));
+    TEST_ASSERT_FALSE(FeedingScheduler::parseSlots("ocho", slots, count));
+
+    // Un horario que no se entiende no cambia el actual
+    FeedingScheduler scheduler(&logic);
+    TEST_ASSERT_TRUE(scheduler.setFeedingSlots("07:30, 19:30"));
+    TEST_ASSERT_FALSE(scheduler.setFeedingSlots("07:30, 99:00"));
+    TEST_ASSERT_EQUAL_STRING("07:30, 19:30", scheduler.getFeedingSlots().c_str());
+}
+
+void test_weekday_slots(void) {
+    FeedingScheduler scheduler(&logic);
+    scheduler.setMaxFeedingsPerDay(10);
+    TimeUtils::setSimulatedTime(localTime(2026, 5, 4, 0, 0));  // Lunes
+    TEST_ASSERT_TRUE(scheduler.setFeedingSlots("08:00, 13:00 LMXJV, 20:00"));
+
+    runUntil(scheduler, localTime(2026, 5, 11, 0, 0));
+
+    // Dos al día y la de mediodía solo entre semana
+    TEST_ASSERT_EQUAL(7 * 2 + 5, feedCount);
+    TEST_ASSERT_EQUAL(7, newDays);
+    for (int i = 0; i < feedCount; i++) {
+        if (fed[i].tm_hour == 13) {
+            TEST_ASSERT_TRUE(fed[i].tm_wday >= 1 && fed[i].tm_wday <= 5);
+        }
+        TEST_ASSERT_EQUAL(0, fed[i].tm_min);
+    }
+}
+
+void test_march_nonexistent_hour_moves_on(void) {
+    // 29/03/2026: de 02:00 CET se pasa a 03:00 CEST
+    FeedingScheduler scheduler(&logic);
+    scheduler.setMaxFeedingsPerDay(10);
+    TimeUtils::setSimulatedTime(localTime(2026, 3, 28, 12, 0));
+    TEST_ASSERT_TRUE(scheduler.setFeedingSlots("02:30, 08:00"));
+
+    runUntil(scheduler, localTime(2026, 3, 30, 0, 0));
+
+    // La de las 02:30 no existe ese día: se da al pasar la hora, sin perderla
+    TEST_ASSERT_EQUAL(2, feedCount);
+    TEST_ASSERT_EQUAL(29, fed[0].tm_mday);
+    TEST_ASSERT_EQUAL(3, fed[0].tm_hour);
+    TEST_ASSERT_TRUE(fed[0].tm_isdst > 0);
+    TEST_ASSERT_EQUAL(29, fed[1].tm_mday);
+    TEST_ASSERT_EQUAL(8, fed[1].tm_hour);
+    TEST_ASSERT_EQUAL(2, newDays);
+}
+
+void test_october_repeated_hour_fires_once(void) {
+    // 25/10/2026: a las 03:00 CEST se vuelve a las 02:00 CET
+    FeedingScheduler scheduler(&logic);
+    scheduler.setMaxFeedingsPerDay(10);
+    TimeUtils::setSimulatedTime(localTime(2026, 10, 24, 12, 0));
+    TEST_ASSERT_TRUE(scheduler.setFeedingSlots("02:30"));
+
+    runUntil(scheduler, localTime(2026, 10, 26, 0, 0));
+
+    TEST_ASSERT_EQUAL(1, feedCount);
+    TEST_ASSERT_EQUAL(25, fed[0].tm_mday);
+    TEST_ASSERT_EQUAL(2, fed[0].tm_hour);
+    TEST_ASSERT_EQUAL(30, fed[0].tm_min);
+    TEST_ASSERT_EQUAL(2, newDays);
+
+    // Y al día siguiente vuelve a la normalidad
+    runUntil(scheduler, localTime(2026, 10, 27, 0, 0));
+    TEST_ASSERT_EQUAL(2, feedCount);
+    TEST_ASSERT_EQUAL(26, fed[1].tm_mday);
+}
+
+void test_clock_jump_skips_stale_slot(void) {
+    FeedingScheduler scheduler(&logic);
+    scheduler.setMaxFeedingsPerDay(10);
+    TimeUtils::setSimulatedTime(localTime(2026, 6, 1, 7, 0));
+    TEST_ASSERT_TRUE(scheduler.setFeedingSlots("08:00, 20:00"));
+    runUntil(scheduler, localTime(2026, 6, 1, 7, 30));
+
+    // La hora salta por encima de las 08:00 más allá del margen: se omite
+    TimeUtils::stepSimulatedTime(localTime(2026, 6, 1, 9, 0));
+    eventBus.dispatch();
+    scheduler.invalidate();
+    runUntil(scheduler, localTime(2026, 6, 1, 21, 0));
+
+    TEST_ASSERT_EQUAL(1, feedCount);
+    TEST_ASSERT_EQUAL(20, fed[0].tm_hour);
+}
+
+int main() {
+    TimeUtils::init();
+    eventBus.subscribe(EVENT_SCHEDULED_FEEDING, onScheduledFeeding);
+    eventBus.subscribe(EVENT_NEW_DAY, onNewDay);
+    logic.begin();
+    logic.enableSound(false);
+    logic.requirePresence(false);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_and_format_slots);
+    RUN_TEST(test_weekday_slots);
+    RUN_TEST(test_march_nonexistent_hour_moves_on);
+    RUN_TEST(test_october_repeated_hour_fires_once);
+    RUN_TEST(test_clock_jump_skips_stale_slot);
+    return UNITY_END();
+}
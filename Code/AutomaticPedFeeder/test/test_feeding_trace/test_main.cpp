@@ -0,0 +1,165 @@
+// Traza de alimentación: volcado hexadecimal y reproducción (env:native)
+//   pio test -e native -f test_feeding_trace
+
+#include <unity.h>
+#include "feeding/FeedingLogic.h"
+#include "hardware/StepperController.h"
+#include "hardware/SensorManager.h"
+#include "utils/FeedingTrace.h"
+
+static StepperController stepper;
+static SensorManager sensors;
+
+static TraceRecord feedingRecord(FeedingState from, FeedingEvent event, FeedingState to,
+                                 uint8_t flags) {
+    TraceRecord entry = {};
+    entry.source = TRACE_SOURCE_FEEDING;
+    entry.state = from;
+    entry.event = event;
+    entry.next = to;
+    entry.compartment = -1;
+    entry.flags = flags;
+    entry.temperature = TRACE_NO_TEMPERATURE;
+    entry.humidity = TRACE_NO_HUMIDITY;
+    return entry;
+}
+
+// Una toma programada completa, con alerta y espera de presencia, y los
+// registros del motor intercalados (la reproducción los salta)
+static uint16_t buildFeeding(TraceRecord* out) {
+    const uint8_t guards = TRACE_FLAG_SOUND_ENABLED | TRACE_FLAG_PRESENCE_NEEDED;
+    uint16_t n = 0;
+    out[n++] = feedingRecord(FEEDING_IDLE, FEEDING_EV_START, FEEDING_SOUND_ALERT, guards);
+    out[n++] = feedingRecord(FEEDING_SOUND_ALERT, FEEDING_EV_ALERT_DONE, FEEDING_WAITING_PRESENCE, guards);
+    out[n++] = feedingRecord(FEEDING_WAITING_PRESENCE, FEEDING_EV_PRESENCE, FEEDING_MOVING_CAROUSEL,
+                             guards | TRACE_FLAG_PRESENCE);
+
+    TraceRecord motor = {};
+    motor.source = TRACE_SOURCE_MOTOR;
+    motor.state = 1;
+    motor.event = MOTOR_TRACE_START;
+    motor.next = 1;
+    motor.value = 1234;
+    out[n++] = motor;
+
+    out[n++] = feedingRecord(FEEDING_MOVING_CAROUSEL, FEEDING_EV_AT_HOLE, FEEDING_DISPENSING,
+                             guards | TRACE_FLAG_DISPENSE_QUEUED | TRACE_FLAG_MOTOR_MOVING);
+    out[n++] = feedingRecord(FEEDING_DISPENSING, FEEDING_EV_RETURNING, FEEDING_RETURNING,
+                             guards | TRACE_FLAG_DISPENSE_QUEUED | TRACE_FLAG_MOTOR_MOVING);
+    out[n++] = feedingRecord(FEEDING_RETURNING, FEEDING_EV_DONE, FEEDING_COMPLETE,
+                             guards | TRACE_FLAG_DISPENSE_QUEUED);
+    out[n++] = feedingRecord(FEEDING_COMPLETE, FEEDING_EV_ACK, FEEDING_IDLE, guards);
+    return n;
+}
+
+// Mismo formato que /api/feeding/trace?format=hex, con saltos de línea
+// como los de un volcado copiado de la consola
+static String toHex(const TraceRecord* records, uint16_t count) {
+    static const char digits[] = "0123456789abcdef";
+    const uint8_t* bytes = (const uint8_t*)records;
+    String hex;
+    for (size_t i = 0; i < count * sizeof(TraceRecord); i++) {
+        hex += digits[bytes[i] >> 4];
+        hex += digits[bytes[i] & 0x0F];
+        if (i % 32 == 31) hex += "\n";
+    }
+    return hex;
+}
+
+void setUp(void) {
+    feedingTrace.clear();
+}
+
+void tearDown(void) {
+}
+
+void test_parse_hex_round_trip(void) {
+    TraceRecord records[16];
+    uint16_t count = buildFeeding(records);
+
+    TraceRecord parsed[16];
+    TEST_ASSERT_EQUAL(count, FeedingTrace::parseHex(toHex(records, count).c_str(), parsed, 16));
+    TEST_ASSERT_EQUAL(0, memcmp(records, parsed, count * sizeof(TraceRecord)));
+
+    // Sin sitio para todos: solo los registros completos que caben
+    TEST_ASSERT_EQUAL(3, FeedingTrace::parseHex(toHex(records, count).c_str(), parsed, 3));
+}
+
+void test_replay_matches_table(void) {
+    TraceRecord records[16];
+    uint16_t count = buildFeeding(records);
+    TraceRecord parsed[16];
+    count = FeedingTrace::parseHex(toHex(records, count).c_str(), parsed, 16);
+
+    FeedingLogic logic(&stepper, &sensors);
+    logic.begin();
+    TEST_ASSERT_EQUAL(-1, logic.replay(parsed, count));
+}
+
+void test_replay_uses_recorded_guards(void) {
+    // Sin sonido ni presencia START va directo al carrusel; con los flags
+    // de la traza original (sonido) ese destino ya no coincide
+    TraceRecord records[2];
+    records[0] = feedingRecord(FEEDING_IDLE, FEEDING_EV_START, FEEDING_MOVING_CAROUSEL, 0);
+    records[1] = feedingRecord(FEEDING_MOVING_CAROUSEL, FEEDING_EV_CANCEL, FEEDING_ERROR, 0);
+
+    FeedingLogic logic(&stepper, &sensors);
+    logic.begin();
+    TEST_ASSERT_EQUAL(-1, logic.replay(records, 2));
+
+    records[0].flags = TRACE_FLAG_SOUND_ENABLED;
+    TEST_ASSERT_EQUAL(0, logic.replay(records, 2));
+}
+
+void test_replay_reports_first_mismatch(void) {
+    TraceRecord records[16];
+    uint16_t count = buildFeeding(records);
+
+    FeedingLogic logic(&stepper, &sensors);
+    logic.begin();
+
+    // Destino que la tabla no da (el registro 3 es del motor)
+    records[4].next = FEEDING_COMPLETE;
+    TEST_ASSERT_EQUAL(4, logic.replay(records, count));
+
+    // Estado de origen que no sigue al destino anterior
+    records[4].next = FEEDING_DISPENSING;
+    records[5].state = FEEDING_MOVING_CAROUSEL;
+    TEST_ASSERT_EQUAL(5, logic.replay(records, count));
+
+    // Valores fuera de rango (volcado corrupto)
+    records[5].state = FEEDING_DISPENSING;
+    records[1].event = FEEDING_EVENT_COUNT;
+    TEST_ASSERT_EQUAL(1, logic.replay(records, count));
+}
+
+void test_replay_has_no_side_effects(void) {
+    TraceRecord records[16];
+    uint16_t count = buildFeeding(records);
+
+    FeedingLogic logic(&stepper, &sensors);
+    logic.begin();
+    int filled = logic.getInventory().getFilledCount();
+    uint32_t published = eventBus.getPublishedCount();
+    uint32_t traced = feedingTrace.getTotalRecorded();
+
+    // Empieza a mitad de una alimentación: no debe mover la máquina real
+    TEST_ASSERT_EQUAL(-1, logic.replay(records + 4, count - 4));
+
+    TEST_ASSERT_EQUAL(FEEDING_IDLE, logic.getState());
+    TEST_ASSERT_FALSE(logic.isFeedingInProgress());
+    TEST_ASSERT_EQUAL(filled, logic.getInventory().getFilledCount());
+    TEST_ASSERT_EQUAL(published, eventBus.getPublishedCount());
+    TEST_ASSERT_EQUAL(traced, feedingTrace.getTotalRecorded());
+    TEST_ASSERT_FALSE(stepper.isMotorMoving());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_hex_round_trip);
+    RUN_TEST(test_replay_matches_table);
+    RUN_TEST(test_replay_uses_recorded_guards);
+    RUN_TEST(test_replay_reports_first_mismatch);
+    RUN_TEST(test_replay_has_no_side_effects);
+    return UNITY_END();
+}
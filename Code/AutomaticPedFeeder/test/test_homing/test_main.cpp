@@ -0,0 +1,164 @@
+// Homing contra el modelo simulado del sensor de origen (env:native-homing,
+// que activa HOME_SENSOR_ENABLED y HOME_SENSOR_COMPARTMENT_MARKS)
+//   pio test -e native-homing -f test_homing
+
+#include <unity.h>
+#include "hardware/StepperController.h"
+#include "hardware/HomeSensor.h"
+
+#define HOME_WIDTH 40
+#define MARK_WIDTH 10
+
+static StepperController stepper;
+
+// Desviación real de cada compartimento (la que el homing debe aprender)
+static const int offsets[TOTAL_COMPARTMENTS] = { 0, 30, -25, 0, 50 };
+
+static int calibrations;
+static bool lastCalibration;
+static String lastError;
+
+static void onCalibration(const Event& event) {
+    calibrations++;
+    lastCalibration = event.success();
+}
+
+static void onMotorError(const Event& event) {
+    lastError = event.text;
+}
+
+static long wrap(long steps) {
+    long turn = STEPS_PER_CAROUSEL_TURN;
+    steps %= turn;
+    if (steps > turn / 2) steps -= turn;
+    if (steps <= -turn / 2) steps += turn;
+    return steps;
+}
+
+// Marcas en posiciones físicas: la de origen (más ancha) en 'home'
+static void placeMarks(int32_t home) {
+    HomeSensor::simulateClear();
+    HomeSensor::simulateMark(home, HOME_WIDTH);
+    for (int i = 1; i < TOTAL_COMPARTMENTS; i++) {
+        HomeSensor::simulateMark(home + i * STEPS_PER_COMPARTMENT + offsets[i], MARK_WIDTH);
+    }
+}
+
+static void runWhileBusy() {
+    for (uint32_t i = 0; i < 2000000 && (stepper.isCalibrating() || stepper.isMotorMoving()); i++) {
+        StepTimer::advance(50);
+        stepper.update();
+        eventBus.dispatch();
+    }
+    eventBus.dispatch();
+}
+
+void setUp(void) {
+    calibrations = 0;
+    lastCalibration = false;
+    lastError = "";
+}
+
+void tearDown(void) {
+    if (stepper.getState() != MOTOR_IDLE) stepper.stopMotor();
+}
+
+void test_homing_learns_offsets(void) {
+    // El contador no sabe dónde está el carrusel: el origen queda a 1000
+    int32_t home = HomeSensor::simulatedPosition() + 1000;
+    placeMarks(home);
+
+    TEST_ASSERT_TRUE(stepper.calibrate());
+    TEST_ASSERT_TRUE(stepper.isCalibrating());
+    runWhileBusy();
+
+    TEST_ASSERT_EQUAL(1, calibrations);
+    TEST_ASSERT_TRUE(lastCalibration);
+    TEST_ASSERT_TRUE(stepper.isHomed());
+    TEST_ASSERT_EQUAL(MOTOR_IDLE, stepper.getState());
+    TEST_ASSERT_EQUAL(0, stepper.getCurrentCompartment());
+
+    // Aparcado en el flanco de origen, con las desviaciones aprendidas
+    TEST_ASSERT_EQUAL_INT32(0, wrap(HomeSensor::simulatedPosition() - home));
+    TEST_ASSERT_TRUE(HomeSensor::isActive());
+    for (int i = 0; i < TOTAL_COMPARTMENTS; i++) {
+        TEST_ASSERT_EQUAL(offsets[i], stepper.getCompartmentOffset(i));
+    }
+
+    // Las rutas ya llevan la desviación de cada compartimento
+    for (int i = 1; i < TOTAL_COMPARTMENTS; i++) {
+        TEST_ASSERT_TRUE(stepper.moveToCompartment(i));
+        runWhileBusy();
+        TEST_ASSERT_EQUAL(i, stepper.getCurrentCompartment());
+        TEST_ASSERT_EQUAL_INT32(0, wrap(HomeSensor::simulatedPosition() -
+                                        (home + i * STEPS_PER_COMPARTMENT + offsets[i])));
+        TEST_ASSERT_TRUE(HomeSensor::isActive());
+    }
+}
+
+void test_homing_reports_position_error(void) {
+    // Pasos perdidos (o un corte a mitad de movimiento): el carrusel está
+    // 200 micropasos por detrás de donde cree el contador
+    TEST_ASSERT_TRUE(stepper.moveToCompartment(0));
+    runWhileBusy();
+    int32_t home = HomeSensor::simulatedPosition() + 200;
+    placeMarks(home);
+
+    TEST_ASSERT_TRUE(stepper.calibrate());
+    runWhileBusy();
+
+    TEST_ASSERT_TRUE(lastCalibration);
+    TEST_ASSERT_EQUAL(200, stepper.getLastHomingError());
+    TEST_ASSERT_EQUAL_INT32(0, wrap(HomeSensor::simulatedPosition() - home));
+}
+
+void test_homing_without_sensor_fails(void) {
+    HomeSensor::simulateClear();
+
+    TEST_ASSERT_TRUE(stepper.calibrate());
+    runWhileBusy();
+
+    // Una vuelta entera sin flancos
+    TEST_ASSERT_EQUAL(1, calibrations);
+    TEST_ASSERT_FALSE(lastCalibration);
+    TEST_ASSERT_FALSE(stepper.isHomed());
+    TEST_ASSERT_EQUAL(MOTOR_ERROR, stepper.getState());
+    TEST_ASSERT_EQUAL_STRING("Sensor de origen no detectado", lastError.c_str());
+}
+
+void test_homing_timeout(void) {
+    placeMarks(HomeSensor::simulatedPosition() + 1000);
+    TEST_ASSERT_TRUE(stepper.calibrate());
+
+    // El timer no entrega ticks: el plazo de seguridad corta la búsqueda
+    MonotonicClock::advance((uint64_t)(stepper.getPlannedDuration() + 30001) * 1000);
+    stepper.update();
+    eventBus.dispatch();
+
+    TEST_ASSERT_EQUAL(1, calibrations);
+    TEST_ASSERT_FALSE(lastCalibration);
+    TEST_ASSERT_FALSE(stepper.isCalibrating());
+    TEST_ASSERT_EQUAL(MOTOR_ERROR, stepper.getState());
+    TEST_ASSERT_EQUAL_STRING("Timeout en la búsqueda del origen", lastError.c_str());
+    TEST_ASSERT_FALSE(StepTimer::isEnabled());
+
+    // Y se puede volver a intentar
+    TEST_ASSERT_TRUE(stepper.calibrate());
+    runWhileBusy();
+    TEST_ASSERT_TRUE(lastCalibration);
+}
+
+int main() {
+    static_assert(HOME_SENSOR_ENABLED && HOME_SENSOR_COMPARTMENT_MARKS,
+                  "test_homing necesita env:native-homing");
+    eventBus.subscribe(EVENT_CALIBRATION_COMPLETE, onCalibration);
+    eventBus.subscribe(EVENT_MOTOR_ERROR, onMotorError);
+    stepper.begin();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_homing_learns_offsets);
+    RUN_TEST(test_homing_reports_position_error);
+    RUN_TEST(test_homing_without_sensor_fails);
+    RUN_TEST(test_homing_timeout);
+    return UNITY_END();
+}
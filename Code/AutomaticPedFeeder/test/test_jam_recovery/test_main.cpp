@@ -0,0 +1,175 @@
+// Detección de atascos por el sensor de origen y retroceso para soltar el
+// pienso (env:native). Con HOME_SENSOR_ENABLED en false StepperController no
+// arma la vigilancia, así que se prueba directamente sobre StepEngine con
+// las mismas marcas y ventana que usaría armStallSupervision()
+//   pio test -e native -f test_jam_recovery
+
+#include <unity.h>
+#include "hardware/StepEngine.h"
+
+#define MARK_WIDTH 20
+#define SUPERVISION_WINDOW (STEPS_PER_COMPARTMENT + 2 * JAM_EDGE_TOLERANCE_STEPS)
+
+static StepEngine engine;
+static int32_t expectedMarks[TOTAL_COMPARTMENTS];
+
+static MotionSegment fineMove(long steps, SensorAction sensorAction, int8_t notifyCommand) {
+    MotionSegment segment = {};
+    segment.type = SEGMENT_MOVE;
+    segment.schedule.ramp = nullptr;
+    segment.schedule.rampSteps = 0;
+    segment.schedule.cruiseTicks = 2;
+    segment.schedule.totalSteps = abs(steps);
+    segment.schedule.direction = steps > 0 ? 1 : -1;
+    segment.stepSize = 1;
+    segment.sensorAction = sensorAction;
+    segment.microsteps = MICROSTEPS;
+    segment.notifyCommand = notifyCommand;
+    return segment;
+}
+
+static void runUntilIdle() {
+    for (uint32_t i = 0; i < 1000000 && engine.isRunning(); i++) {
+        StepTimer::advance(1);
+    }
+    engine.releaseTimer();
+}
+
+// Una marca por compartimento a partir de la posición física actual, que
+// pasa a ser el cero del contador (parado sobre la marca del compartimento 0)
+static int32_t placeMarks(int displaced, int32_t shift) {
+    int32_t origin = HomeSensor::simulatedPosition();
+    HomeSensor::simulateClear();
+    for (int k = 0; k < TOTAL_COMPARTMENTS; k++) {
+        int32_t position = origin + k * STEPS_PER_COMPARTMENT + (k == displaced ? shift : 0);
+        HomeSensor::simulateMark(position, MARK_WIDTH);
+        expectedMarks[k] = k * STEPS_PER_COMPARTMENT;
+    }
+    engine.setPosition(0);
+    engine.setStallSupervision(expectedMarks, TOTAL_COMPARTMENTS, SUPERVISION_WINDOW);
+    return origin;
+}
+
+void setUp(void) {
+    engine.begin();
+    HomeSensor::simulateJam(0, 0);
+    int8_t command;
+    while (engine.popCompleted(command)) {
+    }
+}
+
+void tearDown(void) {
+    engine.setStallSupervision(nullptr, 0, 0);
+}
+
+void test_free_turn_has_no_stall(void) {
+    placeMarks(-1, 0);
+
+    TEST_ASSERT_TRUE(engine.enqueue(fineMove(STEPS_PER_CAROUSEL_TURN, SENSOR_IGNORE, 0)));
+    TEST_ASSERT_TRUE(engine.run());
+    runUntilIdle();
+
+    TEST_ASSERT_EQUAL(STALL_NONE, engine.getStallCause());
+    int8_t command;
+    TEST_ASSERT_TRUE(engine.popCompleted(command));
+    TEST_ASSERT_EQUAL(0, command);
+}
+
+void test_jam_detected_at_next_mark(void) {
+    int32_t origin = placeMarks(-1, 0);
+    HomeSensor::simulateJam(origin + STEPS_PER_COMPARTMENT + 100, 1);
+
+    TEST_ASSERT_TRUE(engine.enqueue(fineMove(3 * STEPS_PER_COMPARTMENT, SENSOR_IGNORE, -1)));
+    TEST_ASSERT_TRUE(engine.enqueue(fineMove(STEPS_PER_COMPARTMENT, SENSOR_IGNORE, 0)));
+    TEST_ASSERT_TRUE(engine.run());
+    runUntilIdle();
+
+    // El flanco del compartimento 2 no llega: atasco nada más pasar su tolerancia
+    TEST_ASSERT_EQUAL(STALL_SENSOR, engine.getStallCause());
+    TEST_ASSERT_EQUAL(1, engine.getStallDirection());
+    TEST_ASSERT_EQUAL_INT32(2 * STEPS_PER_COMPARTMENT + JAM_EDGE_TOLERANCE_STEPS, engine.getStallPosition());
+    TEST_ASSERT_EQUAL_INT32(origin + STEPS_PER_COMPARTMENT + 100, HomeSensor::simulatedPosition());
+
+    // El resto de la secuencia se descarta sin notificar
+    int8_t command;
+    TEST_ASSERT_FALSE(engine.popCompleted(command));
+    TEST_ASSERT_EQUAL(MOTION_QUEUE_SIZE - 1, engine.getFreeSlots());
+}
+
+void test_misplaced_edge_is_a_stall(void) {
+    // Marca del compartimento 1 desplazada más de la tolerancia (pasos perdidos)
+    placeMarks(1, JAM_EDGE_TOLERANCE_STEPS + 20);
+
+    TEST_ASSERT_TRUE(engine.enqueue(fineMove(2 * STEPS_PER_COMPARTMENT, SENSOR_IGNORE, 0)));
+    TEST_ASSERT_TRUE(engine.run());
+    runUntilIdle();
+
+    TEST_ASSERT_EQUAL(STALL_SENSOR, engine.getStallCause());
+
+    // Dentro de la tolerancia no salta
+    placeMarks(1, JAM_EDGE_TOLERANCE_STEPS - 5);
+    TEST_ASSERT_TRUE(engine.enqueue(fineMove(2 * STEPS_PER_COMPARTMENT, SENSOR_IGNORE, 0)));
+    TEST_ASSERT_TRUE(engine.run());
+    runUntilIdle();
+
+    TEST_ASSERT_EQUAL(STALL_NONE, engine.getStallCause());
+}
+
+void test_reverse_and_agitate_release_the_jam(void) {
+    // Atasco más allá del retroceso desde la marca del compartimento 1
+    int32_t origin = placeMarks(-1, 0);
+    int32_t jamAt = origin + STEPS_PER_COMPARTMENT + JAM_REVERSE_STEPS + 100;
+    HomeSensor::simulateJam(jamAt, 1);
+
+    TEST_ASSERT_TRUE(engine.enqueue(fineMove(3 * STEPS_PER_COMPARTMENT, SENSOR_IGNORE, 0)));
+    TEST_ASSERT_TRUE(engine.run());
+    runUntilIdle();
+    TEST_ASSERT_EQUAL(STALL_SENSOR, engine.getStallCause());
+
+    // La misma recuperación que StepperController::handleStall(): retroceso,
+    // vaivenes y búsqueda del flanco siguiente sin vigilancia
+    engine.setStallSupervision(nullptr, 0, 0);
+    TEST_ASSERT_TRUE(engine.enqueue(fineMove(-JAM_REVERSE_STEPS, SENSOR_IGNORE, -1)));
+    for (int cycle = 0; cycle < JAM_AGITATE_CYCLES; cycle++) {
+        TEST_ASSERT_TRUE(engine.enqueue(fineMove(AGITATE_STEPS, SENSOR_IGNORE, -1)));
+        TEST_ASSERT_TRUE(engine.enqueue(fineMove(-AGITATE_STEPS, SENSOR_IGNORE, -1)));
+    }
+    TEST_ASSERT_TRUE(engine.enqueue(fineMove(SUPERVISION_WINDOW, SENSOR_STOP, -1)));
+    TEST_ASSERT_TRUE(engine.run(true));
+    runUntilIdle();
+
+    // Suelto: la búsqueda pasa el atasco y para en el flanco del compartimento 2
+    TEST_ASSERT_EQUAL(STALL_NONE, engine.getStallCause());
+    TEST_ASSERT_FALSE(engine.wasSensorMissed());
+    TEST_ASSERT_TRUE(HomeSensor::simulatedPosition() > jamAt);
+    TEST_ASSERT_EQUAL(2 * STEPS_PER_COMPARTMENT,
+                      HomeSensor::simulatedPosition() - origin);
+}
+
+void test_persistent_jam_misses_the_edge(void) {
+    // Atasco entre dos marcas, más lejos de la primera que el retroceso
+    int32_t origin = placeMarks(-1, 0);
+    int32_t jamAt = origin + 2 * JAM_REVERSE_STEPS;
+    HomeSensor::simulateJam(jamAt, 3);
+
+    // Un retroceso no basta: la búsqueda vuelve al tope y no ve el flanco
+    TEST_ASSERT_TRUE(engine.enqueue(fineMove(3 * JAM_REVERSE_STEPS, SENSOR_IGNORE, -1)));
+    TEST_ASSERT_TRUE(engine.enqueue(fineMove(-JAM_REVERSE_STEPS, SENSOR_IGNORE, -1)));
+    TEST_ASSERT_TRUE(engine.enqueue(fineMove(SUPERVISION_WINDOW, SENSOR_STOP, -1)));
+    engine.setStallSupervision(nullptr, 0, 0);
+    TEST_ASSERT_TRUE(engine.run());
+    runUntilIdle();
+
+    TEST_ASSERT_TRUE(engine.wasSensorMissed());
+    TEST_ASSERT_EQUAL_INT32(jamAt, HomeSensor::simulatedPosition());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_free_turn_has_no_stall);
+    RUN_TEST(test_jam_detected_at_next_mark);
+    RUN_TEST(test_misplaced_edge_is_a_stall);
+    RUN_TEST(test_reverse_and_agitate_release_the_jam);
+    RUN_TEST(test_persistent_jam_misses_the_edge);
+    return UNITY_END();
+}
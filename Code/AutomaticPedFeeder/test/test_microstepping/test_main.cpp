@@ -0,0 +1,143 @@
+// Crucero en paso completo y aproximación en micropasos (env:native)
+//   pio test -e native -f test_microstepping
+
+#include <unity.h>
+#include "hardware/StepperController.h"
+#include "hardware/MotionTables.h"
+
+static StepperController stepper;
+
+// Pulsos de una secuencia según el nivel del pin MS al emitirlos
+struct PulseCount {
+    uint32_t coarse;        // MS en LOW: un pulso = MICROSTEPS micropasos
+    uint32_t fine;          // MS en HIGH: un pulso = un micropaso
+    uint32_t mismatched;    // Pulsos cuyo avance no corresponde al pin MS
+    uint32_t modeSwitches;
+};
+
+static PulseCount runUntilIdle() {
+    PulseCount count = {};
+    int32_t previous = HomeSensor::simulatedPosition();
+    int lastLevel = HIGH;  // Reposo en micropasos (el primer cambio ya es en run())
+    if (simPinLevels[STEPPER_MS_PIN] != lastLevel) {
+        count.modeSwitches++;
+        lastLevel = simPinLevels[STEPPER_MS_PIN];
+    }
+
+    for (uint32_t i = 0; i < 5000000 && stepper.isMotorMoving(); i++) {
+        StepTimer::advance(1);
+        stepper.update();
+
+        int level = simPinLevels[STEPPER_MS_PIN];
+        if (level != lastLevel) {
+            count.modeSwitches++;
+            lastLevel = level;
+        }
+
+        int32_t delta = HomeSensor::simulatedPosition() - previous;
+        previous = HomeSensor::simulatedPosition();
+        if (delta == 0) continue;
+        if (abs(delta) == MICROSTEPS && level == LOW) {
+            count.coarse++;
+        } else if (abs(delta) == 1 && level == HIGH) {
+            count.fine++;
+        } else {
+            count.mismatched++;
+        }
+    }
+    return count;
+}
+
+static long physicalPosition(int32_t origin) {
+    return StepperController::normalizePosition(HomeSensor::simulatedPosition() - origin);
+}
+
+void setUp(void) {
+    stepper.begin();
+    stepper.calibrate();
+}
+
+void tearDown(void) {
+}
+
+void test_cruise_in_full_steps(void) {
+    int32_t origin = HomeSensor::simulatedPosition();
+    TEST_ASSERT_EQUAL(HIGH, simPinLevels[STEPPER_MS_PIN]);
+
+    TEST_ASSERT_TRUE(stepper.moveToCompartment(2));
+    PulseCount count = runUntilIdle();
+
+    // Crucero completo a paso completo y solo el último paso en micropasos
+    TEST_ASSERT_EQUAL_UINT32(0, count.mismatched);
+    TEST_ASSERT_EQUAL_UINT32(MotionTables::coarseSteps(2), count.coarse);
+    TEST_ASSERT_EQUAL_UINT32(MICROSTEP_APPROACH_FULL_STEPS * MICROSTEPS, count.fine);
+    TEST_ASSERT_EQUAL_UINT32(2, count.modeSwitches);
+
+    // Termina en micropasos y en la posición exacta
+    TEST_ASSERT_EQUAL(HIGH, simPinLevels[STEPPER_MS_PIN]);
+    TEST_ASSERT_EQUAL(2, stepper.getCurrentCompartment());
+    TEST_ASSERT_EQUAL(2 * STEPS_PER_COMPARTMENT, physicalPosition(origin));
+}
+
+void test_unaligned_targets_stay_exact(void) {
+    // Correcciones por compartimento: destinos fuera de la fase de paso
+    // completo, que obligan a alinear al salir y a recortar la aproximación
+    const int offsets[TOTAL_COMPARTMENTS] = { 0, 5, -7, 11, 3 };
+    stepper.setCompartmentOffsets(offsets);
+    int32_t origin = HomeSensor::simulatedPosition();
+
+    const int route[] = { 1, 3, 4, 2, 0, 3, 1 };
+    for (int target : route) {
+        TEST_ASSERT_TRUE(stepper.moveToCompartment(target));
+        PulseCount count = runUntilIdle();
+
+        TEST_ASSERT_EQUAL_UINT32(0, count.mismatched);
+        TEST_ASSERT_TRUE(count.coarse > 0);
+        TEST_ASSERT_TRUE(count.fine < 2 * MICROSTEPS * (MICROSTEP_APPROACH_FULL_STEPS + 1));
+        TEST_ASSERT_EQUAL(HIGH, simPinLevels[STEPPER_MS_PIN]);
+        TEST_ASSERT_EQUAL(target, stepper.getCurrentCompartment());
+        TEST_ASSERT_EQUAL(StepperController::normalizePosition(target * STEPS_PER_COMPARTMENT + offsets[target]),
+                          physicalPosition(origin));
+    }
+
+    const int none[TOTAL_COMPARTMENTS] = {};
+    stepper.setCompartmentOffsets(none);
+}
+
+void test_short_moves_stay_in_microsteps(void) {
+    int32_t origin = HomeSensor::simulatedPosition();
+
+    // Agitar no compensa cambiar de modo: todo en micropasos
+    MotionCommand agitate = { MOTION_AGITATE, 0, 0, 2 };
+    TEST_ASSERT_TRUE(stepper.runSequence(&agitate, 1));
+    PulseCount count = runUntilIdle();
+
+    TEST_ASSERT_EQUAL_UINT32(0, count.mismatched);
+    TEST_ASSERT_EQUAL_UINT32(0, count.coarse);
+    TEST_ASSERT_EQUAL_UINT32(0, count.modeSwitches);
+    TEST_ASSERT_EQUAL_UINT32(4 * AGITATE_STEPS, count.fine);
+    TEST_ASSERT_EQUAL(0, physicalPosition(origin));
+}
+
+void test_stop_restores_microsteps(void) {
+    TEST_ASSERT_TRUE(stepper.moveToCompartment(2));
+
+    // Parar a mitad del crucero: el reposo siempre es en micropasos
+    for (int i = 0; i < 20000 && simPinLevels[STEPPER_MS_PIN] == HIGH; i++) {
+        StepTimer::advance(1);
+        stepper.update();
+    }
+    TEST_ASSERT_EQUAL(LOW, simPinLevels[STEPPER_MS_PIN]);
+    stepper.stopMotor();
+    TEST_ASSERT_EQUAL(HIGH, simPinLevels[STEPPER_MS_PIN]);
+    TEST_ASSERT_FALSE(stepper.isMotorMoving());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_cruise_in_full_steps);
+    RUN_TEST(test_unaligned_targets_stay_exact);
+    RUN_TEST(test_short_moves_stay_in_microsteps);
+    RUN_TEST(test_stop_restores_microsteps);
+    return UNITY_END();
+}
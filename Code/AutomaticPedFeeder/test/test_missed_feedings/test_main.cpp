@@ -0,0 +1,266 @@
+// Tomas perdidas con el comedero apagado, contador diario y estado que
+// sobrevive al reinicio (env:native)
+//   pio test -e native -f test_missed_feedings
+
+#include <unity.h>
+#include "feeding/FeedingScheduler.h"
+#include "utils/TimeUtils.h"
+
+static StepperController stepper;
+static SensorManager sensors;
+static FeedingLogic logic(&stepper, &sensors);
+
+static int feedCount;
+static time_t lastFedAt;
+static int32_t missedReported;
+static int32_t recoverReported;
+
+static void onScheduledFeeding(const Event& /*event*/) {
+    feedCount++;
+    lastFedAt = TimeUtils::now();
+}
+
+static void onMissedFeedings(const Event& event) {
+    missedReported = event.value;
+    recoverReported = event.detail;
+}
+
+static time_t localTime(int year, int month, int day, int hour, int minute) {
+    struct tm local = {};
+    local.tm_year = year - 1900;
+    local.tm_mon = month - 1;
+    local.tm_mday = day;
+    local.tm_hour = hour;
+    local.tm_min = minute;
+    local.tm_isdst = -1;
+    return mktime(&local);
+}
+
+static int32_t localDay(time_t t) {
+    struct tm local;
+    localtime_r(&t, &local);
+    return (local.tm_year + 1900) * 1000 + local.tm_yday;
+}
+
+// Avanza la hora de 30 en 30 s; las peticiones se descartan sin mover nada
+static void runUntil(FeedingScheduler& scheduler, time_t end) {
+    while (TimeUtils::now() < end) {
+        TimeUtils::setSimulatedTime(TimeUtils::now() + 30);
+        MonotonicClock::advance(30000000ULL);
+        scheduler.update();
+        eventBus.dispatch();
+        logic.cancelFeeding();
+        logic.update();
+        eventBus.dispatch();
+    }
+}
+
+// Apagado desde la noche anterior: las tres tomas de hoy se han perdido
+static void restoreAfterOutage(FeedingScheduler& scheduler, int policy) {
+    scheduler.setMaxFeedingsPerDay(10);
+    scheduler.setMissedFeedingPolicy(policy);
+    TEST_ASSERT_TRUE(scheduler.setFeedingSlots("08:00, 12:00, 16:00"));
+
+    TimeUtils::setSimulatedTime(localTime(2026, 5, 6, 17, 0));
+    scheduler.restore(localTime(2026, 5, 6, 8, 0), localTime(2026, 5, 5, 16, 0),
+                      localDay(localTime(2026, 5, 5, 12, 0)), 3, 0);
+    scheduler.update();
+    eventBus.dispatch();
+}
+
+void setUp(void) {
+    feedCount = 0;
+    lastFedAt = 0;
+    missedReported = -1;
+    recoverReported = -1;
+    logic.getInventory().fillAll(50, 0);
+}
+
+void tearDown(void) {
+}
+
+void test_policy_skip(void) {
+    FeedingScheduler scheduler(&logic);
+    restoreAfterOutage(scheduler, MISSED_FEEDING_SKIP);
+
+    TEST_ASSERT_EQUAL(3, missedReported);
+    TEST_ASSERT_EQUAL(0, recoverReported);
+    TEST_ASSERT_EQUAL(0, scheduler.getPendingCatchUp());
+
+    // Se sigue por la de mañana
+    runUntil(scheduler, localTime(2026, 5, 7, 7, 0));
+    TEST_ASSERT_EQUAL(0, feedCount);
+    TEST_ASSERT_EQUAL(localTime(2026, 5, 7, 8, 0), scheduler.getNextFeedingTime());
+}
+
+void test_policy_once(void) {
+    FeedingScheduler scheduler(&logic);
+    restoreAfterOutage(scheduler, MISSED_FEEDING_ONCE);
+
+    TEST_ASSERT_EQUAL(3, missedReported);
+    TEST_ASSERT_EQUAL(1, recoverReported);
+
+    runUntil(scheduler, localTime(2026, 5, 7, 7, 0));
+    TEST_ASSERT_EQUAL(1, feedCount);
+    TEST_ASSERT_TRUE(lastFedAt <= localTime(2026, 5, 6, 17, 1));
+
+    // El día anterior al apagado ya no cuenta en el de hoy
+    TEST_ASSERT_EQUAL(0, scheduler.getFeedingsTodayCount());
+}
+
+void test_policy_all_spaced(void) {
+    FeedingScheduler scheduler(&logic);
+    restoreAfterOutage(scheduler, MISSED_FEEDING_ALL);
+
+    TEST_ASSERT_EQUAL(3, missedReported);
+    TEST_ASSERT_EQUAL(3, recoverReported);
+
+    runUntil(scheduler, localTime(2026, 5, 6, 17, 50));
+    TEST_ASSERT_EQUAL(2, feedCount);
+    TEST_ASSERT_EQUAL(1, scheduler.getPendingCatchUp());
+
+    runUntil(scheduler, localTime(2026, 5, 7, 7, 0));
+    TEST_ASSERT_EQUAL(3, feedCount);
+    TEST_ASSERT_TRUE(lastFedAt >= localTime(2026, 5, 6, 17, 0) + 2 * MISSED_FEEDING_SPACING_MIN * 60);
+}
+
+void test_catch_up_fits_before_next_slot(void) {
+    // Vuelve a las 15:10: solo cabe una recuperación antes de las 16:00
+    FeedingScheduler scheduler(&logic);
+    scheduler.setMaxFeedingsPerDay(10);
+    scheduler.setMissedFeedingPolicy(MISSED_FEEDING_ALL);
+    TEST_ASSERT_TRUE(scheduler.setFeedingSlots("08:00, 12:00, 16:00"));
+    TimeUtils::setSimulatedTime(localTime(2026, 5, 6, 15, 10));
+    scheduler.restore(localTime(2026, 5, 6, 8, 0), 0, localDay(localTime(2026, 5, 6, 0, 0)), 0, 0);
+    eventBus.dispatch();
+
+    TEST_ASSERT_EQUAL(2, missedReported);
+    TEST_ASSERT_EQUAL(1, recoverReported);
+}
+
+void test_nothing_missed(void) {
+    FeedingScheduler scheduler(&logic);
+    scheduler.setMissedFeedingPolicy(MISSED_FEEDING_ALL);
+    TEST_ASSERT_TRUE(scheduler.setFeedingSlots("08:00, 20:00"));
+    TimeUtils::setSimulatedTime(localTime(2026, 5, 6, 10, 0));
+    scheduler.restore(localTime(2026, 5, 6, 20, 0), localTime(2026, 5, 6, 8, 0),
+                      localDay(localTime(2026, 5, 6, 0, 0)), 1, 0);
+    eventBus.dispatch();
+
+    TEST_ASSERT_EQUAL(-1, missedReported);
+    TEST_ASSERT_EQUAL(0, scheduler.getPendingCatchUp());
+    TEST_ASSERT_EQUAL(1, scheduler.getFeedingsTodayCount());
+}
+
+void test_single_daily_counter(void) {
+    FeedingScheduler scheduler(&logic);
+    scheduler.setMaxFeedingsPerDay(2);
+    TEST_ASSERT_TRUE(scheduler.setFeedingSlots("08:00, 12:00, 16:00"));
+    TimeUtils::setSimulatedTime(localTime(2026, 5, 6, 7, 0));
+    scheduler.update();
+
+    // Programadas o manuales, solo cuentan las completadas
+    runUntil(scheduler, localTime(2026, 5, 6, 9, 0));
+    TEST_ASSERT_EQUAL(1, feedCount);
+    TEST_ASSERT_EQUAL(0, scheduler.getFeedingsTodayCount());
+    scheduler.recordFeeding();
+    scheduler.recordFeeding();  // Una manual por la web
+    TEST_ASSERT_EQUAL(2, scheduler.getFeedingsTodayCount());
+
+    FeederConfig config = {};
+    scheduler.copyTo(config);
+    TEST_ASSERT_EQUAL(2, config.feedingsToday);
+    TEST_ASSERT_EQUAL(localDay(TimeUtils::now()), config.feedingsDay);
+    TEST_ASSERT_EQUAL((unsigned long)localTime(2026, 5, 6, 12, 0), config.nextFeedingTime);
+
+    // Tope alcanzado: la de las 12:00 y la de las 16:00 no se piden
+    runUntil(scheduler, localTime(2026, 5, 6, 23, 0));
+    TEST_ASSERT_EQUAL(1, feedCount);
+
+    // Día nuevo: contador a cero y vuelta a las tomas
+    runUntil(scheduler, localTime(2026, 5, 7, 9, 0));
+    TEST_ASSERT_EQUAL(0, scheduler.getFeedingsTodayCount());
+    TEST_ASSERT_EQUAL(2, feedCount);
+
+    scheduler.resetDailyCount();
+    TEST_ASSERT_EQUAL(0, scheduler.getFeedingsTodayCount());
+}
+
+void test_reboot_in_repeated_hour_does_not_refire(void) {
+    // 25/10/2026: a las 03:00 CEST se vuelve a las 02:00 CET y las 02:30
+    // llegan dos veces. Se da una sola y se guarda el estado
+    FeedingScheduler before(&logic);
+    before.setMaxFeedingsPerDay(10);
+    TEST_ASSERT_TRUE(before.setFeedingSlots("02:30"));
+    TimeUtils::setSimulatedTime(localTime(2026, 10, 25, 1, 0));
+    runUntil(before, localTime(2026, 10, 25, 4, 0));
+    TEST_ASSERT_EQUAL(1, feedCount);
+
+    FeederConfig config = {};
+    before.copyTo(config);
+    config.lastFeedingTime = (unsigned long)lastFedAt;
+    TEST_ASSERT_NOT_EQUAL(0, config.lastSlotKey);
+
+    // Reinicio justo después de la toma. Que mktime() dé las 02:30 en CEST
+    // o en CET depende de la libc; con la clave guardada la otra no se da
+    FeedingScheduler after(&logic);
+    after.setMaxFeedingsPerDay(10);
+    TEST_ASSERT_TRUE(after.setFeedingSlots("02:30"));
+    TimeUtils::setSimulatedTime(lastFedAt + 60);
+    after.restore(config.nextFeedingTime, config.lastFeedingTime, config.feedingsDay,
+                  config.feedingsToday, config.lastSlotKey);
+    feedCount = 0;
+    runUntil(after, localTime(2026, 10, 25, 6, 0));
+    TEST_ASSERT_EQUAL(0, feedCount);
+    TEST_ASSERT_EQUAL(localTime(2026, 10, 26, 2, 30), after.getNextFeedingTime());
+
+    // La clave no tapa la toma del día siguiente
+    runUntil(after, localTime(2026, 10, 26, 3, 0));
+    TEST_ASSERT_EQUAL(1, feedCount);
+}
+
+void test_saved_slot_key_blocks_same_slot(void) {
+    // Estado guardado con la toma de hoy a las 08:00 ya hecha y la hora
+    // de vuelta antes de ella (el mismo caso de la hora repetida, sin
+    // depender de la libc): no se repite, y sin la clave sí
+    FeedingScheduler done(&logic);
+    done.setMaxFeedingsPerDay(10);
+    TEST_ASSERT_TRUE(done.setFeedingSlots("08:00"));
+    TimeUtils::setSimulatedTime(localTime(2026, 5, 6, 7, 0));
+    runUntil(done, localTime(2026, 5, 6, 8, 30));
+    TEST_ASSERT_EQUAL(1, feedCount);
+    FeederConfig config = {};
+    done.copyTo(config);
+
+    for (int withKey = 1; withKey >= 0; withKey--) {
+        FeedingScheduler after(&logic);
+        after.setMaxFeedingsPerDay(10);
+        TEST_ASSERT_TRUE(after.setFeedingSlots("08:00"));
+        TimeUtils::setSimulatedTime(localTime(2026, 5, 6, 7, 50));
+        after.restore(config.nextFeedingTime, (time_t)lastFedAt, config.feedingsDay,
+                      config.feedingsToday, withKey ? config.lastSlotKey : 0);
+        feedCount = 0;
+        runUntil(after, localTime(2026, 5, 6, 9, 0));
+        TEST_ASSERT_EQUAL(withKey ? 0 : 1, feedCount);
+    }
+}
+
+int main() {
+    TimeUtils::init();
+    eventBus.subscribe(EVENT_SCHEDULED_FEEDING, onScheduledFeeding);
+    eventBus.subscribe(EVENT_MISSED_FEEDINGS, onMissedFeedings);
+    logic.begin();
+    logic.enableSound(false);
+    logic.requirePresence(false);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_policy_skip);
+    RUN_TEST(test_policy_once);
+    RUN_TEST(test_policy_all_spaced);
+    RUN_TEST(test_catch_up_fits_before_next_slot);
+    RUN_TEST(test_nothing_missed);
+    RUN_TEST(test_single_daily_counter);
+    RUN_TEST(test_reboot_in_repeated_hour_does_not_refire);
+    RUN_TEST(test_saved_slot_key_blocks_same_slot);
+    return UNITY_END();
+}
@@ -0,0 +1,133 @@
+// Reloj monotónico de 64 bits frente a la vuelta de millis() (env:native)
+//   pio test -e native -f test_monotonic_clock
+
+#include <unity.h>
+#include "utils/MonotonicClock.h"
+#include "utils/TimerQueue.h"
+#include "feeding/FeedingLogic.h"
+#include "hardware/StepTimer.h"
+
+// millis() de 32 bits da la vuelta a los 2^32 ms (~49,7 días)
+#define MILLIS_WRAP_US (4294967296ULL * 1000)
+
+static StepperController stepper;
+static SensorManager sensors;
+static FeedingLogic logic(&stepper, &sensors);
+
+static int timerFired;
+static uint64_t timerFiredAt;
+static int completions;
+
+static void onTimer(void* /*context*/) {
+    timerFired++;
+    timerFiredAt = MonotonicClock::nowMs();
+}
+
+static void onFeedingComplete(const Event& event) {
+    if (event.success()) completions++;
+}
+
+static void runUntilIdle() {
+    for (uint32_t i = 0; i < 2000000; i++) {
+        StepTimer::advance(50);
+        timerQueue.run();
+        stepper.update();
+        logic.update();
+        eventBus.dispatch();
+        if (logic.getState() == FEEDING_IDLE && !logic.isFeedingInProgress() && !stepper.isMotorMoving()) {
+            break;
+        }
+    }
+}
+
+void setUp(void) {
+    timerFired = 0;
+    timerFiredAt = 0;
+    completions = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_millis_wraps_clock_does_not(void) {
+    MonotonicClock::set(MILLIS_WRAP_US - 1500 * 1000ULL);
+    uint64_t before = MonotonicClock::nowMs();
+    unsigned long millisBefore = millis();
+
+    // Un plazo de 2 s calculado con millis() da la vuelta y la comparación
+    // directa que había antes lo daba por vencido al instante
+    unsigned long deadline = (uint32_t)(millisBefore + 2000);
+    TEST_ASSERT_TRUE(millis() >= deadline);
+    TEST_ASSERT_FALSE(MonotonicClock::elapsedMs(before) >= 2000);
+
+    MonotonicClock::advance(3000 * 1000ULL);
+
+    // millis() ha vuelto a empezar; el reloj de 64 bits sigue creciendo
+    TEST_ASSERT_TRUE(millis() < millisBefore);
+    TEST_ASSERT_EQUAL_UINT32(1500, millis());
+    TEST_ASSERT_TRUE(MonotonicClock::nowMs() > before);
+    TEST_ASSERT_EQUAL_UINT64(3000, MonotonicClock::elapsedMs(before));
+    TEST_ASSERT_EQUAL_UINT64(MonotonicClock::nowUs(), StepTimer::nowMicros());
+}
+
+void test_timer_across_wrap(void) {
+    MonotonicClock::set(MILLIS_WRAP_US - 500 * 1000ULL);
+    TimerId id = timerQueue.add(onTimer);
+    TEST_ASSERT_NOT_EQUAL(TIMER_NONE, id);
+    uint64_t start = MonotonicClock::nowMs();
+    TEST_ASSERT_TRUE(timerQueue.start(id, 1000, 1000));
+
+    // Ni antes de tiempo ni nunca
+    for (int i = 0; i < 999; i++) {
+        MonotonicClock::advance(1000);
+        timerQueue.run();
+    }
+    TEST_ASSERT_EQUAL(0, timerFired);
+    MonotonicClock::advance(1000);
+    timerQueue.run();
+    TEST_ASSERT_EQUAL(1, timerFired);
+    TEST_ASSERT_EQUAL_UINT64(start + 1000, timerFiredAt);
+
+    // Y sigue siendo periódico al otro lado de la vuelta
+    for (int i = 0; i < 3000; i++) {
+        MonotonicClock::advance(1000);
+        timerQueue.run();
+    }
+    TEST_ASSERT_EQUAL(4, timerFired);
+    timerQueue.stop(id);
+}
+
+void test_feeding_across_wrap(void) {
+    logic.getInventory().fillAll(50, 0);
+
+    // 2 s antes de la vuelta: la alimentación la cruza de lado a lado
+    MonotonicClock::set(MILLIS_WRAP_US - 2000 * 1000ULL);
+    TEST_ASSERT_EQUAL(FEEDING_REQUEST_STARTED, logic.requestFeeding(FEEDING_SOURCE_WEB));
+    runUntilIdle();
+
+    TEST_ASSERT_TRUE(MonotonicClock::nowUs() > MILLIS_WRAP_US);
+    TEST_ASSERT_EQUAL(1, completions);
+    TEST_ASSERT_EQUAL(FEEDING_IDLE, logic.getState());
+    TEST_ASSERT_FALSE(stepper.isMotorMoving());
+
+    // Pasado el plazo de unificación, otra petición es un trabajo nuevo
+    MonotonicClock::advance((uint64_t)(FEEDING_COALESCE_MS + 10000) * 1000);
+    TEST_ASSERT_EQUAL(FEEDING_REQUEST_STARTED, logic.requestFeeding(FEEDING_SOURCE_WEB));
+    runUntilIdle();
+    TEST_ASSERT_EQUAL(2, completions);
+}
+
+int main() {
+    eventBus.subscribe(EVENT_FEEDING_COMPLETE, onFeedingComplete);
+    stepper.begin();
+    stepper.calibrate();
+    logic.begin();
+    logic.enableSound(false);
+    logic.requirePresence(false);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_millis_wraps_clock_does_not);
+    RUN_TEST(test_timer_across_wrap);
+    RUN_TEST(test_feeding_across_wrap);
+    return UNITY_END();
+}
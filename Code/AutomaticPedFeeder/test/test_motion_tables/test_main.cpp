@@ -0,0 +1,259 @@
+// Planificador en S y tablas de movimiento precalculadas (env:native)
+//   pio test -e native -f test_motion_tables
+
+#include <unity.h>
+#include <chrono>
+#include "hardware/MotionPlanner.h"
+#include "hardware/MotionTables.h"
+
+using namespace MotionTables;
+
+// Margen para el redondeo de los intervalos a ticks de STEP_TIMER_TICK_US
+#define LIMIT_TOLERANCE 1.05
+#define ACCEL_WINDOW 4
+#define BENCH_MOVES 2000
+
+static double tickSeconds(uint32_t ticks) {
+    return ticks * (double)STEP_TIMER_TICK_US / 1000000.0;
+}
+
+// Tiempo real: el MonotonicClock nativo es simulado y no avanza solo
+static uint64_t wallNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Lo que AccelStepper::run() calculaba en cada paso con computeNewSpeed()
+// (ecuaciones de Austin: una raíz al arrancar y una división en coma
+// flotante por paso), solo hacia delante y sin la espera de runSpeed()
+struct AccelStepperModel {
+    long position = 0;
+    long target = 0;
+    long n = 0;
+    float speed = 0;
+    float c0 = 0;
+    float cn = 0;
+    float cmin = 0;
+
+    void moveTo(long steps, float maxSpeed, float acceleration) {
+        target = position + steps;
+        c0 = 0.676f * sqrtf(2.0f / acceleration) * 1000000.0f;
+        cmin = 1000000.0f / maxSpeed;
+        n = 0;
+        speed = 0;
+    }
+
+    // Intervalo hasta el paso siguiente en µs (0 = llegado)
+    float computeNewSpeed(float acceleration) {
+        long distanceTo = target - position;
+        long stepsToStop = (long)((speed * speed) / (2.0f * acceleration));
+        if (distanceTo == 0 && stepsToStop <= 1) {
+            speed = 0;
+            n = 0;
+            return 0;
+        }
+        if (n > 0 && stepsToStop >= distanceTo) {
+            n = -stepsToStop;
+        }
+        if (n == 0) {
+            cn = c0;
+        } else {
+            cn = cn - ((2.0f * cn) / ((4.0f * n) + 1));
+            if (cn < cmin) cn = cmin;
+        }
+        n++;
+        speed = 1000000.0f / cn;
+        return cn;
+    }
+};
+
+// Igual que StepEngine::intervalForStep(): rampa, crucero y rampa al revés
+static uint16_t tableInterval(const MoveTable& table, uint32_t step) {
+    if (step < table.rampSteps) {
+        return table.ramp[step];
+    }
+    if (step + table.rampSteps >= table.totalSteps) {
+        uint32_t mirrored = table.totalSteps - 1 - step;
+        return mirrored < table.rampSteps ? table.ramp[mirrored] : table.cruiseTicks;
+    }
+    return table.cruiseTicks;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_ramp_respects_limits(void) {
+    SCurveProfile full = MotionPlanner::rampTo(COARSE_MAX_SPEED, COARSE_ACCELERATION, COARSE_JERK);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, COARSE_MAX_SPEED, full.peakSpeed);
+    TEST_ASSERT_TRUE(full.peakAccel <= COARSE_ACCELERATION);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, full.peakAccel / COARSE_JERK, full.jerkTime);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 2 * full.jerkTime + full.accelTime, full.rampTime);
+
+    // La rampa termina en rampDistance
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, full.rampDistance, MotionPlanner::positionAt(full, full.rampTime));
+
+    // Velocidad baja: el perfil es solo jerk y no llega a la aceleración máxima
+    SCurveProfile slow = MotionPlanner::rampTo(1.0, COARSE_ACCELERATION, COARSE_JERK);
+    TEST_ASSERT_TRUE(slow.peakAccel < COARSE_ACCELERATION);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 0.0, slow.accelTime);
+}
+
+void test_plan_fits_short_moves(void) {
+    SCurveProfile full = MotionPlanner::rampTo(COARSE_MAX_SPEED, COARSE_ACCELERATION, COARSE_JERK);
+
+    // Con sitio para las dos rampas se usa el perfil completo
+    SCurveProfile longMove = MotionPlanner::plan(2 * full.rampDistance + 10, COARSE_MAX_SPEED,
+                                                 COARSE_ACCELERATION, COARSE_JERK);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, COARSE_MAX_SPEED, longMove.peakSpeed);
+
+    // Sin sitio la rampa ocupa como mucho media distancia
+    for (uint32_t distance = 1; distance < 2 * full.rampDistance; distance += 7) {
+        SCurveProfile p = MotionPlanner::plan(distance, COARSE_MAX_SPEED, COARSE_ACCELERATION, COARSE_JERK);
+        TEST_ASSERT_TRUE(p.peakSpeed < COARSE_MAX_SPEED);
+        TEST_ASSERT_TRUE(p.peakAccel <= COARSE_ACCELERATION);
+        TEST_ASSERT_TRUE(p.rampDistance <= distance / 2.0);
+        TEST_ASSERT_FLOAT_WITHIN(0.01, distance / 2.0, p.rampDistance);
+    }
+}
+
+void test_tables_cover_every_move(void) {
+    for (int k = 1; k <= MOTION_MAX_COMPARTMENT_MOVE; k++) {
+        const MoveTable& table = TABLES[k - 1];
+        TEST_ASSERT_EQUAL_UINT32(coarseSteps(k), table.totalSteps);
+        TEST_ASSERT_TRUE(2UL * table.rampSteps <= table.totalSteps);
+        TEST_ASSERT_TRUE(table.rampSteps <= rampCapacity());
+        TEST_ASSERT_TRUE(table.rampSteps > 0);
+
+        uint32_t rampTicks = 0;
+        for (uint32_t n = 0; n < table.rampSteps; n++) {
+            rampTicks += table.ramp[n];
+        }
+        TEST_ASSERT_EQUAL_UINT32(rampTicks, table.rampTicks);
+        TEST_ASSERT_EQUAL_UINT32(2 * table.rampTicks + (table.totalSteps - 2 * table.rampSteps) * table.cruiseTicks,
+                                 table.durationTicks);
+    }
+}
+
+void test_tables_respect_limits(void) {
+    for (int k = 1; k <= MOTION_MAX_COMPARTMENT_MOVE; k++) {
+        const MoveTable& table = TABLES[k - 1];
+
+        // Rampa monótona que no baja del intervalo de crucero
+        for (uint32_t n = 0; n < table.rampSteps; n++) {
+            TEST_ASSERT_TRUE(table.ramp[n] >= table.cruiseTicks);
+            if (n > 0) {
+                TEST_ASSERT_TRUE(table.ramp[n] <= table.ramp[n - 1]);
+            }
+        }
+
+        // Velocidad de cada paso, y aceleración media sobre una ventana de
+        // pasos (entre dos intervalos seguidos domina el redondeo a ticks)
+        TEST_ASSERT_TRUE(1.0 / tickSeconds(table.cruiseTicks) <= COARSE_MAX_SPEED * LIMIT_TOLERANCE);
+        for (uint32_t n = 0; n < table.rampSteps; n++) {
+            TEST_ASSERT_TRUE(1.0 / tickSeconds(table.ramp[n]) <= COARSE_MAX_SPEED * LIMIT_TOLERANCE);
+        }
+        for (uint32_t n = ACCEL_WINDOW; n < table.rampSteps; n++) {
+            double first = tickSeconds(table.ramp[n - ACCEL_WINDOW]);
+            double last = tickSeconds(table.ramp[n]);
+            double elapsed = (first + last) / 2;
+            for (uint32_t i = n - ACCEL_WINDOW + 1; i < n; i++) {
+                elapsed += tickSeconds(table.ramp[i]);
+            }
+            double accel = (1.0 / last - 1.0 / first) / elapsed;
+            TEST_ASSERT_TRUE(accel <= COARSE_ACCELERATION * LIMIT_TOLERANCE);
+        }
+    }
+}
+
+void test_longer_moves_reach_higher_speed(void) {
+    for (int k = 2; k <= MOTION_MAX_COMPARTMENT_MOVE; k++) {
+        TEST_ASSERT_TRUE(TABLES[k - 1].cruiseTicks <= TABLES[k - 2].cruiseTicks);
+        TEST_ASSERT_TRUE(TABLES[k - 1].rampSteps >= TABLES[k - 2].rampSteps);
+        TEST_ASSERT_TRUE(TABLES[k - 1].durationTicks > TABLES[k - 2].durationTicks);
+    }
+}
+
+void test_for_steps_picks_longest_fitting_ramp(void) {
+    // Por debajo de la tabla más corta siempre la primera
+    TEST_ASSERT_EQUAL_PTR(&TABLES[0], &forSteps(0));
+    TEST_ASSERT_EQUAL_PTR(&TABLES[0], &forSteps(1));
+
+    for (int k = 1; k <= MOTION_MAX_COMPARTMENT_MOVE; k++) {
+        const MoveTable& table = forSteps(coarseSteps(k));
+        TEST_ASSERT_TRUE(2UL * table.rampSteps <= coarseSteps(k));
+        TEST_ASSERT_TRUE(table.rampSteps >= TABLES[k - 1].rampSteps);
+    }
+
+    TEST_ASSERT_EQUAL_PTR(&TABLES[MOTION_MAX_COMPARTMENT_MOVE - 1], &forSteps(100000));
+}
+
+void test_to_ticks_clamps(void) {
+    TEST_ASSERT_EQUAL_UINT16(2, toTicks(0));
+    TEST_ASSERT_EQUAL_UINT16(2, toTicks(STEP_TIMER_TICK_US));
+    TEST_ASSERT_EQUAL_UINT16(10, toTicks(10 * STEP_TIMER_TICK_US));
+    TEST_ASSERT_EQUAL_UINT16(10, toTicks(10.4 * STEP_TIMER_TICK_US));
+    TEST_ASSERT_EQUAL_UINT16(11, toTicks(10.6 * STEP_TIMER_TICK_US));
+    TEST_ASSERT_EQUAL_UINT16(65535, toTicks(1e9));
+}
+
+void test_step_cost_against_accelstepper(void) {
+    // Cuatro compartimentos: rampa completa y crucero
+    const MoveTable& table = TABLES[MOTION_MAX_COMPARTMENT_MOVE - 1];
+
+    // Tablas: el intervalo de cada paso es una lectura (la suma impide que
+    // el compilador quite el bucle)
+    uint64_t steps = 0;
+    uint64_t tableTicks = 0;
+    uint64_t start = wallNs();
+    for (int move = 0; move < BENCH_MOVES; move++) {
+        for (uint32_t step = 0; step < table.totalSteps; step++) {
+            tableTicks += tableInterval(table, step);
+            steps++;
+        }
+    }
+    uint64_t tableNs = wallNs() - start;
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)BENCH_MOVES * table.totalSteps, steps);
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)BENCH_MOVES * table.durationTicks, tableTicks);
+
+    // AccelStepper: su cálculo en cada paso
+    AccelStepperModel model;
+    uint64_t modelSteps = 0;
+    double modelUs = 0;
+    start = wallNs();
+    for (int move = 0; move < BENCH_MOVES; move++) {
+        model.moveTo(table.totalSteps, COARSE_MAX_SPEED, COARSE_ACCELERATION);
+        float interval;
+        while ((interval = model.computeNewSpeed(COARSE_ACCELERATION)) > 0) {
+            model.position++;
+            modelUs += interval;
+            modelSteps++;
+        }
+    }
+    uint64_t modelNs = wallNs() - start;
+    TEST_ASSERT_EQUAL_UINT64(steps, modelSteps);
+
+    // Los dos perfiles recorren el movimiento en un tiempo parecido
+    double tableUs = (double)tableTicks * STEP_TIMER_TICK_US;
+    TEST_ASSERT_TRUE(modelUs > tableUs * 0.5 && modelUs < tableUs * 2);
+
+    char message[128];
+    snprintf(message, sizeof(message), "Tablas %.1f ns/paso, recurrencia de AccelStepper %.1f ns/paso",
+             (double)tableNs / steps, (double)modelNs / modelSteps);
+    TEST_MESSAGE(message);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_ramp_respects_limits);
+    RUN_TEST(test_plan_fits_short_moves);
+    RUN_TEST(test_tables_cover_every_move);
+    RUN_TEST(test_tables_respect_limits);
+    RUN_TEST(test_longer_moves_reach_higher_speed);
+    RUN_TEST(test_for_steps_picks_longest_fitting_ramp);
+    RUN_TEST(test_to_ticks_clamps);
+    RUN_TEST(test_step_cost_against_accelstepper);
+    return UNITY_END();
+}
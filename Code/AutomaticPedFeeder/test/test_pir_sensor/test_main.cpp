@@ -0,0 +1,148 @@
+// PIR por flancos: antirrebote, confianza y cola llena (env:native)
+//   pio test -e native -f test_pir_sensor
+
+#include <unity.h>
+#include "hardware/SensorManager.h"
+#include "hardware/PirSensor.h"
+
+static int presences;
+
+static void onPresence(const Event& /*event*/) {
+    presences++;
+}
+
+// Flancos en ms relativos a 'base' (la marca la pone la ISR, no update())
+static void edgeAt(uint64_t base, bool level, uint32_t ms) {
+    PirSensor::simulateEdge(level, base + (uint64_t)ms * 1000);
+}
+
+static void consume(SensorManager& sensors) {
+    sensors.update();
+    eventBus.dispatch();
+}
+
+void setUp(void) {
+    MonotonicClock::advance(60000000ULL);
+    presences = 0;
+}
+
+void tearDown(void) {
+    // El modelo del PIR es estático: cada prueba acaba en reposo
+    PirSensor::simulateLevel(false);
+    PirEdge edge;
+    while (PirSensor::pop(edge)) {
+    }
+}
+
+void test_short_pulse_is_not_lost(void) {
+    SensorManager sensors;
+    uint64_t t = MonotonicClock::nowUs();
+
+    // 40 µs: un sondeo periódico no lo habría visto
+    PirSensor::simulateEdge(true, t + 100);
+    PirSensor::simulateEdge(false, t + 140);
+    consume(sensors);
+
+    TEST_ASSERT_EQUAL(1, presences);
+    TEST_ASSERT_FALSE(sensors.isPresenceDetected());
+    TEST_ASSERT_EQUAL_UINT64(t / 1000, sensors.getPresenceData().lastDetectionTime);
+}
+
+void test_debounce_continues_detection(void) {
+    SensorManager sensors;
+    uint64_t t = MonotonicClock::nowUs();
+
+    // Bajada y subida a 100 ms y justo en PIR_DEBOUNCE_MS: la misma detección
+    edgeAt(t, true, 0);
+    edgeAt(t, false, 500);
+    edgeAt(t, true, 600);
+    edgeAt(t, false, 900);
+    edgeAt(t, true, 900 + PIR_DEBOUNCE_MS);
+    edgeAt(t, false, 1500);
+    MonotonicClock::set(t + 1600000);
+    consume(sensors);
+
+    TEST_ASSERT_EQUAL(1, presences);
+    PresenceData data = sensors.getPresenceData();
+    TEST_ASSERT_EQUAL_UINT32(1500, data.detectionDuration);
+    TEST_ASSERT_EQUAL_UINT64(t / 1000, data.lastDetectionTime);
+
+    // Pasado el antirrebote es una detección nueva
+    edgeAt(t, true, 1500 + PIR_DEBOUNCE_MS + 1);
+    MonotonicClock::set(t + 2000000);
+    consume(sensors);
+
+    TEST_ASSERT_EQUAL(2, presences);
+    TEST_ASSERT_TRUE(sensors.isPresenceDetected());
+    TEST_ASSERT_EQUAL_UINT64(t / 1000 + 1500 + PIR_DEBOUNCE_MS + 1,
+                             sensors.getPresenceData().lastDetectionTime);
+}
+
+void test_confidence_from_active_time(void) {
+    SensorManager sensors;
+    uint64_t t = MonotonicClock::nowUs();
+
+    // 800 + 600 ms activos de los PIR_DETECTION_TIMEOUT (2000) que confirman
+    edgeAt(t, true, 0);
+    edgeAt(t, false, 800);
+    edgeAt(t, true, 900);
+    edgeAt(t, false, 1500);
+    MonotonicClock::set(t + 1600000);
+    consume(sensors);
+    TEST_ASSERT_EQUAL_UINT8(1400 * 100 / PIR_DETECTION_TIMEOUT, sensors.getPresenceConfidence());
+    TEST_ASSERT_EQUAL_UINT8(70, sensors.getPresenceData().confidence);
+
+    // Activo: cuenta hasta ahora y se queda en 100
+    edgeAt(t, true, 1600);
+    consume(sensors);
+    TEST_ASSERT_EQUAL_UINT8(70, sensors.getPresenceConfidence());
+    MonotonicClock::advance(300000);
+    TEST_ASSERT_EQUAL_UINT8(85, sensors.getPresenceConfidence());
+    MonotonicClock::advance(5000000);
+    TEST_ASSERT_EQUAL_UINT8(100, sensors.getPresenceConfidence());
+    TEST_ASSERT_TRUE(sensors.waitForPresence(1000));
+
+    // Sin presencia, la espera agota su plazo
+    PirSensor::simulateLevel(false);
+    consume(sensors);
+    TEST_ASSERT_FALSE(sensors.waitForPresence(5000));
+}
+
+void test_full_queue_resyncs_with_pin(void) {
+    SensorManager sensors;
+    uint32_t dropped = PirSensor::getDroppedCount();
+    uint64_t t = MonotonicClock::nowUs() + 1000;
+
+    // 40 flancos sin consumir: caben PIR_EDGE_QUEUE_SIZE - 1
+    for (int i = 0; i < 40; i++) {
+        PirSensor::simulateEdge(i % 2 == 0, t + i * 10);
+    }
+    TEST_ASSERT_EQUAL_UINT32(dropped + 40 - (PIR_EDGE_QUEUE_SIZE - 1), PirSensor::getDroppedCount());
+
+    // El último flanco encolado es de subida, pero el pin ya está en reposo
+    MonotonicClock::set(t + 1000);
+    consume(sensors);
+    TEST_ASSERT_FALSE(PirSensor::hasPending());
+    TEST_ASSERT_FALSE(sensors.isPresenceDetected());
+    TEST_ASSERT_EQUAL(1, presences);
+
+    // Y con el pin activo, la resincronización abre la detección
+    PirSensor::simulateEdge(true, t + 2000);
+    for (int i = 0; i < 20; i++) {
+        PirSensor::simulateEdge(i % 2 != 0, t + 3000 + i * 10);
+    }
+    PirSensor::simulateEdge(true, t + 4000);
+    consume(sensors);
+    TEST_ASSERT_TRUE(sensors.isPresenceDetected());
+}
+
+int main() {
+    eventBus.subscribe(EVENT_PRESENCE, onPresence);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_short_pulse_is_not_lost);
+    RUN_TEST(test_debounce_continues_detection);
+    RUN_TEST(test_confidence_from_active_time);
+    RUN_TEST(test_full_queue_resyncs_with_pin);
+    return UNITY_END();
+}
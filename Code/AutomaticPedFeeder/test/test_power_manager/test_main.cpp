@@ -0,0 +1,158 @@
+// Reposo entre plazos: despertares en un día simulado (env:native)
+//   pio test -e native -f test_power_manager
+
+#include <unity.h>
+#include "feeding/FeedingLogic.h"
+#include "hardware/StepperController.h"
+#include "hardware/SensorManager.h"
+#include "utils/PowerManager.h"
+#include "utils/TimerQueue.h"
+
+#define DAY_MS 86400000ULL
+
+static StepperController stepper;
+static SensorManager sensors;
+static FeedingLogic logic(&stepper, &sensors);
+
+struct Periodic {
+    uint32_t periodMs;
+    uint64_t nextDueMs;
+    uint32_t fired;
+    uint32_t late;  // Disparos fuera de su plazo exacto
+};
+
+static uint32_t firedThisPass;
+static int completions;
+
+static void onFeedingComplete(const Event& event) {
+    if (event.success()) completions++;
+}
+
+static void onPeriodic(void* context) {
+    Periodic* timer = static_cast<Periodic*>(context);
+    if (MonotonicClock::nowMs() != timer->nextDueMs) timer->late++;
+    timer->nextDueMs += timer->periodMs;
+    timer->fired++;
+    firedThisPass++;
+}
+
+static bool isIdle() {
+    // Como isSystemIdle() en main.cpp
+    return eventBus.getDepth() == 0 &&
+           !stepper.isMotorMoving() &&
+           !stepper.isCalibrating() &&
+           logic.getState() == FEEDING_IDLE &&
+           logic.getQueueDepth() == 0 &&
+           !sensors.isSoundPlaying();
+}
+
+void setUp(void) {
+    firedThisPass = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_day_of_timer_deadlines(void) {
+    Periodic fast = { 2000, 0, 0, 0 };
+    Periodic slow = { 5000, 0, 0, 0 };
+    TimerId fastId = timerQueue.every(fast.periodMs, onPeriodic, &fast);
+    TimerId slowId = timerQueue.every(slow.periodMs, onPeriodic, &slow);
+    uint64_t start = MonotonicClock::nowMs();
+    fast.nextDueMs = start + fast.periodMs;
+    slow.nextDueMs = start + slow.periodMs;
+    powerManager.resetStats();
+
+    uint32_t emptyWakeups = 0;
+    uint32_t earlyReturns = 0;
+    while (MonotonicClock::nowMs() < start + DAY_MS) {
+        uint64_t deadline = timerQueue.getNextDeadline();
+        powerManager.idleUntil(deadline);
+        if (MonotonicClock::nowMs() != deadline) earlyReturns++;
+
+        // Cada despertar tiene trabajo: ninguno llega antes del plazo
+        firedThisPass = 0;
+        timerQueue.run();
+        if (firedThisPass == 0) emptyWakeups++;
+    }
+    timerQueue.stop(fastId);
+    timerQueue.stop(slowId);
+
+    TEST_ASSERT_EQUAL_UINT32(0, earlyReturns);
+    TEST_ASSERT_EQUAL_UINT32(0, emptyWakeups);
+    TEST_ASSERT_EQUAL_UINT32(0, fast.late);
+    TEST_ASSERT_EQUAL_UINT32(0, slow.late);
+    TEST_ASSERT_EQUAL_UINT32(43200, fast.fired);
+    TEST_ASSERT_EQUAL_UINT32(17280, slow.fired);
+
+    // Cada 10 s coinciden los dos: un solo despertar
+    TEST_ASSERT_EQUAL_UINT32(43200 + 17280 - 8640, powerManager.getWakeupCount());
+    TEST_ASSERT_EQUAL_UINT32(0, powerManager.getEarlyWakeupCount());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 2160.0f, powerManager.getWakeupsPerHour());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.0f, powerManager.getIdleRatio());
+}
+
+void test_feeder_day_sleeps_between_feedings(void) {
+    stepper.begin();
+    sensors.begin();
+    stepper.calibrate();
+    logic.begin();
+    logic.enableSound(false);
+    logic.requirePresence(false);
+    logic.getInventory().fillAll(50, 0);
+    completions = 0;
+    uint64_t start = MonotonicClock::nowMs();
+    powerManager.resetStats();
+
+    // Tres tomas al día; el resto, solo el temporizador del DHT
+    const uint64_t feedAt[] = { 8 * 3600000ULL, 14 * 3600000ULL, 20 * 3600000ULL };
+    int nextFeed = 0;
+    uint32_t timerLeftOn = 0;
+    while (MonotonicClock::nowMs() < start + DAY_MS) {
+        if (nextFeed < 3 && MonotonicClock::nowMs() >= start + feedAt[nextFeed]) {
+            TEST_ASSERT_EQUAL(FEEDING_REQUEST_STARTED, logic.requestFeeding(FEEDING_SOURCE_WEB));
+            nextFeed++;
+        }
+
+        // Lo mismo que loop()
+        timerQueue.run();
+        sensors.update();
+        stepper.update();
+        logic.update();
+        eventBus.dispatch();
+
+        if (isIdle()) {
+            // En reposo el timer de pasos no retiene el cerrojo de energía
+            if (StepTimer::isEnabled()) timerLeftOn++;
+            uint64_t deadline = timerQueue.getNextDeadline();
+            if (nextFeed < 3) deadline = min(deadline, start + feedAt[nextFeed]);
+            powerManager.idleUntil(deadline);
+        } else if (StepTimer::isRunning()) {
+            StepTimer::advance(50);
+        } else {
+            MonotonicClock::advance(10000);
+        }
+    }
+
+    TEST_ASSERT_EQUAL(3, nextFeed);
+    TEST_ASSERT_EQUAL(3, completions);
+    TEST_ASSERT_EQUAL_UINT32(0, timerLeftOn);
+    TEST_ASSERT_EQUAL_UINT32(0, powerManager.getEarlyWakeupCount());
+
+    // Un despertar por lectura del DHT (más los de las tomas), y casi todo
+    // el día en reposo
+    uint32_t dhtReads = DAY_MS / DHT_READ_INTERVAL_MS;
+    TEST_ASSERT_TRUE(powerManager.getWakeupCount() <= dhtReads + 3);
+    TEST_ASSERT_TRUE(powerManager.getWakeupCount() >= dhtReads - 3 * 60000 / DHT_READ_INTERVAL_MS);
+    TEST_ASSERT_TRUE(powerManager.getIdleRatio() > 0.995f);
+}
+
+int main() {
+    eventBus.subscribe(EVENT_FEEDING_COMPLETE, onFeedingComplete);
+    powerManager.begin();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_day_of_timer_deadlines);
+    RUN_TEST(test_feeder_day_sleeps_between_feedings);
+    return UNITY_END();
+}
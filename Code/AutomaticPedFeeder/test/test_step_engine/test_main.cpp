@@ -0,0 +1,204 @@
+// Generador de pasos por timer y sustituto nativo de StepTimer (env:native)
+//   pio test -e native -f test_step_engine
+
+#include <unity.h>
+#include "hardware/StepEngine.h"
+
+static StepEngine engine;
+
+static const uint16_t ramp[] = { 40, 30, 24, 20 };
+static int tickCount;
+
+static void countTick() {
+    tickCount++;
+}
+
+static MotionSegment moveSegment(long steps, const uint16_t* table, uint16_t rampSteps,
+                                 uint16_t cruiseTicks, int8_t notifyCommand) {
+    MotionSegment segment = {};
+    segment.type = SEGMENT_MOVE;
+    segment.schedule.ramp = table;
+    segment.schedule.rampSteps = rampSteps;
+    segment.schedule.cruiseTicks = cruiseTicks;
+    segment.schedule.totalSteps = abs(steps);
+    segment.schedule.direction = steps > 0 ? 1 : -1;
+    segment.stepSize = 1;
+    segment.sensorAction = SENSOR_IGNORE;
+    segment.microsteps = MICROSTEPS;
+    segment.notifyCommand = notifyCommand;
+    return segment;
+}
+
+static MotionSegment dwellSegment(uint32_t ticks, int8_t notifyCommand) {
+    MotionSegment segment = {};
+    segment.type = SEGMENT_DWELL;
+    segment.schedule.direction = 1;
+    segment.stepSize = 1;
+    segment.microsteps = MICROSTEPS;
+    segment.dwellTicks = ticks;
+    segment.notifyCommand = notifyCommand;
+    return segment;
+}
+
+// Ticks entre pasos consecutivos hasta que la ISR termina la secuencia
+static uint32_t runAndRecord(uint32_t* intervals, uint32_t maxSteps) {
+    uint32_t steps = 0;
+    uint32_t sinceStep = 0;
+    int32_t previous = engine.getPosition();
+    for (uint32_t i = 0; i < 1000000 && engine.isRunning(); i++) {
+        StepTimer::advance(1);
+        sinceStep++;
+        if (engine.getPosition() != previous) {
+            if (steps < maxSteps) intervals[steps] = sinceStep;
+            steps++;
+            sinceStep = 0;
+            previous = engine.getPosition();
+        }
+    }
+    return steps;
+}
+
+void setUp(void) {
+    engine.stop();
+    engine.setPosition(0);
+    engine.resetStats();
+    int8_t command;
+    while (engine.popCompleted(command)) {
+    }
+}
+
+void tearDown(void) {
+}
+
+void test_timer_stand_in(void) {
+    tickCount = 0;
+    StepTimer::begin(STEP_TIMER_TICK_US, countTick);
+
+    // Sin arrancar no hay ticks, pero el reloj avanza
+    uint64_t before = StepTimer::nowMicros();
+    StepTimer::advance(10);
+    TEST_ASSERT_EQUAL(0, tickCount);
+    TEST_ASSERT_EQUAL_UINT64(before + 10 * STEP_TIMER_TICK_US, StepTimer::nowMicros());
+
+    TEST_ASSERT_TRUE(StepTimer::start());
+    StepTimer::advance(10);
+    TEST_ASSERT_EQUAL(10, tickCount);
+
+    // halt() (desde la ISR) corta los ticks pero deja el timer encendido
+    StepTimer::halt();
+    StepTimer::advance(10);
+    TEST_ASSERT_EQUAL(10, tickCount);
+    TEST_ASSERT_FALSE(StepTimer::isRunning());
+    TEST_ASSERT_TRUE(StepTimer::isEnabled());
+
+    StepTimer::stop();
+    TEST_ASSERT_FALSE(StepTimer::isEnabled());
+
+    // Devolver el timer al generador de pasos
+    TEST_ASSERT_TRUE(engine.begin());
+}
+
+void test_steps_follow_schedule(void) {
+    TEST_ASSERT_TRUE(engine.enqueue(moveSegment(12, ramp, 4, 16, 0)));
+    TEST_ASSERT_TRUE(engine.run());
+
+    uint32_t intervals[16];
+    TEST_ASSERT_EQUAL_UINT32(12, runAndRecord(intervals, 16));
+    TEST_ASSERT_EQUAL_INT32(12, engine.getPosition());
+
+    // Rampa, crucero y la rampa en orden inverso (el primer paso sale
+    // ramp[0] ticks después de arrancar)
+    const uint32_t expected[12] = { 40, 30, 24, 20, 16, 16, 16, 16, 20, 24, 30, 40 };
+    for (int i = 0; i < 12; i++) {
+        TEST_ASSERT_EQUAL_UINT32(expected[i], intervals[i]);
+    }
+
+    // Sin loop() de por medio el plan se cumple exacto
+    MotionStats stats = engine.getStats();
+    TEST_ASSERT_EQUAL_UINT32(12, stats.stepsEmitted);
+    TEST_ASSERT_EQUAL_UINT32(11, stats.jitterHistogram[0]);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.maxGapUs);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.sequences);
+}
+
+void test_segments_chain_without_loop(void) {
+    TEST_ASSERT_TRUE(engine.enqueue(moveSegment(5, nullptr, 0, 10, -1)));
+    TEST_ASSERT_TRUE(engine.enqueue(dwellSegment(100, 0)));
+    TEST_ASSERT_TRUE(engine.enqueue(moveSegment(-3, nullptr, 0, 10, 1)));
+    TEST_ASSERT_TRUE(engine.run());
+
+    uint32_t intervals[8];
+    TEST_ASSERT_EQUAL_UINT32(8, runAndRecord(intervals, 8));
+    TEST_ASSERT_EQUAL_INT32(2, engine.getPosition());
+
+    // La espera separa los dos movimientos
+    TEST_ASSERT_TRUE(intervals[5] >= 100);
+
+    int8_t command;
+    TEST_ASSERT_TRUE(engine.popCompleted(command));
+    TEST_ASSERT_EQUAL(0, command);
+    TEST_ASSERT_TRUE(engine.popCompleted(command));
+    TEST_ASSERT_EQUAL(1, command);
+    TEST_ASSERT_FALSE(engine.popCompleted(command));
+}
+
+void test_timer_released_after_sequence(void) {
+    TEST_ASSERT_FALSE(engine.run());  // Cola vacía: no enciende el timer
+    TEST_ASSERT_FALSE(StepTimer::isEnabled());
+
+    TEST_ASSERT_TRUE(engine.enqueue(moveSegment(3, nullptr, 0, 5, 0)));
+    TEST_ASSERT_TRUE(engine.run());
+    TEST_ASSERT_TRUE(StepTimer::isRunning());
+
+    uint32_t intervals[4];
+    runAndRecord(intervals, 4);
+
+    // La ISR solo corta los ticks; loop() libera el timer después
+    TEST_ASSERT_FALSE(engine.isRunning());
+    TEST_ASSERT_FALSE(StepTimer::isRunning());
+    TEST_ASSERT_TRUE(StepTimer::isEnabled());
+
+    engine.releaseTimer();
+    TEST_ASSERT_FALSE(StepTimer::isEnabled());
+}
+
+void test_failed_start_discards_queue(void) {
+    TEST_ASSERT_TRUE(engine.enqueue(moveSegment(10, nullptr, 0, 5, 0)));
+    StepTimer::failNextStart();
+    TEST_ASSERT_FALSE(engine.run());
+
+    // Nada queda a medias: ni la cola ni el timer
+    TEST_ASSERT_FALSE(engine.isRunning());
+    TEST_ASSERT_FALSE(StepTimer::isEnabled());
+    TEST_ASSERT_EQUAL(MOTION_QUEUE_SIZE - 1, engine.getFreeSlots());
+    StepTimer::advance(100);
+    TEST_ASSERT_EQUAL_INT32(0, engine.getPosition());
+}
+
+void test_stop_discards_queue(void) {
+    TEST_ASSERT_TRUE(engine.enqueue(moveSegment(100, nullptr, 0, 5, -1)));
+    TEST_ASSERT_TRUE(engine.enqueue(moveSegment(100, nullptr, 0, 5, 0)));
+    TEST_ASSERT_TRUE(engine.run());
+    StepTimer::advance(52);
+
+    engine.stop();
+    TEST_ASSERT_FALSE(engine.isRunning());
+    TEST_ASSERT_FALSE(StepTimer::isEnabled());
+    TEST_ASSERT_EQUAL(MOTION_QUEUE_SIZE - 1, engine.getFreeSlots());
+
+    int32_t position = engine.getPosition();
+    StepTimer::advance(1000);
+    TEST_ASSERT_EQUAL_INT32(position, engine.getPosition());
+    TEST_ASSERT_EQUAL(LOW, simPinLevels[STEPPER_STEP_PIN]);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_timer_stand_in);
+    RUN_TEST(test_steps_follow_schedule);
+    RUN_TEST(test_segments_chain_without_loop);
+    RUN_TEST(test_timer_released_after_sequence);
+    RUN_TEST(test_failed_start_discards_queue);
+    RUN_TEST(test_stop_discards_queue);
+    return UNITY_END();
+}